@@ -1,7 +1,16 @@
 #ifndef GLOBALS_H
 #define GLOBALS_H
 
-#define FRAME_SIZE 2048 // adc read frame size in bytes
+#define FRAME_SIZE 2048 // adc read frame size in bytes per audio channel, i2s frames hold FRAME_SIZE/2 samples
 #define SAMPLE_RATE 32000 //in hz
+#define ADC_SCAN 1 // 1 scans the aux line-in and the mic volume, music volume and echo knobs along with the mic, 0 reads the mic alone
+#if ADC_SCAN
+#define ADC_SCAN_STRIDE 3 // conversions per audio sample: mic, aux and one of the knobs in turn
+#else
+#define ADC_SCAN_STRIDE 1
+#endif
+#define ADC_FRAME_SIZE (FRAME_SIZE * ADC_SCAN_STRIDE) // adc read frame size in bytes
+#define ECHO_DELAY 4096 // samples, 128 ms
+#define FRAME_QUEUE_LEN 6 // frames each queue between tasks can hold
 
 #endif
\ No newline at end of file
@@ -6,6 +6,11 @@
 #include "utils.h"
 
 void adc_init(adc_continuous_handle_t* handle_ptr, uint32_t frame_size, uint32_t sample_rate) {
+    const adc_scan_entry_t mic[1] = { { ADC_CHANNEL_0, ADC_ATTEN_DB_6 } }; // ADC1 channel 0 (GPIO36)
+    adc_init_scan(handle_ptr, frame_size, sample_rate, mic, 1);
+}
+
+void adc_init_scan(adc_continuous_handle_t* handle_ptr, uint32_t frame_size, uint32_t sample_rate, const adc_scan_entry_t* scan, uint32_t scan_len) {
     adc_continuous_handle_cfg_t adc_init_config = {
         .max_store_buf_size = frame_size * 4,
         .conv_frame_size = frame_size // in bytes
@@ -13,24 +18,23 @@ void adc_init(adc_continuous_handle_t* handle_ptr, uint32_t frame_size, uint32_t
     ESP_ERROR_CHECK(adc_continuous_new_handle(&adc_init_config, handle_ptr));
 
     adc_continuous_config_t adc_read_config = {
-        .sample_freq_hz = sample_rate,  
-        .pattern_num = 1,
+        .sample_freq_hz = sample_rate, // conversions per second over the whole pattern
+        .pattern_num = scan_len,
         .conv_mode = ADC_CONV_SINGLE_UNIT_1, // ADC1 only
         .format = ADC_DIGI_OUTPUT_FORMAT_TYPE1
     };
 
-    adc_digi_pattern_config_t adc_pattern[1] = {
-        {
-            .atten = ADC_ATTEN_DB_6,
-            .channel = ADC_CHANNEL_0, // ADC1 channel 0 (GPIO36)
-            .unit = ADC_UNIT_1,
-            .bit_width = ADC_BITWIDTH_12
-        }
-    };
+    adc_digi_pattern_config_t adc_pattern[SOC_ADC_PATT_LEN_MAX] = { 0 };
+    for (uint32_t i = 0; i < scan_len && i < SOC_ADC_PATT_LEN_MAX; i++) {
+        adc_pattern[i].atten = scan[i].atten;
+        adc_pattern[i].channel = scan[i].channel;
+        adc_pattern[i].unit = ADC_UNIT_1;
+        adc_pattern[i].bit_width = ADC_BITWIDTH_12;
+    }
 
     adc_read_config.adc_pattern = adc_pattern;
     ESP_ERROR_CHECK(adc_continuous_config(*handle_ptr, &adc_read_config));
-    printf("ADC continuous driver initialized\n");
+    printf("ADC continuous driver initialized, %lu channel pattern\n", (unsigned long)scan_len);
 }
 
 esp_err_t adc_read_once(adc_continuous_handle_t* handle_ptr, uint8_t* data, uint32_t frame_size, uint16_t delay) {
@@ -6,6 +6,17 @@
 // initialize the adc continuous driver on ADC1 channel 0 (GPIO36)
 void adc_init(adc_continuous_handle_t* handle_ptr, uint32_t frame_size, uint32_t sample_rate);
 
+// one entry of a scan pattern
+typedef struct {
+    adc_channel_t channel; // ADC1
+    adc_atten_t atten;
+} adc_scan_entry_t;
+
+// initialize the adc continuous driver to convert the ADC1 channels in scan in turn, over and over.
+// sample_rate is conversions per second across all of them, at most SOC_ADC_PATT_LEN_MAX entries.
+// the TYPE1 results carry their channel id, AdcInput's demux splits them
+void adc_init_scan(adc_continuous_handle_t* handle_ptr, uint32_t frame_size, uint32_t sample_rate, const adc_scan_entry_t* scan, uint32_t scan_len);
+
 // fills data from adc stream once.
 // will fail if init & start not called first
 esp_err_t adc_read_once(adc_continuous_handle_t* handle_ptr, uint8_t* data, uint32_t frame_size, uint16_t delay);
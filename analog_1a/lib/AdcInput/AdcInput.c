@@ -0,0 +1,158 @@
+#include <string.h>
+#include "AdcInput.h"
+
+static inline int16_t sat16(int32_t x) {
+    if (x > INT16_MAX) return INT16_MAX;
+    if (x < INT16_MIN) return INT16_MIN;
+    return (int16_t)x;
+}
+
+void adc_input_init(adc_input_t* in, uint8_t dc_shift, int16_t gate) {
+    memset(in, 0, sizeof(*in));
+    in->dc_shift = dc_shift;
+    in->gate = gate;
+}
+
+// num / range as a Q15 mantissa and shift. range >= 2, so the gain never needs a negative shift
+static void reciprocal(uint32_t num, uint32_t range, int32_t* gain, uint8_t* shift) {
+    uint8_t sh = 0;
+    uint32_t g = (num + range / 2) / range;
+    while (g < (1 << 14)) {
+        sh++;
+        g = ((num << sh) + range / 2) / range;
+    }
+    *gain = (int32_t)g;
+    *shift = sh;
+}
+
+adc_input_scale_t adc_input_scale(uint16_t dc) {
+    if (dc < 2) dc = 2; // keep both sides at least 2 wide
+    if (dc > ADC_INPUT_MAX - 2) dc = ADC_INPUT_MAX - 2;
+    adc_input_scale_t s;
+    reciprocal(32767, ADC_INPUT_MAX - dc, &s.pos_gain, &s.pos_shift);
+    reciprocal(32768, dc, &s.neg_gain, &s.neg_shift);
+    return s;
+}
+
+// the differences are kept in Q3 so the fractional part of the dc isn't lost: |x| < 2^15 and gain < 2^15, so the
+// product fits 32 bits
+static inline int16_t adc_input_sample(adc_input_t* in, const adc_input_scale_t* s, uint32_t raw) {
+    int32_t sample = raw & ADC_INPUT_MAX; // TYPE1: channel in the top 4 bits
+    int32_t x = (sample << 3) - (int32_t)(in->dc >> 13);
+    in->dc += (int32_t)((sample << 16) - (int32_t)in->dc) >> in->dc_shift;
+    int32_t y = (x >= 0) ? (x * s->pos_gain) >> (s->pos_shift + 3) : -((-x * s->neg_gain) >> (s->neg_shift + 3));
+    if (y < in->gate && y > -in->gate) return 0;
+    return sat16(y);
+}
+
+static void adc_input_seed(adc_input_t* in, uint32_t sum, uint32_t n) {
+    in->dc = (n > 0) ? (uint32_t)(((uint64_t)sum << 16) / n) : (2048u << 16);
+    in->seeded = true;
+}
+
+static inline adc_input_scale_t adc_input_frame_scale(const adc_input_t* in) {
+    return adc_input_scale((uint16_t)((in->dc + 0x8000) >> 16));
+}
+
+void adc_input_process(adc_input_t* in, const uint8_t* raw, int16_t* out, size_t count) {
+    const uint32_t* words = (const uint32_t*)raw; // two results per load
+    if (!in->seeded) {
+        uint32_t sum = 0;
+        for (size_t i = 0; i < count / 2; i++) sum += (words[i] & ADC_INPUT_MAX) + ((words[i] >> 16) & ADC_INPUT_MAX);
+        adc_input_seed(in, sum, (uint32_t)count);
+    }
+    adc_input_scale_t s = adc_input_frame_scale(in);
+    for (size_t i = 0; i < count / 2; i++) {
+        uint32_t w = words[i]; // little endian, the earlier result in the low half
+        out[2 * i] = adc_input_sample(in, &s, w);
+        out[2 * i + 1] = adc_input_sample(in, &s, w >> 16);
+    }
+}
+
+void adc_demux_init(adc_demux_t* demux) {
+    memset(demux, 0, sizeof(*demux));
+    memset(demux->route, ADC_DEMUX_SKIP, sizeof(demux->route));
+}
+
+int adc_demux_add_stream(adc_demux_t* demux, uint8_t channel, uint8_t dc_shift, int16_t gate) {
+    if (channel >= ADC_DEMUX_CHANNELS || demux->route[channel] != ADC_DEMUX_SKIP || demux->stream_count >= ADC_DEMUX_MAX_STREAMS) {
+        return -1;
+    }
+    adc_input_init(&demux->streams[demux->stream_count], dc_shift, gate);
+    demux->route[channel] = demux->stream_count;
+    return demux->stream_count++;
+}
+
+int adc_demux_add_control(adc_demux_t* demux, uint8_t channel, uint8_t decim_shift, uint8_t smooth_shift) {
+    if (channel >= ADC_DEMUX_CHANNELS || demux->route[channel] != ADC_DEMUX_SKIP || demux->control_count >= ADC_DEMUX_MAX_CONTROLS) {
+        return -1;
+    }
+    adc_control_t* ctl = &demux->controls[demux->control_count];
+    memset(ctl, 0, sizeof(*ctl));
+    ctl->decim_shift = (decim_shift > 15) ? 15 : decim_shift; // n counts to 2^15, and 2^15 results of 12 bits fit the sum
+    ctl->smooth_shift = smooth_shift;
+    demux->route[channel] = ADC_DEMUX_CONTROL | demux->control_count;
+    return demux->control_count++;
+}
+
+static inline void adc_control_sample(adc_control_t* ctl, uint32_t sample) {
+    ctl->sum += sample;
+    if (++ctl->n < (1u << ctl->decim_shift)) return;
+    uint32_t avg = (ctl->sum << (16 - ctl->decim_shift)); // Q16 mean
+    if (ctl->seeded) {
+        ctl->value += (int32_t)(avg - ctl->value) >> ctl->smooth_shift;
+    } else {
+        ctl->value = avg;
+        ctl->seeded = true;
+    }
+    ctl->sum = 0;
+    ctl->n = 0;
+}
+
+// d is a local copy of the demux, so the sample stores can't alias its state and force reloads
+static inline void adc_demux_sample(adc_demux_t* d, const adc_input_scale_t* scale, int16_t** out, size_t* n,
+    size_t capacity, uint32_t raw) {
+    uint8_t route = d->route[(raw >> 12) & 0xF];
+    if (route < ADC_DEMUX_MAX_STREAMS) {
+        int16_t y = adc_input_sample(&d->streams[route], &scale[route], raw);
+        if (n[route] < capacity) out[route][n[route]++] = y;
+        else d->overflowed++;
+    } else if (route != ADC_DEMUX_SKIP) {
+        adc_control_sample(&d->controls[route & ~ADC_DEMUX_CONTROL], raw & ADC_INPUT_MAX);
+    } else {
+        d->unrouted++;
+    }
+}
+
+void adc_demux_process(adc_demux_t* demux, const uint8_t* raw, size_t count, int16_t* const* out, size_t capacity,
+    size_t* out_count) {
+    const uint32_t* words = (const uint32_t*)raw;
+    if (demux->stream_count > 0 && !demux->streams[demux->stream_count - 1].seeded) {
+        // first frame: every stream's dc starts from its mean
+        uint32_t sum[ADC_DEMUX_MAX_STREAMS] = { 0 }, n[ADC_DEMUX_MAX_STREAMS] = { 0 };
+        for (size_t i = 0; i < count; i++) {
+            uint32_t r = (uint32_t)raw[2 * i] | (uint32_t)raw[2 * i + 1] << 8;
+            uint8_t route = demux->route[(r >> 12) & 0xF];
+            if (route < ADC_DEMUX_MAX_STREAMS) {
+                sum[route] += r & ADC_INPUT_MAX;
+                n[route]++;
+            }
+        }
+        for (uint8_t s = 0; s < demux->stream_count; s++) adc_input_seed(&demux->streams[s], sum[s], n[s]);
+    }
+    adc_demux_t d = *demux;
+    adc_input_scale_t scale[ADC_DEMUX_MAX_STREAMS];
+    int16_t* o[ADC_DEMUX_MAX_STREAMS];
+    size_t n[ADC_DEMUX_MAX_STREAMS] = { 0 };
+    for (uint8_t s = 0; s < d.stream_count; s++) {
+        scale[s] = adc_input_frame_scale(&d.streams[s]);
+        o[s] = out[s];
+    }
+    for (size_t i = 0; i < count / 2; i++) {
+        uint32_t w = words[i];
+        adc_demux_sample(&d, scale, o, n, capacity, w & 0xFFFF);
+        adc_demux_sample(&d, scale, o, n, capacity, w >> 16);
+    }
+    *demux = d;
+    for (uint8_t s = 0; s < d.stream_count; s++) out_count[s] = n[s];
+}
@@ -0,0 +1,89 @@
+#ifndef ADCINPUT_H
+#define ADCINPUT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// adc continuous TYPE1 results to signed 16 bit audio in one pass: unpack the 12 bit value, take off the dc with a
+// running one-pole high-pass, scale each side of the dc to full range and gate. the dc estimate follows the bias
+// as it drifts with temperature, so there is no boot-time calibration. the scale factors are reciprocals worked out
+// once per frame, so there is no division per sample. portable c, no esp-idf dependencies
+
+#define ADC_INPUT_MAX 4095 // 12 bit results
+
+typedef struct {
+    uint32_t dc; // Q16 running mean of the raw results
+    uint8_t dc_shift; // high-pass pole is 1 - 2^-dc_shift, the corner is sample_rate / (2 pi 2^dc_shift)
+    bool seeded; // dc starts from the first frame's mean
+    int16_t gate; // outputs below this magnitude are zeroed, 0 for no gate
+} adc_input_t;
+
+void adc_input_init(adc_input_t* in, uint8_t dc_shift, int16_t gate);
+
+// raw holds count TYPE1 words as read from the driver and has to be 4 byte aligned. count has to be even
+void adc_input_process(adc_input_t* in, const uint8_t* raw, int16_t* out, size_t count);
+
+// scale factors for a given dc, as adc_input_process uses them. gain is a Q15 mantissa in [0.5, 1), so
+// diff * gain >> shift stands in for diff * 32767 / (4095 - dc) above the dc and diff * 32768 / dc below it
+typedef struct {
+    int32_t pos_gain, neg_gain;
+    uint8_t pos_shift, neg_shift;
+} adc_input_scale_t;
+
+adc_input_scale_t adc_input_scale(uint16_t dc);
+
+// scan mode: several channels interleaved in one continuous stream. the demux routes every TYPE1 result by its
+// channel id, either to an audio stream (the adc_input_process path above, one per channel) or to a control, a knob
+// that is averaged over 2^decim_shift results and then smoothed with a one-pole, 1 - 2^-smooth_shift, per average.
+// the whole frame is one pass, whatever order the pattern puts the channels in
+#define ADC_DEMUX_CHANNELS 16 // TYPE1 channel ids are 4 bits
+#define ADC_DEMUX_MAX_STREAMS 2
+#define ADC_DEMUX_MAX_CONTROLS 4
+
+typedef struct {
+    uint32_t sum; // results since the last average
+    uint16_t n;
+    uint8_t decim_shift;
+    uint8_t smooth_shift;
+    bool seeded; // the first average is taken as is
+    uint32_t value; // Q16, 0..ADC_INPUT_MAX
+} adc_control_t;
+
+typedef struct {
+    uint8_t route[ADC_DEMUX_CHANNELS]; // ADC_DEMUX_SKIP, a stream index, or ADC_DEMUX_CONTROL | control index
+    adc_input_t streams[ADC_DEMUX_MAX_STREAMS];
+    uint8_t stream_count;
+    adc_control_t controls[ADC_DEMUX_MAX_CONTROLS];
+    uint8_t control_count;
+    uint32_t unrouted; // results from a channel nobody asked for
+    uint32_t overflowed; // stream results past the room the caller gave, dropped
+} adc_demux_t;
+
+#define ADC_DEMUX_SKIP 0xFF
+#define ADC_DEMUX_CONTROL 0x80
+
+void adc_demux_init(adc_demux_t* demux);
+
+// return the stream or control index, or -1 if the channel is taken or there's no room
+int adc_demux_add_stream(adc_demux_t* demux, uint8_t channel, uint8_t dc_shift, int16_t gate);
+int adc_demux_add_control(adc_demux_t* demux, uint8_t channel, uint8_t decim_shift, uint8_t smooth_shift);
+
+// raw holds count TYPE1 words, 4 byte aligned, count even. out[s] gets stream s and has room for capacity samples,
+// out_count[s] is how many it got. a frame that has more of a stream than that, a pattern gone wrong or a corrupt
+// read, still runs the stream's dc tracker over the extra results but drops them and counts them in overflowed
+void adc_demux_process(adc_demux_t* demux, const uint8_t* raw, size_t count, int16_t* const* out, size_t capacity,
+    size_t* out_count);
+
+// smoothed knob position, 0..ADC_INPUT_MAX
+static inline uint16_t adc_demux_control(const adc_demux_t* demux, int index) {
+    return (uint16_t)((demux->controls[index].value + 0x8000) >> 16);
+}
+
+// knob position as a Q15 gain, 0..32767, no division
+static inline int16_t adc_demux_gain(const adc_demux_t* demux, int index) {
+    uint16_t v = adc_demux_control(demux, index);
+    return (int16_t)((v << 3) | (v >> 9));
+}
+
+#endif
@@ -0,0 +1,128 @@
+#include <math.h>
+#include <string.h>
+#include "Filter.h"
+
+static inline int16_t sat16(int32_t x) {
+    if (x > INT16_MAX) return INT16_MAX;
+    if (x < INT16_MIN) return INT16_MIN;
+    return (int16_t)x;
+}
+
+void fir_init(fir_t* fir, const int16_t* coeffs, uint16_t taps) {
+    memset(fir, 0, sizeof(*fir));
+    fir->coeffs = coeffs;
+    fir->taps = (taps > FIR_MAX_TAPS) ? FIR_MAX_TAPS : taps;
+}
+
+// pushes one sample, returns the window starting at the newest
+static inline const int16_t* fir_push(fir_t* fir, int16_t x) {
+    fir->pos = (fir->pos == 0) ? fir->taps - 1 : fir->pos - 1;
+    fir->delay[fir->pos] = x;
+    fir->delay[fir->pos + fir->taps] = x;
+    return &fir->delay[fir->pos];
+}
+
+static inline int16_t fir_dot(const int16_t* coeffs, const int16_t* window, uint16_t taps) {
+    int32_t acc = 1 << 14; // round
+    for (uint16_t k = 0; k < taps; k++) acc += coeffs[k] * window[k]; // 16x16 mac
+    return sat16(acc >> 15);
+}
+
+void fir_process(fir_t* fir, const int16_t* in, int16_t* out, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        const int16_t* window = fir_push(fir, in[i]);
+        out[i] = fir_dot(fir->coeffs, window, fir->taps);
+    }
+}
+
+void biquad_cascade_init(biquad_cascade_t* bc) {
+    memset(bc, 0, sizeof(*bc));
+}
+
+static int biquad_cascade_add(biquad_cascade_t* bc, double b0, double b1, double b2, double a0, double a1, double a2) {
+    if (bc->sections >= BIQUAD_MAX_SECTIONS) return -1;
+    float* c = bc->coeffs[bc->sections];
+    c[0] = (float)(b0 / a0);
+    c[1] = (float)(b1 / a0);
+    c[2] = (float)(b2 / a0);
+    c[3] = (float)(a1 / a0);
+    c[4] = (float)(a2 / a0);
+    bc->state[bc->sections][0] = bc->state[bc->sections][1] = 0.0f;
+    return bc->sections++;
+}
+
+int biquad_cascade_add_lowpass(biquad_cascade_t* bc, float sample_rate, float freq, float q) {
+    double w0 = 2.0 * M_PI * freq / sample_rate;
+    double cos_w0 = cos(w0);
+    double alpha = sin(w0) / (2.0 * q);
+    return biquad_cascade_add(bc, (1.0 - cos_w0) / 2.0, 1.0 - cos_w0, (1.0 - cos_w0) / 2.0, 1.0 + alpha, -2.0 * cos_w0, 1.0 - alpha);
+}
+
+int biquad_cascade_add_highpass(biquad_cascade_t* bc, float sample_rate, float freq, float q) {
+    double w0 = 2.0 * M_PI * freq / sample_rate;
+    double cos_w0 = cos(w0);
+    double alpha = sin(w0) / (2.0 * q);
+    return biquad_cascade_add(bc, (1.0 + cos_w0) / 2.0, -(1.0 + cos_w0), (1.0 + cos_w0) / 2.0, 1.0 + alpha, -2.0 * cos_w0, 1.0 - alpha);
+}
+
+// one section over a float block in place
+static void biquad_section(const float* c, float* w, float* data, size_t count) {
+    const float b0 = c[0], b1 = c[1], b2 = c[2], a1 = c[3], a2 = c[4];
+    float s1 = w[0], s2 = w[1];
+    for (size_t i = 0; i < count; i++) {
+        float x = data[i];
+        float y = b0 * x + s1;
+        s1 = b1 * x - a1 * y + s2;
+        s2 = b2 * x - a2 * y;
+        data[i] = y;
+    }
+    w[0] = s1;
+    w[1] = s2;
+}
+
+void biquad_cascade_process(biquad_cascade_t* bc, const int16_t* in, int16_t* out, size_t count) {
+    while (count > 0) {
+        size_t n = (count > FILTER_BLOCK) ? FILTER_BLOCK : count;
+        for (size_t i = 0; i < n; i++) bc->scratch[i] = in[i];
+        for (uint8_t s = 0; s < bc->sections; s++) biquad_section(bc->coeffs[s], bc->state[s], bc->scratch, n);
+        for (size_t i = 0; i < n; i++) out[i] = sat16((int32_t)lrintf(bc->scratch[i]));
+        in += n;
+        out += n;
+        count -= n;
+    }
+}
+
+void decimator_init(decimator_t* dec, const int16_t* coeffs, uint16_t taps, uint16_t factor) {
+    fir_init(&dec->fir, coeffs, taps);
+    dec->factor = (factor == 0) ? 1 : factor;
+    dec->phase = 0;
+}
+
+size_t decimator_process(decimator_t* dec, const int16_t* in, int16_t* out, size_t count) {
+    size_t written = 0;
+    for (size_t i = 0; i < count; i++) {
+        const int16_t* window = fir_push(&dec->fir, in[i]);
+        if (++dec->phase == dec->factor) {
+            dec->phase = 0;
+            out[written++] = fir_dot(dec->fir.coeffs, window, dec->fir.taps);
+        }
+    }
+    return written;
+}
+
+void comb_init(comb_t* comb, int16_t* line, uint16_t length, int16_t feedback) {
+    memset(line, 0, length * sizeof(int16_t));
+    comb->line = line;
+    comb->length = length;
+    comb->pos = 0;
+    comb->feedback = feedback;
+}
+
+void comb_process(comb_t* comb, const int16_t* in, int16_t* out, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        int16_t y = sat16(in[i] + ((comb->line[comb->pos] * comb->feedback) >> 15));
+        comb->line[comb->pos] = y;
+        out[i] = y;
+        if (++comb->pos == comb->length) comb->pos = 0;
+    }
+}
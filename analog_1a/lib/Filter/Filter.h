@@ -0,0 +1,65 @@
+#ifndef FILTER_H
+#define FILTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// block filters with per-instance state, so any number of streams can be filtered side by side.
+// every process call takes a whole frame of 16 bit samples; in and out may be the same buffer. portable c.
+
+// fir, Q15 coefficients. the sum of |coeffs| has to stay below 2.0 so the 32 bit accumulator can't overflow
+#define FIR_MAX_TAPS 64
+
+typedef struct {
+    const int16_t* coeffs; // Q15, caller keeps them alive
+    uint16_t taps;
+    uint16_t pos; // newest sample sits at delay[pos] (and delay[pos + taps])
+    int16_t delay[2 * FIR_MAX_TAPS]; // every sample is stored twice so each window is contiguous, no wrap or modulo
+} fir_t;
+
+void fir_init(fir_t* fir, const int16_t* coeffs, uint16_t taps);
+void fir_process(fir_t* fir, const int16_t* in, int16_t* out, size_t count);
+
+// transposed direct form II biquad cascade in float
+#define BIQUAD_MAX_SECTIONS 4
+#define FILTER_BLOCK 256 // samples converted to float at a time
+
+typedef struct {
+    float coeffs[BIQUAD_MAX_SECTIONS][5]; // b0, b1, b2, a1, a2 (a0 normalized to 1)
+    float state[BIQUAD_MAX_SECTIONS][2];
+    uint8_t sections;
+    float scratch[FILTER_BLOCK];
+} biquad_cascade_t;
+
+void biquad_cascade_init(biquad_cascade_t* bc);
+
+// rbj cookbook sections, appended in order. return the section index, or -1 if the cascade is full
+int biquad_cascade_add_lowpass(biquad_cascade_t* bc, float sample_rate, float freq, float q);
+int biquad_cascade_add_highpass(biquad_cascade_t* bc, float sample_rate, float freq, float q);
+
+void biquad_cascade_process(biquad_cascade_t* bc, const int16_t* in, int16_t* out, size_t count);
+
+// decimate by factor: anti-alias fir (Q15, same limits as fir_t) evaluated only at the kept outputs, so the cost is
+// taps per output instead of taps per input. count is in input samples, returns the outputs written
+typedef struct {
+    fir_t fir;
+    uint16_t factor;
+    uint16_t phase; // inputs since the last output
+} decimator_t;
+
+void decimator_init(decimator_t* dec, const int16_t* coeffs, uint16_t taps, uint16_t factor);
+size_t decimator_process(decimator_t* dec, const int16_t* in, int16_t* out, size_t count);
+
+// feedback comb, a plain echo: out = in + feedback * out from length samples ago. the caller owns the delay line.
+// feedback is Q15 and has to stay below 1.0
+typedef struct {
+    int16_t* line;
+    uint16_t length;
+    uint16_t pos;
+    int16_t feedback; // Q15, may be changed between calls
+} comb_t;
+
+void comb_init(comb_t* comb, int16_t* line, uint16_t length, int16_t feedback);
+void comb_process(comb_t* comb, const int16_t* in, int16_t* out, size_t count);
+
+#endif
@@ -0,0 +1,61 @@
+#include "FramePool.h"
+
+#define NONE 0xFFFF // end of the free list
+#define IN_USE 0xFFFE // next[] of an allocated block
+
+static inline uint32_t pack(uint32_t head, uint16_t index) {
+    return ((head >> 16) + 1) << 16 | index; // bump the change count on every swap
+}
+
+void frame_pool_init(frame_pool_t* pool, void* storage, size_t block_size, uint32_t block_count) {
+    pool->storage = storage;
+    pool->block_size = block_size;
+    pool->block_count = (block_count > FRAME_POOL_MAX_BLOCKS) ? FRAME_POOL_MAX_BLOCKS : block_count;
+    for (uint32_t i = 0; i < FRAME_POOL_MAX_BLOCKS; i++) {
+        atomic_init(&pool->next[i], (i + 1 < pool->block_count) ? (uint16_t)(i + 1) : NONE);
+    }
+    atomic_init(&pool->head, (pool->block_count > 0) ? 0 : NONE);
+    atomic_init(&pool->in_use, 0);
+    atomic_init(&pool->max_in_use, 0);
+    atomic_init(&pool->exhausted, 0);
+    atomic_init(&pool->bad_frees, 0);
+}
+
+void* frame_pool_alloc(frame_pool_t* pool) {
+    uint32_t head = atomic_load_explicit(&pool->head, memory_order_acquire);
+    uint16_t index;
+    do {
+        index = head & 0xFFFF;
+        if (index == NONE) {
+            atomic_fetch_add_explicit(&pool->exhausted, 1, memory_order_relaxed);
+            return NULL;
+        }
+        // may read a stale next if the block was taken meanwhile, the change count then fails the swap
+    } while (!atomic_compare_exchange_weak_explicit(&pool->head, &head,
+                 pack(head, atomic_load_explicit(&pool->next[index], memory_order_relaxed)), memory_order_acquire, memory_order_acquire));
+    atomic_store_explicit(&pool->next[index], IN_USE, memory_order_relaxed);
+
+    uint32_t used = atomic_fetch_add_explicit(&pool->in_use, 1, memory_order_relaxed) + 1;
+    uint32_t peak = atomic_load_explicit(&pool->max_in_use, memory_order_relaxed);
+    while (used > peak && !atomic_compare_exchange_weak_explicit(&pool->max_in_use, &peak, used, memory_order_relaxed, memory_order_relaxed)) {}
+    return pool->storage + (size_t)index * pool->block_size;
+}
+
+void frame_pool_free(frame_pool_t* pool, void* block) {
+    if (block == NULL) return;
+    size_t offset = (size_t)((uint8_t*)block - pool->storage);
+    uint16_t index = (uint16_t)(offset / pool->block_size);
+    uint16_t expected = IN_USE;
+    // outside the pool, not on a block boundary, or already free
+    if ((uint8_t*)block < pool->storage || index >= pool->block_count || offset % pool->block_size != 0 ||
+        !atomic_compare_exchange_strong_explicit(&pool->next[index], &expected, NONE, memory_order_relaxed, memory_order_relaxed)) {
+        atomic_fetch_add_explicit(&pool->bad_frees, 1, memory_order_relaxed);
+        return;
+    }
+    atomic_fetch_sub_explicit(&pool->in_use, 1, memory_order_relaxed);
+
+    uint32_t head = atomic_load_explicit(&pool->head, memory_order_relaxed);
+    do {
+        atomic_store_explicit(&pool->next[index], (uint16_t)(head & 0xFFFF), memory_order_relaxed);
+    } while (!atomic_compare_exchange_weak_explicit(&pool->head, &head, pack(head, index), memory_order_release, memory_order_relaxed));
+}
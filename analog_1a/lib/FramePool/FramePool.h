@@ -0,0 +1,47 @@
+#ifndef FRAMEPOOL_H
+#define FRAMEPOOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+// fixed-block pool over static storage, so frames handed between tasks never touch the heap.
+// free blocks sit on a lock-free stack; alloc and free are a single compare-and-swap each (retried only if another
+// core or an isr got in between), so any task or isr may call them. portable c11 atomics, no esp-idf or freertos
+// dependencies. the head carries a change count next to the block index so a block freed and reallocated under a
+// slow alloc can't corrupt the list
+
+#define FRAME_POOL_MAX_BLOCKS 64
+
+typedef struct {
+    uint8_t* storage; // block_count blocks of block_size bytes, back to back
+    size_t block_size;
+    uint32_t block_count;
+    _Atomic uint32_t head; // change count << 16 | index of the first free block
+    _Atomic uint16_t next[FRAME_POOL_MAX_BLOCKS]; // next free block, or a marker while allocated
+    _Atomic uint32_t in_use;
+    _Atomic uint32_t max_in_use;
+    _Atomic uint32_t exhausted; // allocs that found every block taken
+    _Atomic uint32_t bad_frees; // frees of a pointer that isn't an allocated block of this pool, ignored
+} frame_pool_t;
+
+// storage must hold block_count*block_size bytes. block_count is capped at FRAME_POOL_MAX_BLOCKS
+void frame_pool_init(frame_pool_t* pool, void* storage, size_t block_size, uint32_t block_count);
+
+// a free block, or NULL (and an exhaustion is counted) if every block is in use
+void* frame_pool_alloc(frame_pool_t* pool);
+
+// gives a block back. NULL is ignored
+void frame_pool_free(frame_pool_t* pool, void* block);
+
+// typed front end, so an adc frame can't be handed to the pcm pool by mistake. FRAME_POOL_TYPED(adc_pool, adc_frame_t)
+// declares adc_pool_t with adc_pool_init(pool, adc_frame_t* storage, count), adc_pool_alloc(pool) and
+// adc_pool_free(pool, frame)
+#define FRAME_POOL_TYPED(name, type) \
+    typedef struct { frame_pool_t pool; } name##_t; \
+    static inline void name##_init(name##_t* p, type* storage, uint32_t count) { frame_pool_init(&p->pool, storage, sizeof(type), count); } \
+    static inline type* name##_alloc(name##_t* p) { return (type*)frame_pool_alloc(&p->pool); } \
+    static inline void name##_free(name##_t* p, type* frame) { frame_pool_free(&p->pool, frame); }
+
+#endif
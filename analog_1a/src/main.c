@@ -4,6 +4,9 @@
 #include "ADC.h"
 #include "I2S.h"
 #include "utils.h" 
+#include "Filter.h"
+#include "FramePool.h"
+#include "AdcInput.h"
 #include "constants.h"
 #include "math.h"
 
@@ -14,63 +17,109 @@ QueueHandle_t adc_queue = NULL;
 QueueHandle_t i2s_queue = NULL;
 const int adc_delay_ms = 1000*FRAME_SIZE/SAMPLE_RATE; // how long adc_continuous_read should wait for reads
 
-// anti cricket stuff.
-static const int16_t fir7[4] = { 175, 603, 886, 1024 }; // Q15 coeffs
-static int16_t lowpass_delay[7];
-static uint8_t idx = 0;
+#if ADC_SCAN
+// mic and aux take every third conversion so both are evenly spaced at SAMPLE_RATE, the knobs share the rest
+static const adc_scan_entry_t adc_scan[] = {
+    { ADC_CHANNEL_0, ADC_ATTEN_DB_6 }, // mic, GPIO36
+    { ADC_CHANNEL_3, ADC_ATTEN_DB_6 }, // aux line-in, GPIO39
+    { ADC_CHANNEL_6, ADC_ATTEN_DB_12 }, // mic volume knob, GPIO34
+    { ADC_CHANNEL_0, ADC_ATTEN_DB_6 },
+    { ADC_CHANNEL_3, ADC_ATTEN_DB_6 },
+    { ADC_CHANNEL_7, ADC_ATTEN_DB_12 }, // music volume knob, GPIO35
+    { ADC_CHANNEL_0, ADC_ATTEN_DB_6 },
+    { ADC_CHANNEL_3, ADC_ATTEN_DB_6 },
+    { ADC_CHANNEL_4, ADC_ATTEN_DB_12 }, // echo knob, GPIO32
+};
+#else
+static const adc_scan_entry_t adc_scan[] = {
+    { ADC_CHANNEL_0, ADC_ATTEN_DB_6 }, // mic, GPIO36
+};
+#endif
 
-int16_t lowpass_7kHz(int16_t x) {
-    lowpass_delay[idx] = x;
-
-    int32_t acc =  fir7[3] * lowpass_delay[idx]                                 // h3·x[n-3]
-                 + fir7[2] * (lowpass_delay[(idx+6)%7] + lowpass_delay[(idx+1)%7])      // h2·(x[n]+x[n-6])
-                 + fir7[1] * (lowpass_delay[(idx+5)%7] + lowpass_delay[(idx+2)%7])      // h1· …
-                 + fir7[0] * (lowpass_delay[(idx+4)%7] + lowpass_delay[(idx+3)%7]);     // h0· …
-
-    idx = (idx + 1) % 7;
-    return (int16_t)(acc >> 15);
-}
+// anti cricket stuff. 7 tap linear phase lowpass, ~7 kHz
+static const int16_t fir7[7] = { 175, 603, 886, 1024, 886, 603, 175 }; // Q15 coeffs
+static fir_t lowpass_7kHz;
+static adc_demux_t adc_demux; // splits the scan by channel. dc tracking and scaling per audio channel
+enum { STREAM_MIC, STREAM_AUX };
+enum { KNOB_MIC, KNOB_MUSIC, KNOB_ECHO };
+#if ADC_SCAN
+static int16_t aux_samples[FRAME_SIZE/2];
+static int16_t echo_line[ECHO_DELAY];
+static comb_t echo;
+#endif
 
+// frames live in static pools instead of the heap. every frame is either free, queued, or held by one task, so
+// a queue's worth plus one per task at each end covers it
+typedef struct { _Alignas(4) uint8_t bytes[ADC_FRAME_SIZE]; } adc_frame_t; // raw TYPE1 results, aligned for adc_demux_process
+typedef struct { int16_t samples[FRAME_SIZE/2]; } pcm_frame_t; // i2s samples, one per mic result
+FRAME_POOL_TYPED(adc_pool, adc_frame_t)
+FRAME_POOL_TYPED(pcm_pool, pcm_frame_t)
+#define POOL_FRAMES (FRAME_QUEUE_LEN + 2)
+static adc_frame_t adc_frames[POOL_FRAMES];
+static pcm_frame_t pcm_frames[POOL_FRAMES];
+static adc_pool_t adc_pool;
+static pcm_pool_t pcm_pool;
 
 // task to read adc data continuously
 void adc_read_task(void *param) {
+    static adc_frame_t drain; // keeps the driver's pool drained while every frame is taken
+    adc_frame_t* frame = NULL;
     while (1) {
-        uint8_t* data = malloc(FRAME_SIZE); // buffer in pure bytes
-        if (adc_read_once(&adc_handle, data, FRAME_SIZE, adc_delay_ms) == ESP_OK) { // safeguard against sending garbage into queue
-            if(xQueueSend(adc_queue, &data, pdMS_TO_TICKS(100)) != pdTRUE) { // send data to queue
+        if (frame == NULL) frame = adc_pool_alloc(&adc_pool); // kept across failed reads
+        if (frame == NULL) {
+            printf("ADC frame pool exhausted\n");
+            adc_read_once(&adc_handle, drain.bytes, ADC_FRAME_SIZE, adc_delay_ms); // drop a frame rather than spin
+            continue;
+        }
+        if (adc_read_once(&adc_handle, frame->bytes, ADC_FRAME_SIZE, adc_delay_ms) == ESP_OK) { // safeguard against sending garbage into queue
+            if(xQueueSend(adc_queue, &frame, pdMS_TO_TICKS(100)) != pdTRUE) { // send data to queue
                 printf("Failed to send adc data to queue\n");
-                free(data); // free if send failed. needs to freed on receiver end if send succeeds
-            } 
+                adc_pool_free(&adc_pool, frame); // free if send failed. needs to freed on receiver end if send succeeds
+            }
+            frame = NULL;
         }
     }
 }
 
 // adc to i2s processing task
 void adc_to_i2s_task(void *param) {
-    uint8_t* adc_data = malloc(FRAME_SIZE); 
-    uint16_t idle_adc_val;
-    // find idle value 
-    while(adc_read_once(&adc_handle, adc_data, FRAME_SIZE, adc_delay_ms) != ESP_OK) {}; // make sure we have valid data for idle calibration
-    idle_adc_val = find_idle_value(adc_data, FRAME_SIZE); // find idle value for i2s scaling
-    free(adc_data); // free after finding idle value
-    adc_data = NULL; // reset pointer
-
+    adc_frame_t* adc_data = NULL;
     while (1) {
         if (xQueueReceive(adc_queue, &adc_data, portMAX_DELAY) == pdTRUE) {
             if (adc_data != NULL) {
-                // scale to i2s format
-                int16_t* i2s_data = malloc(FRAME_SIZE/2 * sizeof(int16_t)); // allocate memory for i2s data
-                for (uint16_t i = 0; i < FRAME_SIZE; i += 2) {
-                    uint16_t sample = convert_adc_sample(adc_data[i], adc_data[i + 1]); // lower 12 bits are adc
-                    //printf("ADC Sample: %d\n", sample);
-                    i2s_data[i/2] = lowpass_7kHz(scale_adc_to_i2s(sample, idle_adc_val)); // 2048 adc half-samples filled into 1024 i2s samples
-                    if (abs(i2s_data[i/2]) < 500) i2s_data[i/2] = 0; // noise gate
-                    //printf("I2S Converted & filtered: %d\n", i2s_data[i/2]);
+                pcm_frame_t* pcm = pcm_pool_alloc(&pcm_pool);
+                if (pcm == NULL) {
+                    printf("I2S frame pool exhausted\n");
+                    adc_pool_free(&adc_pool, adc_data); // drop the frame
+                    continue;
+                }
+                // split by channel, remove dc and scale to i2s format in one pass
+                int16_t* i2s_data = pcm->samples;
+#if ADC_SCAN
+                int16_t* streams[2] = { i2s_data, aux_samples };
+                size_t got[2];
+                adc_demux_process(&adc_demux, adc_data->bytes, ADC_FRAME_SIZE/2, streams, FRAME_SIZE/2, got); // FRAME_SIZE/2 samples each
+                // mix by the knobs, then echo
+                int32_t mic_gain = adc_demux_gain(&adc_demux, KNOB_MIC);
+                int32_t music_gain = adc_demux_gain(&adc_demux, KNOB_MUSIC);
+                for (size_t i = 0; i < got[STREAM_MIC] && i < got[STREAM_AUX]; i++) {
+                    int32_t mixed = (i2s_data[i] * mic_gain + aux_samples[i] * music_gain) >> 15;
+                    i2s_data[i] = (mixed > INT16_MAX) ? INT16_MAX : (mixed < INT16_MIN) ? INT16_MIN : mixed;
                 }
-                free(adc_data); // free after processing
-                if(xQueueSend(i2s_queue, &i2s_data, pdMS_TO_TICKS(100)) != pdTRUE) {
+                echo.feedback = adc_demux_gain(&adc_demux, KNOB_ECHO) * 3 / 4; // knob fully up is 0.75 feedback
+                comb_process(&echo, i2s_data, i2s_data, FRAME_SIZE/2);
+#else
+                size_t got;
+                adc_demux_process(&adc_demux, adc_data->bytes, ADC_FRAME_SIZE/2, &i2s_data, FRAME_SIZE/2, &got); // 2048 adc bytes into 1024 i2s samples
+#endif
+                fir_process(&lowpass_7kHz, i2s_data, i2s_data, FRAME_SIZE/2); // whole frame at once
+                for (uint16_t i = 0; i < FRAME_SIZE/2; i++) {
+                    if (abs(i2s_data[i]) < 500) i2s_data[i] = 0; // noise gate, after the lowpass so its tails are gated too
+                }
+                adc_pool_free(&adc_pool, adc_data); // free after processing
+                if(xQueueSend(i2s_queue, &pcm, pdMS_TO_TICKS(100)) != pdTRUE) {
                     printf("Failed to send i2s data to queue\n");
-                    free(i2s_data); // free if send failed
+                    pcm_pool_free(&pcm_pool, pcm); // free if send failed
                 } 
             }
         } 
@@ -79,10 +128,11 @@ void adc_to_i2s_task(void *param) {
 
 // i2s out task
 void i2s_out_task(void *param) {
-    int16_t* i2s_data = NULL;
+    pcm_frame_t* pcm = NULL;
     while (1) {
-        if (xQueueReceive(i2s_queue, &i2s_data, portMAX_DELAY) == pdTRUE) {
-            if (i2s_data != NULL) {
+        if (xQueueReceive(i2s_queue, &pcm, portMAX_DELAY) == pdTRUE) {
+            if (pcm != NULL) {
+                int16_t* i2s_data = pcm->samples;
                 // reduce amplification and swap bits??
                 
                 for (uint16_t i = 0; i < FRAME_SIZE/2; i+=2) {
@@ -91,7 +141,7 @@ void i2s_out_task(void *param) {
                     i2s_data[i] = temp/2;
                 }
                 i2s_write_once(&i2s_out_handle, i2s_data, FRAME_SIZE/2 * sizeof(int16_t));
-                free(i2s_data); // free after writing
+                pcm_pool_free(&pcm_pool, pcm); // free after writing
             }
         } else {
             printf("Failed to receive i2s data from queue\n");
@@ -100,15 +150,28 @@ void i2s_out_task(void *param) {
 }
 
 void app_main(void) {
+    fir_init(&lowpass_7kHz, fir7, 7);
+    adc_demux_init(&adc_demux);
+    adc_demux_add_stream(&adc_demux, ADC_CHANNEL_0, 12, 0); // ~1.2 Hz dc corner, gated after the lowpass
+#if ADC_SCAN
+    adc_demux_add_stream(&adc_demux, ADC_CHANNEL_3, 12, 0);
+    adc_demux_add_control(&adc_demux, ADC_CHANNEL_6, 5, 3); // knobs average 32 results (~330 Hz), then smooth with a ~25 ms time constant
+    adc_demux_add_control(&adc_demux, ADC_CHANNEL_7, 5, 3);
+    adc_demux_add_control(&adc_demux, ADC_CHANNEL_4, 5, 3);
+    comb_init(&echo, echo_line, ECHO_DELAY, 0);
+#endif
+    adc_pool_init(&adc_pool, adc_frames, POOL_FRAMES);
+    pcm_pool_init(&pcm_pool, pcm_frames, POOL_FRAMES);
+
     // queue for adc readings
-    adc_queue = xQueueCreate(6, sizeof(uint8_t*)); // store pointers to data buffers to prevent unnecessary copies
+    adc_queue = xQueueCreate(FRAME_QUEUE_LEN, sizeof(adc_frame_t*)); // store pointers to data buffers to prevent unnecessary copies
     if (adc_queue == NULL) {
         printf("Failed to create adc queue\n");
         return;
     }
 
     // queue for i2s data
-    i2s_queue = xQueueCreate(6, sizeof(int16_t*)); // store pointers to i2s data buffers
+    i2s_queue = xQueueCreate(FRAME_QUEUE_LEN, sizeof(pcm_frame_t*)); // store pointers to i2s data buffers
     if (i2s_queue == NULL) {
         printf("Failed to create i2s queue\n");
         vQueueDelete(adc_queue); // cleanup adc queue
@@ -116,7 +179,7 @@ void app_main(void) {
     }
 
     // start ADC continuous sampling and I2S
-    adc_init(&adc_handle, FRAME_SIZE, SAMPLE_RATE);
+    adc_init_scan(&adc_handle, ADC_FRAME_SIZE, SAMPLE_RATE * ADC_SCAN_STRIDE, adc_scan, sizeof(adc_scan) / sizeof(adc_scan[0]));
     i2s_init(&i2s_out_handle, SAMPLE_RATE);
     ESP_ERROR_CHECK(adc_continuous_start(adc_handle));
     ESP_ERROR_CHECK(i2s_channel_enable(i2s_out_handle));
@@ -0,0 +1,74 @@
+#include "FrameRing.h"
+
+// head and tail count laps of 2*slot_count, so a full ring (slot_count apart) differs from an empty one and a
+// slot_count that doesn't divide 2^32 never hands out a slot still in use when they wrap
+static inline uint32_t ring_next(const frame_ring_t* ring, uint32_t pos) {
+    return (pos + 1 == 2 * ring->slot_count) ? 0 : pos + 1;
+}
+
+static inline uint32_t ring_used(const frame_ring_t* ring, uint32_t head, uint32_t tail) {
+    return (head >= tail) ? head - tail : head + 2 * ring->slot_count - tail;
+}
+
+static inline int32_t* ring_slot(const frame_ring_t* ring, uint32_t pos) {
+    return ring->pool + ((pos < ring->slot_count) ? pos : pos - ring->slot_count) * ring->frame_size;
+}
+
+void frame_ring_init(frame_ring_t* ring, int32_t* pool, size_t frame_size, uint32_t slot_count) {
+    ring->pool = pool;
+    ring->frame_size = frame_size;
+    ring->slot_count = slot_count;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->consumer_waiting, false);
+    atomic_init(&ring->overruns, 0);
+    atomic_init(&ring->max_occupancy, 0);
+}
+
+int32_t* frame_ring_acquire(frame_ring_t* ring) {
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire); // slot is free once the consumer released it
+    if (ring_used(ring, head, tail) >= ring->slot_count) {
+        atomic_fetch_add_explicit(&ring->overruns, 1, memory_order_relaxed);
+        return NULL;
+    }
+    return ring_slot(ring, head);
+}
+
+bool frame_ring_publish(frame_ring_t* ring) {
+    uint32_t head = ring_next(ring, atomic_load_explicit(&ring->head, memory_order_relaxed));
+    atomic_store_explicit(&ring->head, head, memory_order_seq_cst); // ordered before the waiting check below
+
+    uint32_t occupancy = ring_used(ring, head, atomic_load_explicit(&ring->tail, memory_order_relaxed));
+    if (occupancy > atomic_load_explicit(&ring->max_occupancy, memory_order_relaxed)) {
+        atomic_store_explicit(&ring->max_occupancy, occupancy, memory_order_relaxed); // only the producer writes this
+    }
+    return atomic_exchange_explicit(&ring->consumer_waiting, false, memory_order_seq_cst);
+}
+
+int32_t* frame_ring_peek(frame_ring_t* ring) {
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    if (tail == atomic_load_explicit(&ring->head, memory_order_acquire)) return NULL;
+    return ring_slot(ring, tail);
+}
+
+int32_t* frame_ring_prepare_wait(frame_ring_t* ring) {
+    int32_t* frame = frame_ring_peek(ring);
+    if (frame != NULL) return frame;
+    atomic_store_explicit(&ring->consumer_waiting, true, memory_order_seq_cst);
+    // recheck, a publish may have landed before the flag was visible. seq_cst pairs with the head store in publish
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    if (tail == atomic_load_explicit(&ring->head, memory_order_seq_cst)) return NULL;
+    atomic_store_explicit(&ring->consumer_waiting, false, memory_order_relaxed);
+    return ring_slot(ring, tail);
+}
+
+void frame_ring_release(frame_ring_t* ring) {
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    atomic_store_explicit(&ring->tail, ring_next(ring, tail), memory_order_release);
+}
+
+uint32_t frame_ring_occupancy(frame_ring_t* ring) {
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    return ring_used(ring, head, atomic_load_explicit(&ring->tail, memory_order_acquire));
+}
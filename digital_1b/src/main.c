@@ -4,27 +4,26 @@
 #include "I2S.h"
 #include "utils.h" 
 #include "constants.h"
+#include "FrameRing.h"
 #include "math.h"
 
 // global buffer
 static int32_t global_buffer[DMA_BUFFER_COUNT][FRAME_SIZE];
+static int32_t overrun_buffer[FRAME_SIZE]; // mic frames land here and get dropped while every slot is still in use
+static frame_ring_t mic_ring; // read task -> write task hand-off over global_buffer
 
 // handlers, runtime constants
 i2s_chan_handle_t i2s_in_handle = NULL;
 i2s_chan_handle_t i2s_out_handle = NULL;
-QueueHandle_t i2s_queue_free = NULL;
-QueueHandle_t i2s_queue_busy = NULL;
+TaskHandle_t write_task_handle = NULL;
 
 // read in i2s 
 void i2s_read_task(void* param) {
-    int32_t* raw_input_buffer;
     while(1) {
-        if (xQueueReceive(i2s_queue_free, &raw_input_buffer, portMAX_DELAY) == pdTRUE) { // Queue send and receive work with pointers of pointers
-            if (i2s_read_once(&i2s_in_handle, raw_input_buffer, FRAME_SIZE) == ESP_OK) {
-                if (xQueueSend(i2s_queue_busy, &raw_input_buffer, portMAX_DELAY) != pdTRUE) {
-                    printf("Could not send data to busy queue\n");
-                } 
-            }
+        int32_t* raw_input_buffer = frame_ring_acquire(&mic_ring);
+        if (raw_input_buffer == NULL) raw_input_buffer = overrun_buffer; // keep draining i2s so the dma doesn't overflow
+        if (i2s_read_once(&i2s_in_handle, raw_input_buffer, FRAME_SIZE) == ESP_OK && raw_input_buffer != overrun_buffer) {
+            if (frame_ring_publish(&mic_ring)) xTaskNotifyGive(write_task_handle); // only wake the writer if it is asleep
         }
     }
 }
@@ -34,44 +33,22 @@ void i2s_write_task(void *param) {
     int32_t* i2s_data = NULL;
     int16_t output_buffer[FRAME_SIZE*2];
     while (1) {
-        if (xQueueReceive(i2s_queue_busy, &i2s_data, portMAX_DELAY) == pdTRUE) {
-            if (i2s_data != NULL) {
-                for (int i = 0; i < FRAME_SIZE*2; i+=2) {
-                    output_buffer[i] = (int16_t)(i2s_data[i / 2] >> 16);
-                    output_buffer[i+1] = output_buffer[i];
-                }
-                i2s_write_once(&i2s_out_handle, output_buffer, FRAME_SIZE);
-            }
-            if (xQueueSend(i2s_queue_free, &i2s_data, portMAX_DELAY) != pdTRUE) {
-                printf("Could not return buffer to free queue\n");
-            } 
-        } else {
-            printf("Failed to receive i2s data from queue\n");
+        if ((i2s_data = frame_ring_prepare_wait(&mic_ring)) == NULL) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
         }
+        for (int i = 0; i < FRAME_SIZE*2; i+=2) {
+            output_buffer[i] = (int16_t)(i2s_data[i / 2] >> 16);
+            output_buffer[i+1] = output_buffer[i];
+        }
+        frame_ring_release(&mic_ring); // done with the mic frame, hand it back before blocking on the write
+        i2s_write_once(&i2s_out_handle, output_buffer, FRAME_SIZE);
     }
 }
 
 void app_main(void) {
-    // queue for incoming i2s data
-    i2s_queue_free = xQueueCreate(DMA_BUFFER_COUNT, sizeof(int32_t*)); // store pointers to i2s data buffers
-    if (i2s_queue_free == NULL) {
-        printf("Failed to create i2s input queue\n");
-        return;
-    }
-
-    // set all initial buffers to free
-    for (uint8_t i = 0; i < DMA_BUFFER_COUNT; i++) {
-        int32_t* p = global_buffer[i];
-        xQueueSend(i2s_queue_free, &p, portMAX_DELAY);
-    }
-
-    // queue for outstream i2s data
-    i2s_queue_busy = xQueueCreate(DMA_BUFFER_COUNT, sizeof(int32_t*)); // store pointers to i2s data buffers
-    if (i2s_queue_busy == NULL) {
-        printf("Failed to create i2s output queue\n");
-        vQueueDelete(i2s_queue_free);
-        return;
-    }
+    // all mic buffers start out free
+    frame_ring_init(&mic_ring, &global_buffer[0][0], FRAME_SIZE, DMA_BUFFER_COUNT);
 
     // start I2S
     i2s_init(&i2s_in_handle, &i2s_out_handle, SAMPLE_RATE, FRAME_SIZE, DMA_BUFFER_COUNT);
@@ -82,6 +59,6 @@ void app_main(void) {
     printf("I2S fully initialized\n");
 
     // start threads
+    xTaskCreate(i2s_write_task, "i2s_write_task", 4096, NULL, 5, &write_task_handle); // writer first, the reader wakes it
     xTaskCreate(i2s_read_task, "i2s_read_task", 4096, NULL, 5, NULL); 
-    xTaskCreate(i2s_write_task, "i2s_write_task", 4096, NULL, 5, NULL);
 }
\ No newline at end of file
@@ -1,9 +1,78 @@
 #ifndef CONSTANTS_H
 #define CONSTANTS_H
 
-#define FRAME_SIZE 256 // size per DMA buffer
-#define DMA_BUFFER_COUNT 8 // number of dma buffers
-#define SAMPLE_RATE 44100 //in hz
-#define RINGBUFFER_CAPACITY sizeof(int32_t) * FRAME_SIZE * DMA_BUFFER_COUNT * 2
+#include "sdkconfig.h"
+
+#define FRAME_SIZE 256 // size per DMA buffer. the default, and the largest the latency tuner picks
+#define DMA_BUFFER_COUNT 8 // number of dma buffers. same
+#define MIN_FRAME_SIZE 64 // smallest frame the latency tuner tries
+#define SAMPLE_RATE 44100 //in hz, output. a2dp streams at other rates are resampled to it
+#define MIC_RATE_SHIFT 0 // mic runs at SAMPLE_RATE >> MIC_RATE_SHIFT, 1 halves the vocal chain's cpu
+#define MIC_SAMPLE_RATE (SAMPLE_RATE >> MIC_RATE_SHIFT)
+#define MIC_FRAME_SIZE (FRAME_SIZE >> MIC_RATE_SHIFT) // mic frames cover the same period as output frames
+#define MIC_COUNT 2 // inmp441s on the input bus, L/R pin low on the first and high on the second. 1 or 2
+#define RINGBUFFER_CAPACITY (sizeof(int32_t) * FRAME_SIZE * DMA_BUFFER_COUNT * 2) // power of 2, whole frames
+#define JITTER_MIN_TARGET (FRAME_SIZE * 4) // a2dp jitter buffer fill target bounds, in stereo frames
+#define JITTER_MAX_TARGET (RINGBUFFER_CAPACITY / 4 * 3 / 4)
+#define SPP_RING_CAPACITY 1024 // sidecar bytes each way, power of 2. a burst of ~10 lyric lines
+#define SIDECAR_PARSE_BUDGET 128 // sidecar bytes the write task parses per frame, the rest waits a frame
+#define FRAME_PERIOD_US (1000000ULL * FRAME_SIZE / SAMPLE_RATE) // ~5.8 ms
+
+// boot time latency tuner: plays a noise burst, measures the loopback through the mic and shrinks the dma buffers
+// to the smallest setting that runs clean. 0 always uses FRAME_SIZE/DMA_BUFFER_COUNT, 1 tunes once and keeps the
+// result in nvs, 2 tunes on every boot
+#define CALIBRATE_MODE 1
+#define CALIBRATE_WINDOW_MS 2000 // a setting has to run this long without an overrun or underrun
+#define CALIBRATE_MARGIN 1 // settings to step up from the smallest that passed, tuning runs without bluetooth load
+#define CALIBRATE_LEVEL 4096 // burst amplitude, -18 dBFS
+
+// core mapping: bluetooth stack + a2dp ingest on one core, capture + dsp + output on the other.
+// single core variants put everything on core 0
+#if CONFIG_FREERTOS_UNICORE
+#define BT_CORE 0
+#define AUDIO_CORE 0
+#else
+#define BT_CORE 0 // must match CONFIG_BT_BLUEDROID_PINNED_TO_CORE
+#define AUDIO_CORE 1
+#endif
+
+// deadline monotonic priorities. the writer has to fill a tx dma buffer within DMA_BUFFER_COUNT-2 periods,
+// the reader has all DMA_BUFFER_COUNT rx periods before the driver overflows, stats have no deadline
+#define WRITE_TASK_PRIORITY (configMAX_PRIORITIES - 2)
+#define READ_TASK_PRIORITY (configMAX_PRIORITIES - 3)
+#define STATS_TASK_PRIORITY 1
+#define REMOTE_TASK_PRIORITY 2 // avrcp follow-ups and cabinet buttons, a few ms late is fine
+#define SIDECAR_TASK_PRIORITY 2 // forwards lyric lines back to the phone, no deadline beyond keeping up with spp
+#define STATS_PERIOD_MS 5000
+// stack sizes in bytes. TELEMETRY shows how much of each was ever used
+#define WRITE_TASK_STACK 4096
+#define READ_TASK_STACK 4096
+#define REMOTE_TASK_STACK 3072
+#define RECORD_TASK_STACK 4096
+#define SIDECAR_TASK_STACK 3072 // calls into the bluetooth stack like remote_task, 2048 was used up
+#define STATS_TASK_STACK 3072
+#define TELEMETRY_DUMP 0 // 1 sends stack, cpu, heap and fault counters as binary over the console uart for tools/telemetry_decode.py, 0 logs them
+#define REMOTE_POLL_MS 10 // button sampling and avrcp event period
+#define REMOTE_DEBOUNCE 3 // samples a button has to read pressed in a row
+// cabinet buttons, to ground with the internal pull-ups
+#define REMOTE_PREV_GPIO GPIO_NUM_18
+#define REMOTE_PLAY_GPIO GPIO_NUM_19
+#define REMOTE_NEXT_GPIO GPIO_NUM_21
+#define REMOTE_RECORD_GPIO GPIO_NUM_27 // starts and stops a take
+
+// recording the final mix to an sd card over spi, as wav in /sdcard/takeNNN.wav
+#define RECORD_ADPCM 0 // 1 writes 4 bit ima-adpcm, a quarter of the card bandwidth
+#define RECORD_BLOCKS 4
+#define RECORD_BLOCK_BYTES (64 * 1024) // in psram, ~1.1 s of card stalls covered at 176 KB/s
+#define RECORD_FALLBACK_BLOCK_BYTES (8 * 1024) // in internal ram when there is no psram, ~140 ms
+#define RECORD_TASK_PRIORITY 1
+#define RECORD_POLL_MS 20
+#define RECORD_MOUNT "/sdcard"
+#define RECORD_SD_MOSI GPIO_NUM_15
+#define RECORD_SD_MISO GPIO_NUM_2
+#define RECORD_SD_SCLK GPIO_NUM_14
+#define RECORD_SD_CS GPIO_NUM_13
+#define LATENCY_DUMP 0 // 1 streams raw latency events over the console uart for tools/latency_decode.py
+#define LATENCY_DUMP_PERIOD_MS 250 // trace ring holds ~370 ms of events
 
 #endif
\ No newline at end of file
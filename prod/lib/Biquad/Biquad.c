@@ -0,0 +1,57 @@
+#include <math.h>
+#include "Biquad.h"
+
+static int32_t to_q28(double x) {
+    return (int32_t)lrint(x * (double)(1 << BIQUAD_COEFF_BITS));
+}
+
+// normalizes by a0 and stores the section, leaving the history alone
+static void biquad_set(biquad_t* bq, double b0, double b1, double b2, double a0, double a1, double a2) {
+    bq->b0 = to_q28(b0 / a0);
+    bq->b1 = to_q28(b1 / a0);
+    bq->b2 = to_q28(b2 / a0);
+    bq->a1 = to_q28(a1 / a0);
+    bq->a2 = to_q28(a2 / a0);
+}
+
+void biquad_lowpass(biquad_t* bq, float sample_rate, float freq, float q) {
+    double w0 = 2.0 * M_PI * freq / sample_rate;
+    double cos_w0 = cos(w0);
+    double alpha = sin(w0) / (2.0 * q);
+    biquad_set(bq, (1.0 - cos_w0) / 2.0, 1.0 - cos_w0, (1.0 - cos_w0) / 2.0, 1.0 + alpha, -2.0 * cos_w0, 1.0 - alpha);
+}
+
+void biquad_highpass(biquad_t* bq, float sample_rate, float freq, float q) {
+    double w0 = 2.0 * M_PI * freq / sample_rate;
+    double cos_w0 = cos(w0);
+    double alpha = sin(w0) / (2.0 * q);
+    biquad_set(bq, (1.0 + cos_w0) / 2.0, -(1.0 + cos_w0), (1.0 + cos_w0) / 2.0, 1.0 + alpha, -2.0 * cos_w0, 1.0 - alpha);
+}
+
+void biquad_notch(biquad_t* bq, float sample_rate, float freq, float q) {
+    double w0 = 2.0 * M_PI * freq / sample_rate;
+    double cos_w0 = cos(w0);
+    double alpha = sin(w0) / (2.0 * q);
+    biquad_set(bq, 1.0, -2.0 * cos_w0, 1.0, 1.0 + alpha, -2.0 * cos_w0, 1.0 - alpha);
+}
+
+void biquad_reset(biquad_t* bq) {
+    bq->x1 = bq->x2 = bq->y1 = bq->y2 = 0;
+    bq->error = 0;
+}
+
+void biquad_process(biquad_t* bq, int32_t* data, size_t count) {
+    const int64_t b0 = bq->b0, b1 = bq->b1, b2 = bq->b2, a1 = bq->a1, a2 = bq->a2;
+    int32_t x1 = bq->x1, x2 = bq->x2, y1 = bq->y1, y2 = bq->y2, error = bq->error; // kept in registers for the whole block
+    for (size_t i = 0; i < count; i++) {
+        int32_t x0 = data[i];
+        int64_t acc = b0*x0 + b1*x1 + b2*x2 - a1*y1 - a2*y2 + error;
+        int64_t y = acc >> BIQUAD_COEFF_BITS; // a resonant section can ring past full scale
+        int32_t y0 = (y > INT32_MAX) ? INT32_MAX : (y < INT32_MIN) ? INT32_MIN : (int32_t)y;
+        error = (int32_t)(acc & ((1 << BIQUAD_COEFF_BITS) - 1));
+        x2 = x1; x1 = x0;
+        y2 = y1; y1 = y0;
+        data[i] = y0;
+    }
+    bq->x1 = x1; bq->x2 = x2; bq->y1 = y1; bq->y2 = y2; bq->error = error;
+}
@@ -0,0 +1,31 @@
+#ifndef BIQUAD_H
+#define BIQUAD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// fixed-point biquad sections for the prod audio path. direct form 1, Q28 coefficients with a 64 bit accumulator
+// so low cutoffs at 44.1 kHz stay stable. coefficients are designed once in double (rbj cookbook), the per-sample
+// path is integer only. no esp-idf or freertos dependencies.
+
+#define BIQUAD_COEFF_BITS 28
+
+typedef struct {
+    int32_t b0, b1, b2, a1, a2; // Q28, a0 normalized to 1
+    int32_t x1, x2, y1, y2;
+    int32_t error; // fraction dropped from the last output, fed back so truncation noise doesn't pile up at dc
+} biquad_t;
+
+// the designs only set the coefficients, the history carries over so a running filter can be retuned without a
+// click. biquad_reset before the first block
+void biquad_lowpass(biquad_t* bq, float sample_rate, float freq, float q);
+void biquad_highpass(biquad_t* bq, float sample_rate, float freq, float q);
+void biquad_notch(biquad_t* bq, float sample_rate, float freq, float q);
+
+// clears the filter history, keeps the coefficients
+void biquad_reset(biquad_t* bq);
+
+// filters count samples of data in place. outputs past full scale saturate rather than wrap
+void biquad_process(biquad_t* bq, int32_t* data, size_t count);
+
+#endif
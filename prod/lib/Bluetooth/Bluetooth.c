@@ -1,23 +1,69 @@
+#include <string.h>
 #include "esp_log.h"
-#include "nvs_flash.h"
+#include "esp_timer.h"
 #include "esp_bt.h"
 #include "esp_bt_main.h"
 #include "esp_bt_device.h"
 #include "esp_gap_bt_api.h"
 #include "esp_err.h"
 #include "esp_a2dp_api.h"
-#include "freertos/ringbuf.h"
+#include "esp_spp_api.h"
+#include "esp_avrc_api.h"
 #include "Bluetooth.h"
 
 #define TAG "A2DP"
+#define SPP_SERVER_NAME "karaoke"
 
 // not ideal, but better than extern
-unsigned long RINGBUFFER_CAPACITY; 
-RingbufHandle_t* bt_ringbuf_ptr;
-bool* bt_playing_ptr;
+byte_ring_t* bt_ring_ptr;
+_Atomic bool* bt_playing_ptr;
+_Atomic uint32_t* bt_sample_rate_ptr;
+byte_ring_t* bt_spp_ring_ptr;
+static _Atomic uint32_t spp_handle = 0; // 0 while no client is connected
+
+// worst case time per stack callback, written by the bluetooth task only
+static _Atomic uint32_t callback_worst_us[BT_CB_COUNT];
+
+static inline void callback_timed(bt_callback_t cb, int64_t start) {
+    uint32_t us = (uint32_t)(esp_timer_get_time() - start);
+    if (us > atomic_load_explicit(&callback_worst_us[cb], memory_order_relaxed)) {
+        atomic_store_explicit(&callback_worst_us[cb], us, memory_order_relaxed);
+    }
+}
+
+// avrcp callbacks -> bt_remote_poll. single producer (the bluetooth task), single consumer
+enum { // follow-ups bt_remote_poll handles itself, after the public kinds
+    REMOTE_CAPABILITIES = 0x80, // value: the phone's notification capability bits
+    REMOTE_NOTIFY, // id: event that fired, value: its parameter
+    REMOTE_VOLUME_REGISTER, // phone wants to hear about our volume changes
+};
+static bt_remote_event_t remote_queue[BT_REMOTE_QUEUE_LEN];
+static _Atomic uint32_t remote_head = 0;
+static _Atomic uint32_t remote_tail = 0;
+static _Atomic uint32_t remote_dropped = 0;
+static uint8_t remote_volume = 127; // last absolute volume the phone set, bt_remote_poll side
+static bool remote_connected = false; // same
+static uint8_t remote_label = 0; // avrcp transaction label, same
+
+static void remote_push(uint8_t kind, uint8_t id, uint32_t value, const uint8_t* text, size_t text_len) {
+    uint32_t head = atomic_load_explicit(&remote_head, memory_order_relaxed);
+    if (head - atomic_load_explicit(&remote_tail, memory_order_acquire) == BT_REMOTE_QUEUE_LEN) {
+        atomic_fetch_add_explicit(&remote_dropped, 1, memory_order_relaxed);
+        return;
+    }
+    bt_remote_event_t* ev = &remote_queue[head % BT_REMOTE_QUEUE_LEN];
+    ev->kind = kind;
+    ev->id = id;
+    ev->value = value;
+    if (text_len > BT_REMOTE_TEXT_MAX) text_len = BT_REMOTE_TEXT_MAX;
+    if (text != NULL) memcpy(ev->text, text, text_len);
+    ev->text[text != NULL ? text_len : 0] = '\0';
+    atomic_store_explicit(&remote_head, head + 1, memory_order_release);
+}
 
 // on connection request
 static void bt_app_gap_cb(esp_bt_gap_cb_event_t event, esp_bt_gap_cb_param_t* param) {
+    int64_t start = esp_timer_get_time();
     switch (event) {
         case ESP_BT_GAP_AUTH_CMPL_EVT:
             if (param->auth_cmpl.stat == ESP_BT_STATUS_SUCCESS) {
@@ -43,19 +89,21 @@ static void bt_app_gap_cb(esp_bt_gap_cb_event_t event, esp_bt_gap_cb_param_t* pa
             ESP_LOGI(TAG, "Unhandled GAP event: %d", event);
             break;
     }
+    callback_timed(BT_CB_GAP, start);
 }
 
-// Dummy audio data handler
+// audio data handler
 static void bt_app_a2d_data_cb(const uint8_t* data, uint32_t len) {
-    // write to ringbuffer. separate thread will write to i2s
-    if (xRingbufferSend(*bt_ringbuf_ptr, data, len, 0) != pdTRUE) { // write failed. callback must be nonblocking
-        ESP_LOGI(TAG, "Ringbuffer is full");
-        return;
-    }
+    int64_t start = esp_timer_get_time();
+    // write to the cross-core ring. audio core will mix it out. callback must be nonblocking,
+    // whatever doesn't fit is dropped and counted in the ring's overrun_bytes
+    byte_ring_write(bt_ring_ptr, data, len);
+    callback_timed(BT_CB_A2D_DATA, start);
 }
 
 // Bluetooth event callback
 static void bt_app_a2d_cb(esp_a2d_cb_event_t event, esp_a2d_cb_param_t* param) {
+    int64_t start = esp_timer_get_time();
     ESP_LOGI(TAG, "A2DP event: %d", event);
     esp_a2d_cb_param_t* a2d = param;
     assert(a2d != NULL);
@@ -63,49 +111,199 @@ static void bt_app_a2d_cb(esp_a2d_cb_event_t event, esp_a2d_cb_param_t* param) {
     switch(event) {
         case ESP_A2D_CONNECTION_STATE_EVT: // handle a2dp connections
             if (a2d->conn_stat.state == ESP_A2D_CONNECTION_STATE_CONNECTED) {
-                if ((*bt_ringbuf_ptr = xRingbufferCreate(RINGBUFFER_CAPACITY, RINGBUF_TYPE_BYTEBUF)) == NULL) {
-                    ESP_LOGE(TAG, "%s ringbuffer create failed", __func__);
-                    return;
-                } // ringbuf needs to exist before a2dp connnections
-                *bt_playing_ptr = false;
-                ESP_LOGI(TAG, "Ringbuffer created");
+                atomic_store(bt_playing_ptr, false); // ring is static, audio core flushes it while not playing
+                ESP_LOGI(TAG, "A2DP connected");
             } else if (a2d->conn_stat.state == ESP_A2D_CONNECTION_STATE_DISCONNECTED) {
-                *bt_playing_ptr = false;
+                atomic_store(bt_playing_ptr, false);
             }
             break;
         case ESP_A2D_AUDIO_CFG_EVT: // when audio codec configure
-            // configure frequency. might not do this
-            ESP_LOGI(TAG, "config A2DP event: %d", event);
+            if (a2d->audio_cfg.mcc.type == ESP_A2D_MCT_SBC) {
+                // sbc sampling frequency bits, see the a2dp spec codec info element
+                uint32_t sample_rate = 16000;
+                uint8_t oct0 = a2d->audio_cfg.mcc.cie.sbc[0];
+                if (oct0 & (0x01 << 6)) sample_rate = 32000;
+                else if (oct0 & (0x01 << 5)) sample_rate = 44100;
+                else if (oct0 & (0x01 << 4)) sample_rate = 48000;
+                atomic_store(bt_sample_rate_ptr, sample_rate); // audio core resamples to the output rate
+                ESP_LOGI(TAG, "A2DP sample rate: %lu", (unsigned long)sample_rate);
+            }
             break;
         case ESP_A2D_AUDIO_STATE_EVT: // pause, play
-            if (a2d->audio_stat.state == ESP_A2D_AUDIO_STATE_STARTED) *bt_playing_ptr = true;
-            else if (a2d->audio_stat.state == ESP_A2D_AUDIO_STATE_SUSPEND) *bt_playing_ptr = false;
+            if (a2d->audio_stat.state == ESP_A2D_AUDIO_STATE_STARTED) atomic_store(bt_playing_ptr, true);
+            else if (a2d->audio_stat.state == ESP_A2D_AUDIO_STATE_SUSPEND) atomic_store(bt_playing_ptr, false);
             break;
         default:
             ESP_LOGI(TAG, "Unhandled A2DP event: %d", event);
             break;
     }
+    callback_timed(BT_CB_A2D, start);
+}
+
+// lyric/control sidecar
+static void bt_app_spp_cb(esp_spp_cb_event_t event, esp_spp_cb_param_t* param) {
+    int64_t start = esp_timer_get_time();
+    switch (event) {
+        case ESP_SPP_INIT_EVT:
+            esp_spp_start_srv(ESP_SPP_SEC_AUTHENTICATE, ESP_SPP_ROLE_SLAVE, 0, SPP_SERVER_NAME);
+            break;
+        case ESP_SPP_SRV_OPEN_EVT:
+            atomic_store(&spp_handle, param->srv_open.handle);
+            ESP_LOGI(TAG, "SPP connected");
+            break;
+        case ESP_SPP_CLOSE_EVT:
+            atomic_store(&spp_handle, 0);
+            ESP_LOGI(TAG, "SPP disconnected");
+            break;
+        case ESP_SPP_DATA_IND_EVT:
+            // same as the a2dp data: nonblocking, overruns are counted by the ring
+            byte_ring_write(bt_spp_ring_ptr, param->data_ind.data, param->data_ind.len);
+            break;
+        default:
+            break;
+    }
+    callback_timed(BT_CB_SPP, start);
+}
+
+// avrcp controller: the phone's metadata and notifications. copy and queue only, bt_remote_poll does the rest
+static void bt_app_avrc_ct_cb(esp_avrc_ct_cb_event_t event, esp_avrc_ct_cb_param_t* param) {
+    int64_t start = esp_timer_get_time();
+    switch (event) {
+        case ESP_AVRC_CT_CONNECTION_STATE_EVT:
+            remote_push(BT_REMOTE_CONNECTED, 0, param->conn_stat.connected, NULL, 0);
+            break;
+        case ESP_AVRC_CT_GET_RN_CAPABILITIES_RSP_EVT:
+            remote_push(REMOTE_CAPABILITIES, 0, param->get_rn_caps_rsp.evt_set.bits, NULL, 0);
+            break;
+        case ESP_AVRC_CT_METADATA_RSP_EVT: {
+            uint8_t kind = BT_REMOTE_ALBUM;
+            if (param->meta_rsp.attr_id == ESP_AVRC_MD_ATTR_TITLE) kind = BT_REMOTE_TITLE;
+            else if (param->meta_rsp.attr_id == ESP_AVRC_MD_ATTR_ARTIST) kind = BT_REMOTE_ARTIST;
+            remote_push(kind, param->meta_rsp.attr_id, 0, param->meta_rsp.attr_text, param->meta_rsp.attr_length);
+            break;
+        }
+        case ESP_AVRC_CT_CHANGE_NOTIFY_EVT:
+            remote_push(REMOTE_NOTIFY, param->change_ntf.event_id, param->change_ntf.event_parameter.playback, NULL, 0);
+            break;
+        default:
+            break;
+    }
+    callback_timed(BT_CB_AVRC_CT, start);
 }
 
-void bt_init(RingbufHandle_t* ringbuf_handle_ptr, unsigned long ringbuf_size, bool* bt_playing) {
+// avrcp target: the phone drives our volume
+static void bt_app_avrc_tg_cb(esp_avrc_tg_cb_event_t event, esp_avrc_tg_cb_param_t* param) {
+    int64_t start = esp_timer_get_time();
+    switch (event) {
+        case ESP_AVRC_TG_SET_ABSOLUTE_VOLUME_CMD_EVT:
+            remote_push(BT_REMOTE_VOLUME, 0, param->set_abs_vol.volume, NULL, 0);
+            break;
+        case ESP_AVRC_TG_REGISTER_NOTIFICATION_EVT:
+            if (param->reg_ntf.event_id == ESP_AVRC_RN_VOLUME_CHANGE) remote_push(REMOTE_VOLUME_REGISTER, 0, 0, NULL, 0);
+            break;
+        default:
+            break;
+    }
+    callback_timed(BT_CB_AVRC_TG, start);
+}
+
+static uint8_t next_label(void) {
+    remote_label = (remote_label + 1) & 0x0F;
+    return remote_label;
+}
+
+static void remote_register(uint8_t event_id) {
+    esp_avrc_ct_send_register_notification_cmd(next_label(), event_id, 0);
+}
+
+static void remote_request_metadata(void) {
+    esp_avrc_ct_send_metadata_cmd(next_label(), ESP_AVRC_MD_ATTR_TITLE | ESP_AVRC_MD_ATTR_ARTIST | ESP_AVRC_MD_ATTR_ALBUM);
+}
+
+bool bt_remote_poll(bt_remote_event_t* out) {
+    while (1) {
+        uint32_t tail = atomic_load_explicit(&remote_tail, memory_order_relaxed);
+        if (tail == atomic_load_explicit(&remote_head, memory_order_acquire)) return false;
+        memcpy(out, &remote_queue[tail % BT_REMOTE_QUEUE_LEN], sizeof(*out));
+        atomic_store_explicit(&remote_tail, tail + 1, memory_order_release);
+
+        switch (out->kind) {
+            case BT_REMOTE_CONNECTED:
+                remote_connected = out->value != 0;
+                if (remote_connected) esp_avrc_ct_send_get_rn_capabilities_cmd(next_label());
+                return true;
+            case BT_REMOTE_VOLUME:
+                remote_volume = (uint8_t)out->value;
+                return true;
+            case REMOTE_CAPABILITIES: {
+                esp_avrc_rn_evt_cap_mask_t caps = { .bits = (uint16_t)out->value };
+                if (esp_avrc_rn_evt_bit_mask_operation(ESP_AVRC_BIT_MASK_OP_TEST, &caps, ESP_AVRC_RN_TRACK_CHANGE)) {
+                    remote_register(ESP_AVRC_RN_TRACK_CHANGE);
+                }
+                if (esp_avrc_rn_evt_bit_mask_operation(ESP_AVRC_BIT_MASK_OP_TEST, &caps, ESP_AVRC_RN_PLAY_STATUS_CHANGE)) {
+                    remote_register(ESP_AVRC_RN_PLAY_STATUS_CHANGE);
+                }
+                remote_request_metadata();
+                break;
+            }
+            case REMOTE_NOTIFY: // notifications are one-shot, register again for the next one
+                remote_register(out->id);
+                if (out->id == ESP_AVRC_RN_TRACK_CHANGE) remote_request_metadata();
+                if (out->id == ESP_AVRC_RN_PLAY_STATUS_CHANGE) {
+                    out->kind = BT_REMOTE_PLAY_STATUS;
+                    out->value = out->value == ESP_AVRC_PLAYBACK_PLAYING;
+                    return true;
+                }
+                break;
+            case REMOTE_VOLUME_REGISTER: {
+                esp_avrc_rn_param_t rn = { .volume = remote_volume };
+                esp_avrc_tg_send_rn_rsp(ESP_AVRC_RN_VOLUME_CHANGE, ESP_AVRC_RN_RSP_INTERIM, &rn);
+                break;
+            }
+            default: // metadata
+                return true;
+        }
+    }
+}
+
+bool bt_remote_key(bt_remote_key_t key) {
+    static const uint8_t codes[] = {
+        [BT_REMOTE_KEY_PLAY] = ESP_AVRC_PT_CMD_PLAY,
+        [BT_REMOTE_KEY_PAUSE] = ESP_AVRC_PT_CMD_PAUSE,
+        [BT_REMOTE_KEY_NEXT] = ESP_AVRC_PT_CMD_FORWARD,
+        [BT_REMOTE_KEY_PREV] = ESP_AVRC_PT_CMD_BACKWARD,
+    };
+    if (!remote_connected) return false;
+    uint8_t label = next_label();
+    if (esp_avrc_ct_send_passthrough_cmd(label, codes[key], ESP_AVRC_PT_CMD_STATE_PRESSED) != ESP_OK) return false;
+    return esp_avrc_ct_send_passthrough_cmd(label, codes[key], ESP_AVRC_PT_CMD_STATE_RELEASED) == ESP_OK;
+}
+
+void bt_callback_worst(uint32_t worst_us[BT_CB_COUNT]) {
+    for (int i = 0; i < BT_CB_COUNT; i++) worst_us[i] = atomic_load_explicit(&callback_worst_us[i], memory_order_relaxed);
+}
+
+uint32_t bt_remote_dropped(void) {
+    return atomic_load_explicit(&remote_dropped, memory_order_relaxed);
+}
+
+bool bt_spp_send(const uint8_t* data, size_t len) {
+    uint32_t handle = atomic_load(&spp_handle);
+    if (handle == 0) return false;
+    return esp_spp_write(handle, (int)len, (uint8_t*)data) == ESP_OK;
+}
+
+void bt_init(byte_ring_t* ring, _Atomic bool* bt_playing, _Atomic uint32_t* sample_rate, byte_ring_t* spp_ring) {
     ESP_LOGI("TEST", "Start");
-    RINGBUFFER_CAPACITY = ringbuf_size;
-    bt_ringbuf_ptr = ringbuf_handle_ptr;
+    bt_ring_ptr = ring;
     bt_playing_ptr = bt_playing;
+    bt_sample_rate_ptr = sample_rate;
+    bt_spp_ring_ptr = spp_ring;
 
     // Release BLE memory first
     ESP_ERROR_CHECK(esp_bt_controller_mem_release(ESP_BT_MODE_BLE));
     ESP_LOGI("TEST", "BLE mem released");
 
-    // Init NVS
-    esp_err_t ret = nvs_flash_init();
-    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
-        ESP_ERROR_CHECK(nvs_flash_erase());
-        ret = nvs_flash_init();
-    }
-    ESP_ERROR_CHECK(ret);
-    ESP_LOGI("TEST", "NVS inited");
-
     // Init BT controller
     esp_bt_controller_config_t bt_cfg = BT_CONTROLLER_INIT_CONFIG_DEFAULT();
     ESP_ERROR_CHECK(esp_bt_controller_init(&bt_cfg));
@@ -136,10 +334,25 @@ void bt_init(RingbufHandle_t* ringbuf_handle_ptr, unsigned long ringbuf_size, bo
     ESP_ERROR_CHECK(esp_bt_gap_set_pin(pin_type, 4, pin_code));
     ESP_ERROR_CHECK(esp_bt_gap_register_callback(bt_app_gap_cb));
 
+    // avrcp before a2dp, so the phone sees both profiles when it connects. controller for metadata and our buttons,
+    // target so the phone's volume reaches us
+    ESP_ERROR_CHECK(esp_avrc_ct_register_callback(bt_app_avrc_ct_cb));
+    ESP_ERROR_CHECK(esp_avrc_ct_init());
+    ESP_ERROR_CHECK(esp_avrc_tg_register_callback(bt_app_avrc_tg_cb));
+    ESP_ERROR_CHECK(esp_avrc_tg_init());
+    esp_avrc_rn_evt_cap_mask_t tg_caps = { 0 };
+    esp_avrc_rn_evt_bit_mask_operation(ESP_AVRC_BIT_MASK_OP_SET, &tg_caps, ESP_AVRC_RN_VOLUME_CHANGE);
+    ESP_ERROR_CHECK(esp_avrc_tg_set_rn_evt_cap(&tg_caps));
+
     // Register A2DP callbacks and initialize sink
     ESP_ERROR_CHECK(esp_a2d_register_callback(&bt_app_a2d_cb));
     ESP_ERROR_CHECK(esp_a2d_sink_register_data_callback(bt_app_a2d_data_cb));
     ESP_ERROR_CHECK(esp_a2d_sink_init());
 
+    // spp server for the sidecar, consumer reads spp_ring
+    ESP_ERROR_CHECK(esp_spp_register_callback(bt_app_spp_cb));
+    esp_spp_cfg_t spp_cfg = { .mode = ESP_SPP_MODE_CB, .enable_l2cap_ertm = true, .tx_buffer_size = 0 };
+    ESP_ERROR_CHECK(esp_spp_enhanced_init(&spp_cfg));
+
     ESP_LOGI(TAG, "A2DP sink initialized and discoverable");
 }
\ No newline at end of file
@@ -1,7 +1,72 @@
 #ifndef BLUETOOTH_H
 #define BLUETOOTH_H
 
-// initialize nvs and bluetooth. will also initialize a ringbuffer of the given size
-void bt_init(RingbufHandle_t* ringbuf_handle_ptr, unsigned long ringbuf_size, bool* bt_playing);
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include "ByteRing.h"
+
+#define BT_REMOTE_TEXT_MAX 64 // metadata strings are cut to this many bytes
+#define BT_REMOTE_QUEUE_LEN 16 // avrcp events waiting for bt_remote_poll, power of 2
+
+// avrcp events for the app. the callbacks only copy them into a lock-free queue, everything else happens in
+// whichever task calls bt_remote_poll
+typedef enum {
+    BT_REMOTE_CONNECTED = 0, // value 1 when the phone's avrcp comes up, 0 when it goes
+    BT_REMOTE_TITLE, // text
+    BT_REMOTE_ARTIST,
+    BT_REMOTE_ALBUM,
+    BT_REMOTE_PLAY_STATUS, // value 1 while the phone is playing
+    BT_REMOTE_VOLUME, // value is the phone's absolute volume, 0..127
+} bt_remote_kind_t;
+
+typedef struct {
+    uint8_t kind;
+    uint8_t id; // raw avrcp attribute or event id
+    uint32_t value;
+    char text[BT_REMOTE_TEXT_MAX + 1]; // nul terminated
+} bt_remote_event_t;
+
+typedef enum {
+    BT_REMOTE_KEY_PLAY = 0,
+    BT_REMOTE_KEY_PAUSE,
+    BT_REMOTE_KEY_NEXT,
+    BT_REMOTE_KEY_PREV,
+} bt_remote_key_t;
+
+// which bluetooth stack callback, for the timing stats
+typedef enum {
+    BT_CB_GAP = 0,
+    BT_CB_A2D,
+    BT_CB_A2D_DATA,
+    BT_CB_AVRC_CT,
+    BT_CB_AVRC_TG,
+    BT_CB_SPP,
+    BT_CB_COUNT,
+} bt_callback_t;
+
+// initialize bluetooth, app_main has initialized nvs for the stack's bonding keys. a2dp pcm is written into ring from the bluetooth stack's task, run bt_init on the
+// core the stack is pinned to (CONFIG_BT_BLUEDROID_PINNED_TO_CORE). sample_rate is updated from the negotiated codec config.
+// an spp server runs next to the a2dp sink for the lyric/control sidecar, whatever the phone sends on it lands in spp_ring
+void bt_init(byte_ring_t* ring, _Atomic bool* bt_playing, _Atomic uint32_t* sample_rate, byte_ring_t* spp_ring);
+
+// queues bytes to the connected spp client. false if nobody is connected or the stack refused them.
+// call from a task, not from the audio path
+bool bt_spp_send(const uint8_t* data, size_t len);
+
+// one task only: answers the phone's avrcp requests (notification registrations, metadata fetches) and returns
+// the next event meant for the app. false when the queue is empty
+bool bt_remote_poll(bt_remote_event_t* ev);
+
+// one task only, the same one that polls: presses and releases a key on the phone. false if avrcp isn't connected
+bool bt_remote_key(bt_remote_key_t key);
+
+// longest time spent in each stack callback since boot. they all run on the bluetooth task, so any of them can hold
+// up the a2dp data callback behind it
+void bt_callback_worst(uint32_t worst_us[BT_CB_COUNT]);
+
+// avrcp events the callbacks had to drop because the queue was full
+uint32_t bt_remote_dropped(void);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,47 @@
+#include <string.h>
+#include "ByteRing.h"
+
+void byte_ring_init(byte_ring_t* ring, uint8_t* storage, size_t capacity) {
+    ring->storage = storage;
+    ring->capacity = capacity;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->overrun_bytes, 0);
+}
+
+size_t byte_ring_write(byte_ring_t* ring, const uint8_t* data, size_t len) {
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    size_t space = ring->capacity - (head - tail);
+    size_t count = (len < space) ? len : space;
+    if (count < len) atomic_fetch_add_explicit(&ring->overrun_bytes, len - count, memory_order_relaxed);
+
+    size_t offset = head % ring->capacity;
+    size_t first = (count < ring->capacity - offset) ? count : ring->capacity - offset;
+    memcpy(ring->storage + offset, data, first);
+    memcpy(ring->storage, data + first, count - first);
+    atomic_store_explicit(&ring->head, head + count, memory_order_release);
+    return count;
+}
+
+const uint8_t* byte_ring_peek(byte_ring_t* ring, size_t* contiguous) {
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    size_t offset = tail % ring->capacity;
+    size_t available = head - tail;
+    *contiguous = (available < ring->capacity - offset) ? available : ring->capacity - offset;
+    return ring->storage + offset;
+}
+
+void byte_ring_consume(byte_ring_t* ring, size_t count) {
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    atomic_store_explicit(&ring->tail, tail + count, memory_order_release);
+}
+
+void byte_ring_flush(byte_ring_t* ring) {
+    atomic_store_explicit(&ring->tail, atomic_load_explicit(&ring->head, memory_order_acquire), memory_order_release);
+}
+
+size_t byte_ring_fill(byte_ring_t* ring) {
+    return atomic_load_explicit(&ring->head, memory_order_acquire) - atomic_load_explicit(&ring->tail, memory_order_acquire);
+}
@@ -0,0 +1,36 @@
+#ifndef BYTERING_H
+#define BYTERING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+// lock-free single producer / single consumer byte ring for handing a2dp pcm from the bluetooth core to the audio
+// core. the producer copies in whatever fits, the consumer reads in place, at most two contiguous runs per wrap.
+// capacity must be a power of two. portable c11 atomics, no esp-idf or freertos dependencies.
+
+typedef struct {
+    uint8_t* storage;
+    size_t capacity;
+    _Atomic uint32_t head; // free-running byte count written, producer only
+    _Atomic uint32_t tail; // free-running byte count read, consumer only
+    _Atomic uint32_t overrun_bytes; // bytes the producer had to drop
+} byte_ring_t;
+
+void byte_ring_init(byte_ring_t* ring, uint8_t* storage, size_t capacity);
+
+// producer: copies up to len bytes in, drops the rest. returns bytes written
+size_t byte_ring_write(byte_ring_t* ring, const uint8_t* data, size_t len);
+
+// consumer: pointer to the oldest buffered bytes, *contiguous gets how many can be read before the wrap
+const uint8_t* byte_ring_peek(byte_ring_t* ring, size_t* contiguous);
+
+// consumer: releases count bytes returned by peek
+void byte_ring_consume(byte_ring_t* ring, size_t count);
+
+// consumer: drops everything currently buffered
+void byte_ring_flush(byte_ring_t* ring);
+
+size_t byte_ring_fill(byte_ring_t* ring);
+
+#endif
@@ -0,0 +1,128 @@
+#include <string.h>
+#include "Calibrate.h"
+
+#define MLS_SEED 0x0001
+
+#define MLS_TAPS 0x0E08 // galois lfsr taps for x^12 + x^11 + x^10 + x^4 + 1, period 4095
+
+static inline int mls_next(uint16_t* lfsr) {
+    int bit = *lfsr & 1;
+    *lfsr >>= 1;
+    if (bit) *lfsr ^= MLS_TAPS;
+    return bit;
+}
+
+void calibrate_start(calibrate_loopback_t* lb, int16_t level, uint32_t hold_shift) {
+    atomic_store_explicit(&lb->active, false, memory_order_relaxed);
+    lb->level = level;
+    lb->hold_shift = hold_shift;
+    lb->played = 0;
+    atomic_store_explicit(&lb->captured, 0, memory_order_relaxed);
+    lb->lfsr = MLS_SEED;
+    lb->chip = 0;
+    atomic_store_explicit(&lb->active, true, memory_order_release);
+}
+
+void calibrate_play(calibrate_loopback_t* lb, int16_t* out, size_t frames) {
+    const uint32_t hold_mask = (1u << lb->hold_shift) - 1;
+    const uint32_t total = CALIBRATE_MLS_LEN << lb->hold_shift;
+    for (size_t i = 0; i < frames; i++, lb->played++) {
+        if (lb->played >= total) lb->chip = 0;
+        else if ((lb->played & hold_mask) == 0) lb->chip = mls_next(&lb->lfsr) ? lb->level : -lb->level;
+        out[2*i] = lb->chip;
+        out[2*i+1] = lb->chip;
+    }
+}
+
+void calibrate_capture(calibrate_loopback_t* lb, const int32_t* mic, size_t frames) {
+    uint32_t captured = atomic_load_explicit(&lb->captured, memory_order_relaxed); // only this task writes it
+    for (size_t i = 0; i < frames && captured < CALIBRATE_CAPTURE_LEN; i++) {
+        lb->capture[captured++] = (mic != NULL) ? (int16_t)(mic[i] >> 16) : 0;
+    }
+    atomic_store_explicit(&lb->captured, captured, memory_order_release);
+}
+
+bool calibrate_done(const calibrate_loopback_t* lb) {
+    return atomic_load_explicit(&lb->captured, memory_order_acquire) >= CALIBRATE_CAPTURE_LEN;
+}
+
+int32_t calibrate_find_lag(const calibrate_loopback_t* lb) {
+    // reference chips as bits, same sequence calibrate_play produced
+    uint8_t ref[(CALIBRATE_MLS_LEN + 7) / 8];
+    memset(ref, 0, sizeof(ref));
+    uint16_t lfsr = MLS_SEED;
+    for (uint32_t i = 0; i < CALIBRATE_MLS_LEN; i++) {
+        if (mls_next(&lfsr)) ref[i >> 3] |= 1 << (i & 7);
+    }
+
+    // +-1 reference, so the correlation is only adds and subtracts. capture[] is final up to captured
+    const uint32_t captured = atomic_load_explicit(&lb->captured, memory_order_acquire);
+    int64_t best = 0;
+    int32_t best_lag = -1;
+    double energy = 0.0;
+    uint32_t lag = 0;
+    for (; lag + CALIBRATE_MLS_LEN <= captured && lag < CALIBRATE_MAX_LAG; lag++) {
+        const int16_t* x = &lb->capture[lag];
+        int64_t acc = 0;
+        for (uint32_t i = 0; i < CALIBRATE_MLS_LEN; i++) {
+            acc += (ref[i >> 3] & (1 << (i & 7))) ? x[i] : -x[i];
+        }
+        energy += (double)acc * acc;
+        int64_t mag = (acc < 0) ? -acc : acc; // a speaker wired the other way round flips the peak
+        if (mag > best) {
+            best = mag;
+            best_lag = (int32_t)lag;
+        }
+    }
+    if (best_lag < 0) return -1;
+
+    // an mls correlates to almost nothing off the peak. ask for the peak to stand well clear of the rms
+    double rms_sq = energy / lag;
+    if ((double)best * best < 64.0 * rms_sq) return -1;
+    return best_lag;
+}
+
+void calibrate_search_init(calibrate_search_t* search, uint32_t min_frame_size, uint32_t max_frame_size, uint32_t max_dma_count) {
+    memset(search, 0, sizeof(*search));
+    for (uint32_t frame = min_frame_size; frame <= max_frame_size; frame *= 2) {
+        for (uint32_t count = 3; count <= max_dma_count && search->count < CALIBRATE_MAX_SETTINGS; count++) {
+            search->settings[search->count].frame_size = frame;
+            search->settings[search->count].dma_count = count;
+            search->count++;
+        }
+    }
+    // insertion sort by total buffering. ties go to the bigger frame, fewer wakeups for the same latency
+    for (uint32_t i = 1; i < search->count; i++) {
+        calibrate_setting_t s = search->settings[i];
+        uint32_t total = s.frame_size * s.dma_count;
+        uint32_t j = i;
+        while (j > 0) {
+            calibrate_setting_t p = search->settings[j - 1];
+            uint32_t p_total = p.frame_size * p.dma_count;
+            if (p_total < total || (p_total == total && p.frame_size > s.frame_size)) break;
+            search->settings[j] = p;
+            j--;
+        }
+        search->settings[j] = s;
+    }
+    search->lo = 0;
+    search->hi = search->count;
+}
+
+bool calibrate_search_next(calibrate_search_t* search, calibrate_setting_t* setting) {
+    if (search->lo >= search->hi) return false;
+    search->trial = search->lo + (search->hi - search->lo) / 2;
+    *setting = search->settings[search->trial];
+    return true;
+}
+
+void calibrate_search_report(calibrate_search_t* search, bool passed) {
+    if (passed) search->hi = search->trial;
+    else search->lo = search->trial + 1;
+}
+
+calibrate_setting_t calibrate_search_result(const calibrate_search_t* search, uint32_t margin) {
+    uint32_t idx = (search->hi < search->count) ? search->hi + margin : search->count - 1;
+    if (idx >= search->count) idx = search->count - 1;
+    return search->settings[idx];
+}
@@ -0,0 +1,76 @@
+#ifndef CALIBRATE_H
+#define CALIBRATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+// loopback latency measurement and buffer size search for the boot time tuner.
+// a maximum length sequence is played into the output, the mic's copy is recorded and the round trip is found by
+// cross-correlation. all positions are in mic samples, the output holds each mls chip for 1 << hold_shift samples.
+// no esp-idf or freertos dependencies
+
+#define CALIBRATE_MLS_ORDER 12
+#define CALIBRATE_MLS_LEN ((1u << CALIBRATE_MLS_ORDER) - 1) // 4095 chips, ~93 ms at 44.1 kHz
+#define CALIBRATE_MAX_LAG 8192 // longest round trip looked for, ~186 ms at 44.1 kHz
+#define CALIBRATE_CAPTURE_LEN (CALIBRATE_MLS_LEN + CALIBRATE_MAX_LAG)
+
+typedef struct {
+    _Atomic bool active; // set by the tuner, the write task only touches the rest while it is
+    int16_t level; // mls amplitude
+    uint32_t hold_shift; // output samples per chip = 1 << hold_shift
+    uint32_t played; // output samples so far
+    _Atomic uint32_t captured; // mic samples so far, published with release so the tuner sees capture[] filled up to it
+    uint16_t lfsr;
+    int16_t chip; // held across frames
+    int16_t capture[CALIBRATE_CAPTURE_LEN];
+} calibrate_loopback_t;
+
+// tuner: resets and arms the measurement. the write task picks it up on its next frame
+void calibrate_start(calibrate_loopback_t* lb, int16_t level, uint32_t hold_shift);
+
+// write task: overwrites a stereo output frame with the next part of the mls (then silence)
+void calibrate_play(calibrate_loopback_t* lb, int16_t* out, size_t frames);
+
+// write task: records a q31 mic frame. mic may be NULL for a late frame, which is recorded as silence to keep the timeline
+void calibrate_capture(calibrate_loopback_t* lb, const int32_t* mic, size_t frames);
+
+// true once the capture buffer is full
+bool calibrate_done(const calibrate_loopback_t* lb);
+
+// tuner: round trip in mic samples from a chip being played to the write task seeing it, or -1 if no clear peak
+int32_t calibrate_find_lag(const calibrate_loopback_t* lb);
+
+// one buffer configuration to try
+typedef struct {
+    uint16_t frame_size; // output samples per dma buffer
+    uint8_t dma_count; // dma descriptors per direction
+} calibrate_setting_t;
+
+#define CALIBRATE_MAX_SETTINGS 32
+
+// binary search over settings sorted by total buffering, for the smallest one that runs without faults.
+// assumes a setting that passes keeps passing with more buffering
+typedef struct {
+    calibrate_setting_t settings[CALIBRATE_MAX_SETTINGS];
+    uint32_t count;
+    uint32_t lo; // every setting below lo failed
+    uint32_t hi; // settings[hi] passed, or count if none has yet
+    uint32_t trial; // index under test
+} calibrate_search_t;
+
+// frame sizes from min_frame_size doubling up to max_frame_size, dma counts from 3 (the fewest DmaSched can schedule) up to
+// max_dma_count. the largest setting is the fallback if nothing smaller passes
+void calibrate_search_init(calibrate_search_t* search, uint32_t min_frame_size, uint32_t max_frame_size, uint32_t max_dma_count);
+
+// next setting to try. false once the search is over
+bool calibrate_search_next(calibrate_search_t* search, calibrate_setting_t* setting);
+
+// result of the setting last returned by calibrate_search_next
+void calibrate_search_report(calibrate_search_t* search, bool passed);
+
+// smallest passing setting, stepped up margin places for headroom. the largest setting if none passed
+calibrate_setting_t calibrate_search_result(const calibrate_search_t* search, uint32_t margin);
+
+#endif
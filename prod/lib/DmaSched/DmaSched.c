@@ -0,0 +1,42 @@
+#include "DmaSched.h"
+
+void dma_sched_init(dma_sched_t* sched, uint32_t desc_num) {
+    sched->desc_num = (desc_num > DMA_SCHED_MAX_DESC) ? DMA_SCHED_MAX_DESC : desc_num;
+    atomic_init(&sched->head, 0);
+    atomic_init(&sched->tail, 0);
+    atomic_init(&sched->sent_count, 0);
+    atomic_init(&sched->dropped, 0);
+    atomic_init(&sched->late, 0);
+}
+
+// a finished buffer plays again once the other desc_num-1 buffers have finished.
+// leave a full period of margin so the fill is done before the dma reaches it
+static inline bool safe_to_fill(dma_sched_t* sched, uint32_t seq) {
+    uint32_t since = atomic_load_explicit(&sched->sent_count, memory_order_relaxed) - seq;
+    return since + 2 <= sched->desc_num;
+}
+
+void* dma_sched_take(dma_sched_t* sched, uint32_t* sent_stamp, uint32_t* seq) {
+    uint32_t tail = atomic_load_explicit(&sched->tail, memory_order_relaxed);
+    while (tail != atomic_load_explicit(&sched->head, memory_order_acquire)) {
+        dma_sched_slot_t slot = sched->slots[tail % DMA_SCHED_MAX_DESC];
+        atomic_store_explicit(&sched->tail, ++tail, memory_order_release);
+        if (safe_to_fill(sched, slot.seq)) {
+            if (sent_stamp != NULL) *sent_stamp = slot.stamp;
+            if (seq != NULL) *seq = slot.seq;
+            return slot.buf;
+        }
+        atomic_fetch_add_explicit(&sched->late, 1, memory_order_relaxed);
+    }
+    return NULL;
+}
+
+bool dma_sched_still_safe(dma_sched_t* sched, uint32_t seq) {
+    if (safe_to_fill(sched, seq)) return true;
+    atomic_fetch_add_explicit(&sched->late, 1, memory_order_relaxed);
+    return false;
+}
+
+uint32_t dma_sched_pending(dma_sched_t* sched) {
+    return atomic_load_explicit(&sched->head, memory_order_acquire) - atomic_load_explicit(&sched->tail, memory_order_relaxed);
+}
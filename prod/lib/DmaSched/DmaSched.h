@@ -0,0 +1,64 @@
+#ifndef DMASCHED_H
+#define DMASCHED_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+// tracks i2s tx dma buffers handed back by the driver's on_sent callback so the write task can mix straight
+// into them. single producer (isr) / single consumer (write task), no esp-idf or freertos dependencies.
+
+#define DMA_SCHED_MAX_DESC 16 // upper bound on dma_desc_num
+
+typedef struct {
+    void* buf;
+    uint32_t seq; // value of sent_count when this buffer finished playing
+    uint32_t stamp; // when it finished, caller's clock
+} dma_sched_slot_t;
+
+typedef struct {
+    dma_sched_slot_t slots[DMA_SCHED_MAX_DESC];
+    uint32_t desc_num; // number of descriptors in the driver's circular dma list
+    _Atomic uint32_t head; // written by isr
+    _Atomic uint32_t tail; // written by task
+    _Atomic uint32_t sent_count; // buffers finished by dma so far
+    _Atomic uint32_t dropped; // isr found the pending list full
+    _Atomic uint32_t late; // buffer was taken after dma had already wrapped back around to it
+} dma_sched_t;
+
+// desc_num must match the channel's dma_desc_num and be at most DMA_SCHED_MAX_DESC
+void dma_sched_init(dma_sched_t* sched, uint32_t desc_num);
+
+// called from on_sent with the buffer that just finished and the time it did. returns false if the task has fallen a full ring behind.
+// inline so the iram callback doesn't call into flash
+static inline bool dma_sched_post(dma_sched_t* sched, void* dma_buf, uint32_t stamp) {
+    uint32_t seq = atomic_fetch_add_explicit(&sched->sent_count, 1, memory_order_relaxed) + 1;
+    uint32_t head = atomic_load_explicit(&sched->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&sched->tail, memory_order_acquire);
+    if (head - tail >= DMA_SCHED_MAX_DESC) {
+        atomic_fetch_add_explicit(&sched->dropped, 1, memory_order_relaxed);
+        return false;
+    }
+    dma_sched_slot_t* slot = &sched->slots[head % DMA_SCHED_MAX_DESC];
+    slot->buf = dma_buf;
+    slot->seq = seq;
+    slot->stamp = stamp;
+    atomic_store_explicit(&sched->head, head + 1, memory_order_release);
+    return true;
+}
+
+// returns the oldest posted buffer that is still safe to fill, or NULL if there is none.
+// buffers the dma has already come back around to are skipped and counted as late.
+// sent_stamp and seq (either may be NULL) get the stamp the buffer was posted with and its place in the sequence
+void* dma_sched_take(dma_sched_t* sched, uint32_t* sent_stamp, uint32_t* seq);
+
+// for a buffer taken with seq and held across a wait: true if it is still safe to fill. when it isn't, the dma has
+// come back around to it, and it is counted as late like dma_sched_take's skips. the caller drops it
+bool dma_sched_still_safe(dma_sched_t* sched, uint32_t seq);
+
+// posted buffers not taken yet. a taken buffer is still safe to fill when the next one is posted, as long as
+// desc_num is at least 3
+uint32_t dma_sched_pending(dma_sched_t* sched);
+
+#endif
@@ -0,0 +1,358 @@
+#include <string.h>
+#include "Effects.h"
+
+static inline int32_t sat16(int32_t x) {
+    if (x > INT16_MAX) return INT16_MAX;
+    if (x < INT16_MIN) return INT16_MIN;
+    return x;
+}
+
+static inline int32_t sat32(int64_t x) {
+    if (x > INT32_MAX) return INT32_MAX;
+    if (x < INT32_MIN) return INT32_MIN;
+    return (int32_t)x;
+}
+
+// Q15 multiply truncating toward zero. plain >> rounds toward -inf, which leaves recirculating
+// delay lines stuck in a small dc limit cycle instead of decaying to silence
+static inline int32_t mul_q15_tz(int32_t a, int32_t b) {
+    int32_t p = a * b;
+    return (p >= 0) ? (p >> 15) : -((-p) >> 15);
+}
+
+// adds a Q15 wet signal onto a Q31 dry sample. multiplied up, a << of a negative wet sample is undefined
+static inline int32_t add_wet(int32_t dry, int32_t wet_q15) {
+    return sat32((int64_t)dry + (int64_t)wet_q15 * 65536);
+}
+
+void effects_chain_init(effects_chain_t* chain) {
+    memset(chain, 0, sizeof(*chain));
+}
+
+int effects_chain_add(effects_chain_t* chain, effect_process_fn process, void* state) {
+    if (chain->count >= EFFECTS_MAX_SLOTS) return -1;
+    chain->slots[chain->count] = (effect_slot_t){ .process = process, .state = state, .enabled = true };
+    return chain->count++;
+}
+
+void effects_chain_set_enabled(effects_chain_t* chain, int slot, bool enabled) {
+    if (slot >= 0 && slot < chain->count) chain->slots[slot].enabled = enabled;
+}
+
+void effects_chain_process(effects_chain_t* chain, int32_t* frame, size_t frame_size) {
+    for (uint8_t i = 0; i < chain->count; i++) {
+        if (chain->slots[i].enabled) chain->slots[i].process(chain->slots[i].state, frame, frame_size);
+    }
+}
+
+// echo
+void effect_echo_init(effect_echo_t* echo, uint32_t delay, uint16_t feedback, uint16_t mix) {
+    memset(echo->line, 0, sizeof(echo->line));
+    echo->delay = (delay == 0) ? 1 : (delay > ECHO_MAX_DELAY) ? ECHO_MAX_DELAY : delay;
+    echo->pos = 0;
+    echo->feedback = feedback;
+    echo->mix = mix;
+}
+
+void effect_echo_process(void* state, int32_t* frame, size_t frame_size) {
+    effect_echo_t* echo = state;
+    const int32_t feedback = echo->feedback;
+    const int32_t mix = echo->mix;
+    uint32_t pos = echo->pos;
+    for (size_t i = 0; i < frame_size; i++) {
+        int32_t delayed = echo->line[pos];
+        int32_t dry = frame[i] >> 16;
+        echo->line[pos] = (int16_t)sat16(dry + mul_q15_tz(delayed, feedback));
+        frame[i] = add_wet(frame[i], (delayed * mix) >> 15);
+        if (++pos >= echo->delay) pos = 0; // compare instead of modulo
+    }
+    echo->pos = pos;
+}
+
+// reverb
+void effect_reverb_init(effect_reverb_t* reverb, uint16_t room_size, uint16_t damping, uint16_t wet) {
+    memset(reverb, 0, sizeof(*reverb));
+    reverb->comb[0] = reverb->comb_0; reverb->comb_len[0] = REVERB_COMB_LEN_0;
+    reverb->comb[1] = reverb->comb_1; reverb->comb_len[1] = REVERB_COMB_LEN_1;
+    reverb->comb[2] = reverb->comb_2; reverb->comb_len[2] = REVERB_COMB_LEN_2;
+    reverb->comb[3] = reverb->comb_3; reverb->comb_len[3] = REVERB_COMB_LEN_3;
+    reverb->allpass[0] = reverb->allpass_0; reverb->allpass_len[0] = REVERB_ALLPASS_LEN_0;
+    reverb->allpass[1] = reverb->allpass_1; reverb->allpass_len[1] = REVERB_ALLPASS_LEN_1;
+    reverb->room_size = room_size;
+    reverb->damping = damping;
+    reverb->wet = wet;
+}
+
+void effect_reverb_process(void* state, int32_t* frame, size_t frame_size) {
+    effect_reverb_t* reverb = state;
+    const int32_t feedback = reverb->room_size;
+    const int32_t damping = reverb->damping;
+    const int32_t wet = reverb->wet;
+    for (size_t i = 0; i < frame_size; i++) {
+        int32_t input = frame[i] >> 19; // Q15 input scaled by 1/8 so 4 resonating combs stay in range
+
+        // parallel combs with a one-pole lowpass in the feedback path
+        int32_t acc = 0;
+        for (int c = 0; c < REVERB_COMBS; c++) {
+            int16_t* line = reverb->comb[c];
+            uint16_t pos = reverb->comb_pos[c];
+            int32_t out = line[pos];
+            reverb->comb_filter[c] = out + mul_q15_tz(reverb->comb_filter[c] - out, damping);
+            line[pos] = (int16_t)sat16(input + mul_q15_tz(reverb->comb_filter[c], feedback));
+            if (++pos >= reverb->comb_len[c]) pos = 0;
+            reverb->comb_pos[c] = pos;
+            acc += out;
+        }
+        acc >>= 2;
+
+        // series allpasses diffuse the comb output, feedback fixed at 0.5
+        for (int a = 0; a < REVERB_ALLPASSES; a++) {
+            int16_t* line = reverb->allpass[a];
+            uint16_t pos = reverb->allpass_pos[a];
+            int32_t buffered = line[pos];
+            line[pos] = (int16_t)sat16(acc + mul_q15_tz(buffered, EFFECTS_UNITY / 2));
+            acc = buffered - acc;
+            if (++pos >= reverb->allpass_len[a]) pos = 0;
+            reverb->allpass_pos[a] = pos;
+        }
+
+        frame[i] = add_wet(frame[i], (sat16(acc) * wet) >> 15);
+    }
+}
+
+// compressor / limiter
+void effect_compressor_init(effect_compressor_t* comp, int32_t threshold, uint8_t ratio, uint16_t attack, uint16_t release, uint16_t makeup) {
+    comp->threshold = (threshold <= 0) ? 1 : threshold;
+    comp->ratio = ratio;
+    comp->attack = attack;
+    comp->release = release;
+    comp->makeup = makeup;
+    comp->envelope = 0;
+    comp->gain = EFFECTS_UNITY;
+}
+
+// Q15 gain that maps the envelope onto the compression curve
+static int32_t compressor_gain(const effect_compressor_t* comp) {
+    int32_t envelope = comp->envelope;
+    if (envelope <= comp->threshold) return EFFECTS_UNITY;
+    int64_t target = comp->threshold;
+    if (comp->ratio > 1) target += (envelope - comp->threshold) / comp->ratio;
+    else if (comp->ratio == 1) target = envelope;
+    return (int32_t)((target << 15) / envelope);
+}
+
+void effect_compressor_process(void* state, int32_t* frame, size_t frame_size) {
+    effect_compressor_t* comp = state;
+    const int32_t attack = comp->attack;
+    const int32_t release = comp->release;
+    int32_t envelope = comp->envelope;
+    for (size_t start = 0; start < frame_size; start += COMPRESSOR_BLOCK) {
+        size_t end = (start + COMPRESSOR_BLOCK < frame_size) ? start + COMPRESSOR_BLOCK : frame_size;
+        comp->envelope = envelope;
+        comp->gain = compressor_gain(comp);
+        const int32_t gain = (comp->gain * (int32_t)comp->makeup) >> 15;
+        for (size_t i = start; i < end; i++) {
+            int32_t level = (frame[i] == INT32_MIN) ? INT32_MAX : (frame[i] < 0 ? -frame[i] : frame[i]);
+            int32_t coeff = (level > envelope) ? attack : release;
+            envelope += (int32_t)(((int64_t)(level - envelope) * coeff) >> 15);
+            frame[i] = sat32(((int64_t)frame[i] * gain) >> 15);
+        }
+    }
+    comp->envelope = envelope;
+}
+
+// pitch correction
+#define PC_UNITY 65536 // Q16 ratio 1.0
+#define PC_SEMITONE_UP 69433
+#define PC_SEMITONE_DOWN 61858
+#define PC_HOLD_UP 67847 // 0.6 semitone. a held note is kept until the voice strays this far from it
+#define PC_HOLD_DOWN 63304
+#define PC_THRESHOLD 4915 // Q15 yin threshold, 0.15
+#define PC_ENERGY_FLOOR (PITCH_CORRECT_SPAN * 16) // Q11 rms of 4, about -54 dBFS. quieter is taken as unvoiced
+#define PC_RECENTER 256 // Q16 tap drift per sample while recentering, 0.4% or 7 cents
+
+// 2^(n/12) in Q16 for n = 0..11
+static const uint32_t semitone_up[12] = {
+    65536, 69433, 73562, 77936, 82570, 87480, 92682, 98193, 104032, 110218, 116772, 123715
+};
+
+void effect_pitch_correct_init(effect_pitch_correct_t* pc, uint32_t sample_rate, uint16_t strength, uint16_t glide) {
+    memset(pc, 0, sizeof(*pc));
+    while ((sample_rate >> pc->decim_shift) > PITCH_CORRECT_ANALYSIS_HZ) pc->decim_shift++;
+    uint32_t rate = sample_rate >> pc->decim_shift;
+    pc->min_lag = (rate / PITCH_CORRECT_MAX_HZ < 2) ? 2 : rate / PITCH_CORRECT_MAX_HZ;
+    pc->max_lag = rate / PITCH_CORRECT_MIN_HZ;
+    if (pc->max_lag > PITCH_CORRECT_HISTORY - PITCH_CORRECT_SPAN - 2) pc->max_lag = PITCH_CORRECT_HISTORY - PITCH_CORRECT_SPAN - 2;
+
+    // period of a4 in Q16 analysis samples, then every note from a1, 36 semitones down
+    uint64_t a4 = ((uint64_t)rate << 16) / 440;
+    for (int k = 0; k < PITCH_CORRECT_NOTES; k++) {
+        int n = k - 36;
+        int octave = (n >= 0) ? n / 12 : -((11 - n) / 12);
+        uint64_t period = (a4 << 16) / semitone_up[n - 12 * octave];
+        period = (octave < 0) ? period << -octave : period >> octave;
+        pc->note_period[k] = (uint32_t)(period >> 8);
+    }
+    pc->strength = strength;
+    pc->glide = glide;
+    effect_pitch_correct_reset(pc);
+}
+
+void effect_pitch_correct_reset(effect_pitch_correct_t* pc) {
+    memset(pc->history, 0, sizeof(pc->history));
+    pc->history_pos = 0;
+    pc->since_estimate = 0;
+    pc->decim_acc = 0;
+    pc->decim_count = 0;
+    pc->note = -1;
+    memset(pc->line, 0, sizeof(pc->line));
+    pc->write_pos = 0;
+    pc->delay = (uint32_t)PITCH_CORRECT_WINDOW << 15; // middle of the window, where the first tap carries it all
+    pc->ratio = PC_UNITY;
+    pc->target = PC_UNITY;
+    pc->period = 0;
+}
+
+// yin: the first lag whose cumulative mean normalized difference dips under the threshold, followed down to that
+// dip's minimum and interpolated. Q8 analysis samples, 0 when there is no clear period. reads the history in place
+// and stops at the dip, so there is no scratch on the write task's stack
+static uint32_t pitch_estimate(const effect_pitch_correct_t* pc) {
+    const int16_t* h = pc->history;
+    const uint32_t mask = PITCH_CORRECT_HISTORY - 1;
+    const uint32_t max_lag = pc->max_lag;
+    const uint32_t start = pc->history_pos - (PITCH_CORRECT_SPAN + max_lag + 1);
+
+    uint32_t energy = 0;
+    for (uint32_t i = 0; i < PITCH_CORRECT_SPAN; i++) energy += (uint32_t)(h[(start + i) & mask] * h[(start + i) & mask]);
+    if (energy < PC_ENERGY_FLOOR) return 0;
+
+    uint64_t cumulative = 0;
+    uint32_t prev = 32768, before = 0, best = 0, after = 0, best_lag = 0; // Q15 normalized differences
+    for (uint32_t lag = 1; lag <= max_lag + 1; lag++) {
+        uint32_t d = 0; // Q11 differences squared, at most 192 * 4095^2, fits
+        for (uint32_t i = 0; i < PITCH_CORRECT_SPAN; i++) {
+            int32_t diff = h[(start + i) & mask] - h[(start + i + lag) & mask];
+            d += (uint32_t)(diff * diff);
+        }
+        cumulative += d;
+        uint32_t v = (cumulative == 0) ? 32768 : (uint32_t)(((uint64_t)d * lag << 15) / cumulative);
+        if (best_lag != 0) {
+            if (v >= best || lag > max_lag) {
+                after = v;
+                break;
+            }
+            before = prev;
+            best = v;
+            best_lag = lag;
+        } else if (lag >= pc->min_lag && lag <= max_lag && v < PC_THRESHOLD) {
+            before = prev;
+            best = v;
+            best_lag = lag;
+        }
+        prev = v;
+    }
+    if (best_lag == 0) return 0;
+
+    // parabola through the minimum and its neighbours
+    int32_t den = (int32_t)before - 2*(int32_t)best + (int32_t)after;
+    int32_t offset = (den > 0) ? ((int32_t)before - (int32_t)after) * 128 / den : 0;
+    if (offset > 128) offset = 128;
+    if (offset < -128) offset = -128;
+    return best_lag * 256 + offset;
+}
+
+// note whose period is nearest to period (Q8 analysis samples), geometrically
+static int8_t nearest_note(const effect_pitch_correct_t* pc, uint32_t period) {
+    for (int k = 0; k + 1 < PITCH_CORRECT_NOTES; k++) {
+        uint32_t shorter = pc->note_period[k + 1];
+        if (period > shorter) return ((uint64_t)period * period >= (uint64_t)pc->note_period[k] * shorter) ? k : k + 1;
+    }
+    return PITCH_CORRECT_NOTES - 1;
+}
+
+// new estimate -> held note -> target ratio, then one glide step towards it
+static void pitch_track(effect_pitch_correct_t* pc) {
+    uint32_t period = pitch_estimate(pc);
+    pc->period = period << pc->decim_shift;
+    int32_t target = PC_UNITY;
+    if (period != 0) {
+        // a singer between two notes would otherwise flip back and forth
+        if (pc->note >= 0) {
+            uint32_t off = (uint32_t)(((uint64_t)period << 16) / pc->note_period[pc->note]);
+            if (off > PC_HOLD_UP || off < PC_HOLD_DOWN) pc->note = -1;
+        }
+        if (pc->note < 0) pc->note = nearest_note(pc, period);
+        int32_t ratio = (int32_t)(((uint64_t)period << 16) / pc->note_period[pc->note]); // a sharp voice has a short period
+        if (ratio > PC_SEMITONE_UP) ratio = PC_SEMITONE_UP; // beyond the ends of the note table
+        if (ratio < PC_SEMITONE_DOWN) ratio = PC_SEMITONE_DOWN;
+        target = PC_UNITY + (int32_t)((int64_t)(ratio - PC_UNITY) * pc->strength / EFFECTS_UNITY);
+    } else {
+        pc->note = -1;
+    }
+    pc->target = target;
+    int32_t move = (int32_t)((int64_t)(target - pc->ratio) * pc->glide / EFFECTS_UNITY);
+    pc->ratio = (move == 0) ? target : pc->ratio + move;
+}
+
+// linearly interpolated read delay (Q16) samples behind the newest sample
+static inline int32_t pc_tap(const int32_t* line, uint32_t newest, uint32_t delay) {
+    uint32_t pos = ((newest & PITCH_CORRECT_LINE_MASK) << 16) + ((uint32_t)PITCH_CORRECT_LINE_LEN << 16) - delay;
+    uint32_t i = (pos >> 16) & PITCH_CORRECT_LINE_MASK;
+    int32_t frac = (pos >> 1) & 0x7FFF; // Q15
+    int32_t s0 = line[i];
+    int32_t s1 = line[(i + 1) & PITCH_CORRECT_LINE_MASK];
+    return s0 + (int32_t)((((int64_t)s1 - s0) * frac) >> 15);
+}
+
+void effect_pitch_correct_process(void* state, int32_t* frame, size_t frame_size) {
+    effect_pitch_correct_t* pc = state;
+
+    // box filtered analysis copy, estimating every hop
+    const uint32_t decim = 1u << pc->decim_shift;
+    for (size_t i = 0; i < frame_size; i++) {
+        pc->decim_acc += frame[i] >> 16;
+        if (++pc->decim_count < decim) continue;
+        pc->history[pc->history_pos++ & (PITCH_CORRECT_HISTORY - 1)] = (int16_t)((pc->decim_acc >> pc->decim_shift) >> 4);
+        pc->decim_acc = 0;
+        pc->decim_count = 0;
+        if (++pc->since_estimate >= PITCH_CORRECT_HOP) {
+            pc->since_estimate = 0;
+            pitch_track(pc);
+        }
+    }
+
+    // with no shift wanted the taps drift back to the middle of the window, after which the output is the input
+    // delayed by half a window, sample for sample
+    const uint32_t window = (uint32_t)PITCH_CORRECT_WINDOW << 16;
+    const uint32_t center = window / 2;
+    int32_t step = PC_UNITY - pc->ratio; // the delay shrinks when pitching up
+    bool recentered = false;
+    if (pc->ratio == PC_UNITY && pc->delay != center) {
+        int64_t remaining = (int64_t)center - pc->delay;
+        int64_t most = (int64_t)PC_RECENTER * (int64_t)frame_size;
+        recentered = (remaining <= most && remaining >= -most);
+        step = recentered ? (int32_t)(remaining / (int64_t)frame_size) : (remaining > 0) ? PC_RECENTER : -PC_RECENTER;
+    }
+
+    uint32_t write_pos = pc->write_pos;
+    uint32_t delay = pc->delay;
+    for (size_t i = 0; i < frame_size; i++) {
+        pc->line[write_pos & PITCH_CORRECT_LINE_MASK] = frame[i];
+
+        // second tap trails by half a window. triangular crossfade, each tap is silent where its delay wraps
+        uint32_t delay_2 = delay + window / 2;
+        if (delay_2 >= window) delay_2 -= window;
+        int32_t t = delay >> (PITCH_CORRECT_WINDOW_BITS + 1); // Q15 position in the window
+        int32_t gain_1 = (t < 16384) ? 2*t : 2*(32768 - t);
+        int64_t mixed = (int64_t)pc_tap(pc->line, write_pos, delay) * gain_1 + (int64_t)pc_tap(pc->line, write_pos, delay_2) * (32768 - gain_1);
+        frame[i] = (int32_t)(mixed >> 15); // convex blend of two samples, cannot overflow
+
+        write_pos++;
+        int32_t next = (int32_t)delay + step;
+        if (next < 0) next += (int32_t)window;
+        else if (next >= (int32_t)window) next -= (int32_t)window;
+        delay = (uint32_t)next;
+    }
+    pc->write_pos = write_pos;
+    pc->delay = recentered ? center : delay;
+}
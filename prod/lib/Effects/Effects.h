@@ -0,0 +1,144 @@
+#ifndef EFFECTS_H
+#define EFFECTS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// allocation-free vocal effects for the mic path. every effect works in place on a frame of 24 bit mono mic samples
+// in a 32 bit container (Q31), keeps its delay lines in Q15 and takes Q15 parameters where 32768 is 1.0.
+// no esp-idf or freertos dependencies.
+
+#define EFFECTS_MAX_SLOTS 4
+#define EFFECTS_UNITY 32768 // Q15 1.0
+
+typedef void (*effect_process_fn)(void* state, int32_t* frame, size_t frame_size);
+
+typedef struct {
+    effect_process_fn process;
+    void* state;
+    bool enabled;
+} effect_slot_t;
+
+// effects run in the order they were added
+typedef struct {
+    effect_slot_t slots[EFFECTS_MAX_SLOTS];
+    uint8_t count;
+} effects_chain_t;
+
+void effects_chain_init(effects_chain_t* chain);
+
+// appends an effect. returns the slot index, or -1 if the chain is full
+int effects_chain_add(effects_chain_t* chain, effect_process_fn process, void* state);
+
+void effects_chain_set_enabled(effects_chain_t* chain, int slot, bool enabled);
+
+void effects_chain_process(effects_chain_t* chain, int32_t* frame, size_t frame_size);
+
+// feedback echo
+#define ECHO_MAX_DELAY 8192 // samples, ~186 ms at 44.1 kHz
+
+typedef struct {
+    int16_t line[ECHO_MAX_DELAY];
+    uint32_t delay; // samples
+    uint32_t pos;
+    uint16_t feedback; // Q15, keep below EFFECTS_UNITY
+    uint16_t mix; // Q15 level of the echo added to the dry signal
+} effect_echo_t;
+
+void effect_echo_init(effect_echo_t* echo, uint32_t delay, uint16_t feedback, uint16_t mix);
+void effect_echo_process(void* state, int32_t* frame, size_t frame_size);
+
+// freeverb-style reverb: 4 damped feedback combs in parallel into 2 allpasses in series.
+// delay lengths are freeverb's tuning for 44.1 kHz
+#define REVERB_COMBS 4
+#define REVERB_ALLPASSES 2
+#define REVERB_COMB_LEN_0 1116
+#define REVERB_COMB_LEN_1 1188
+#define REVERB_COMB_LEN_2 1277
+#define REVERB_COMB_LEN_3 1356
+#define REVERB_ALLPASS_LEN_0 556
+#define REVERB_ALLPASS_LEN_1 441
+
+typedef struct {
+    int16_t comb_0[REVERB_COMB_LEN_0];
+    int16_t comb_1[REVERB_COMB_LEN_1];
+    int16_t comb_2[REVERB_COMB_LEN_2];
+    int16_t comb_3[REVERB_COMB_LEN_3];
+    int16_t allpass_0[REVERB_ALLPASS_LEN_0];
+    int16_t allpass_1[REVERB_ALLPASS_LEN_1];
+    int16_t* comb[REVERB_COMBS];
+    uint16_t comb_len[REVERB_COMBS];
+    uint16_t comb_pos[REVERB_COMBS];
+    int32_t comb_filter[REVERB_COMBS]; // damping lowpass state
+    int16_t* allpass[REVERB_ALLPASSES];
+    uint16_t allpass_len[REVERB_ALLPASSES];
+    uint16_t allpass_pos[REVERB_ALLPASSES];
+    uint16_t room_size; // Q15 comb feedback, sets the decay time
+    uint16_t damping; // Q15, higher is darker
+    uint16_t wet; // Q15 level of the reverb added to the dry signal
+} effect_reverb_t;
+
+void effect_reverb_init(effect_reverb_t* reverb, uint16_t room_size, uint16_t damping, uint16_t wet);
+void effect_reverb_process(void* state, int32_t* frame, size_t frame_size);
+
+// peak compressor. ratio 0 makes it a brickwall limiter
+#define COMPRESSOR_BLOCK 16 // samples per gain update, keeps divisions out of the per-sample loop
+
+typedef struct {
+    int32_t threshold; // Q31 envelope level where compression starts
+    uint8_t ratio; // input:output above threshold
+    uint16_t attack; // Q15 envelope coefficient when the level rises
+    uint16_t release; // Q15 envelope coefficient when the level falls
+    uint16_t makeup; // Q15 gain applied after compression
+    int32_t envelope; // Q31
+    int32_t gain; // Q15, current
+} effect_compressor_t;
+
+void effect_compressor_init(effect_compressor_t* comp, int32_t threshold, uint8_t ratio, uint16_t attack, uint16_t release, uint16_t makeup);
+void effect_compressor_process(void* state, int32_t* frame, size_t frame_size);
+
+// pitch correction. every PITCH_CORRECT_HOP analysis samples the sung pitch is estimated with a yin difference
+// function over a decimated copy of the input (box filtered down to PITCH_CORRECT_ANALYSIS_HZ or less), and a two tap
+// pitch shifter like PitchShift's glides towards the nearest equal tempered semitone, a4 = 440 Hz. unvoiced input
+// glides back to no shift. adds PITCH_CORRECT_WINDOW/2 samples of delay
+#define PITCH_CORRECT_MIN_HZ 70
+#define PITCH_CORRECT_MAX_HZ 1000
+#define PITCH_CORRECT_ANALYSIS_HZ 12000
+#define PITCH_CORRECT_HISTORY 512 // decimated samples kept, power of 2
+#define PITCH_CORRECT_SPAN 192 // decimated samples compared per lag, must leave room for the longest lag in the history
+#define PITCH_CORRECT_MAX_LAG (PITCH_CORRECT_ANALYSIS_HZ / PITCH_CORRECT_MIN_HZ)
+#define PITCH_CORRECT_HOP 64 // decimated samples between estimates, ~5.8 ms at 11 kHz
+#define PITCH_CORRECT_NOTES 52 // a1 (55 Hz) up to c6
+#define PITCH_CORRECT_WINDOW_BITS 9
+#define PITCH_CORRECT_WINDOW (1 << PITCH_CORRECT_WINDOW_BITS) // shifter crossfade, ~11.6 ms at 44.1 kHz
+#define PITCH_CORRECT_LINE_LEN (2 * PITCH_CORRECT_WINDOW)
+#define PITCH_CORRECT_LINE_MASK (PITCH_CORRECT_LINE_LEN - 1)
+
+typedef struct {
+    int16_t history[PITCH_CORRECT_HISTORY]; // decimated input, Q11 so the difference sums fit 32 bits
+    uint32_t history_pos; // free-running
+    uint32_t since_estimate;
+    int32_t decim_acc;
+    uint8_t decim_shift; // analysis rate is sample_rate >> decim_shift
+    uint8_t decim_count;
+    uint16_t min_lag;
+    uint16_t max_lag;
+    uint32_t note_period[PITCH_CORRECT_NOTES]; // Q8 decimated samples, lowest note first
+    int8_t note; // index of the note being held, -1 for none
+    int32_t line[PITCH_CORRECT_LINE_LEN];
+    uint32_t write_pos;
+    uint32_t delay; // Q16 samples behind the newest sample, of the first tap
+    int32_t ratio; // Q16 pitch ratio applied
+    int32_t target; // Q16 pitch ratio being glided to
+    uint16_t strength; // Q15, how much of the way to the note. unity snaps
+    uint16_t glide; // Q15 part of the distance to the target covered per estimate
+    uint32_t period; // last estimate in Q8 input samples, 0 when unvoiced
+} effect_pitch_correct_t;
+
+void effect_pitch_correct_init(effect_pitch_correct_t* pc, uint32_t sample_rate, uint16_t strength, uint16_t glide);
+// forgets the history and the held note, for when the effect is switched back on
+void effect_pitch_correct_reset(effect_pitch_correct_t* pc);
+void effect_pitch_correct_process(void* state, int32_t* frame, size_t frame_size);
+
+#endif
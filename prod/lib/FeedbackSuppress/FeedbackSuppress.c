@@ -0,0 +1,202 @@
+#include <math.h>
+#include <string.h>
+#include "FeedbackSuppress.h"
+
+#define LOG2_FFT_SIZE 9
+#define PNPR_MIN 31.6f // peak to neighbour power ratio, 15 dB
+#define PHPR_MIN 31.6f // peak to (sub)harmonic power ratio, 15 dB
+#define PEAK_FLOOR 3.0e5f // weakest peak worth a look, about -50 dBFS through the hann window
+#define NEIGHBOUR_NEAR 3 // bins either side skipped, the window's main lobe
+#define NEIGHBOUR_FAR 8
+#define Q_MIN 4.0f
+#define Q_MAX 60.0f
+
+// shared by every instance, filled on first init
+static float window[FEEDBACK_FFT_SIZE];
+static float twiddle_re[FEEDBACK_FFT_SIZE / 2];
+static float twiddle_im[FEEDBACK_FFT_SIZE / 2];
+static bool tables_ready = false;
+
+static void build_tables(void) {
+    for (int i = 0; i < FEEDBACK_FFT_SIZE; i++) {
+        window[i] = 0.5f - 0.5f * cosf(2.0f * (float)M_PI * i / FEEDBACK_FFT_SIZE);
+    }
+    for (int i = 0; i < FEEDBACK_FFT_SIZE / 2; i++) {
+        twiddle_re[i] = cosf(2.0f * (float)M_PI * i / FEEDBACK_FFT_SIZE);
+        twiddle_im[i] = -sinf(2.0f * (float)M_PI * i / FEEDBACK_FFT_SIZE);
+    }
+    tables_ready = true;
+}
+
+// in place iterative radix-2
+static void fft(float* re, float* im) {
+    for (uint32_t i = 1, j = 0; i < FEEDBACK_FFT_SIZE; i++) {
+        uint32_t bit = FEEDBACK_FFT_SIZE >> 1;
+        for (; j & bit; bit >>= 1) j ^= bit;
+        j |= bit;
+        if (i < j) {
+            float t = re[i]; re[i] = re[j]; re[j] = t;
+            t = im[i]; im[i] = im[j]; im[j] = t;
+        }
+    }
+    for (uint32_t len = 2, step = FEEDBACK_FFT_SIZE / 2; len <= FEEDBACK_FFT_SIZE; len <<= 1, step >>= 1) {
+        uint32_t half = len >> 1;
+        for (uint32_t base = 0; base < FEEDBACK_FFT_SIZE; base += len) {
+            for (uint32_t k = 0; k < half; k++) {
+                float wr = twiddle_re[k * step], wi = twiddle_im[k * step];
+                uint32_t a = base + k, b = a + half;
+                float tr = re[b] * wr - im[b] * wi;
+                float ti = re[b] * wi + im[b] * wr;
+                re[b] = re[a] - tr; im[b] = im[a] - ti;
+                re[a] += tr; im[a] += ti;
+            }
+        }
+    }
+}
+
+void feedback_suppress_init(feedback_suppress_t* fs, float sample_rate) {
+    if (!tables_ready) build_tables();
+    memset(fs, 0, sizeof(*fs));
+    fs->sample_rate = sample_rate;
+    fs->hold_hops = (uint32_t)(FEEDBACK_HOLD_MS / 1000.0f * sample_rate / FEEDBACK_HOP);
+    fs->candidate_bin = -1;
+}
+
+void feedback_suppress_reset(feedback_suppress_t* fs) {
+    for (int n = 0; n < FEEDBACK_MAX_NOTCHES; n++) fs->notches[n].active = false;
+    fs->candidate_bin = -1;
+    fs->candidate_hops = 0;
+}
+
+uint32_t feedback_suppress_active(const feedback_suppress_t* fs) {
+    uint32_t count = 0;
+    for (int n = 0; n < FEEDBACK_MAX_NOTCHES; n++) count += fs->notches[n].active;
+    return count;
+}
+
+static float neighbour_power(const float* power, int32_t k) {
+    float sum = 0.0f;
+    int count = 0;
+    for (int d = NEIGHBOUR_NEAR; d <= NEIGHBOUR_FAR; d++) {
+        if (k - d >= 1) { sum += power[k - d]; count++; }
+        if (k + d < FEEDBACK_FFT_SIZE / 2) { sum += power[k + d]; count++; }
+    }
+    return sum / count;
+}
+
+// strongest of the 3 bins around a (sub)harmonic position, 0 if out of range
+static float harmonic_power(const float* power, float bin) {
+    int32_t k = (int32_t)lrintf(bin);
+    if (k < 2 || k >= FEEDBACK_FFT_SIZE / 2 - 1) return 0.0f;
+    float p = power[k];
+    if (power[k - 1] > p) p = power[k - 1];
+    if (power[k + 1] > p) p = power[k + 1];
+    return p;
+}
+
+// howl is a lone sinusoid: narrow, no harmonic series around it, loud enough to matter
+static bool is_howl(const float* power, int32_t k) {
+    float p = power[k];
+    if (p < PEAK_FLOOR) return false;
+    if (p < PNPR_MIN * neighbour_power(power, k)) return false;
+    if (p < PHPR_MIN * harmonic_power(power, k * 2.0f)) return false;
+    if (p < PHPR_MIN * harmonic_power(power, k * 3.0f)) return false;
+    if (p < PHPR_MIN * harmonic_power(power, k * 0.5f)) return false; // k itself is a harmonic of a sung note
+    return true;
+}
+
+static void place_notch(feedback_suppress_t* fs, float freq) {
+    const float bin_hz = fs->sample_rate / FEEDBACK_FFT_SIZE;
+    feedback_notch_t* target = NULL;
+    for (int n = 0; n < FEEDBACK_MAX_NOTCHES; n++) {
+        feedback_notch_t* notch = &fs->notches[n];
+        if (notch->active && fabsf(notch->freq - freq) < bin_hz) {
+            // the howl got past this notch: retune to the new estimate and widen
+            target = notch;
+            target->q = fmaxf(target->q * 0.5f, Q_MIN);
+            break;
+        }
+    }
+    if (target == NULL) {
+        // a free notch, otherwise the one idle the longest
+        target = &fs->notches[0];
+        for (int n = 0; n < FEEDBACK_MAX_NOTCHES; n++) {
+            feedback_notch_t* notch = &fs->notches[n];
+            if (!notch->active) { target = notch; break; }
+            if (notch->idle_hops > target->idle_hops) target = notch;
+        }
+        target->q = fminf(fmaxf(freq / FEEDBACK_NOTCH_BW_HZ, Q_MIN), Q_MAX);
+        target->active = true;
+        biquad_reset(&target->bq); // a reused slot's history belongs to another howl
+    }
+    target->freq = freq;
+    target->idle_hops = 0;
+    biquad_notch(&target->bq, fs->sample_rate, freq, target->q); // a retuned notch keeps its history, no click
+    fs->detections++;
+}
+
+static void analyse(feedback_suppress_t* fs) {
+    // oldest sample first, windowed
+    for (uint32_t i = 0; i < FEEDBACK_FFT_SIZE; i++) {
+        fs->re[i] = fs->history[(fs->history_pos + i) & (FEEDBACK_FFT_SIZE - 1)] * window[i];
+        fs->im[i] = 0.0f;
+    }
+    fft(fs->re, fs->im);
+    for (uint32_t k = 0; k < FEEDBACK_FFT_SIZE / 2; k++) {
+        fs->power[k] = (fs->re[k] * fs->re[k] + fs->im[k] * fs->im[k]) * (1.0f / FEEDBACK_FFT_SIZE);
+    }
+
+    const float bin_hz = fs->sample_rate / FEEDBACK_FFT_SIZE;
+    int32_t lo = (int32_t)(FEEDBACK_MIN_HZ / bin_hz) + 1;
+    int32_t hi = (int32_t)(FEEDBACK_MAX_HZ / bin_hz);
+    if (hi > FEEDBACK_FFT_SIZE / 2 - 2) hi = FEEDBACK_FFT_SIZE / 2 - 2;
+    int32_t peak = lo;
+    for (int32_t k = lo; k <= hi; k++) {
+        if (fs->power[k] > fs->power[peak]) peak = k;
+    }
+
+    for (int n = 0; n < FEEDBACK_MAX_NOTCHES; n++) {
+        feedback_notch_t* notch = &fs->notches[n];
+        if (notch->active && ++notch->idle_hops > fs->hold_hops) notch->active = false;
+    }
+
+    if (!is_howl(fs->power, peak)) {
+        fs->candidate_bin = -1;
+        fs->candidate_hops = 0;
+        return;
+    }
+    if (fs->candidate_bin >= 0 && peak >= fs->candidate_bin - 1 && peak <= fs->candidate_bin + 1) {
+        fs->candidate_hops++;
+    } else {
+        fs->candidate_hops = 1;
+    }
+    fs->candidate_bin = peak;
+    if (fs->candidate_hops < FEEDBACK_PERSIST) return;
+
+    // parabolic interpolation on log power puts the notch between bins
+    float a = logf(fs->power[peak - 1] + 1e-9f), b = logf(fs->power[peak] + 1e-9f), c = logf(fs->power[peak + 1] + 1e-9f);
+    float denom = a - 2.0f * b + c;
+    float delta = (denom < 0.0f) ? 0.5f * (a - c) / denom : 0.0f;
+    place_notch(fs, (peak + delta) * bin_hz);
+    fs->candidate_bin = -1;
+    fs->candidate_hops = 0;
+}
+
+void feedback_suppress_process(void* state, int32_t* frame, size_t frame_size) {
+    feedback_suppress_t* fs = (feedback_suppress_t*)state;
+
+    // analyse what comes in, so a notch that is holding a howl down keeps seeing the leftover
+    for (size_t i = 0; i < frame_size; i++) {
+        fs->history[fs->history_pos] = (int16_t)(frame[i] >> 16);
+        fs->history_pos = (fs->history_pos + 1) & (FEEDBACK_FFT_SIZE - 1);
+    }
+    fs->pending += frame_size;
+    if (fs->pending >= FEEDBACK_HOP) {
+        fs->pending = 0;
+        analyse(fs);
+    }
+
+    for (int n = 0; n < FEEDBACK_MAX_NOTCHES; n++) {
+        if (fs->notches[n].active) biquad_process(&fs->notches[n].bq, frame, frame_size);
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef FEEDBACKSUPPRESS_H
+#define FEEDBACKSUPPRESS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "Biquad.h"
+
+// acoustic feedback (howl) suppressor for the mic path. a 512 point fft of the incoming mic signal looks for a peak
+// that is narrow (well above its neighbouring bins), not part of a harmonic series (so not a sung note) and holds
+// still for several hops. each one found gets a narrow notch from a fixed bank, which is released again once it
+// has gone unused for FEEDBACK_HOLD_MS. fixed-size state, no allocation, no esp-idf or freertos dependencies.
+// works in place on Q31 frames, so it can sit in an effects_chain_t
+
+#define FEEDBACK_FFT_SIZE 512 // analysis window, ~86 Hz bins at 44.1 kHz
+#define FEEDBACK_HOP 256 // new samples between analyses
+#define FEEDBACK_MAX_NOTCHES 8
+#define FEEDBACK_MIN_HZ 100.0f
+#define FEEDBACK_MAX_HZ 10000.0f
+#define FEEDBACK_PERSIST 6 // hops a peak has to hold still, ~35 ms at 44.1 kHz
+#define FEEDBACK_HOLD_MS 60000 // an unused notch is released after this, a howl that comes back is caught again
+#define FEEDBACK_NOTCH_BW_HZ 40.0f // notch width, q is clamped so low and high notches stay sensible
+
+typedef struct {
+    biquad_t bq;
+    float freq;
+    float q;
+    uint32_t idle_hops; // hops since the detector last pointed at this notch
+    bool active;
+} feedback_notch_t;
+
+typedef struct {
+    float sample_rate;
+    int16_t history[FEEDBACK_FFT_SIZE]; // circular, newest FEEDBACK_FFT_SIZE input samples in Q15
+    uint32_t history_pos;
+    uint32_t pending; // samples since the last analysis
+    float re[FEEDBACK_FFT_SIZE];
+    float im[FEEDBACK_FFT_SIZE];
+    float power[FEEDBACK_FFT_SIZE / 2];
+    int32_t candidate_bin; // peak being watched, -1 for none
+    uint32_t candidate_hops;
+    uint32_t hold_hops; // FEEDBACK_HOLD_MS in hops
+    feedback_notch_t notches[FEEDBACK_MAX_NOTCHES];
+    uint32_t detections; // notches placed or retuned, for the stats log
+} feedback_suppress_t;
+
+void feedback_suppress_init(feedback_suppress_t* fs, float sample_rate);
+
+// drops every notch
+void feedback_suppress_reset(feedback_suppress_t* fs);
+
+// effect_process_fn compatible: analyses frame_size Q31 samples and runs them through the active notches in place
+void feedback_suppress_process(void* state, int32_t* frame, size_t frame_size);
+
+// number of notches currently placed
+uint32_t feedback_suppress_active(const feedback_suppress_t* fs);
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef FRAMERING_H
+#define FRAMERING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+// lock-free single producer / single consumer ring of frame slots over a static buffer pool.
+// replaces the free/busy pointer queues: the producer fills the slot at head, the consumer reads the slot at tail.
+// portable c11 atomics, no esp-idf or freertos dependencies. waking a sleeping consumer is left to the caller
+
+typedef struct {
+    int32_t* pool; // slot_count frames of frame_size samples, back to back
+    size_t frame_size;
+    uint32_t slot_count;
+    _Atomic uint32_t head; // 0..2*slot_count-1, written by producer
+    _Atomic uint32_t tail; // 0..2*slot_count-1, written by consumer
+    _Atomic bool consumer_waiting;
+    _Atomic uint32_t overruns; // producer found every slot in use
+    _Atomic uint32_t max_occupancy;
+} frame_ring_t;
+
+// pool must hold slot_count*frame_size samples
+void frame_ring_init(frame_ring_t* ring, int32_t* pool, size_t frame_size, uint32_t slot_count);
+
+// producer: slot to fill next, or NULL (and an overrun is counted) if the consumer still holds every slot
+int32_t* frame_ring_acquire(frame_ring_t* ring);
+
+// producer: hands the acquired slot to the consumer. returns true if the consumer is asleep and needs a wake-up
+bool frame_ring_publish(frame_ring_t* ring);
+
+// consumer: oldest published frame, or NULL if the ring is empty
+int32_t* frame_ring_peek(frame_ring_t* ring);
+
+// consumer: like peek, but when the ring is empty also flags the consumer as waiting so the next publish
+// asks for a wake-up. call right before going to sleep
+int32_t* frame_ring_prepare_wait(frame_ring_t* ring);
+
+// consumer: gives the peeked frame back to the producer
+void frame_ring_release(frame_ring_t* ring);
+
+// published frames the consumer has not released yet
+uint32_t frame_ring_occupancy(frame_ring_t* ring);
+
+#endif
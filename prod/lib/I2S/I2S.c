@@ -1,17 +1,32 @@
 #include <stdio.h>
+#include <stdatomic.h>
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "I2S.h"
+#include "Telemetry.h"
 #include "driver/i2s_std.h"
 
-void i2s_init(i2s_chan_handle_t* input_chan_ptr, i2s_chan_handle_t* output_chan_ptr, uint32_t sample_rate, uint32_t frame_size, uint32_t dma_buffer_count) {
+// tx scheduling context, only one output channel
+static dma_sched_t* tx_sched = NULL;
+static TaskHandle_t tx_task = NULL;
+
+// rx capture stamps, one per filled dma buffer, consumed in order by i2s_read_once
+#define RX_STAMP_COUNT 16 // power of 2, at least dma_desc_num
+static uint32_t rx_stamps[RX_STAMP_COUNT];
+static _Atomic uint32_t rx_stamp_head = 0; // written by isr
+static uint32_t rx_stamp_tail = 0; // written by the read task
+static bool rx_stamps_on = false;
+
+void i2s_init(i2s_chan_handle_t* input_chan_ptr, i2s_chan_handle_t* output_chan_ptr, uint32_t input_channels, uint32_t input_sample_rate,
+              uint32_t output_sample_rate, uint32_t input_frame_size, uint32_t output_frame_size, uint32_t dma_buffer_count) {
     // INPUT
     // initialize i2s channel and i2s settings
     i2s_chan_config_t i2s_chan_config_1 = {  // shared between input and output
         .id = I2S_NUM_0, 
         .role = I2S_ROLE_MASTER, 
         .dma_desc_num = dma_buffer_count, 
-        .dma_frame_num = frame_size, 
+        .dma_frame_num = input_frame_size, 
         .auto_clear_after_cb = false, 
         .auto_clear_before_cb = false,
         .allow_pd = false, 
@@ -20,8 +35,8 @@ void i2s_init(i2s_chan_handle_t* input_chan_ptr, i2s_chan_handle_t* output_chan_
     ESP_ERROR_CHECK(i2s_new_channel(&i2s_chan_config_1, NULL, input_chan_ptr));
     
     i2s_std_config_t i2s_in_config = {
-        .clk_cfg  = I2S_STD_CLK_DEFAULT_CONFIG(sample_rate),
-        .slot_cfg = I2S_STD_MSB_SLOT_DEFAULT_CONFIG(I2S_DATA_BIT_WIDTH_32BIT, I2S_SLOT_MODE_MONO),
+        .clk_cfg  = I2S_STD_CLK_DEFAULT_CONFIG(input_sample_rate),
+        .slot_cfg = I2S_STD_MSB_SLOT_DEFAULT_CONFIG(I2S_DATA_BIT_WIDTH_32BIT, (input_channels == 2) ? I2S_SLOT_MODE_STEREO : I2S_SLOT_MODE_MONO),
         .gpio_cfg = {
             .mclk = I2S_GPIO_UNUSED,
             .bclk = GPIO_NUM_33,
@@ -43,16 +58,16 @@ void i2s_init(i2s_chan_handle_t* input_chan_ptr, i2s_chan_handle_t* output_chan_
         .id = I2S_NUM_1, 
         .role = I2S_ROLE_MASTER, 
         .dma_desc_num = dma_buffer_count, 
-        .dma_frame_num = frame_size, 
+        .dma_frame_num = output_frame_size, 
         .auto_clear_after_cb = false, 
-        .auto_clear_before_cb = false,
+        .auto_clear_before_cb = true, // buffers the write task misses play as silence instead of stale audio
         .allow_pd = false, 
         .intr_priority = 0, 
     };
     ESP_ERROR_CHECK(i2s_new_channel(&i2s_chan_config_2, output_chan_ptr, NULL));
 
     i2s_std_config_t i2s_out_config = {
-        .clk_cfg  = I2S_STD_CLK_DEFAULT_CONFIG(sample_rate),
+        .clk_cfg  = I2S_STD_CLK_DEFAULT_CONFIG(output_sample_rate),
         .slot_cfg = I2S_STD_MSB_SLOT_DEFAULT_CONFIG(I2S_DATA_BIT_WIDTH_16BIT, I2S_SLOT_MODE_STEREO),
         .gpio_cfg = {
             .mclk = I2S_GPIO_UNUSED,
@@ -71,13 +86,69 @@ void i2s_init(i2s_chan_handle_t* input_chan_ptr, i2s_chan_handle_t* output_chan_
     printf("I2S output driver initialized\n");
 }
 
-esp_err_t i2s_read_once(i2s_chan_handle_t* chan_handle_ptr, int32_t* data, size_t frame_size) {
+void i2s_deinit(i2s_chan_handle_t* input_chan_ptr, i2s_chan_handle_t* output_chan_ptr) {
+    ESP_ERROR_CHECK(i2s_channel_disable(*input_chan_ptr));
+    ESP_ERROR_CHECK(i2s_channel_disable(*output_chan_ptr));
+    ESP_ERROR_CHECK(i2s_del_channel(*input_chan_ptr));
+    ESP_ERROR_CHECK(i2s_del_channel(*output_chan_ptr));
+    *input_chan_ptr = NULL;
+    *output_chan_ptr = NULL;
+    rx_stamps_on = false;
+}
+
+esp_err_t i2s_read_once(i2s_chan_handle_t* chan_handle_ptr, int32_t* data, size_t frame_size, uint32_t* capture_stamp) {
     size_t bytes_read;
     // read from i2s
     esp_err_t ret = i2s_channel_read(*chan_handle_ptr, data, frame_size*sizeof(int32_t), &bytes_read, portMAX_DELAY);
-    if (ret != ESP_OK) {
-        if (ret == ESP_ERR_TIMEOUT) printf("I2S read timeout\n");
-        else printf("I2S read error: %d\n", ret);
-    } 
+    if (ret != ESP_OK) { // counted, not printed: this runs on the audio core
+        if (ret == ESP_ERR_TIMEOUT) telemetry_event(TELEM_I2S_READ_TIMEOUT, 0);
+        else telemetry_event(TELEM_I2S_READ_ERROR, (uint32_t)ret);
+    }
+    if (capture_stamp != NULL) {
+        // frame_size matches dma_frame_num, so each read drains exactly one dma buffer
+        uint32_t head = atomic_load_explicit(&rx_stamp_head, memory_order_acquire);
+        if (head - rx_stamp_tail > RX_STAMP_COUNT) rx_stamp_tail = head - RX_STAMP_COUNT; // driver dropped buffers too
+        if (rx_stamps_on && rx_stamp_tail != head) *capture_stamp = rx_stamps[rx_stamp_tail++ % RX_STAMP_COUNT];
+        else *capture_stamp = (uint32_t)esp_timer_get_time();
+    }
     return ret;
-}
\ No newline at end of file
+}
+
+// runs in isr context every time the tx dma finishes a buffer
+static IRAM_ATTR bool i2s_tx_sent_cb(i2s_chan_handle_t handle, i2s_event_data_t* event, void* user_ctx) {
+    BaseType_t high_task_woken = pdFALSE;
+    dma_sched_post(tx_sched, event->dma_buf, (uint32_t)esp_timer_get_time());
+    xTaskNotifyFromISR(tx_task, I2S_TX_SENT_BIT, eSetBits, &high_task_woken);
+    return high_task_woken == pdTRUE;
+}
+
+void i2s_register_tx_sched(i2s_chan_handle_t* chan_handle_ptr, dma_sched_t* sched, TaskHandle_t notify_task) {
+    tx_sched = sched;
+    tx_task = notify_task;
+    i2s_event_callbacks_t cbs = {
+        .on_recv = NULL,
+        .on_recv_q_ovf = NULL,
+        .on_sent = i2s_tx_sent_cb,
+        .on_send_q_ovf = NULL,
+    };
+    ESP_ERROR_CHECK(i2s_channel_register_event_callback(*chan_handle_ptr, &cbs, NULL));
+}
+// runs in isr context every time the rx dma fills a buffer
+static IRAM_ATTR bool i2s_rx_recv_cb(i2s_chan_handle_t handle, i2s_event_data_t* event, void* user_ctx) {
+    uint32_t head = atomic_load_explicit(&rx_stamp_head, memory_order_relaxed);
+    rx_stamps[head % RX_STAMP_COUNT] = (uint32_t)esp_timer_get_time();
+    atomic_store_explicit(&rx_stamp_head, head + 1, memory_order_release);
+    return false;
+}
+
+void i2s_register_rx_stamps(i2s_chan_handle_t* chan_handle_ptr) {
+    i2s_event_callbacks_t cbs = {
+        .on_recv = i2s_rx_recv_cb,
+        .on_recv_q_ovf = NULL,
+        .on_sent = NULL,
+        .on_send_q_ovf = NULL,
+    };
+    ESP_ERROR_CHECK(i2s_channel_register_event_callback(*chan_handle_ptr, &cbs, NULL));
+    rx_stamp_tail = atomic_load(&rx_stamp_head); // stamps from a previous channel are stale
+    rx_stamps_on = true;
+}
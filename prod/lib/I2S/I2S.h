@@ -1,12 +1,32 @@
 #ifndef I2S_H
 #define I2S_H
 
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "driver/i2s_std.h"
+#include "DmaSched.h"
 
-// initalizes i2s input to gpio pins 33,32,34, i2s output to gpio pins 26,25,22
-void i2s_init(i2s_chan_handle_t* input_chan_ptr, i2s_chan_handle_t* output_chan_ptr, uint32_t sample_rate, uint32_t frame_size, uint32_t dma_buffer_count);
+// initalizes i2s input to gpio pins 33,32,34, i2s output to gpio pins 26,25,22.
+// input_channels is 1 or 2: a second inmp441 with its L/R pin high shares the bus and lands in the right slot,
+// reads then come back interleaved. input and output rates are independent, size their frames so both cover the same period
+void i2s_init(i2s_chan_handle_t* input_chan_ptr, i2s_chan_handle_t* output_chan_ptr, uint32_t input_channels, uint32_t input_sample_rate,
+              uint32_t output_sample_rate, uint32_t input_frame_size, uint32_t output_frame_size, uint32_t dma_buffer_count);
 
-// reads frame_size samples from DMA over i2s
-esp_err_t i2s_read_once(i2s_chan_handle_t* chan_handle_ptr, int32_t* data, size_t frame_size);
+// disables and deletes both channels so they can be set up again with i2s_init, e.g. with other buffer sizes.
+// nothing may be reading or writing them
+void i2s_deinit(i2s_chan_handle_t* input_chan_ptr, i2s_chan_handle_t* output_chan_ptr);
+
+// reads frame_size samples (all slots) from DMA over i2s. capture_stamp (may be NULL) gets the esp_timer time in us, truncated,
+// at which the dma finished filling them, or the time of the read if i2s_register_rx_stamps was not called
+esp_err_t i2s_read_once(i2s_chan_handle_t* chan_handle_ptr, int32_t* data, size_t frame_size, uint32_t* capture_stamp);
+
+// stamps every filled rx dma buffer for i2s_read_once. must be called before the channel is enabled
+void i2s_register_rx_stamps(i2s_chan_handle_t* chan_handle_ptr);
+
+#define I2S_TX_SENT_BIT (1 << 0) // task notification bit set when a tx dma buffer is ready to be filled
+
+// hands every finished tx dma buffer to sched (stamped with the esp_timer time in us) and sets I2S_TX_SENT_BIT on notify_task,
+// so the buffers can be filled in place instead of going through i2s_channel_write. must be called before the channel is enabled
+void i2s_register_tx_sched(i2s_chan_handle_t* chan_handle_ptr, dma_sched_t* sched, TaskHandle_t notify_task);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,82 @@
+#include <string.h>
+#include "JitterBuffer.h"
+
+#define BYTES_PER_FRAME (2*sizeof(int16_t))
+
+void jitter_buffer_init(jitter_buffer_t* jb, byte_ring_t* ring, uint32_t in_rate, uint32_t out_rate, uint32_t min_target, uint32_t max_target) {
+    memset(jb, 0, sizeof(*jb));
+    jb->ring = ring;
+    jb->min_target = min_target;
+    jb->max_target = max_target;
+    jb->out_rate = out_rate;
+    jitter_buffer_set_in_rate(jb, in_rate);
+}
+
+void jitter_buffer_set_in_rate(jitter_buffer_t* jb, uint32_t in_rate) {
+    jb->nominal_step = ((uint64_t)in_rate << 32) / jb->out_rate;
+    resampler_init(&jb->rs, (in_rate > jb->out_rate) ? 0.85 * jb->out_rate / in_rate : 0.9); // cut below the output nyquist when downsampling
+    resampler_set_step(&jb->rs, jb->nominal_step);
+    jb->integral = 0.0f; // drift estimate was for the old ratio
+    atomic_store_explicit(&jb->target_frames, jb->min_target, memory_order_relaxed);
+    jb->fill_avg = (float)jb->min_target;
+    jitter_buffer_reset(jb);
+}
+
+void jitter_buffer_reset(jitter_buffer_t* jb) {
+    byte_ring_flush(jb->ring);
+    jb->running = false;
+}
+
+// one pi step per read: hold the smoothed fill at a target that covers the recent jitter
+static void jitter_buffer_control(jitter_buffer_t* jb, uint32_t fill) {
+    jb->fill_avg += ((float)fill - jb->fill_avg) * JITTER_AVG_ALPHA;
+    float drawdown = jb->fill_avg - (float)fill;
+    jb->jitter = (drawdown > jb->jitter) ? drawdown : jb->jitter * JITTER_DECAY;
+
+    float target = (float)jb->min_target + 2.0f * jb->jitter;
+    if (target > (float)jb->max_target) target = (float)jb->max_target;
+    atomic_store_explicit(&jb->target_frames, (uint32_t)target, memory_order_relaxed);
+
+    float error = jb->fill_avg - target; // too full -> read faster
+    float ppm = error * JITTER_KP + jb->integral;
+    if (ppm > JITTER_MAX_PPM) ppm = JITTER_MAX_PPM;
+    else if (ppm < -JITTER_MAX_PPM) ppm = -JITTER_MAX_PPM;
+    else jb->integral += error * JITTER_KI; // not while clamped, or a big target change winds it up into an overshoot
+    atomic_store_explicit(&jb->ratio_ppm, (int32_t)ppm, memory_order_relaxed);
+
+    int64_t correction = (int64_t)((float)(jb->nominal_step >> 12) * ppm * 1e-6f) * 4096; // float keeps ~24 bits, plenty at 1 ppm. * not <<, it's negative for a slow source
+    resampler_set_step(&jb->rs, jb->nominal_step + correction);
+}
+
+size_t jitter_buffer_read(jitter_buffer_t* jb, int16_t* out, size_t frames) {
+    uint32_t fill = byte_ring_fill(jb->ring) / BYTES_PER_FRAME;
+    atomic_store_explicit(&jb->fill_frames, fill, memory_order_relaxed);
+    if (!jb->running) {
+        if (fill < atomic_load_explicit(&jb->target_frames, memory_order_relaxed)) {
+            memset(out, 0, frames * BYTES_PER_FRAME);
+            return 0;
+        }
+        jb->running = true;
+        jb->fill_avg = (float)fill;
+    }
+    jitter_buffer_control(jb, fill);
+
+    // the buffered bytes can wrap once, so at most two contiguous runs
+    size_t produced = 0;
+    while (produced < frames) {
+        size_t contiguous;
+        const int16_t* in = (const int16_t*)byte_ring_peek(jb->ring, &contiguous);
+        size_t in_frames = contiguous / BYTES_PER_FRAME;
+        if (in_frames == 0) break;
+        size_t used;
+        produced += resampler_process(&jb->rs, in, in_frames, out + 2*produced, frames - produced, &used);
+        byte_ring_consume(jb->ring, used * BYTES_PER_FRAME);
+    }
+
+    if (produced < frames) { // ran dry, conceal with silence and rebuffer up to the target
+        memset(out + 2*produced, 0, (frames - produced) * BYTES_PER_FRAME);
+        atomic_fetch_add_explicit(&jb->underruns, 1, memory_order_relaxed);
+        jb->running = false;
+    }
+    return produced;
+}
@@ -0,0 +1,52 @@
+#ifndef JITTERBUFFER_H
+#define JITTERBUFFER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "ByteRing.h"
+#include "Resampler.h"
+
+// adaptive a2dp jitter buffer. sits on the consumer side of the bluetooth byte ring and always hands out full
+// output frames: a slow pi loop nudges the resampler ratio so the fill level holds a target instead of dropping
+// or zero padding, and the target follows how deep the arrival jitter has been draining the buffer.
+// no esp-idf or freertos dependencies.
+
+#define JITTER_MAX_PPM 1000.0f // ratio correction limit, ~1.7 cents, inaudible
+#define JITTER_KP 3.0f // ppm per frame of fill error
+#define JITTER_KI 0.0013f // ppm per frame of fill error, per read. with KP a ~60 s loop at 172 reads/s, damped 0.7
+#define JITTER_AVG_ALPHA 0.01f // fill smoothing per read, ~0.6 s at 256 frame reads
+#define JITTER_DECAY 0.9999f // how fast the jitter estimate forgets a burst, per read, ~1 min. the fill can only
+                             // move ~40 frames/s at JITTER_MAX_PPM, so the target has to hold still longer than that
+
+typedef struct {
+    byte_ring_t* ring; // 16 bit stereo pcm
+    resampler_t rs;
+    uint32_t out_rate;
+    uint64_t nominal_step; // Q32.32 in_rate/out_rate
+    uint32_t min_target; // input frames
+    uint32_t max_target;
+    bool running; // false while priming up to the target
+    float fill_avg;
+    float jitter; // deepest recent drawdown below the average fill, frames
+    float integral;
+    // stats, written by the reader only, atomic so the stats task can look at them while it reads
+    _Atomic uint32_t fill_frames;
+    _Atomic uint32_t target_frames;
+    _Atomic int32_t ratio_ppm;
+    _Atomic uint32_t underruns; // reads that ran dry and had to rebuffer
+} jitter_buffer_t;
+
+void jitter_buffer_init(jitter_buffer_t* jb, byte_ring_t* ring, uint32_t in_rate, uint32_t out_rate, uint32_t min_target, uint32_t max_target);
+
+// switches the stream's source rate, e.g. when the phone negotiates 48 kHz. drops what is buffered and primes again
+void jitter_buffer_set_in_rate(jitter_buffer_t* jb, uint32_t in_rate);
+
+// drops everything buffered and primes again, e.g. after a pause
+void jitter_buffer_reset(jitter_buffer_t* jb);
+
+// writes exactly frames stereo frames to out. returns how many came from the stream, the rest is silence
+size_t jitter_buffer_read(jitter_buffer_t* jb, int16_t* out, size_t frames);
+
+#endif
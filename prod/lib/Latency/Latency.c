@@ -0,0 +1,151 @@
+#include <string.h>
+#include "Latency.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_timer.h"
+
+uint32_t latency_now(void) {
+    return (uint32_t)esp_timer_get_time();
+}
+#else
+#include <time.h>
+
+uint32_t latency_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000u + ts.tv_nsec / 1000);
+}
+#endif
+
+void latency_init(latency_tracker_t* lt) {
+    memset(lt, 0, sizeof(*lt));
+    atomic_init(&lt->head, 0);
+    for (uint32_t i = 0; i < LATENCY_TRACE_LEN; i++) atomic_init(&lt->events[i].seq, 0);
+    latency_hist_init(&lt->total, 1000); // 1 ms bins, up to 128 ms
+    latency_hist_init(&lt->software, 100); // 0.1 ms bins, up to 12.8 ms
+}
+
+void latency_trace(latency_tracker_t* lt, uint16_t frame, latency_stage_t stage, uint32_t stamp) {
+    uint32_t idx = atomic_fetch_add_explicit(&lt->head, 1, memory_order_relaxed);
+    latency_event_t* ev = &lt->events[idx & (LATENCY_TRACE_LEN - 1)];
+    atomic_store_explicit(&ev->seq, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release); // reader must not see the new fields under the old seq
+    ev->stamp = stamp;
+    ev->frame = frame;
+    ev->stage = (uint8_t)stage;
+    atomic_store_explicit(&ev->seq, idx + 1, memory_order_release);
+}
+
+size_t latency_trace_drain(latency_tracker_t* lt, latency_event_t* out, size_t max) {
+    uint32_t head = atomic_load_explicit(&lt->head, memory_order_acquire);
+    if (head - lt->tail > LATENCY_TRACE_LEN) {
+        lt->lost += head - lt->tail - LATENCY_TRACE_LEN;
+        lt->tail = head - LATENCY_TRACE_LEN;
+    }
+    size_t n = 0;
+    while (n < max && lt->tail != head) {
+        latency_event_t* ev = &lt->events[lt->tail & (LATENCY_TRACE_LEN - 1)];
+        uint32_t seq = atomic_load_explicit(&ev->seq, memory_order_acquire);
+        if (seq == 0) break; // writer still filling it in, pick it up next time
+        out[n].stamp = ev->stamp;
+        out[n].frame = ev->frame;
+        out[n].stage = ev->stage;
+        atomic_thread_fence(memory_order_acquire);
+        // seqlock check: a writer a full ring ahead may have reused the slot while we copied
+        if (seq == lt->tail + 1 && atomic_load_explicit(&ev->seq, memory_order_relaxed) == seq) n++;
+        else lt->lost++;
+        lt->tail++;
+    }
+    return n;
+}
+
+void latency_tx_mixed(latency_tracker_t* lt, const void* buf, uint16_t frame, uint32_t capture) {
+    latency_tx_tag_t* tag = NULL;
+    for (uint32_t i = 0; i < LATENCY_MAX_TX && tag == NULL; i++) {
+        if (lt->tx[i].buf == NULL || lt->tx[i].buf == buf) tag = &lt->tx[i];
+    }
+    if (tag == NULL) return;
+    tag->buf = buf;
+    tag->frame = frame;
+    tag->capture = capture;
+    latency_hist_add(&lt->software, latency_now() - capture);
+}
+
+void latency_tx_sent(latency_tracker_t* lt, const void* buf, uint32_t sent) {
+    for (uint32_t i = 0; i < LATENCY_MAX_TX; i++) {
+        if (lt->tx[i].buf != buf) continue;
+        latency_trace(lt, lt->tx[i].frame, LATENCY_PLAY, sent);
+        latency_hist_add(&lt->total, sent - lt->tx[i].capture);
+        lt->tx[i].buf = NULL;
+        return;
+    }
+}
+
+void latency_hist_init(latency_hist_t* hist, uint32_t bin_us) {
+    hist->bin_us = bin_us;
+    for (uint32_t i = 0; i < LATENCY_HIST_BINS; i++) atomic_init(&hist->bins[i], 0);
+    atomic_init(&hist->count, 0);
+    atomic_init(&hist->min_us, UINT32_MAX);
+    atomic_init(&hist->max_us, 0);
+    atomic_init(&hist->sum_us, 0);
+}
+
+// single writer, so a load and a store in place of a read-modify-write
+#define HIST_LOAD(field) atomic_load_explicit(&(field), memory_order_relaxed)
+#define HIST_STORE(field, value) atomic_store_explicit(&(field), (value), memory_order_relaxed)
+
+void latency_hist_add(latency_hist_t* hist, uint32_t us) {
+    uint32_t bin = us / hist->bin_us;
+    if (bin >= LATENCY_HIST_BINS) bin = LATENCY_HIST_BINS - 1;
+    HIST_STORE(hist->bins[bin], HIST_LOAD(hist->bins[bin]) + 1);
+    HIST_STORE(hist->sum_us, HIST_LOAD(hist->sum_us) + us);
+    if (us < HIST_LOAD(hist->min_us)) HIST_STORE(hist->min_us, us);
+    if (us > HIST_LOAD(hist->max_us)) HIST_STORE(hist->max_us, us);
+    atomic_store_explicit(&hist->count, HIST_LOAD(hist->count) + 1, memory_order_release); // after the sample it counts
+}
+
+void latency_hist_summary(const latency_hist_t* hist, latency_summary_t* out) {
+    memset(out, 0, sizeof(*out));
+    uint32_t count = atomic_load_explicit(&hist->count, memory_order_acquire);
+    out->count = count;
+    if (count == 0) return;
+    out->min_us = HIST_LOAD(hist->min_us);
+    out->max_us = HIST_LOAD(hist->max_us);
+    out->avg_us = (uint32_t)(HIST_LOAD(hist->sum_us) / count);
+    out->p99_us = out->max_us; // if the bins ran ahead of count
+    uint32_t rank = count - count / 100; // samples at or below the 99th percentile
+    uint32_t seen = 0;
+    for (uint32_t i = 0; i < LATENCY_HIST_BINS; i++) {
+        seen += HIST_LOAD(hist->bins[i]);
+        if (seen >= rank) {
+            // the last bin has no upper edge, it holds everything longer
+            if (i < LATENCY_HIST_BINS - 1) out->p99_us = (i + 1) * hist->bin_us;
+            break;
+        }
+    }
+    if (out->p99_us > out->max_us) out->p99_us = out->max_us;
+}
+
+size_t latency_encode(const latency_event_t* events, size_t count, uint8_t* out, size_t out_len) {
+    if (count > UINT16_MAX || out_len < LATENCY_PACKET_LEN(count)) return 0;
+    size_t n = 0;
+    memcpy(out, "LTCY", 4);
+    n += 4;
+    out[n++] = count & 0xff;
+    out[n++] = count >> 8;
+    for (size_t i = 0; i < count; i++) {
+        uint32_t s = events[i].stamp;
+        out[n++] = s & 0xff;
+        out[n++] = (s >> 8) & 0xff;
+        out[n++] = (s >> 16) & 0xff;
+        out[n++] = s >> 24;
+        out[n++] = events[i].frame & 0xff;
+        out[n++] = events[i].frame >> 8;
+        out[n++] = events[i].stage;
+    }
+    uint16_t sum = 0;
+    for (size_t i = 0; i < n; i++) sum += out[i];
+    out[n++] = sum & 0xff;
+    out[n++] = sum >> 8;
+    return n;
+}
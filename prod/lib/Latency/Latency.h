@@ -0,0 +1,96 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+// mic-to-speaker latency tracing. each mic frame gets an id and the stamp of the rx dma interrupt that filled it,
+// then is followed through the read task, the mix and back out of the tx dma. stamps are microseconds on a clock
+// both cores agree on (the xtensa cycle counters are per core and not synced).
+// no esp-idf or freertos dependencies outside latency_now, so the same code builds on the host.
+
+typedef enum {
+    LATENCY_CAPTURE = 0, // rx dma finished filling the frame
+    LATENCY_READ, // read task handed it to the write task
+    LATENCY_MIX, // mixed into a tx dma buffer
+    LATENCY_PLAY, // tx dma finished playing that buffer
+    LATENCY_STAGE_COUNT,
+} latency_stage_t;
+
+typedef struct {
+    _Atomic uint32_t seq; // index+1 once the event is complete, 0 while it is being written
+    uint32_t stamp;
+    uint16_t frame;
+    uint8_t stage;
+} latency_event_t;
+
+#define LATENCY_TRACE_LEN 256 // power of 2, events kept for the dump. oldest are overwritten
+#define LATENCY_HIST_BINS 128 // the last bin also collects everything longer
+#define LATENCY_MAX_TX 16 // upper bound on tx dma buffers being followed
+
+// one writer, the write task, and a reader that summarises it from another task while it fills. the fields are
+// atomic so the reader never sees a torn one, but not a snapshot: a summary can be a sample or two out of step
+typedef struct {
+    uint32_t bin_us;
+    _Atomic uint32_t bins[LATENCY_HIST_BINS];
+    _Atomic uint32_t count;
+    _Atomic uint32_t min_us;
+    _Atomic uint32_t max_us;
+    _Atomic uint64_t sum_us;
+} latency_hist_t;
+
+typedef struct {
+    uint32_t min_us;
+    uint32_t avg_us;
+    uint32_t p99_us; // upper edge of the bin holding the 99th percentile
+    uint32_t max_us;
+    uint32_t count;
+} latency_summary_t;
+
+typedef struct {
+    const void* buf;
+    uint32_t capture;
+    uint16_t frame;
+} latency_tx_tag_t;
+
+typedef struct {
+    // lock-free trace ring, any number of writers, one reader
+    latency_event_t events[LATENCY_TRACE_LEN];
+    _Atomic uint32_t head;
+    uint32_t tail; // reader only
+    uint32_t lost; // reader fell more than a ring behind, reader only
+    // which mic frame went into which tx dma buffer, write task only
+    latency_tx_tag_t tx[LATENCY_MAX_TX];
+    latency_hist_t total; // capture -> play
+    latency_hist_t software; // capture -> mix
+} latency_tracker_t;
+
+// microseconds, wraps every ~71 minutes. differences stay valid across the wrap
+uint32_t latency_now(void);
+
+void latency_init(latency_tracker_t* lt);
+
+// appends an event, safe from any task on either core
+void latency_trace(latency_tracker_t* lt, uint16_t frame, latency_stage_t stage, uint32_t stamp);
+
+// reader: copies up to max events, oldest first. returns how many
+size_t latency_trace_drain(latency_tracker_t* lt, latency_event_t* out, size_t max);
+
+// write task: frame (captured at capture) was just mixed into tx dma buffer buf
+void latency_tx_mixed(latency_tracker_t* lt, const void* buf, uint16_t frame, uint32_t capture);
+
+// write task: buf came back from the tx dma, which finished playing it at sent. closes out the frame mixed into it
+void latency_tx_sent(latency_tracker_t* lt, const void* buf, uint32_t sent);
+
+void latency_hist_init(latency_hist_t* hist, uint32_t bin_us);
+void latency_hist_add(latency_hist_t* hist, uint32_t us);
+void latency_hist_summary(const latency_hist_t* hist, latency_summary_t* out);
+
+// compact binary dump of events for the host decoder (tools/latency_decode.py):
+// "LTCY", u16 count, count * { u32 stamp, u16 frame, u8 stage }, u16 sum of the preceding bytes. little endian.
+// returns the packet length, or 0 if out is too small
+#define LATENCY_PACKET_LEN(count) (4 + 2 + (count) * 7 + 2)
+size_t latency_encode(const latency_event_t* events, size_t count, uint8_t* out, size_t out_len);
+
+#endif
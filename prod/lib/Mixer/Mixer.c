@@ -0,0 +1,234 @@
+#include <string.h>
+#include "Mixer.h"
+
+// Q31 mic sample scaled by a Q15 gain, down to the Q8.24 bus
+static inline int32_t mic_to_bus(int32_t mic, int32_t gain) {
+    return (int32_t)(((int64_t)mic * gain) >> 22);
+}
+
+// one packed L/R word of music and a mic sample already on the bus scale, onto a stereo bus slot.
+// Q15 sample * Q15 gain >> 6 = Q24, and 32767 * 65535 still fits the int32
+static inline void mix_word(int32_t* bus, uint32_t music_pair, int32_t mic, int32_t music_gain) {
+    bus[0] = (((int16_t)(music_pair & 0xFFFF) * music_gain) >> 6) + mic;
+    bus[1] = (((int16_t)(music_pair >> 16) * music_gain) >> 6) + mic;
+}
+
+// the whole pairs of music frames, 2 stereo frames (two L/R words) per step. inlined once per alignment so the
+// aligned case is plain word loads and the check isn't in the loop
+static inline size_t mix_pairs(int32_t* bus, const uint8_t* music_bytes, size_t music_frames, const int32_t* mic_data,
+                               int32_t mic_gain, int32_t music_gain, int aligned) {
+    const uint32_t* music_words = (const uint32_t*)music_bytes;
+    size_t i = 0;
+    for (; i + 2 <= music_frames; i += 2) {
+        uint32_t m0, m1;
+        if (aligned) {
+            m0 = music_words[i];
+            m1 = music_words[i+1];
+        } else {
+            memcpy(&m0, music_bytes + i*4, 4);
+            memcpy(&m1, music_bytes + i*4 + 4, 4);
+        }
+        int32_t mic0 = 0, mic1 = 0;
+        if (mic_gain != 0) {
+            mic0 = mic_to_bus(mic_data[i], mic_gain);
+            mic1 = mic_to_bus(mic_data[i+1], mic_gain);
+        }
+        mix_word(bus + 2*i, m0, mic0, music_gain);
+        mix_word(bus + 2*i + 2, m1, mic1, music_gain);
+    }
+    return i;
+}
+
+void mixer_mix_bus(int32_t* bus, const uint8_t* music_bytes, size_t music_len,
+                   const int32_t* mic_data, size_t frame_size, const mixer_gains_t* gains) {
+    const int32_t music_gain = gains->music_gain;
+    const int32_t mic_gain = (mic_data != NULL) ? gains->mic_gain : 0;
+    size_t music_frames = music_len / (2*sizeof(int16_t));
+    if (music_frames > frame_size) music_frames = frame_size;
+
+    // a2dp pcm is little-endian like the esp32, so the bytes can be read as L/R words directly.
+    // memcpy loads when the pointer isn't word aligned
+    size_t i;
+    if (((uintptr_t)music_bytes & 3) == 0) i = mix_pairs(bus, music_bytes, music_frames, mic_data, mic_gain, music_gain, 1);
+    else i = mix_pairs(bus, music_bytes, music_frames, mic_data, mic_gain, music_gain, 0);
+    for (; i < music_frames; i++) { // an odd frame left over
+        uint32_t m;
+        memcpy(&m, music_bytes + i*4, 4);
+        mix_word(bus + 2*i, m, (mic_gain != 0) ? mic_to_bus(mic_data[i], mic_gain) : 0, music_gain);
+    }
+    for (; i < frame_size; i++) { // music ran short or is off
+        int32_t mic = (mic_gain != 0) ? mic_to_bus(mic_data[i], mic_gain) : 0;
+        bus[2*i] = mic;
+        bus[2*i+1] = mic;
+    }
+}
+
+void mixer_mix_bus_ref(int32_t* bus, const uint8_t* music_bytes, size_t music_len,
+                       const int32_t* mic_data, size_t frame_size, const mixer_gains_t* gains) {
+    size_t music_samples = (music_len / (2*sizeof(int16_t))) * 2; // whole L/R pairs only
+    for (size_t i = 0; i < frame_size*2; i++) {
+        int32_t music = 0;
+        if (i < music_samples) {
+            music = (int16_t)(((uint16_t)music_bytes[2*i+1] << 8) | music_bytes[2*i]);
+        }
+        int32_t mic = 0;
+        if (mic_data != NULL) {
+            mic = (int32_t)(((int64_t)mic_data[i/2] * gains->mic_gain) >> 22); // mono mic duplicated to L and R
+        }
+        bus[i] = ((music * (int32_t)gains->music_gain) >> 6) + mic;
+    }
+}
+
+void mixer_output_init(mixer_output_t* out, uint16_t gain, int32_t limit, uint32_t release_samples) {
+    memset(out, 0, sizeof(*out));
+    out->gain = gain;
+    out->limit = limit;
+    out->limiter_gain = MIXER_LIMITER_ONE;
+    out->release_shift = 0;
+    while ((1u << (out->release_shift + 1)) <= release_samples) out->release_shift++;
+    out->rng = 0x2545F491;
+}
+
+static inline uint32_t xorshift32(uint32_t* state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+// Q8.24 to int16 with highpass tpdf dither and first order error feedback, which pushes the requantization noise
+// up towards nyquist and out of the band the ear is most sensitive to
+static inline int16_t requantize(int32_t x, int32_t rnd, int32_t* prev_rnd, int32_t* error) {
+    int32_t tpdf = rnd - *prev_rnd; // difference of two uniforms one lsb wide: triangular, +-1 lsb
+    *prev_rnd = rnd;
+    int32_t v = x - *error;
+    int32_t q = (v + tpdf + (1 << (MIXER_BUS_SHIFT - 1))) >> MIXER_BUS_SHIFT;
+    if (q > INT16_MAX || q < INT16_MIN) {
+        *error = 0; // clipping error is not noise, feeding it back would only ring
+        return (q > 0) ? INT16_MAX : INT16_MIN;
+    }
+    *error = q * (1 << MIXER_BUS_SHIFT) - v; // q is negative half the time, << would be undefined
+    return (int16_t)q;
+}
+
+void mixer_output_process(mixer_output_t* out, int16_t* output_buffer, const int32_t* bus, size_t frame_size) {
+    const int32_t gain = out->gain;
+    const int32_t limit = out->limit;
+    const uint32_t release_shift = out->release_shift;
+    int32_t limiter_gain = out->limiter_gain;
+    uint32_t limited = 0;
+    // the dither and noise shaping state in locals, stores through out could alias the bus and the output
+    uint32_t rng = out->rng;
+    int32_t prev_rnd[2] = { out->prev_rnd[0], out->prev_rnd[1] };
+    int32_t error[2] = { out->error[0], out->error[1] };
+    for (size_t i = 0; i < frame_size; i++) {
+        int32_t l = bus[2*i], r = bus[2*i+1];
+        if (gain != MIXER_GAIN_UNITY) {
+            l = (int32_t)(((int64_t)l * gain) >> 15);
+            r = (int32_t)(((int64_t)r * gain) >> 15);
+        }
+
+        // peak limiter: exponential release back to unity, then instant attack down to the ceiling. released first
+        // so the gain that gets applied is the one that was checked
+        int32_t peak = (l < 0) ? -l : l;
+        int32_t peak_r = (r < 0) ? -r : r;
+        if (peak_r > peak) peak = peak_r;
+        if (limiter_gain != MIXER_LIMITER_ONE) {
+            limiter_gain += (MIXER_LIMITER_ONE - limiter_gain + (1 << release_shift) - 1) >> release_shift;
+        }
+        // at unity, the usual case, the gain multiply is an identity and the check is a compare
+        int over = (limiter_gain == MIXER_LIMITER_ONE) ? peak > limit : ((int64_t)peak * limiter_gain) >> 30 > limit;
+        if (over) {
+            limiter_gain = (int32_t)(((int64_t)limit << 30) / peak);
+            limited++;
+        }
+        if (limiter_gain != MIXER_LIMITER_ONE) {
+            l = (int32_t)(((int64_t)l * limiter_gain) >> 30);
+            r = (int32_t)(((int64_t)r * limiter_gain) >> 30);
+        }
+
+        uint32_t rnd = xorshift32(&rng); // one draw covers both channels
+        const int32_t lsb_mask = (1 << MIXER_BUS_SHIFT) - 1;
+        output_buffer[2*i] = requantize(l, rnd & lsb_mask, &prev_rnd[0], &error[0]);
+        output_buffer[2*i+1] = requantize(r, (rnd >> 16) & lsb_mask, &prev_rnd[1], &error[1]);
+    }
+    out->limiter_gain = limiter_gain;
+    out->rng = rng;
+    for (int ch = 0; ch < 2; ch++) {
+        out->prev_rnd[ch] = prev_rnd[ch];
+        out->error[ch] = error[ch];
+    }
+    if (limited != 0) atomic_fetch_add_explicit(&out->limited, limited, memory_order_relaxed); // once a frame, the stats task reads it
+}
+
+void mixer_upsample_mic(int32_t* out, const int32_t* in, size_t in_frames, uint32_t shift, int32_t* last) {
+    const uint32_t factor = 1u << shift;
+    int32_t prev = *last;
+    for (size_t j = 0; j < in_frames; j++) {
+        int64_t diff = (int64_t)in[j] - prev; // 2 full scale q31 values can be 2^32 apart
+        for (uint32_t p = 1; p <= factor; p++) {
+            *out++ = (int32_t)(prev + ((diff * p) >> shift));
+        }
+        prev = in[j];
+    }
+    *last = prev;
+}
+
+static inline int32_t sat32(int64_t x) {
+    if (x > INT32_MAX) return INT32_MAX;
+    if (x < INT32_MIN) return INT32_MIN;
+    return (int32_t)x;
+}
+
+static inline int32_t gain_q31(int32_t x, int32_t gain) {
+    return sat32(((int64_t)x * gain) >> 15); // gains above unity can clip
+}
+
+void mixer_split_mics(int32_t* const* mics, const int32_t* interleaved, size_t frames, uint32_t channels, const uint16_t* gains) {
+    if (channels == 2) { // the common case, a duet on one bus
+        int32_t* a = mics[0];
+        int32_t* b = mics[1];
+        const int32_t ga = gains[0], gb = gains[1];
+        for (size_t i = 0; i < frames; i++) {
+            a[i] = gain_q31(interleaved[2*i], ga);
+            b[i] = gain_q31(interleaved[2*i+1], gb);
+        }
+        return;
+    }
+    for (uint32_t c = 0; c < channels; c++) {
+        int32_t* out = mics[c];
+        const int32_t gain = gains[c];
+        const int32_t* in = interleaved + c;
+        for (size_t i = 0; i < frames; i++, in += channels) out[i] = gain_q31(*in, gain);
+    }
+}
+
+void mixer_sum_mics(int32_t* out, int32_t* const* mics, size_t frames, uint32_t channels) {
+    for (size_t i = 0; i < frames; i++) {
+        int64_t acc = 0;
+        for (uint32_t c = 0; c < channels; c++) acc += mics[c][i];
+        out[i] = sat32(acc);
+    }
+}
+
+void mixer_conceal_mic(int32_t* out, const int32_t* last, size_t frames) {
+    if (frames == 0) return;
+    const int32_t step = MIXER_GAIN_UNITY / (int32_t)frames;
+    int32_t gain = MIXER_GAIN_UNITY;
+    for (size_t i = 0; i < frames; i++) {
+        out[i] = (int32_t)(((int64_t)last[i] * gain) >> 15);
+        gain -= step;
+    }
+}
+
+void mixer_conceal_music(int16_t* out, const int16_t* last, size_t from, size_t frames) {
+    if (from >= frames) return;
+    const int32_t step = MIXER_GAIN_UNITY / (int32_t)(frames - from);
+    int32_t gain = MIXER_GAIN_UNITY;
+    for (size_t i = from; i < frames; i++) {
+        out[2*i] = (int16_t)((last[2*i] * gain) >> 15);
+        out[2*i+1] = (int16_t)((last[2*i+1] * gain) >> 15);
+        gain -= step;
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef MIXER_H
+#define MIXER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+
+// per-frame mixing core used by i2s_write_task. no esp-idf or freertos dependencies,
+// so it can be compiled and measured off the esp32.
+
+#define MIXER_GAIN_UNITY 32768 // Q15 gain of 1.0. gains go up to 65535 (~2x)
+
+// per-source gains in Q15
+typedef struct {
+    uint16_t music_gain;
+    uint16_t mic_gain;
+} mixer_gains_t;
+
+// the mix bus is int32 stereo in Q8.24: 1.0 (16 bit full scale) is 1 << 24, leaving 7 bits of headroom
+// so nothing clips or loses bits until the output stage
+#define MIXER_BUS_SHIFT 9 // Q8.24 -> 16 bit
+#define MIXER_BUS_ONE (1 << 24)
+
+// mixes one frame of a2dp pcm bytes (little-endian 16 bit stereo) with one frame of Q31 mono mic data into
+// frame_size stereo samples on the bus, at full precision.
+// music_bytes may be shorter than a frame (missing samples are silence), mic_data may be NULL.
+// reads the music bytes as packed L/R words, two stereo frames per step.
+void mixer_mix_bus(int32_t* bus, const uint8_t* music_bytes, size_t music_len,
+                   const int32_t* mic_data, size_t frame_size, const mixer_gains_t* gains);
+
+// portable one-sample-at-a-time reference for mixer_mix_bus. output is bit-exact with it
+void mixer_mix_bus_ref(int32_t* bus, const uint8_t* music_bytes, size_t music_len,
+                       const int32_t* mic_data, size_t frame_size, const mixer_gains_t* gains);
+
+// final stage from the bus to the dac: master gain, peak limiter, then tpdf dither with first order noise
+// shaping down to 16 bit stereo
+#define MIXER_LIMITER_ONE (1 << 30) // limiter gain of 1.0
+
+typedef struct {
+    uint16_t gain; // Q15 master gain
+    int32_t limit; // Q8.24 ceiling
+    int32_t limiter_gain; // current limiter gain, Q30
+    uint32_t release_shift; // limiter release time constant, log2 samples
+    uint32_t rng;
+    int32_t prev_rnd[2]; // last uniform draw per channel, for the highpass tpdf
+    int32_t error[2]; // requantization error per channel, fed back for the noise shaping
+    _Atomic uint32_t limited; // samples the limiter had to pull down, for the stats log
+} mixer_output_t;
+
+// release_samples is rounded down to a power of 2
+void mixer_output_init(mixer_output_t* out, uint16_t gain, int32_t limit, uint32_t release_samples);
+
+// writes frame_size*2 16 bit samples for the dac
+void mixer_output_process(mixer_output_t* out, int16_t* output_buffer, const int32_t* bus, size_t frame_size);
+
+// upsamples a mic frame recorded at 1/(1 << shift) of the output rate by linear interpolation.
+// *last carries the previous frame's final sample between calls. out holds in_frames << shift samples
+void mixer_upsample_mic(int32_t* out, const int32_t* in, size_t in_frames, uint32_t shift, int32_t* last);
+
+// splits one interleaved frame from mics sharing an i2s bus (slot 0, slot 1, ...) into a buffer per mic,
+// applying each mic's Q15 gain in the same pass. mics[c] holds frames samples
+void mixer_split_mics(int32_t* const* mics, const int32_t* interleaved, size_t frames, uint32_t channels, const uint16_t* gains);
+
+// sums channels mic buffers into out with saturation. out may be mics[0]
+void mixer_sum_mics(int32_t* out, int32_t* const* mics, size_t frames, uint32_t channels);
+
+// loss concealment for a source that missed its frame: the last good one again, faded from full level at the
+// first sample to silence at the end, so the gap doesn't click. a second miss in a row should get silence.
+// mic: frames Q31 mono samples. music: 16 bit stereo, frames [from, frames) only, for a read that came up short
+void mixer_conceal_mic(int32_t* out, const int32_t* last, size_t frames);
+void mixer_conceal_music(int16_t* out, const int16_t* last, size_t from, size_t frames);
+
+#endif
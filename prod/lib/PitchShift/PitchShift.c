@@ -0,0 +1,167 @@
+#include <string.h>
+#include "PitchShift.h"
+
+// 2^(n/12) in Q16 for n = -12..12
+static const uint32_t semitone_ratio[2*PITCH_SHIFT_MAX_SEMITONES + 1] = {
+    32768, 34716, 36781, 38968, 41285, 43740, 46341, 49097, 52016, 55109, 58386, 61858, 65536,
+    69433, 73562, 77936, 82570, 87480, 92682, 98193, 104032, 110218, 116772, 123715, 131072
+};
+
+#define WINDOW_Q16 ((uint32_t)PITCH_SHIFT_WINDOW << 16)
+#define FADE_STEP (32768 / PITCH_SHIFT_FADE) // Q15 wet change per sample
+
+void pitch_shift_init(pitch_shift_t* ps) {
+    memset(ps->line, 0, sizeof(ps->line));
+    ps->write_pos = 0;
+    ps->delay[0] = WINDOW_Q16 / 2;
+    ps->delay[1] = WINDOW_Q16 / 2;
+    ps->phase = WINDOW_Q16 / 2; // first tap at full gain, so no shift is a plain delay
+    ps->step = 0;
+    ps->wet = 0;
+    ps->semitones = 0;
+    atomic_init(&ps->target_semitones, 0);
+}
+
+void pitch_shift_set_semitones(pitch_shift_t* ps, int8_t semitones) {
+    if (semitones > PITCH_SHIFT_MAX_SEMITONES) semitones = PITCH_SHIFT_MAX_SEMITONES;
+    if (semitones < -PITCH_SHIFT_MAX_SEMITONES) semitones = -PITCH_SHIFT_MAX_SEMITONES;
+    atomic_store_explicit(&ps->target_semitones, semitones, memory_order_relaxed);
+}
+
+int pitch_shift_active(pitch_shift_t* ps) {
+    return ps->semitones != 0 || atomic_load_explicit(&ps->target_semitones, memory_order_relaxed) != 0;
+}
+
+static void feed(pitch_shift_t* ps, const uint8_t* in_bytes, size_t pairs) {
+    uint32_t write_pos = ps->write_pos;
+    for (size_t n = 0; n < pairs; n++) {
+        int16_t in[2];
+        memcpy(in, in_bytes + n*4, 4); // ringbuffer items are not guaranteed to be aligned
+        ps->line[0][write_pos & PITCH_SHIFT_LINE_MASK] = in[0];
+        ps->line[1][write_pos & PITCH_SHIFT_LINE_MASK] = in[1];
+        write_pos++;
+    }
+    ps->write_pos = write_pos;
+}
+
+void pitch_shift_feed(pitch_shift_t* ps, const uint8_t* in_bytes, size_t in_len) {
+    feed(ps, in_bytes, in_len / (2*sizeof(int16_t)));
+}
+
+// linearly interpolated read delay (Q16) samples behind the newest sample
+static inline int32_t tap(const int16_t* line, uint32_t newest, uint32_t delay) {
+    uint32_t pos = ((newest & PITCH_SHIFT_LINE_MASK) << 16) + ((uint32_t)PITCH_SHIFT_LINE_LEN << 16) - delay;
+    uint32_t i = (pos >> 16) & PITCH_SHIFT_LINE_MASK;
+    int32_t frac = (pos >> 1) & 0x7FFF; // Q15
+    int32_t s0 = line[i];
+    int32_t s1 = line[(i + 1) & PITCH_SHIFT_LINE_MASK];
+    return s0 + (((s1 - s0) * frac) >> 15);
+}
+
+// mono, scaled to 13 bits so PITCH_SHIFT_MATCH/4 products fit an int32 sum
+static inline int32_t mono(const pitch_shift_t* ps, uint32_t pos) {
+    pos &= PITCH_SHIFT_LINE_MASK;
+    return (ps->line[0][pos] + ps->line[1][pos]) >> 4;
+}
+
+static int32_t match(const pitch_shift_t* ps, uint32_t newest, uint32_t ref, uint32_t candidate, int stride) {
+    int32_t sum = 0;
+    for (int i = 0; i < PITCH_SHIFT_MATCH; i += stride) sum += mono(ps, newest - ref - i) * mono(ps, newest - candidate - i);
+    return sum;
+}
+
+// where a tap restarts: base plus the offset in 1..PITCH_SHIFT_SEARCH whose recent audio lines up best with the
+// other tap's, so the crossfade blends two copies of the same waveform in phase. a coarse pass over every other
+// offset and every 4th sample, then the neighbours at full resolution
+static uint32_t restart_delay(const pitch_shift_t* ps, uint32_t newest, uint32_t base, uint32_t other_delay) {
+    uint32_t ref = (other_delay + 32768) >> 16;
+    uint32_t best = 2;
+    int32_t best_sum = INT32_MIN;
+    for (uint32_t o = 2; o <= PITCH_SHIFT_SEARCH; o += 2) {
+        int32_t sum = match(ps, newest, ref, base + o, 4);
+        if (sum > best_sum) best_sum = sum, best = o;
+    }
+    uint32_t coarse = best;
+    best_sum = INT32_MIN;
+    for (uint32_t o = coarse - 1; o <= coarse + 1 && o <= PITCH_SHIFT_SEARCH; o++) {
+        int32_t sum = match(ps, newest, ref, base + o, 1);
+        if (sum > best_sum) best_sum = sum, best = o;
+    }
+    return base + best;
+}
+
+size_t pitch_shift_process(pitch_shift_t* ps, int16_t* output_buffer, const uint8_t* in_bytes, size_t in_len) {
+    size_t pairs = in_len / (2*sizeof(int16_t));
+    int8_t target = atomic_load_explicit(&ps->target_semitones, memory_order_relaxed);
+    if (target == 0 && ps->semitones == 0) { // bypass
+        feed(ps, in_bytes, pairs);
+        if ((const uint8_t*)output_buffer != in_bytes) memmove(output_buffer, in_bytes, pairs * 2*sizeof(int16_t));
+        return pairs * 2*sizeof(int16_t);
+    }
+    if (target != 0 && target != ps->semitones) {
+        int32_t step = (int32_t)65536 - (int32_t)semitone_ratio[target + PITCH_SHIFT_MAX_SEMITONES];
+        if (ps->semitones == 0) { // coming out of bypass, the line holds the music up to now
+            ps->delay[0] = WINDOW_Q16 / 2;
+            ps->delay[1] = (step < 0) ? WINDOW_Q16 + 65536 : 65536; // at its restart, gain 0
+            ps->phase = WINDOW_Q16 / 2;
+        } else if ((step < 0) != (ps->step < 0)) {
+            // up <-> down: each tap runs back the way it came. the crossfade is symmetric, so the gains don't move
+            ps->phase = (WINDOW_Q16 - ps->phase) % WINDOW_Q16;
+        }
+        ps->semitones = target;
+        ps->step = step;
+    }
+    // back to 0 keeps the taps sweeping at the old key until they have faded out under the unshifted stream
+    const int32_t wet_to = (target != 0) ? 32768 : 0;
+
+    uint32_t write_pos = ps->write_pos;
+    uint32_t delay_1 = ps->delay[0], delay_2 = ps->delay[1];
+    uint32_t phase = ps->phase;
+    int32_t wet = ps->wet;
+    const int32_t step = ps->step;
+    const uint32_t rate = (uint32_t)((step < 0) ? -step : step);
+    const uint32_t base = (step < 0) ? PITCH_SHIFT_WINDOW : 0; // pitching up a tap starts a window back and closes in
+    for (size_t n = 0; n < pairs; n++) {
+        int16_t in[2];
+        memcpy(in, in_bytes + n*4, 4); // ringbuffer items are not guaranteed to be aligned
+        ps->line[0][write_pos & PITCH_SHIFT_LINE_MASK] = in[0];
+        ps->line[1][write_pos & PITCH_SHIFT_LINE_MASK] = in[1];
+
+        // triangular crossfade half a window apart, each tap silent at its restart
+        int32_t t = phase >> (PITCH_SHIFT_WINDOW_BITS + 1); // Q15 position in the window
+        int32_t gain_1 = (t < 16384) ? 2*t : 2*(32768 - t);
+        int32_t gain_2 = 32768 - gain_1;
+
+        for (int ch = 0; ch < 2; ch++) {
+            int32_t mixed = (tap(ps->line[ch], write_pos, delay_1) * gain_1 + tap(ps->line[ch], write_pos, delay_2) * gain_2) >> 15;
+            if (wet != 32768) mixed = (in[ch] * (32768 - wet) + mixed * wet) >> 15; // fading with the unshifted stream
+            output_buffer[2*n + ch] = (int16_t)mixed; // convex blend of two samples, cannot overflow
+        }
+        if (wet != wet_to) wet += (wet < wet_to) ? FADE_STEP : -FADE_STEP;
+
+        // both taps move at the pitch ratio. a tap that has swept its window restarts, lined up with the other
+        delay_1 += (uint32_t)step;
+        delay_2 += (uint32_t)step;
+        uint32_t next = phase + rate;
+        if (next >= WINDOW_Q16) {
+            next -= WINDOW_Q16;
+            delay_1 = restart_delay(ps, write_pos, base, delay_2) << 16;
+            delay_1 = (step < 0) ? delay_1 - next : delay_1 + next;
+        } else if (phase < WINDOW_Q16 / 2 && next >= WINDOW_Q16 / 2) {
+            delay_2 = restart_delay(ps, write_pos, base, delay_1) << 16;
+            delay_2 = (step < 0) ? delay_2 - (next - WINDOW_Q16 / 2) : delay_2 + (next - WINDOW_Q16 / 2);
+        }
+        phase = next;
+        write_pos++;
+    }
+    ps->write_pos = write_pos;
+    ps->delay[0] = delay_1;
+    ps->delay[1] = delay_2;
+    ps->phase = phase;
+    ps->wet = wet;
+    if (wet == 0 && wet_to == 0) { // faded out, bypass from the next frame
+        ps->semitones = 0;
+        ps->step = 0;
+    }
+    return pairs * 2*sizeof(int16_t);
+}
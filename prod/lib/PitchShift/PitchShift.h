@@ -0,0 +1,51 @@
+#ifndef PITCHSHIFT_H
+#define PITCHSHIFT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+// key change for the a2dp backing track. time-domain pitch shifter: two read taps sweep through a short
+// delay line at the pitch ratio and are crossfaded half a window apart. when a tap has swept its window it
+// restarts where its audio lines up with the other tap's (a wsola style search, once per tap per window), so
+// a held note keeps its pitch through the splices instead of landing on a multiple of the sweep rate. no fft.
+// a key change from or back to 0 crossfades with the unshifted stream, which keeps feeding the line in bypass.
+// fixed-size state, 16 bit stereo in and out, no esp-idf or freertos dependencies.
+
+#define PITCH_SHIFT_MAX_SEMITONES 12
+#define PITCH_SHIFT_WINDOW_BITS 10
+#define PITCH_SHIFT_WINDOW (1 << PITCH_SHIFT_WINDOW_BITS) // crossfade window in samples, ~23 ms at 44.1 kHz
+#define PITCH_SHIFT_LINE_LEN (2 * PITCH_SHIFT_WINDOW) // per channel, power of 2
+#define PITCH_SHIFT_LINE_MASK (PITCH_SHIFT_LINE_LEN - 1)
+#define PITCH_SHIFT_SEARCH 512 // restart offsets tried, lines up periods down to ~86 Hz. adds ~6 ms of latency on average
+#define PITCH_SHIFT_MATCH 256 // samples compared per offset. SEARCH + MATCH must stay under the window
+#define PITCH_SHIFT_FADE 512 // samples to crossfade into and out of bypass, ~12 ms. power of 2
+
+typedef struct {
+    int16_t line[2][PITCH_SHIFT_LINE_LEN];
+    uint32_t write_pos;
+    uint32_t delay[2]; // Q16 samples behind write_pos of each tap, 1..PITCH_SHIFT_WINDOW + PITCH_SHIFT_SEARCH
+    uint32_t phase; // Q16 crossfade position, 0..PITCH_SHIFT_WINDOW. the first tap restarts at 0, the second halfway
+    int32_t step; // Q16 change in delay per sample, 1 - ratio
+    int32_t wet; // Q15 share of the taps in the output, 0 in bypass, 32768 once faded in
+    int8_t semitones; // applied, held through the fade back to bypass
+    _Atomic int8_t target_semitones; // requested, picked up at the next frame
+} pitch_shift_t;
+
+void pitch_shift_init(pitch_shift_t* ps);
+
+// sets the key change in semitones, clamped to +-PITCH_SHIFT_MAX_SEMITONES. safe to call from another task
+void pitch_shift_set_semitones(pitch_shift_t* ps, int8_t semitones);
+
+// true when a key change is requested or still applied. when false the stream can bypass the shifter
+int pitch_shift_active(pitch_shift_t* ps);
+
+// bypass: writes in_len bytes of the unshifted stream into the delay line only, so a key change starts on the music
+// instead of stale or silent audio. call it for every frame pitch_shift_process isn't called for
+void pitch_shift_feed(pitch_shift_t* ps, const uint8_t* in_bytes, size_t in_len);
+
+// shifts in_len bytes of little-endian 16 bit stereo pcm into output_buffer. returns bytes written (whole L/R pairs).
+// output_buffer may be the input. in bypass it is the input unchanged
+size_t pitch_shift_process(pitch_shift_t* ps, int16_t* output_buffer, const uint8_t* in_bytes, size_t in_len);
+
+#endif
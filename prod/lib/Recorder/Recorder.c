@@ -0,0 +1,240 @@
+#include <string.h>
+#include "Recorder.h"
+
+#define FRAME_BYTES (2*sizeof(int16_t))
+
+void recorder_init(recorder_t* rec, uint8_t* storage, size_t block_bytes, uint32_t block_count) {
+    memset(rec, 0, sizeof(*rec));
+    if (block_count > RECORDER_MAX_BLOCKS) block_count = RECORDER_MAX_BLOCKS;
+    for (uint32_t i = 0; i < block_count; i++) rec->blocks[i] = storage + i * block_bytes;
+    rec->block_bytes = block_bytes;
+    rec->block_count = block_count;
+    atomic_init(&rec->filled, 0);
+    atomic_init(&rec->drained, 0);
+    atomic_init(&rec->state, RECORDER_IDLE);
+    atomic_init(&rec->dropped_frames, 0);
+}
+
+void recorder_start(recorder_t* rec) {
+    if (atomic_load_explicit(&rec->state, memory_order_acquire) != RECORDER_IDLE) return;
+    atomic_store_explicit(&rec->dropped_frames, 0, memory_order_relaxed);
+    atomic_store_explicit(&rec->blocks_written, 0, memory_order_relaxed);
+    rec->fill_pos = 0; // the write task leaves it alone while idle
+    atomic_store_explicit(&rec->state, RECORDER_RUNNING, memory_order_release);
+}
+
+void recorder_stop(recorder_t* rec) {
+    uint8_t running = RECORDER_RUNNING;
+    atomic_compare_exchange_strong(&rec->state, &running, RECORDER_STOPPING);
+}
+
+static void publish(recorder_t* rec, uint32_t filled) {
+    rec->block_lens[filled % rec->block_count] = (uint32_t)rec->fill_pos;
+    rec->fill_pos = 0;
+    atomic_store_explicit(&rec->filled, filled + 1, memory_order_release);
+}
+
+void recorder_push(recorder_t* rec, const int16_t* frame, size_t frames) {
+    uint8_t state = atomic_load_explicit(&rec->state, memory_order_acquire);
+    if (state == RECORDER_STOPPING) {
+        if (rec->fill_pos > 0) publish(rec, atomic_load_explicit(&rec->filled, memory_order_relaxed));
+        atomic_store_explicit(&rec->state, RECORDER_STOPPED, memory_order_release);
+        return;
+    }
+    if (state != RECORDER_RUNNING) return;
+
+    const uint8_t* src = (const uint8_t*)frame;
+    size_t bytes = frames * FRAME_BYTES;
+    while (bytes > 0) {
+        uint32_t filled = atomic_load_explicit(&rec->filled, memory_order_relaxed);
+        if (filled - atomic_load_explicit(&rec->drained, memory_order_acquire) == rec->block_count) {
+            // every block is waiting on the card. blocks are whole frames, so this always splits on a frame
+            atomic_fetch_add_explicit(&rec->dropped_frames, (uint32_t)(bytes / FRAME_BYTES), memory_order_relaxed);
+            return;
+        }
+        uint8_t* block = rec->blocks[filled % rec->block_count];
+        size_t n = rec->block_bytes - rec->fill_pos;
+        if (n > bytes) n = bytes;
+        memcpy(block + rec->fill_pos, src, n);
+        rec->fill_pos += n;
+        src += n;
+        bytes -= n;
+        if (rec->fill_pos == rec->block_bytes) publish(rec, filled);
+    }
+}
+
+const uint8_t* recorder_peek(recorder_t* rec, size_t* len) {
+    uint32_t drained = atomic_load_explicit(&rec->drained, memory_order_relaxed);
+    if (drained == atomic_load_explicit(&rec->filled, memory_order_acquire)) return NULL;
+    *len = rec->block_lens[drained % rec->block_count];
+    return rec->blocks[drained % rec->block_count];
+}
+
+void recorder_release(recorder_t* rec) {
+    atomic_fetch_add_explicit(&rec->blocks_written, 1, memory_order_relaxed);
+    atomic_store_explicit(&rec->drained, atomic_load_explicit(&rec->drained, memory_order_relaxed) + 1, memory_order_release);
+}
+
+bool recorder_finished(recorder_t* rec) {
+    if (atomic_load_explicit(&rec->state, memory_order_acquire) != RECORDER_STOPPED) return false;
+    if (atomic_load_explicit(&rec->drained, memory_order_relaxed) != atomic_load_explicit(&rec->filled, memory_order_acquire)) return false;
+    atomic_store_explicit(&rec->state, RECORDER_IDLE, memory_order_release);
+    return true;
+}
+
+static void put16(uint8_t* p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put32(uint8_t* p, uint32_t v) {
+    put16(p, (uint16_t)v);
+    put16(p + 2, (uint16_t)(v >> 16));
+}
+
+// RIFF, fmt (and fact for adpcm), a JUNK chunk to pad, then the data chunk header ending on RECORDER_HEADER_BYTES
+static bool write_header(recorder_writer_t* w) {
+    uint8_t h[RECORDER_HEADER_BYTES];
+    memset(h, 0, sizeof(h));
+    const bool adpcm = w->format == RECORDER_IMA_ADPCM;
+    uint8_t* p = h;
+    memcpy(p, "RIFF", 4);
+    put32(p + 4, RECORDER_HEADER_BYTES - 8 + w->data_bytes);
+    memcpy(p + 8, "WAVE", 4);
+    p += 12;
+
+    memcpy(p, "fmt ", 4);
+    put32(p + 4, adpcm ? 20 : 16);
+    put16(p + 8, adpcm ? 0x0011 : 0x0001); // ima adpcm / pcm
+    put16(p + 10, 2);
+    put32(p + 12, w->sample_rate);
+    if (adpcm) {
+        put32(p + 16, (uint32_t)((uint64_t)w->sample_rate * RECORDER_ADPCM_BLOCK / RECORDER_ADPCM_FRAMES));
+        put16(p + 20, RECORDER_ADPCM_BLOCK);
+        put16(p + 22, 4);
+        put16(p + 24, 2); // extra bytes
+        put16(p + 26, RECORDER_ADPCM_FRAMES);
+        p += 28;
+        memcpy(p, "fact", 4);
+        put32(p + 4, 4);
+        put32(p + 8, w->frames);
+        p += 12;
+    } else {
+        put32(p + 16, w->sample_rate * FRAME_BYTES);
+        put16(p + 20, FRAME_BYTES);
+        put16(p + 22, 16);
+        p += 24;
+    }
+
+    uint8_t* data = h + RECORDER_HEADER_BYTES - 8;
+    memcpy(p, "JUNK", 4);
+    put32(p + 4, (uint32_t)(data - p - 8));
+    memcpy(data, "data", 4);
+    put32(data + 4, w->data_bytes);
+    return fwrite(h, 1, sizeof(h), w->file) == sizeof(h);
+}
+
+bool recorder_writer_open(recorder_writer_t* w, FILE* file, recorder_format_t format, uint32_t sample_rate) {
+    memset(w, 0, sizeof(*w));
+    w->file = file;
+    w->format = format;
+    w->sample_rate = sample_rate;
+    w->failed = !write_header(w);
+    return !w->failed;
+}
+
+static void writer_put(recorder_writer_t* w, const void* data, size_t len) {
+    if (w->failed) return;
+    if (fwrite(data, 1, len, w->file) != len) w->failed = true;
+    else w->data_bytes += (uint32_t)len;
+}
+
+static const int16_t ima_steps[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45, 50, 55, 60, 66, 73, 80, 88, 97,
+    107, 118, 130, 143, 157, 173, 190, 209, 230, 253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
+    876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871,
+    5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623,
+    27086, 29794, 32767,
+};
+static const int8_t ima_index_steps[8] = { -1, -1, -1, -1, 2, 4, 6, 8 };
+
+static inline uint8_t ima_encode(int32_t* predictor, int32_t* step_index, int32_t sample) {
+    int32_t step = ima_steps[*step_index];
+    int32_t diff = sample - *predictor;
+    uint8_t code = 0;
+    if (diff < 0) {
+        code = 8;
+        diff = -diff;
+    }
+    // same successive approximation the decoder undoes, so the predictor tracks the decoder's exactly
+    int32_t delta = step >> 3;
+    if (diff >= step) { code |= 4; diff -= step; delta += step; }
+    step >>= 1;
+    if (diff >= step) { code |= 2; diff -= step; delta += step; }
+    step >>= 1;
+    if (diff >= step) { code |= 1; delta += step; }
+    int32_t p = *predictor + ((code & 8) ? -delta : delta);
+    *predictor = (p > INT16_MAX) ? INT16_MAX : (p < INT16_MIN) ? INT16_MIN : p;
+    int32_t index = *step_index + ima_index_steps[code & 7];
+    *step_index = (index < 0) ? 0 : (index > 88) ? 88 : index;
+    return code;
+}
+
+// one RECORDER_ADPCM_FRAMES block out of w->carry into the stage
+static void adpcm_block(recorder_writer_t* w) {
+    uint8_t* out = w->stage + w->stage_len;
+    const int16_t* in = w->carry;
+    for (int c = 0; c < 2; c++) {
+        w->predictor[c] = in[c]; // the first frame goes in the header verbatim
+        put16(out + 4*c, (uint16_t)in[c]);
+        out[4*c + 2] = (uint8_t)w->step_index[c];
+        out[4*c + 3] = 0;
+    }
+    out += 8;
+    for (int f = 1; f < RECORDER_ADPCM_FRAMES; f += 8) {
+        for (int c = 0; c < 2; c++) { // 8 samples of one channel, then 8 of the other, low nibble first
+            for (int k = 0; k < 8; k += 2) {
+                uint8_t lo = ima_encode(&w->predictor[c], &w->step_index[c], in[2*(f + k) + c]);
+                uint8_t hi = ima_encode(&w->predictor[c], &w->step_index[c], in[2*(f + k + 1) + c]);
+                *out++ = (uint8_t)(lo | (hi << 4));
+            }
+        }
+    }
+    w->stage_len += RECORDER_ADPCM_BLOCK;
+    w->carry_frames = 0;
+    if (w->stage_len == RECORDER_ADPCM_STAGE) {
+        writer_put(w, w->stage, w->stage_len);
+        w->stage_len = 0;
+    }
+}
+
+bool recorder_writer_write(recorder_writer_t* w, const int16_t* pcm, size_t frames) {
+    w->frames += (uint32_t)frames;
+    if (w->format == RECORDER_PCM16) {
+        writer_put(w, pcm, frames * FRAME_BYTES);
+        return !w->failed;
+    }
+    while (frames > 0) {
+        size_t n = RECORDER_ADPCM_FRAMES - w->carry_frames;
+        if (n > frames) n = frames;
+        memcpy(w->carry + 2*w->carry_frames, pcm, n * FRAME_BYTES);
+        w->carry_frames += n;
+        pcm += 2*n;
+        frames -= n;
+        if (w->carry_frames == RECORDER_ADPCM_FRAMES) adpcm_block(w);
+    }
+    return !w->failed;
+}
+
+bool recorder_writer_close(recorder_writer_t* w) {
+    if (w->format == RECORDER_IMA_ADPCM) {
+        if (w->carry_frames > 0) { // the fact chunk tells players where the real samples end
+            memset(w->carry + 2*w->carry_frames, 0, (RECORDER_ADPCM_FRAMES - w->carry_frames) * FRAME_BYTES);
+            adpcm_block(w);
+        }
+        if (w->stage_len > 0) writer_put(w, w->stage, w->stage_len);
+        w->stage_len = 0;
+    }
+    if (w->failed || fflush(w->file) != 0 || fseek(w->file, 0, SEEK_SET) != 0 || !write_header(w)) return false;
+    return fflush(w->file) == 0;
+}
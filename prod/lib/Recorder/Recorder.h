@@ -0,0 +1,92 @@
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdatomic.h>
+
+// records the final mix to a wav file. the write task copies each output frame into big blocks (psram on the
+// device), a low priority task streams full blocks to a FILE in sector multiples, converting to ima-adpcm on the
+// way if asked. the write task never waits: with no free block the frame is dropped and counted.
+// plain c11 and stdio, no esp-idf or freertos dependencies, so the same code runs against a file on the host.
+
+#define RECORDER_MAX_BLOCKS 8
+#define RECORDER_HEADER_BYTES 512 // header is padded with a JUNK chunk so the samples start on a sector
+#define RECORDER_ADPCM_BLOCK 2048 // stereo ima-adpcm block, bytes
+#define RECORDER_ADPCM_FRAMES 2041 // stereo frames per adpcm block: one in the header, 8 per 8 bytes after it
+#define RECORDER_ADPCM_STAGE (8 * RECORDER_ADPCM_BLOCK) // adpcm bytes collected before a write
+
+typedef enum {
+    RECORDER_IDLE = 0,
+    RECORDER_RUNNING, // write task copies frames in
+    RECORDER_STOPPING, // write task publishes the partial block at its next frame, then goes STOPPED
+    RECORDER_STOPPED, // nothing more will come, the writer drains and closes
+} recorder_state_t;
+
+typedef enum {
+    RECORDER_PCM16 = 0,
+    RECORDER_IMA_ADPCM,
+} recorder_format_t;
+
+typedef struct {
+    uint8_t* blocks[RECORDER_MAX_BLOCKS];
+    uint32_t block_lens[RECORDER_MAX_BLOCKS]; // bytes used, set by the producer when it publishes
+    size_t block_bytes; // multiple of the 4 byte frame and of 512
+    uint32_t block_count;
+    _Atomic uint32_t filled; // blocks published, producer only
+    _Atomic uint32_t drained; // blocks released, consumer only
+    size_t fill_pos; // bytes in the block being filled, producer only
+    _Atomic uint8_t state;
+    _Atomic uint32_t dropped_frames; // this take
+    _Atomic uint32_t blocks_written; // this take, written by the consumer only
+} recorder_t;
+
+typedef struct {
+    FILE* file;
+    recorder_format_t format;
+    uint32_t sample_rate;
+    uint32_t data_bytes; // after the header
+    uint32_t frames;
+    bool failed; // a write came back short, the rest of the take is skipped
+    // adpcm
+    int32_t predictor[2];
+    int32_t step_index[2];
+    int16_t carry[2 * RECORDER_ADPCM_FRAMES]; // frames waiting for a whole adpcm block
+    size_t carry_frames;
+    uint8_t stage[RECORDER_ADPCM_STAGE];
+    size_t stage_len;
+} recorder_writer_t;
+
+// storage holds block_count blocks of block_bytes each
+void recorder_init(recorder_t* rec, uint8_t* storage, size_t block_bytes, uint32_t block_count);
+
+// control side: a new take starts with the next frame. only from RECORDER_IDLE
+void recorder_start(recorder_t* rec);
+
+// control side: asks the write task to wrap up the take
+void recorder_stop(recorder_t* rec);
+
+// write task: copies frames of 16 bit stereo in while running. never blocks
+void recorder_push(recorder_t* rec, const int16_t* frame, size_t frames);
+
+// writer: the oldest full block and its length, NULL if none is ready
+const uint8_t* recorder_peek(recorder_t* rec, size_t* len);
+
+// writer: hands the block from recorder_peek back
+void recorder_release(recorder_t* rec);
+
+// writer: true once the write task has stopped and every block has been drained. the take is then back to IDLE
+bool recorder_finished(recorder_t* rec);
+
+// writes a placeholder header, the sizes are filled in by recorder_writer_close
+bool recorder_writer_open(recorder_writer_t* w, FILE* file, recorder_format_t format, uint32_t sample_rate);
+
+// appends frames of 16 bit stereo. false once a write has failed
+bool recorder_writer_write(recorder_writer_t* w, const int16_t* pcm, size_t frames);
+
+// flushes what is left (the last adpcm block padded with silence), rewrites the header. does not close the file
+bool recorder_writer_close(recorder_writer_t* w);
+
+#endif
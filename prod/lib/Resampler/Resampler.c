@@ -0,0 +1,94 @@
+#include <math.h>
+#include <string.h>
+#include "Resampler.h"
+
+// modified bessel function of the first kind, order 0, by its power series
+static double bessel_i0(double x) {
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 25; k++) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+// kaiser-windowed sinc at offset x samples from the interpolation point. over 16 taps beta 4 trades a little
+// stopband for a narrower transition than blackman, which kept 15 kHz 1.3 dB down at 8 taps
+static double kernel(double x, double cutoff) {
+    const double half = RESAMPLER_TAPS / 2.0;
+    if (fabs(x) >= half) return 0.0;
+    double sinc = (x == 0.0) ? cutoff : sin(M_PI * cutoff * x) / (M_PI * x);
+    double r = x / half;
+    return sinc * bessel_i0(RESAMPLER_KAISER_BETA * sqrt(1.0 - r * r)) / bessel_i0(RESAMPLER_KAISER_BETA);
+}
+
+void resampler_init(resampler_t* rs, double cutoff) {
+    memset(rs, 0, sizeof(*rs));
+    for (int p = 0; p <= RESAMPLER_PHASES; p++) {
+        double frac = (double)p / RESAMPLER_PHASES;
+        double row[RESAMPLER_TAPS];
+        double sum = 0.0;
+        for (int k = 0; k < RESAMPLER_TAPS; k++) {
+            // tap k sits k - TAPS/2 + 1 samples from the window's centre sample
+            row[k] = kernel(frac - (k - RESAMPLER_TAPS / 2 + 1), cutoff);
+            sum += row[k];
+        }
+        int32_t total = 0;
+        for (int k = 0; k < RESAMPLER_TAPS; k++) {
+            rs->coeffs[p][k] = (int16_t)lrint(row[k] / sum * (1 << RESAMPLER_COEFF_BITS));
+            total += rs->coeffs[p][k];
+        }
+        // unity dc gain per phase: the rounding left over goes on the tap nearest the point
+        rs->coeffs[p][(frac < 0.5) ? RESAMPLER_TAPS / 2 - 1 : RESAMPLER_TAPS / 2] += (int16_t)((1 << RESAMPLER_COEFF_BITS) - total);
+    }
+    rs->step = (uint64_t)1 << 32;
+    rs->need = RESAMPLER_TAPS; // fill the window before the first output
+}
+
+void resampler_set_step(resampler_t* rs, uint64_t step) {
+    rs->step = step;
+}
+
+size_t resampler_process(resampler_t* rs, const int16_t* in, size_t in_frames, int16_t* out, size_t out_frames, size_t* in_used) {
+    const uint32_t step_int = (uint32_t)(rs->step >> 32);
+    const uint32_t step_frac = (uint32_t)rs->step;
+    size_t used = 0;
+    size_t produced = 0;
+    while (produced < out_frames) {
+        // push the inputs the last step moved past
+        while (rs->need > 0) {
+            if (used == in_frames) goto done;
+            rs->hist_pos = (rs->hist_pos + 1 == RESAMPLER_TAPS) ? 0 : rs->hist_pos + 1;
+            for (int ch = 0; ch < 2; ch++) {
+                rs->hist[ch][rs->hist_pos] = in[2*used + ch];
+                rs->hist[ch][rs->hist_pos + RESAMPLER_TAPS] = in[2*used + ch];
+            }
+            used++;
+            rs->need--;
+        }
+
+        uint32_t phase = rs->frac >> (32 - RESAMPLER_PHASE_BITS);
+        int32_t t = (rs->frac >> (32 - RESAMPLER_PHASE_BITS - 15)) & 0x7FFF; // Q15 between phase and phase+1
+        const int16_t* h0 = rs->coeffs[phase];
+        const int16_t* h1 = rs->coeffs[phase + 1];
+        for (int ch = 0; ch < 2; ch++) {
+            const int16_t* window = &rs->hist[ch][rs->hist_pos + 1]; // oldest to newest
+            int32_t acc0 = 0, acc1 = 0;
+            for (int k = 0; k < RESAMPLER_TAPS; k++) {
+                acc0 += window[k] * h0[k];
+                acc1 += window[k] * h1[k];
+            }
+            int32_t acc = acc0 + (int32_t)(((int64_t)(acc1 - acc0) * t) >> 15);
+            acc = (acc + (1 << (RESAMPLER_COEFF_BITS - 1))) >> RESAMPLER_COEFF_BITS;
+            out[2*produced + ch] = (int16_t)((acc > INT16_MAX) ? INT16_MAX : (acc < INT16_MIN) ? INT16_MIN : acc);
+        }
+        produced++;
+
+        uint64_t next = (uint64_t)rs->frac + step_frac;
+        rs->frac = (uint32_t)next;
+        rs->need = step_int + (uint32_t)(next >> 32);
+    }
+done:
+    *in_used = used;
+    return produced;
+}
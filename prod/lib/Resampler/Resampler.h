@@ -0,0 +1,36 @@
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// fractional-ratio polyphase resampler for 16 bit stereo. kaiser-windowed sinc table with RESAMPLER_PHASES phases,
+// linearly interpolated between neighbouring phases, so the ratio can be nudged by fractions of a ppm at runtime.
+// fixed-size state, no esp-idf or freertos dependencies.
+
+#define RESAMPLER_TAPS 16 // sum of |coeffs| stays under 2, so a window of full scale samples fits an int32
+#define RESAMPLER_KAISER_BETA 4.0
+#define RESAMPLER_PHASE_BITS 5
+#define RESAMPLER_PHASES (1 << RESAMPLER_PHASE_BITS)
+#define RESAMPLER_COEFF_BITS 14 // Q14, 1.0 still fits an int16
+
+typedef struct {
+    int16_t coeffs[RESAMPLER_PHASES + 1][RESAMPLER_TAPS]; // extra row so phase p+1 always exists
+    int16_t hist[2][2 * RESAMPLER_TAPS]; // double-length delay line per channel, window never wraps
+    uint32_t hist_pos;
+    uint32_t frac; // Q32 position of the next output between input samples
+    uint32_t need; // inputs to push before the next output
+    uint64_t step; // Q32.32 input samples per output sample
+} resampler_t;
+
+// cutoff is the passband edge as a fraction of the input nyquist, lower it below out/in rate when downsampling
+void resampler_init(resampler_t* rs, double cutoff);
+
+// step is input samples per output sample in Q32.32, e.g. ((uint64_t)in_rate << 32) / out_rate
+void resampler_set_step(resampler_t* rs, uint64_t step);
+
+// produces up to out_frames stereo frames from up to in_frames input frames, stops early when the input runs out.
+// returns frames produced, *in_used gets the input frames consumed
+size_t resampler_process(resampler_t* rs, const int16_t* in, size_t in_frames, int16_t* out, size_t out_frames, size_t* in_used);
+
+#endif
@@ -0,0 +1,171 @@
+#include <string.h>
+#include "Sidecar.h"
+
+enum { HUNT = 0, TYPE, LEN, PAYLOAD, CRC };
+
+static uint8_t crc8_table[256];
+
+static void crc8_build(void) {
+    if (crc8_table[1] != 0) return;
+    for (int i = 0; i < 256; i++) {
+        uint8_t c = (uint8_t)i;
+        for (int b = 0; b < 8; b++) c = (c & 0x80) ? (uint8_t)((c << 1) ^ 0x07) : (uint8_t)(c << 1);
+        crc8_table[i] = c;
+    }
+}
+
+static inline uint8_t crc8(uint8_t crc, uint8_t byte) {
+    return crc8_table[crc ^ byte];
+}
+
+void sidecar_parser_init(sidecar_parser_t* p) {
+    crc8_build();
+    memset(p, 0, sizeof(*p));
+}
+
+size_t sidecar_parse(sidecar_parser_t* p, const uint8_t* data, size_t len, bool* complete) {
+    *complete = false;
+    size_t i = 0;
+    while (i < len) {
+        switch (p->state) {
+            case HUNT: {
+                const uint8_t* sof = memchr(data + i, SIDECAR_SOF, len - i);
+                if (sof == NULL) return len;
+                i = (size_t)(sof - data) + 1;
+                p->state = TYPE;
+                break;
+            }
+            case TYPE:
+                p->type = data[i++];
+                p->crc = crc8(0, p->type);
+                p->state = LEN;
+                break;
+            case LEN:
+                p->len = data[i++];
+                p->crc = crc8(p->crc, p->len);
+                p->pos = 0;
+                if (p->len > SIDECAR_MAX_PAYLOAD) {
+                    p->errors++;
+                    p->state = HUNT;
+                } else {
+                    p->state = (p->len == 0) ? CRC : PAYLOAD;
+                }
+                break;
+            case PAYLOAD: {
+                // copy as much of the payload as this chunk has in one go
+                size_t n = p->len - p->pos;
+                if (n > len - i) n = len - i;
+                uint8_t crc = p->crc;
+                for (size_t k = 0; k < n; k++) crc = crc8(crc, data[i + k]);
+                memcpy(p->payload + p->pos, data + i, n);
+                p->crc = crc;
+                p->pos += (uint8_t)n;
+                i += n;
+                if (p->pos == p->len) p->state = CRC;
+                break;
+            }
+            case CRC:
+                p->state = HUNT;
+                if (data[i++] == p->crc) {
+                    p->frames++;
+                    *complete = true;
+                    return i;
+                }
+                p->errors++;
+                break;
+        }
+    }
+    return i;
+}
+
+size_t sidecar_encode(uint8_t* out, uint8_t type, const uint8_t* payload, size_t len) {
+    if (len > SIDECAR_MAX_PAYLOAD) return 0;
+    crc8_build();
+    out[0] = SIDECAR_SOF;
+    out[1] = type;
+    out[2] = (uint8_t)len;
+    memcpy(out + 3, payload, len);
+    uint8_t crc = 0;
+    for (size_t i = 1; i < len + 3; i++) crc = crc8(crc, out[i]);
+    out[len + 3] = crc;
+    return SIDECAR_FRAME_LEN(len);
+}
+
+static inline uint32_t read_u32(const uint8_t* b) {
+    return (uint32_t)b[0] | ((uint32_t)b[1] << 8) | ((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24);
+}
+
+static inline uint32_t ms_to_samples(const sidecar_sched_t* s, uint32_t ms) {
+    return (uint32_t)((uint64_t)ms * s->sample_rate / 1000);
+}
+
+void sidecar_sched_init(sidecar_sched_t* s, uint32_t sample_rate) {
+    memset(s, 0, sizeof(*s));
+    s->sample_rate = sample_rate;
+    s->free_count = SIDECAR_QUEUE_LEN;
+    for (uint32_t i = 0; i < SIDECAR_QUEUE_LEN; i++) s->free_slots[i] = (uint8_t)(SIDECAR_QUEUE_LEN - 1 - i);
+}
+
+// keeps order[] sorted by time, after any events already queued for the same moment
+static sidecar_event_t* sched_insert(sidecar_sched_t* s, uint32_t at_ms) {
+    if (s->free_count == 0) return NULL;
+    uint8_t slot = s->free_slots[--s->free_count];
+    uint32_t lo = 0, hi = s->count;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if (s->events[s->order[mid]].at_ms <= at_ms) lo = mid + 1;
+        else hi = mid;
+    }
+    memmove(s->order + lo + 1, s->order + lo, s->count - lo);
+    s->order[lo] = slot;
+    s->count++;
+    sidecar_event_t* ev = &s->events[slot];
+    ev->at_ms = at_ms;
+    return ev;
+}
+
+bool sidecar_sched_handle(sidecar_sched_t* s, const sidecar_parser_t* p, uint32_t now) {
+    const uint8_t* b = p->payload;
+    sidecar_event_t* ev;
+    switch (p->type) {
+        case SIDECAR_MSG_CLOCK:
+            if (p->len != 4) break;
+            s->origin = now - ms_to_samples(s, read_u32(b));
+            s->synced = true;
+            return true;
+        case SIDECAR_MSG_CLEAR:
+            for (uint32_t i = 0; i < s->count; i++) s->free_slots[s->free_count++] = s->order[i];
+            s->count = 0;
+            return true;
+        case SIDECAR_MSG_LYRIC:
+            if (p->len < 4 || (ev = sched_insert(s, read_u32(b))) == NULL) break;
+            ev->type = SIDECAR_MSG_LYRIC;
+            ev->text_len = p->len - 4;
+            memcpy(ev->text, b + 4, ev->text_len);
+            ev->text[ev->text_len] = '\0';
+            return true;
+        case SIDECAR_MSG_PARAM:
+            if (p->len != 7 || b[4] >= SIDECAR_PARAM_COUNT || (ev = sched_insert(s, read_u32(b))) == NULL) break;
+            ev->type = SIDECAR_MSG_PARAM;
+            ev->param = b[4];
+            ev->value = (int16_t)(b[5] | (b[6] << 8));
+            ev->text_len = 0;
+            return true;
+        default: // unknown types are skipped, newer phones may send more than this build understands
+            return true;
+    }
+    s->dropped++;
+    return false;
+}
+
+const sidecar_event_t* sidecar_sched_pop_due(sidecar_sched_t* s, uint32_t now) {
+    if (!s->synced || s->count == 0) return NULL;
+    int32_t elapsed = (int32_t)(now - s->origin);
+    if (elapsed < 0) return NULL; // before the song started
+    uint8_t slot = s->order[0];
+    if (ms_to_samples(s, s->events[slot].at_ms) > (uint32_t)elapsed) return NULL;
+    s->count--;
+    memmove(s->order, s->order + 1, s->count);
+    s->free_slots[s->free_count++] = slot;
+    return &s->events[slot];
+}
@@ -0,0 +1,93 @@
+#ifndef SIDECAR_H
+#define SIDECAR_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// lyric and control sidecar to the a2dp stream, carried over spp. the byte stream is a run of frames
+//   0x7E | type | len | payload[len] | crc8
+// with the crc8 (poly 0x07, init 0) over type, len and payload, multi-byte fields little-endian.
+// the parser takes the stream in any chunking, never allocates and resyncs on the next 0x7E after a bad frame.
+// lyric lines and parameter changes are timed in song milliseconds and fire against the output sample clock, so
+// they line up with what is actually playing. no esp-idf or freertos dependencies.
+
+#define SIDECAR_SOF 0x7E
+#define SIDECAR_MAX_PAYLOAD 100
+#define SIDECAR_MAX_TEXT (SIDECAR_MAX_PAYLOAD - 4) // a lyric payload is the u32 time, then the utf-8 line
+#define SIDECAR_FRAME_LEN(payload_len) ((payload_len) + 4)
+#define SIDECAR_QUEUE_LEN 32 // pending timed events, the phone should send a few lines ahead, not a whole song
+
+typedef enum {
+    // phone -> device
+    SIDECAR_MSG_CLOCK = 0x01, // u32 song position in ms of the audio the phone is sending right now
+    SIDECAR_MSG_LYRIC = 0x02, // u32 at ms, utf-8 text (the rest of the payload, no terminator)
+    SIDECAR_MSG_PARAM = 0x03, // u32 at ms, u8 sidecar_param_t, i16 value
+    SIDECAR_MSG_CLEAR = 0x04, // empty: drop everything pending, for a seek or the next song
+    // device -> phone
+    SIDECAR_MSG_SHOW = 0x82, // same payload as LYRIC, sent when the line reaches the speaker
+} sidecar_msg_type_t;
+
+typedef enum {
+    SIDECAR_PARAM_KEY = 0, // key change in semitones
+    SIDECAR_PARAM_VOCAL_CANCEL, // 0 off, anything else on
+    SIDECAR_PARAM_MUSIC_GAIN, // Q15, read as unsigned
+    SIDECAR_PARAM_MIC_GAIN, // Q15, read as unsigned
+    SIDECAR_PARAM_ECHO, // 0 off, anything else on
+    SIDECAR_PARAM_REVERB, // 0 off, anything else on
+    SIDECAR_PARAM_PITCH_CORRECT, // 0 off, anything else on
+    SIDECAR_PARAM_COUNT,
+} sidecar_param_t;
+
+typedef struct {
+    uint8_t state;
+    uint8_t type;
+    uint8_t len;
+    uint8_t pos;
+    uint8_t crc;
+    uint8_t payload[SIDECAR_MAX_PAYLOAD];
+    uint32_t frames; // good frames
+    uint32_t errors; // bad crc or oversized length, each costs one resync
+} sidecar_parser_t;
+
+typedef struct {
+    uint32_t at_ms;
+    uint8_t type; // SIDECAR_MSG_LYRIC or SIDECAR_MSG_PARAM
+    uint8_t param;
+    int16_t value;
+    uint8_t text_len;
+    char text[SIDECAR_MAX_TEXT + 1]; // nul terminated copy
+} sidecar_event_t;
+
+typedef struct {
+    sidecar_event_t events[SIDECAR_QUEUE_LEN];
+    uint8_t order[SIDECAR_QUEUE_LEN]; // indexes into events, earliest first
+    uint8_t free_slots[SIDECAR_QUEUE_LEN]; // stack of unused indexes
+    uint32_t count;
+    uint32_t free_count;
+    uint32_t sample_rate;
+    uint32_t origin; // sample clock at song position 0, valid once synced
+    bool synced; // nothing fires before the first CLOCK
+    uint32_t dropped; // events refused because the queue was full or the payload was malformed
+} sidecar_sched_t;
+
+void sidecar_parser_init(sidecar_parser_t* p);
+
+// feeds up to len bytes and stops right after a complete frame. returns bytes consumed, *complete says whether
+// p->type, p->len and p->payload now hold a frame. they stay valid until the next call
+size_t sidecar_parse(sidecar_parser_t* p, const uint8_t* data, size_t len, bool* complete);
+
+// writes one frame into out, which must hold SIDECAR_FRAME_LEN(len). returns the frame length, 0 if len is too big
+size_t sidecar_encode(uint8_t* out, uint8_t type, const uint8_t* payload, size_t len);
+
+void sidecar_sched_init(sidecar_sched_t* s, uint32_t sample_rate);
+
+// takes a frame the parser just completed. now is the sample clock of the newest audio received, which is what
+// the phone means by its CLOCK position. returns false if the frame was refused
+bool sidecar_sched_handle(sidecar_sched_t* s, const sidecar_parser_t* p, uint32_t now);
+
+// removes and returns the earliest event due at sample clock now, NULL if none is. the event stays valid until
+// the next sidecar_sched_handle
+const sidecar_event_t* sidecar_sched_pop_due(sidecar_sched_t* s, uint32_t now);
+
+#endif
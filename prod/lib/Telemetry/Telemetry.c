@@ -0,0 +1,115 @@
+#include <string.h>
+#include "Telemetry.h"
+
+telemetry_counter_t telemetry_counters[TELEM_ID_COUNT];
+
+static void sample_counters(telemetry_snapshot_t* snap) {
+    for (int i = 0; i < TELEM_ID_COUNT; i++) {
+        snap->counts[i] = atomic_load_explicit(&telemetry_counters[i].count, memory_order_relaxed);
+        snap->args[i] = atomic_load_explicit(&telemetry_counters[i].arg, memory_order_relaxed);
+    }
+}
+
+#ifdef ESP_PLATFORM
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+void telemetry_sample(telemetry_snapshot_t* snap) {
+    memset(snap, 0, sizeof(*snap));
+    snap->uptime_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    snap->heap_free = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    snap->heap_min_free = heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL);
+    snap->heap_largest = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL);
+    snap->psram_free = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+    sample_counters(snap);
+
+#if configUSE_TRACE_FACILITY
+    // run time of each task at the last sample, by task number
+    static TaskStatus_t status[TELEMETRY_MAX_TASKS];
+    typedef struct {
+        UBaseType_t number;
+        uint32_t run_time;
+    } run_t;
+    static run_t last[TELEMETRY_MAX_TASKS], now[TELEMETRY_MAX_TASKS];
+    static UBaseType_t last_count = 0;
+    static uint32_t last_total = 0;
+    uint32_t total = 0;
+    UBaseType_t count = uxTaskGetSystemState(status, TELEMETRY_MAX_TASKS, &total); // 0 if there are more tasks
+    uint32_t elapsed = total - last_total;
+    for (UBaseType_t i = 0; i < count; i++) {
+        telemetry_task_t* t = &snap->tasks[i];
+        memcpy(t->name, status[i].pcTaskName, strnlen(status[i].pcTaskName, TELEMETRY_NAME_LEN)); // rest is zeroed
+        uint32_t stack_free = status[i].usStackHighWaterMark * sizeof(StackType_t);
+        t->stack_free = (stack_free > UINT16_MAX) ? UINT16_MAX : (uint16_t)stack_free;
+        t->priority = (uint8_t)status[i].uxCurrentPriority;
+#if configGENERATE_RUN_TIME_STATS
+        uint32_t ran = status[i].ulRunTimeCounter;
+        for (UBaseType_t k = 0; k < last_count; k++) {
+            if (last[k].number == status[i].xTaskNumber && elapsed != 0) {
+                t->cpu_permille = (uint16_t)((uint64_t)(ran - last[k].run_time) * 1000 / elapsed);
+                break;
+            }
+        }
+        now[i].number = status[i].xTaskNumber;
+        now[i].run_time = ran;
+#endif
+    }
+    memcpy(last, now, sizeof(last));
+    last_count = count;
+    last_total = total;
+    snap->task_count = (uint8_t)count;
+#endif
+}
+#else
+#include <time.h>
+
+void telemetry_sample(telemetry_snapshot_t* snap) {
+    memset(snap, 0, sizeof(*snap));
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    snap->uptime_ms = (uint32_t)((uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+    sample_counters(snap);
+}
+#endif
+
+static uint8_t* put16(uint8_t* p, uint16_t v) {
+    p[0] = v & 0xff;
+    p[1] = v >> 8;
+    return p + 2;
+}
+
+static uint8_t* put32(uint8_t* p, uint32_t v) {
+    return put16(put16(p, v & 0xffff), v >> 16);
+}
+
+size_t telemetry_encode(const telemetry_snapshot_t* snap, uint8_t* out, size_t out_len) {
+    if (out_len < (size_t)TELEMETRY_PACKET_LEN(snap->task_count)) return 0;
+    uint8_t* p = out;
+    memcpy(p, "TLMY", 4);
+    p += 4;
+    *p++ = TELEMETRY_VERSION;
+    p = put32(p, snap->uptime_ms);
+    p = put32(p, snap->heap_free);
+    p = put32(p, snap->heap_min_free);
+    p = put32(p, snap->heap_largest);
+    p = put32(p, snap->psram_free);
+    *p++ = TELEM_ID_COUNT;
+    for (int i = 0; i < TELEM_ID_COUNT; i++) {
+        p = put32(p, snap->counts[i]);
+        p = put32(p, snap->args[i]);
+    }
+    *p++ = snap->task_count;
+    for (int i = 0; i < snap->task_count; i++) {
+        memcpy(p, snap->tasks[i].name, TELEMETRY_NAME_LEN);
+        p += TELEMETRY_NAME_LEN;
+        p = put16(p, snap->tasks[i].stack_free);
+        p = put16(p, snap->tasks[i].cpu_permille);
+        *p++ = snap->tasks[i].priority;
+    }
+    uint16_t sum = 0;
+    for (uint8_t* q = out; q < p; q++) sum += *q;
+    p = put16(p, sum);
+    return (size_t)(p - out);
+}
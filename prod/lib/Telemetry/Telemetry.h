@@ -0,0 +1,84 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+// health of the pipeline without printing from it. real-time code bumps a counter (and keeps the last argument)
+// with telemetry_event, a low priority reporter snapshots those together with per-task stack and cpu use and the
+// heap watermarks, and sends the snapshot as a small binary packet for tools/telemetry_decode.py.
+// telemetry_sample is the only esp-idf/freertos dependent part, the rest builds on the host.
+
+// keep in step with IDS in tools/telemetry_decode.py
+typedef enum {
+    TELEM_I2S_READ_TIMEOUT = 0,
+    TELEM_I2S_READ_ERROR, // arg: esp_err_t
+    TELEM_MIC_OVERRUN, // the ones below are copied in by the reporter from the modules that count them
+    TELEM_MIC_LATE,
+    TELEM_DSP_OVERRUN,
+    TELEM_DSP_WORST_US,
+    TELEM_TX_LATE,
+    TELEM_TX_DROPPED,
+    TELEM_BT_OVERRUN_BYTES,
+    TELEM_JITTER_UNDERRUN,
+    TELEM_RECORD_DROPPED,
+    TELEM_BT_CALLBACK_WORST_US, // arg: which bt_callback_t
+    TELEM_MIC_DROPPED,
+    TELEM_MUSIC_LATE,
+    TELEM_ID_COUNT,
+} telemetry_id_t;
+
+#define TELEMETRY_MAX_TASKS 24
+#define TELEMETRY_NAME_LEN 12 // task names are cut to this, not nul terminated when they fill it
+
+typedef struct {
+    _Atomic uint32_t count;
+    _Atomic uint32_t arg; // from the latest event
+} telemetry_counter_t;
+
+typedef struct {
+    char name[TELEMETRY_NAME_LEN];
+    uint16_t stack_free; // bytes never touched since the task started
+    uint16_t cpu_permille; // of one core, since the last sample
+    uint8_t priority;
+} telemetry_task_t;
+
+typedef struct {
+    uint32_t uptime_ms;
+    uint32_t heap_free; // internal ram
+    uint32_t heap_min_free; // lowest it has been since boot
+    uint32_t heap_largest; // biggest block that could be allocated right now
+    uint32_t psram_free; // 0 without psram
+    uint32_t counts[TELEM_ID_COUNT];
+    uint32_t args[TELEM_ID_COUNT];
+    uint8_t task_count;
+    telemetry_task_t tasks[TELEMETRY_MAX_TASKS];
+} telemetry_snapshot_t;
+
+extern telemetry_counter_t telemetry_counters[TELEM_ID_COUNT];
+
+// any task, either core, isr included: two relaxed atomics, no locks, no formatting
+static inline void telemetry_event(telemetry_id_t id, uint32_t arg) {
+    atomic_fetch_add_explicit(&telemetry_counters[id].count, 1, memory_order_relaxed);
+    atomic_store_explicit(&telemetry_counters[id].arg, arg, memory_order_relaxed);
+}
+
+// reporter: overwrites a counter with a value some other module keeps
+static inline void telemetry_gauge(telemetry_id_t id, uint32_t value, uint32_t arg) {
+    atomic_store_explicit(&telemetry_counters[id].count, value, memory_order_relaxed);
+    atomic_store_explicit(&telemetry_counters[id].arg, arg, memory_order_relaxed);
+}
+
+// reporter: fills snap with the counters, the heap and every task. cpu use is measured from the previous call
+void telemetry_sample(telemetry_snapshot_t* snap);
+
+// "TLMY" | u8 version | u32 uptime ms | u32 heap free, min free, largest, psram free
+//   | u8 id count | per id: u32 count, u32 arg
+//   | u8 task count | per task: name[TELEMETRY_NAME_LEN], u16 stack free, u16 cpu permille, u8 priority
+//   | u16 sum of every byte before it. little-endian
+#define TELEMETRY_VERSION 1
+#define TELEMETRY_PACKET_LEN(tasks) (4 + 1 + 4 + 16 + 1 + TELEM_ID_COUNT * 8 + 1 + (tasks) * (TELEMETRY_NAME_LEN + 5) + 2)
+size_t telemetry_encode(const telemetry_snapshot_t* snap, uint8_t* out, size_t out_len);
+
+#endif
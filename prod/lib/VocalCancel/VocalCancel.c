@@ -0,0 +1,61 @@
+#include <string.h>
+#include "VocalCancel.h"
+
+void vocal_cancel_init(vocal_cancel_t* vc, float sample_rate, float low_hz, float high_hz) {
+    // butterworth pairs: q 0.541 and 1.307 make a 4th order edge
+    biquad_lowpass(&vc->low[0], sample_rate, low_hz, 0.5412f);
+    biquad_lowpass(&vc->low[1], sample_rate, low_hz, 1.3066f);
+    biquad_highpass(&vc->high[0], sample_rate, high_hz, 0.5412f);
+    biquad_highpass(&vc->high[1], sample_rate, high_hz, 1.3066f);
+    for (int s = 0; s < 2; s++) {
+        biquad_reset(&vc->low[s]);
+        biquad_reset(&vc->high[s]);
+    }
+    atomic_init(&vc->enabled, false);
+}
+
+void vocal_cancel_set_enabled(vocal_cancel_t* vc, bool enabled) {
+    atomic_store_explicit(&vc->enabled, enabled, memory_order_relaxed);
+}
+
+bool vocal_cancel_enabled(vocal_cancel_t* vc) {
+    return atomic_load_explicit(&vc->enabled, memory_order_relaxed);
+}
+
+static inline int32_t sat16(int32_t x) {
+    if (x > INT16_MAX) return INT16_MAX;
+    if (x < INT16_MIN) return INT16_MIN;
+    return x;
+}
+
+size_t vocal_cancel_process(vocal_cancel_t* vc, int16_t* output_buffer, const uint8_t* in_bytes, size_t in_len) {
+    size_t pairs = in_len / (2*sizeof(int16_t));
+    for (size_t start = 0; start < pairs; start += VOCAL_CANCEL_BLOCK) {
+        size_t count = (pairs - start < VOCAL_CANCEL_BLOCK) ? pairs - start : VOCAL_CANCEL_BLOCK;
+        const uint8_t* block = in_bytes + start*4;
+
+        // pass 1: mid channel, kept at 2x so the halving costs no precision
+        for (size_t n = 0; n < count; n++) {
+            int16_t in[2];
+            memcpy(in, block + n*4, 4);
+            vc->mid_low[n] = (int32_t)in[0] + in[1];
+        }
+        memcpy(vc->mid_high, vc->mid_low, count * sizeof(int32_t));
+
+        // pass 2: keep the mid only outside the vocal band, whole block one section at a time
+        for (int s = 0; s < 2; s++) biquad_process(&vc->low[s], vc->mid_low, count);
+        for (int s = 0; s < 2; s++) biquad_process(&vc->high[s], vc->mid_high, count);
+
+        // pass 3: rebuild L/R from the side and the vocal-free mid
+        int16_t* out = output_buffer + start*2;
+        for (size_t n = 0; n < count; n++) {
+            int16_t in[2];
+            memcpy(in, block + n*4, 4);
+            int32_t side_2x = (int32_t)in[0] - in[1];
+            int32_t mid_2x = vc->mid_low[n] + vc->mid_high[n];
+            out[2*n] = (int16_t)sat16((mid_2x + side_2x) >> 1);
+            out[2*n + 1] = (int16_t)sat16((mid_2x - side_2x) >> 1);
+        }
+    }
+    return pairs * 2*sizeof(int16_t);
+}
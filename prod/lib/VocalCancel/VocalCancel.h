@@ -0,0 +1,38 @@
+#ifndef VOCALCANCEL_H
+#define VOCALCANCEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "Biquad.h"
+
+// center-channel vocal removal for the a2dp stream. each channel is rebuilt as side +- (the mid signal (L+R)/2
+// with the vocal band removed): below low_hz and above high_hz the mid passes through, in between only the
+// side (L-R)/2 is left, so centered vocals cancel while bass, cymbals and anything panned stay.
+// works a block at a time, no esp-idf or freertos dependencies.
+
+#define VOCAL_CANCEL_BLOCK 256 // stereo samples per internal block
+#define VOCAL_CANCEL_LOW_HZ 150.0f
+#define VOCAL_CANCEL_HIGH_HZ 5000.0f
+
+typedef struct {
+    biquad_t low[2]; // 4th order lowpass at the bottom of the vocal band
+    biquad_t high[2]; // 4th order highpass at the top of the vocal band
+    int32_t mid_low[VOCAL_CANCEL_BLOCK];
+    int32_t mid_high[VOCAL_CANCEL_BLOCK];
+    _Atomic bool enabled;
+} vocal_cancel_t;
+
+// starts disabled
+void vocal_cancel_init(vocal_cancel_t* vc, float sample_rate, float low_hz, float high_hz);
+
+// safe to call from another task
+void vocal_cancel_set_enabled(vocal_cancel_t* vc, bool enabled);
+bool vocal_cancel_enabled(vocal_cancel_t* vc);
+
+// removes the centered vocal band from in_len bytes of little-endian 16 bit stereo pcm. output_buffer may alias
+// in_bytes. returns bytes written (whole L/R pairs)
+size_t vocal_cancel_process(vocal_cancel_t* vc, int16_t* output_buffer, const uint8_t* in_bytes, size_t in_len);
+
+#endif
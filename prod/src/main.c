@@ -1,111 +1,804 @@
+#include <stdio.h>
+#include <string.h>
 #include "esp_log.h"
-#include "freertos/ringbuf.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOSConfig.h"
 #include "freertos/FreeRTOS.h"
 #include "driver/i2s_std.h"
+#include "driver/gpio.h"
+#include "driver/sdspi_host.h"
+#include "esp_vfs_fat.h"
+#include "esp_heap_caps.h"
+#include "sdmmc_cmd.h"
+#include <sys/stat.h>
+#include "nvs_flash.h"
+#include "nvs.h"
 
 #include "constants.h"
 #include "I2S.h"
 #include "Bluetooth.h"
+#include "Mixer.h"
+#include "FrameRing.h"
+#include "Effects.h"
+#include "FeedbackSuppress.h"
+#include "PitchShift.h"
+#include "VocalCancel.h"
+#include "ByteRing.h"
+#include "JitterBuffer.h"
+#include "Latency.h"
+#include "Calibrate.h"
+#include "Sidecar.h"
+#include "Recorder.h"
+#include "Telemetry.h"
 
 #define TAG_MAIN "MAIN"
+#define MIC_FRAME_BIT (1 << 1) // write task notification bit, set when a sleeping write task has a new mic frame
+#define AUDIO_PAUSE_BIT (1 << 2) // wakes the write task so it sees audio_paused
+#define AUDIO_RESUME_BIT (1 << 3) // lets a paused write task go again
 
 // globals
-static int32_t global_buffer[DMA_BUFFER_COUNT][FRAME_SIZE]; // buffer roll for i2s mic input.
+static int32_t global_buffer[DMA_BUFFER_COUNT * MIC_FRAME_SIZE * MIC_COUNT]; // buffer roll for i2s mic input (interleaved), sized for the largest setting
+static int32_t overrun_buffer[MIC_FRAME_SIZE * MIC_COUNT]; // mic frames land here and get dropped while every slot is still in use
+static struct {
+    uint32_t capture; // rx dma stamp
+    uint16_t frame; // running mic frame id
+} mic_meta[DMA_BUFFER_COUNT]; // travels with the matching global_buffer slot
+static frame_ring_t mic_ring; // read task -> write task hand-off over global_buffer
+static latency_tracker_t latency; // mic-to-speaker timing
+static TaskHandle_t write_task_handle = NULL;
+static TaskHandle_t read_task_handle = NULL;
+static TaskHandle_t record_task_handle = NULL; // notified to start or stop a take
+static TaskHandle_t control_task_handle = NULL; // gets the pause acknowledgements
+static _Atomic bool audio_paused = false; // read and write tasks park while the channels are rebuilt
+// dma sizing, only changed while the tasks are parked
+static uint32_t frame_size = FRAME_SIZE;
+static uint32_t mic_frame_size = MIC_FRAME_SIZE;
+static uint32_t dma_buffer_count = DMA_BUFFER_COUNT;
+static int64_t frame_period_us = FRAME_PERIOD_US;
 static i2s_chan_handle_t i2s_in_handle = NULL; // i2s mic input stream
 static i2s_chan_handle_t i2s_out_handle = NULL; // i2s output stream
-static RingbufHandle_t bt_ringbuf = NULL; // bluetooth input bytes
-static QueueHandle_t i2s_queue_free = NULL;
-static QueueHandle_t i2s_queue_busy = NULL;
-static bool bt_playing = false;
+static uint8_t bt_ring_storage[RINGBUFFER_CAPACITY] __attribute__((aligned(4))); // stereo samples stay aligned for the resampler
+static byte_ring_t bt_ring; // bluetooth core -> audio core a2dp bytes
+static jitter_buffer_t bt_jitter; // drift-corrected reader for bt_ring
+static dma_sched_t tx_sched; // tx dma buffers waiting to be mixed into
+static _Atomic bool bt_playing = false;
+static _Atomic uint16_t music_volume = MIXER_GAIN_UNITY; // Q15, the phone's avrcp volume on top of mix_gains.music_gain
+static _Atomic uint32_t bt_sample_rate = SAMPLE_RATE; // negotiated a2dp rate, written by the bluetooth stack
+// per mic: feedback suppressor -> compressor -> pitch correction. the mics are then summed onto one bus for the echo -> reverb,
+// so a second singer doesn't double the cost of the heavy effects
+static effects_chain_t voice_chain[MIC_COUNT];
+static feedback_suppress_t mic_feedback[MIC_COUNT]; // howl notches, first in each chain so they see the dry mic
+static effect_compressor_t mic_compressor[MIC_COUNT];
+static effect_pitch_correct_t mic_pitch[MIC_COUNT]; // snaps each singer to the nearest note, off until selected
+static int mic_pitch_slot;
+static uint16_t mic_gains[MIC_COUNT]; // Q15 per-mic level, applied while splitting the bus
+static int32_t mic_split[MIC_COUNT][MIC_FRAME_SIZE]; // one buffer per mic, mic_split[0] becomes the summed bus
+static effects_chain_t mic_chain; // shared vocal effects, run on the summed mics before mixing
+static effect_echo_t mic_echo;
+static effect_reverb_t mic_reverb;
+static int mic_echo_slot, mic_reverb_slot;
+static pitch_shift_t music_pitch; // key change for the a2dp stream
+static vocal_cancel_t music_vocal_cancel; // center-channel vocal removal for the a2dp stream
+static int16_t music_buffer[FRAME_SIZE*2] __attribute__((aligned(4))); // resampled a2dp frame, processed in place
+static mixer_gains_t mix_gains = { .music_gain = MIXER_GAIN_UNITY, .mic_gain = MIXER_GAIN_UNITY }; // Q15 per-source gains
+static int32_t mix_bus[FRAME_SIZE*2]; // Q8.24 stereo, music + mics before the output stage
+static mixer_output_t mix_output; // master gain, limiter and dither down to the dac
+// lyric/control sidecar over spp. parsed and fired by the write task, so parameter changes land between frames
+static uint8_t spp_rx_storage[SPP_RING_CAPACITY];
+static uint8_t spp_tx_storage[SPP_RING_CAPACITY];
+static byte_ring_t spp_rx_ring; // bluetooth task -> write task
+static byte_ring_t spp_tx_ring; // write task -> sidecar task
+static sidecar_parser_t sidecar_parser;
+static sidecar_sched_t sidecar;
+static uint32_t music_clock = 0; // output samples of a2dp music mixed so far, the sidecar's timebase
+static uint32_t sidecar_shown = 0; // lyric lines that reached the speaker
+static recorder_t recorder; // final mix -> sd card, filled by the write task
+#if CALIBRATE_MODE
+static calibrate_loopback_t loopback; // latency tuner's test burst and recording
+#endif
+
+// per-stage deadline misses not already counted by the rings. written by the write task only, read by the stats
+// task and the tuner
+static struct {
+    _Atomic uint32_t mic_late; // no mic frame by the time the next tx buffer came due, concealed
+    _Atomic uint32_t mic_dropped; // stale mic frames skipped after a stall so the latency doesn't grow
+    _Atomic uint32_t music_late; // a2dp came up short mid-stream, concealed
+    _Atomic uint32_t dsp_overruns; // effects + mix for one frame took longer than a frame period
+    _Atomic uint32_t dsp_worst_us;
+} stage_stats;
+
+static inline uint32_t mic_slot(const int32_t* frame) {
+    return (frame - global_buffer) / (mic_frame_size * MIC_COUNT);
+}
 
 // read in i2s 
 void i2s_read_task(void* param) {
-    int32_t* raw_input_buffer;
+    uint16_t frame_id = 0;
     while(1) {
-        if (xQueueReceive(i2s_queue_free, &raw_input_buffer, portMAX_DELAY) == pdTRUE) { // Queue send and receive work with pointers of pointers
-            if (i2s_read_once(&i2s_in_handle, raw_input_buffer, FRAME_SIZE) == ESP_OK) {
-                if (xQueueSend(i2s_queue_busy, &raw_input_buffer, portMAX_DELAY) != pdTRUE) {
-                    printf("Could not send data to busy queue\n");
-                } 
+        if (atomic_load(&audio_paused)) {
+            xTaskNotifyGive(control_task_handle);
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+        int32_t* raw_input_buffer = frame_ring_acquire(&mic_ring);
+        if (raw_input_buffer == NULL) raw_input_buffer = overrun_buffer; // keep draining i2s so the dma doesn't overflow
+        uint32_t capture;
+        if (i2s_read_once(&i2s_in_handle, raw_input_buffer, mic_frame_size * MIC_COUNT, &capture) == ESP_OK && raw_input_buffer != overrun_buffer) {
+            uint32_t slot = mic_slot(raw_input_buffer);
+            mic_meta[slot].capture = capture;
+            mic_meta[slot].frame = ++frame_id;
+            latency_trace(&latency, frame_id, LATENCY_CAPTURE, capture);
+            latency_trace(&latency, frame_id, LATENCY_READ, latency_now());
+            if (frame_ring_publish(&mic_ring)) xTaskNotify(write_task_handle, MIC_FRAME_BIT, eSetBits);
+        }
+    }
+}
+
+// the mic frame to mix now, or NULL (and the read task asked to wake us) if it hasn't arrived.
+// one frame per tx buffer waiting is fine, more than that is a backlog a stall left behind and only the newest is kept
+// so the mic doesn't stay late
+static int32_t* next_mic_frame(void) {
+    while (frame_ring_occupancy(&mic_ring) > dma_sched_pending(&tx_sched) + 1) {
+        frame_ring_release(&mic_ring);
+        atomic_fetch_add_explicit(&stage_stats.mic_dropped, 1, memory_order_relaxed);
+    }
+    return frame_ring_prepare_wait(&mic_ring);
+}
+
+// write task: a timed parameter change from the phone
+static void sidecar_apply(uint8_t param, int16_t value) {
+    switch (param) {
+        case SIDECAR_PARAM_KEY:
+            pitch_shift_set_semitones(&music_pitch, (int8_t)((value > INT8_MAX) ? INT8_MAX : (value < INT8_MIN) ? INT8_MIN : value));
+            break;
+        case SIDECAR_PARAM_VOCAL_CANCEL:
+            vocal_cancel_set_enabled(&music_vocal_cancel, value != 0);
+            break;
+        case SIDECAR_PARAM_MUSIC_GAIN:
+            mix_gains.music_gain = (uint16_t)value;
+            break;
+        case SIDECAR_PARAM_MIC_GAIN:
+            mix_gains.mic_gain = (uint16_t)value;
+            break;
+        case SIDECAR_PARAM_ECHO:
+            effects_chain_set_enabled(&mic_chain, mic_echo_slot, value != 0);
+            break;
+        case SIDECAR_PARAM_REVERB:
+            effects_chain_set_enabled(&mic_chain, mic_reverb_slot, value != 0);
+            break;
+        case SIDECAR_PARAM_PITCH_CORRECT:
+            for (int c = 0; c < MIC_COUNT; c++) {
+                if (value != 0) effect_pitch_correct_reset(&mic_pitch[c]); // no stale history from the last time it ran
+                effects_chain_set_enabled(&voice_chain[c], mic_pitch_slot, value != 0);
             }
+            break;
+    }
+}
+
+// write task: takes new sidecar frames off the spp ring and fires whatever has reached the speaker
+static void sidecar_poll(uint32_t music_rate) {
+    // the phone's clock position is the newest audio it sent, which sits at the back of the jitter buffer
+    uint32_t received = music_clock + (uint32_t)((uint64_t)atomic_load(&bt_jitter.fill_frames) * SAMPLE_RATE / music_rate);
+    size_t budget = SIDECAR_PARSE_BUDGET;
+    while (budget > 0) {
+        size_t contiguous;
+        const uint8_t* bytes = byte_ring_peek(&spp_rx_ring, &contiguous);
+        if (contiguous == 0) break;
+        if (contiguous > budget) contiguous = budget;
+        bool complete;
+        size_t used = sidecar_parse(&sidecar_parser, bytes, contiguous, &complete);
+        byte_ring_consume(&spp_rx_ring, used);
+        budget -= used;
+        if (complete) sidecar_sched_handle(&sidecar, &sidecar_parser, received);
+    }
+
+    // what was just mixed plays after every other queued tx buffer. for the first few frames nothing has played yet,
+    // and the difference would wrap to a clock near 2^32
+    uint32_t queued = dma_buffer_count * frame_size;
+    uint32_t audible = (music_clock > queued) ? music_clock - queued : 0;
+    const sidecar_event_t* ev;
+    while ((ev = sidecar_sched_pop_due(&sidecar, audible)) != NULL) {
+        if (ev->type == SIDECAR_MSG_PARAM) {
+            sidecar_apply(ev->param, ev->value);
+            continue;
         }
+        // echo the line back so the phone can show it in time with the speaker instead of its own clock
+        static uint8_t payload[SIDECAR_MAX_PAYLOAD];
+        static uint8_t frame[SIDECAR_FRAME_LEN(SIDECAR_MAX_PAYLOAD)];
+        for (int b = 0; b < 4; b++) payload[b] = (uint8_t)(ev->at_ms >> (8*b));
+        memcpy(payload + 4, ev->text, ev->text_len);
+        size_t len = sidecar_encode(frame, SIDECAR_MSG_SHOW, payload, 4 + ev->text_len);
+        if (SPP_RING_CAPACITY - byte_ring_fill(&spp_tx_ring) >= len) { // whole frames only
+            byte_ring_write(&spp_tx_ring, frame, len);
+            sidecar_shown++;
+        }
+    }
+}
+
+// mic source for one output frame into mic_split[0]: the frame the read task handed over, or a fade-out of the
+// last one if it is late. the effects run either way so their tails carry on through a gap
+static void mix_mic_source(const int32_t* i2s_mic_data) {
+    static int32_t mic_last[MIC_COUNT][MIC_FRAME_SIZE]; // last dry frame per mic, for concealment
+    static bool mic_last_valid = false;
+    int32_t* mic_channels[MIC_COUNT];
+    for (int c = 0; c < MIC_COUNT; c++) mic_channels[c] = mic_split[c];
+    if (i2s_mic_data != NULL) {
+        mixer_split_mics(mic_channels, i2s_mic_data, mic_frame_size, MIC_COUNT, mic_gains);
+        for (int c = 0; c < MIC_COUNT; c++) memcpy(mic_last[c], mic_split[c], mic_frame_size * sizeof(int32_t));
+        mic_last_valid = true;
+    } else {
+        atomic_fetch_add_explicit(&stage_stats.mic_late, 1, memory_order_relaxed);
+        for (int c = 0; c < MIC_COUNT; c++) {
+            if (mic_last_valid) mixer_conceal_mic(mic_split[c], mic_last[c], mic_frame_size);
+            else memset(mic_split[c], 0, mic_frame_size * sizeof(int32_t));
+        }
+        mic_last_valid = false; // a second miss in a row is silence
+    }
+#if CALIBRATE_MODE
+    if (atomic_load_explicit(&loopback.active, memory_order_acquire)) {
+        calibrate_capture(&loopback, (i2s_mic_data != NULL) ? mic_split[0] : NULL, mic_frame_size); // dry, before the effects
     }
+#endif
+    for (int c = 0; c < MIC_COUNT; c++) effects_chain_process(&voice_chain[c], mic_split[c], mic_frame_size);
+    mixer_sum_mics(mic_split[0], mic_channels, mic_frame_size, MIC_COUNT);
+    effects_chain_process(&mic_chain, mic_split[0], mic_frame_size);
 }
 
-// i2s output to speaker
+// music source for one output frame into music_buffer. returns its length in bytes, 0 when nothing is playing.
+// a read that comes up short mid-stream gets the rest of the last full frame faded out
+static size_t mix_music_source(uint32_t* music_rate) {
+    static int16_t music_last[FRAME_SIZE*2]; // last full frame, for concealment
+    static bool music_last_valid = false;
+
+    // the phone picked a new rate, retune the resampler. done here so it never races a read
+    uint32_t new_rate = atomic_load(&bt_sample_rate);
+    if (new_rate != *music_rate) {
+        *music_rate = new_rate;
+        jitter_buffer_set_in_rate(&bt_jitter, *music_rate);
+        music_last_valid = false;
+    }
+
+    // handle a2dp stuff if bluetooth is on. the jitter buffer resamples out of the ring,
+    // correcting for drift between the phone's clock and ours
+    size_t frames = 0;
+    if (atomic_load(&bt_playing)) {
+        frames = jitter_buffer_read(&bt_jitter, music_buffer, frame_size);
+    } else {
+        jitter_buffer_reset(&bt_jitter); // drop whatever is left from before a pause or disconnect
+        music_last_valid = false;
+    }
+    music_clock += frames; // only what the phone sent moves the sidecar's clock
+    size_t music_len = frames * 2*sizeof(int16_t);
+    if (frames == frame_size) {
+        memcpy(music_last, music_buffer, frame_size * 2*sizeof(int16_t));
+        music_last_valid = true;
+    } else if (music_last_valid) {
+        atomic_fetch_add_explicit(&stage_stats.music_late, 1, memory_order_relaxed);
+        mixer_conceal_music(music_buffer, music_last, frames, frame_size);
+        music_len = frame_size * 2*sizeof(int16_t);
+        music_last_valid = false;
+    }
+    sidecar_poll(*music_rate);
+
+    const uint8_t* music = (const uint8_t*)music_buffer;
+    if (music_len != 0 && vocal_cancel_enabled(&music_vocal_cancel)) {
+        music_len = vocal_cancel_process(&music_vocal_cancel, music_buffer, music, music_len);
+    }
+    if (music_len != 0 && pitch_shift_active(&music_pitch)) {
+        music_len = pitch_shift_process(&music_pitch, music_buffer, music, music_len);
+    } else if (music_len != 0) {
+        pitch_shift_feed(&music_pitch, music, music_len); // so a key change starts on the song, not on silence
+    }
+    return music_len;
+}
+
+// i2s output to speaker. woken by the tx dma and mixes straight into the buffer it just finished.
+// every source that is ready goes in and the missing ones are concealed, so one late source never holds up another.
+// the mic usually lands just after the tx buffer, so a buffer with no mic frame yet is held until the mic frame
+// comes or the next tx buffer does, whichever is first. that is the deadline, the write task never waits on the mic
 void i2s_write_task(void *param) {
-    uint8_t* byte_data = NULL;
-    int32_t* i2s_mic_data = NULL;
+    uint32_t music_rate = SAMPLE_RATE;
+#if MIC_RATE_SHIFT > 0
+    static int32_t mic_upsampled[FRAME_SIZE];
+    int32_t mic_last = 0;
+#endif
+    int16_t* held = NULL; // tx buffer waiting for the mic
+    uint32_t held_seq = 0; // its place in the tx sequence, to tell whether the dma got back to it while it waited
     while (1) {
-        int16_t output_buffer[FRAME_SIZE*2] = {0};
-        if (bt_playing) {
-            // first handle a2dp stuff if bluetooth is on
-            size_t item_size = 0;
-            byte_data = xRingbufferReceiveUpTo(bt_ringbuf, &item_size, 0, 2*sizeof(int16_t) * FRAME_SIZE);
-            if (item_size != 0) {
-                for (int i = 0; i < item_size; i+=2) {
-                    output_buffer[i/2] = ((int16_t)(((uint16_t)byte_data[i+1] << 8) | byte_data[i]));
-                }
-                
-                vRingbufferReturnItem(bt_ringbuf, byte_data);    
-            }
+        xTaskNotifyWait(0, I2S_TX_SENT_BIT | MIC_FRAME_BIT | AUDIO_PAUSE_BIT, NULL, portMAX_DELAY);
+        if (atomic_load(&audio_paused)) {
+            held = NULL; // belongs to the channel being torn down
+            xTaskNotifyGive(control_task_handle);
+            uint32_t bits;
+            do {
+                xTaskNotifyWait(0, UINT32_MAX, &bits, portMAX_DELAY); // drops tx bits from the old channel too
+            } while (!(bits & AUDIO_RESUME_BIT));
+            continue;
         }
-        
-        // then pipe in mic if successful
-        if (xQueueReceive(i2s_queue_busy, &i2s_mic_data, pdMS_TO_TICKS(20)) == pdTRUE) {
+        while (1) {
+            int16_t* dma_out = held;
+            uint32_t seq = held_seq;
+            if (dma_out != NULL && !dma_sched_still_safe(&tx_sched, seq)) {
+                held = NULL; // woken so late the dma is playing it again, filling it now would tear it. counted late
+                continue;
+            }
+            if (dma_out == NULL) {
+                uint32_t sent;
+                dma_out = dma_sched_take(&tx_sched, &sent, &seq);
+                if (dma_out == NULL) break;
+                latency_tx_sent(&latency, dma_out, sent); // whatever was mixed into it last time has now played
+            }
+            int32_t* i2s_mic_data = next_mic_frame();
+            if (i2s_mic_data == NULL && dma_sched_pending(&tx_sched) == 0) {
+                held = dma_out;
+                held_seq = seq;
+                break;
+            }
+            held = NULL;
+
+            int64_t dsp_start = esp_timer_get_time();
+            mix_mic_source(i2s_mic_data);
+            const int32_t* mic = mic_split[0];
+#if MIC_RATE_SHIFT > 0
+            mixer_upsample_mic(mic_upsampled, mic, mic_frame_size, MIC_RATE_SHIFT, &mic_last);
+            mic = mic_upsampled;
+#endif
+            size_t music_len = mix_music_source(&music_rate);
+
+            mixer_gains_t gains = mix_gains;
+            gains.music_gain = (uint16_t)(((uint32_t)gains.music_gain * atomic_load(&music_volume)) >> 15);
+            mixer_mix_bus(mix_bus, (const uint8_t*)music_buffer, music_len, mic, frame_size, &gains);
+            mixer_output_process(&mix_output, dma_out, mix_bus, frame_size);
+            recorder_push(&recorder, dma_out, frame_size); // one atomic load unless a take is running
+#if CALIBRATE_MODE
+            if (atomic_load_explicit(&loopback.active, memory_order_acquire)) {
+                calibrate_play(&loopback, dma_out, frame_size); // the mix still ran, so the load is real
+            }
+#endif
+
             if (i2s_mic_data != NULL) {
-                for (int i = 0; i < FRAME_SIZE*2; i+=2) {
-                    int16_t mic_reading_16 = (int16_t)(i2s_mic_data[i / 2] >> 16);
-                    output_buffer[i] += (mic_reading_16);
-                    output_buffer[i+1] += (mic_reading_16);
+                uint32_t slot = mic_slot(i2s_mic_data);
+                latency_trace(&latency, mic_meta[slot].frame, LATENCY_MIX, latency_now());
+                latency_tx_mixed(&latency, dma_out, mic_meta[slot].frame, mic_meta[slot].capture);
+                frame_ring_release(&mic_ring);
+            }
+
+            int64_t dsp_us = esp_timer_get_time() - dsp_start;
+            if (dsp_us > frame_period_us) atomic_fetch_add_explicit(&stage_stats.dsp_overruns, 1, memory_order_relaxed);
+            if (dsp_us > atomic_load_explicit(&stage_stats.dsp_worst_us, memory_order_relaxed)) {
+                atomic_store_explicit(&stage_stats.dsp_worst_us, (uint32_t)dsp_us, memory_order_relaxed);
+            }
+        }
+    }
+}
+
+#if LATENCY_DUMP
+// raw events out the console uart, between the log lines. tools/latency_decode.py picks them back out
+static void latency_dump(void) {
+    static latency_event_t events[LATENCY_TRACE_LEN];
+    static uint8_t packet[LATENCY_PACKET_LEN(LATENCY_TRACE_LEN)];
+    size_t count = latency_trace_drain(&latency, events, LATENCY_TRACE_LEN);
+    size_t len = latency_encode(events, count, packet, sizeof(packet));
+    fwrite(packet, 1, len, stdout);
+    fflush(stdout);
+}
+#endif
+
+// sends the lyric lines the write task queued for the phone
+static void sidecar_task(void* param) {
+    while (1) {
+        size_t contiguous;
+        const uint8_t* bytes = byte_ring_peek(&spp_tx_ring, &contiguous);
+        if (contiguous == 0) {
+            vTaskDelay(pdMS_TO_TICKS(10));
+            continue;
+        }
+        bt_spp_send(bytes, contiguous); // nobody listening is fine, the lines are just dropped
+        byte_ring_consume(&spp_tx_ring, contiguous);
+    }
+}
+
+// avrcp metadata, volume and the cabinet buttons, kept off the bluetooth task and the audio core
+static void remote_task(void* param) {
+    static const gpio_num_t pins[] = { REMOTE_PREV_GPIO, REMOTE_PLAY_GPIO, REMOTE_NEXT_GPIO, REMOTE_RECORD_GPIO };
+    const int buttons = sizeof(pins) / sizeof(pins[0]);
+    uint8_t held[sizeof(pins) / sizeof(pins[0])] = { 0 };
+    gpio_config_t io = { .mode = GPIO_MODE_INPUT, .pull_up_en = GPIO_PULLUP_ENABLE, .intr_type = GPIO_INTR_DISABLE };
+    for (int b = 0; b < buttons; b++) io.pin_bit_mask |= 1ULL << pins[b];
+    ESP_ERROR_CHECK(gpio_config(&io));
+
+    static bt_remote_event_t ev;
+    static char title[BT_REMOTE_TEXT_MAX + 1];
+    bool phone_playing = false;
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(REMOTE_POLL_MS));
+        while (bt_remote_poll(&ev)) {
+            switch (ev.kind) {
+                case BT_REMOTE_TITLE:
+                    memcpy(title, ev.text, sizeof(title));
+                    break;
+                case BT_REMOTE_ARTIST: // comes after the title in the same metadata response
+                    ESP_LOGI(TAG_MAIN, "now playing: %s - %s", title, ev.text);
+                    break;
+                case BT_REMOTE_PLAY_STATUS:
+                    phone_playing = ev.value != 0;
+                    break;
+                case BT_REMOTE_VOLUME: { // squared, so the phone's steps sound even
+                    uint32_t v = ev.value > 127 ? 127 : ev.value;
+                    atomic_store(&music_volume, (uint16_t)(MIXER_GAIN_UNITY * v * v / (127 * 127)));
+                    break;
                 }
             }
-            if (xQueueSend(i2s_queue_free, &i2s_mic_data, portMAX_DELAY) != pdTRUE) {
-                printf("Could not return buffer to free queue\n");
-            } 
-        } else {
-            printf("Failed to receive i2s data from queue\n");
-        }    
+        }
+
+        // a press fires once, after REMOTE_DEBOUNCE samples low in a row
+        for (int b = 0; b < buttons; b++) {
+            if (gpio_get_level(pins[b]) != 0) {
+                held[b] = 0;
+                continue;
+            }
+            if (held[b] > REMOTE_DEBOUNCE || ++held[b] <= REMOTE_DEBOUNCE) continue;
+            if (pins[b] == REMOTE_PREV_GPIO) bt_remote_key(BT_REMOTE_KEY_PREV);
+            else if (pins[b] == REMOTE_NEXT_GPIO) bt_remote_key(BT_REMOTE_KEY_NEXT);
+            else if (pins[b] == REMOTE_RECORD_GPIO) {
+                if (record_task_handle != NULL) xTaskNotifyGive(record_task_handle);
+            }
+            else bt_remote_key((phone_playing || atomic_load(&bt_playing)) ? BT_REMOTE_KEY_PAUSE : BT_REMOTE_KEY_PLAY);
+        }
+    }
+}
+
+// sd card over spi, mounted on the first take
+static bool record_mount(void) {
+    sdmmc_host_t host = SDSPI_HOST_DEFAULT();
+    spi_bus_config_t bus = {
+        .mosi_io_num = RECORD_SD_MOSI,
+        .miso_io_num = RECORD_SD_MISO,
+        .sclk_io_num = RECORD_SD_SCLK,
+        .quadwp_io_num = -1,
+        .quadhd_io_num = -1,
+        .max_transfer_sz = 4096,
+    };
+    if (spi_bus_initialize(host.slot, &bus, SDSPI_DEFAULT_DMA) != ESP_OK) return false;
+    sdspi_device_config_t slot = SDSPI_DEVICE_CONFIG_DEFAULT();
+    slot.gpio_cs = RECORD_SD_CS;
+    slot.host_id = host.slot;
+    esp_vfs_fat_sdmmc_mount_config_t mount = { .format_if_mount_failed = false, .max_files = 2, .allocation_unit_size = 32 * 1024 };
+    sdmmc_card_t* card;
+    if (esp_vfs_fat_sdspi_mount(RECORD_MOUNT, &host, &slot, &mount, &card) != ESP_OK) {
+        spi_bus_free(host.slot);
+        return false;
+    }
+    return true;
+}
+
+// next free takeNNN.wav
+static FILE* record_open(char* path, size_t path_len) {
+    struct stat st;
+    for (int take = 1; take < 1000; take++) {
+        snprintf(path, path_len, RECORD_MOUNT "/take%03d.wav", take);
+        if (stat(path, &st) != 0) return fopen(path, "wb");
+    }
+    return NULL;
+}
+
+// streams takes from the recorder's blocks to the card. the write task only ever copies into the blocks
+static void record_task(void* param) {
+    static recorder_writer_t writer;
+    static char path[32];
+    bool mounted = false;
+    FILE* file = NULL;
+    while (1) {
+        bool pressed = ulTaskNotifyTake(pdTRUE, (file != NULL) ? pdMS_TO_TICKS(RECORD_POLL_MS) : portMAX_DELAY) != 0;
+        if (pressed && file == NULL) {
+            if (!mounted) mounted = record_mount();
+            if (mounted) file = record_open(path, sizeof(path));
+            if (file == NULL) {
+                ESP_LOGE(TAG_MAIN, "recording: no sd card");
+                continue;
+            }
+            setvbuf(file, NULL, _IONBF, 0); // blocks already come in sector multiples, skip the stdio copy
+            recorder_writer_open(&writer, file, RECORD_ADPCM ? RECORDER_IMA_ADPCM : RECORDER_PCM16, SAMPLE_RATE);
+            recorder_start(&recorder);
+            ESP_LOGI(TAG_MAIN, "recording to %s", path);
+        } else if (pressed) {
+            recorder_stop(&recorder);
+        }
+        if (file == NULL) continue;
 
-        // write to i2s.
-        i2s_channel_write(i2s_out_handle, output_buffer, FRAME_SIZE*sizeof(int16_t)*2, NULL, pdMS_TO_TICKS(20));  
+        size_t len;
+        const uint8_t* block;
+        while ((block = recorder_peek(&recorder, &len)) != NULL) {
+            recorder_writer_write(&writer, (const int16_t*)block, len / (2*sizeof(int16_t)));
+            recorder_release(&recorder);
+        }
+        if (writer.failed) recorder_stop(&recorder); // card full or pulled, keep what made it
+        if (recorder_finished(&recorder)) {
+            bool ok = recorder_writer_close(&writer);
+            fclose(file);
+            file = NULL;
+            ESP_LOGI(TAG_MAIN, "recording %s: %s, %lu frames, %lu dropped", path, ok ? "saved" : "write failed",
+                (unsigned long)writer.frames, (unsigned long)atomic_load(&recorder.dropped_frames));
+        }
     }
 }
 
+// copies the pipeline's own counters into the telemetry table, then sends or logs a snapshot with the tasks and heap
+static void telemetry_report(const uint32_t cb_us[BT_CB_COUNT]) {
+    uint32_t worst_cb = 0;
+    for (uint32_t cb = 1; cb < BT_CB_COUNT; cb++) {
+        if (cb_us[cb] > cb_us[worst_cb]) worst_cb = cb;
+    }
+    telemetry_gauge(TELEM_MIC_OVERRUN, atomic_load(&mic_ring.overruns), 0);
+    telemetry_gauge(TELEM_MIC_LATE, atomic_load(&stage_stats.mic_late), 0);
+    telemetry_gauge(TELEM_DSP_OVERRUN, atomic_load(&stage_stats.dsp_overruns), 0);
+    telemetry_gauge(TELEM_DSP_WORST_US, atomic_load(&stage_stats.dsp_worst_us), 0);
+    telemetry_gauge(TELEM_TX_LATE, atomic_load(&tx_sched.late), 0);
+    telemetry_gauge(TELEM_TX_DROPPED, atomic_load(&tx_sched.dropped), 0);
+    telemetry_gauge(TELEM_BT_OVERRUN_BYTES, atomic_load(&bt_ring.overrun_bytes), 0);
+    telemetry_gauge(TELEM_JITTER_UNDERRUN, atomic_load(&bt_jitter.underruns), 0);
+    telemetry_gauge(TELEM_RECORD_DROPPED, atomic_load(&recorder.dropped_frames), 0);
+    telemetry_gauge(TELEM_BT_CALLBACK_WORST_US, cb_us[worst_cb], worst_cb);
+    telemetry_gauge(TELEM_MIC_DROPPED, atomic_load(&stage_stats.mic_dropped), 0);
+    telemetry_gauge(TELEM_MUSIC_LATE, atomic_load(&stage_stats.music_late), 0);
+
+    static telemetry_snapshot_t snap;
+    telemetry_sample(&snap);
+#if TELEMETRY_DUMP
+    static uint8_t packet[TELEMETRY_PACKET_LEN(TELEMETRY_MAX_TASKS)];
+    fwrite(packet, 1, telemetry_encode(&snap, packet, sizeof(packet)), stdout);
+    fflush(stdout);
+#else
+    ESP_LOGI(TAG_MAIN, "heap: %lu free, %lu min, %lu largest | psram: %lu free | i2s reads: %lu timeouts, %lu errors",
+        (unsigned long)snap.heap_free, (unsigned long)snap.heap_min_free, (unsigned long)snap.heap_largest, (unsigned long)snap.psram_free,
+        (unsigned long)snap.counts[TELEM_I2S_READ_TIMEOUT], (unsigned long)snap.counts[TELEM_I2S_READ_ERROR]);
+    for (int i = 0; i < snap.task_count; i++) {
+        ESP_LOGI(TAG_MAIN, "task %-*.*s prio %2u: %5u bytes stack free, %3u.%u%% cpu", TELEMETRY_NAME_LEN, TELEMETRY_NAME_LEN,
+            snap.tasks[i].name, snap.tasks[i].priority, snap.tasks[i].stack_free, snap.tasks[i].cpu_permille / 10, snap.tasks[i].cpu_permille % 10);
+    }
+#endif
+}
+
+// low priority report of every stage's misses, runs on the bluetooth core
+void stats_task(void* param) {
+#if LATENCY_DUMP
+    TickType_t last_report = xTaskGetTickCount();
+#endif
+    while (1) {
+#if LATENCY_DUMP
+        vTaskDelay(pdMS_TO_TICKS(LATENCY_DUMP_PERIOD_MS));
+        latency_dump();
+        if (xTaskGetTickCount() - last_report < pdMS_TO_TICKS(STATS_PERIOD_MS)) continue;
+        last_report = xTaskGetTickCount();
+#else
+        vTaskDelay(pdMS_TO_TICKS(STATS_PERIOD_MS));
+#endif
+        ESP_LOGI(TAG_MAIN, "bt ingest: %lu bytes dropped | jitter: fill %lu/%lu frames, %ld ppm, %lu underruns, %lu late | mic: %lu overruns, %lu late, %lu dropped | dsp: %lu overruns, worst %lu us | tx: %lu late, %lu dropped | out: %lu limited",
+            (unsigned long)atomic_load(&bt_ring.overrun_bytes),
+            (unsigned long)atomic_load(&bt_jitter.fill_frames), (unsigned long)atomic_load(&bt_jitter.target_frames),
+            (long)atomic_load(&bt_jitter.ratio_ppm), (unsigned long)atomic_load(&bt_jitter.underruns),
+            (unsigned long)atomic_load(&stage_stats.music_late), (unsigned long)atomic_load(&mic_ring.overruns),
+            (unsigned long)atomic_load(&stage_stats.mic_late), (unsigned long)atomic_load(&stage_stats.mic_dropped),
+            (unsigned long)atomic_load(&stage_stats.dsp_overruns), (unsigned long)atomic_load(&stage_stats.dsp_worst_us),
+            (unsigned long)atomic_load(&tx_sched.late), (unsigned long)atomic_load(&tx_sched.dropped), (unsigned long)atomic_load(&mix_output.limited));
+
+        latency_summary_t total, software;
+        latency_hist_summary(&latency.total, &total);
+        latency_hist_summary(&latency.software, &software);
+        uint32_t notches = 0, placed = 0;
+        for (int c = 0; c < MIC_COUNT; c++) {
+            notches += feedback_suppress_active(&mic_feedback[c]);
+            placed += mic_feedback[c].detections;
+        }
+        ESP_LOGI(TAG_MAIN, "feedback: %lu notches active, %lu placed", (unsigned long)notches, (unsigned long)placed);
+        ESP_LOGI(TAG_MAIN, "sidecar: %lu frames, %lu bad, %lu bytes dropped, %lu events refused, %lu lines shown",
+            (unsigned long)sidecar_parser.frames, (unsigned long)sidecar_parser.errors, (unsigned long)atomic_load(&spp_rx_ring.overrun_bytes),
+            (unsigned long)sidecar.dropped, (unsigned long)sidecar_shown);
+        uint32_t cb_us[BT_CB_COUNT];
+        bt_callback_worst(cb_us);
+        ESP_LOGI(TAG_MAIN, "bt callbacks worst: gap %lu a2dp %lu a2dp data %lu avrc ct %lu avrc tg %lu spp %lu us | %lu avrcp events dropped",
+            (unsigned long)cb_us[BT_CB_GAP], (unsigned long)cb_us[BT_CB_A2D], (unsigned long)cb_us[BT_CB_A2D_DATA],
+            (unsigned long)cb_us[BT_CB_AVRC_CT], (unsigned long)cb_us[BT_CB_AVRC_TG], (unsigned long)cb_us[BT_CB_SPP],
+            (unsigned long)bt_remote_dropped());
+        telemetry_report(cb_us);
+        if (atomic_load(&recorder.state) != RECORDER_IDLE) {
+            ESP_LOGI(TAG_MAIN, "recording: %lu blocks written, %lu frames dropped",
+                (unsigned long)atomic_load(&recorder.blocks_written), (unsigned long)atomic_load(&recorder.dropped_frames));
+        }
+        ESP_LOGI(TAG_MAIN, "latency mic->speaker: min %lu avg %lu p99 %lu max %lu us (%lu frames) | mic->mix: min %lu avg %lu p99 %lu max %lu us",
+            (unsigned long)total.min_us, (unsigned long)total.avg_us, (unsigned long)total.p99_us, (unsigned long)total.max_us, (unsigned long)total.count,
+            (unsigned long)software.min_us, (unsigned long)software.avg_us, (unsigned long)software.p99_us, (unsigned long)software.max_us);
+    }
+}
+
+// (re)builds both i2s channels and everything sized by them. the channels come back disabled
+static void audio_configure(uint32_t new_frame_size, uint32_t new_dma_count) {
+    if (i2s_out_handle != NULL) i2s_deinit(&i2s_in_handle, &i2s_out_handle);
+    frame_size = new_frame_size;
+    mic_frame_size = new_frame_size >> MIC_RATE_SHIFT;
+    dma_buffer_count = new_dma_count;
+    frame_period_us = 1000000LL * frame_size / SAMPLE_RATE;
+
+    frame_ring_init(&mic_ring, global_buffer, mic_frame_size * MIC_COUNT, dma_buffer_count); // all mic buffers start out free
+    dma_sched_init(&tx_sched, dma_buffer_count);
+    latency_init(&latency);
+    memset(&stage_stats, 0, sizeof(stage_stats));
+
+    i2s_init(&i2s_in_handle, &i2s_out_handle, MIC_COUNT, MIC_SAMPLE_RATE, SAMPLE_RATE, mic_frame_size, frame_size, dma_buffer_count);
+    i2s_register_tx_sched(&i2s_out_handle, &tx_sched, write_task_handle);
+    i2s_register_rx_stamps(&i2s_in_handle);
+    ESP_LOGI(TAG_MAIN, "I2S configured: %lu samples x %lu buffers", (unsigned long)frame_size, (unsigned long)dma_buffer_count);
+}
+
+#if CALIBRATE_MODE
+// parks the read and write tasks between frames so the channels can be torn down under them
+static void audio_pause(void) {
+    atomic_store(&audio_paused, true);
+    xTaskNotify(write_task_handle, AUDIO_PAUSE_BIT, eSetBits);
+    uint32_t acks = 0;
+    while (acks < 2) acks += ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+}
+
+static void audio_resume(void) {
+    ESP_ERROR_CHECK(i2s_channel_enable(i2s_in_handle));
+    ESP_ERROR_CHECK(i2s_channel_enable(i2s_out_handle));
+    atomic_store(&audio_paused, false);
+    xTaskNotify(write_task_handle, AUDIO_RESUME_BIT, eSetBits);
+    xTaskNotifyGive(read_task_handle);
+}
+
+// dropped or missed frames anywhere between the mic and the speaker
+static uint32_t audio_faults(void) {
+    return atomic_load(&mic_ring.overruns) + atomic_load(&stage_stats.mic_late) + atomic_load(&stage_stats.mic_dropped) +
+        atomic_load(&tx_sched.late) + atomic_load(&tx_sched.dropped);
+}
+
+// runs the pipeline at setting for a test window with the burst playing. true if nothing was dropped
+static bool tune_trial(calibrate_setting_t setting) {
+    audio_pause();
+    audio_configure(setting.frame_size, setting.dma_count);
+    audio_resume();
+    vTaskDelay(pdMS_TO_TICKS(100)); // startup misses while the buffers fill don't count
+
+    uint32_t faults = audio_faults();
+    calibrate_start(&loopback, CALIBRATE_LEVEL, MIC_RATE_SHIFT);
+    vTaskDelay(pdMS_TO_TICKS(CALIBRATE_WINDOW_MS));
+    atomic_store(&loopback.active, false);
+    faults = audio_faults() - faults;
+
+    // the recording stops changing once it is full
+    int32_t lag = calibrate_done(&loopback) ? calibrate_find_lag(&loopback) : -1;
+    if (lag >= 0) {
+        ESP_LOGI(TAG_MAIN, "tune %lu x %lu: %lu faults, loopback %lld us", (unsigned long)setting.frame_size, (unsigned long)setting.dma_count,
+            (unsigned long)faults, (long long)(1000000LL * lag / MIC_SAMPLE_RATE));
+    } else {
+        ESP_LOGI(TAG_MAIN, "tune %lu x %lu: %lu faults, no loopback heard", (unsigned long)setting.frame_size, (unsigned long)setting.dma_count,
+            (unsigned long)faults);
+    }
+    return faults == 0;
+}
+
+#if CALIBRATE_MODE == 1
+static bool tune_load(calibrate_setting_t* setting) {
+    nvs_handle_t nvs;
+    if (nvs_open("tune", NVS_READONLY, &nvs) != ESP_OK) return false;
+    bool ok = nvs_get_u16(nvs, "frame", &setting->frame_size) == ESP_OK && nvs_get_u8(nvs, "count", &setting->dma_count) == ESP_OK;
+    nvs_close(nvs);
+    // a stored setting from a build with other limits is not trusted
+    return ok && setting->frame_size >= MIN_FRAME_SIZE && setting->frame_size <= FRAME_SIZE &&
+        setting->dma_count >= 3 && setting->dma_count <= DMA_BUFFER_COUNT;
+}
+
+static void tune_save(calibrate_setting_t setting) {
+    nvs_handle_t nvs;
+    if (nvs_open("tune", NVS_READWRITE, &nvs) != ESP_OK) return;
+    nvs_set_u16(nvs, "frame", setting.frame_size);
+    nvs_set_u8(nvs, "count", setting.dma_count);
+    nvs_commit(nvs);
+    nvs_close(nvs);
+}
+#endif
+
+// binary search for the smallest buffers that run clean, then settle on it (plus margin)
+static calibrate_setting_t tune_latency(void) {
+    static calibrate_search_t search;
+    calibrate_search_init(&search, MIN_FRAME_SIZE, FRAME_SIZE, DMA_BUFFER_COUNT);
+    calibrate_setting_t setting;
+    while (calibrate_search_next(&search, &setting)) {
+        calibrate_search_report(&search, tune_trial(setting));
+    }
+    setting = calibrate_search_result(&search, CALIBRATE_MARGIN);
+    audio_pause();
+    audio_configure(setting.frame_size, setting.dma_count);
+    audio_resume();
+    return setting;
+}
+#endif
+
 void app_main(void)
 {       
-    // queue for incoming i2s data
-    i2s_queue_free = xQueueCreate(DMA_BUFFER_COUNT, sizeof(int32_t*)); // store pointers to i2s data buffers
-    if (i2s_queue_free == NULL) {
-        ESP_LOGE(TAG_MAIN, "%s free queue create failed", __func__);
-        return;
+    control_task_handle = xTaskGetCurrentTaskHandle();
+
+    // per mic: feedback suppressor -> compressor -> pitch correction
+    for (int c = 0; c < MIC_COUNT; c++) {
+        mic_gains[c] = MIXER_GAIN_UNITY;
+        feedback_suppress_init(&mic_feedback[c], MIC_SAMPLE_RATE);
+        effect_compressor_init(&mic_compressor[c], 0x20000000, 4, 1000, 20, EFFECTS_UNITY); // -12 dBFS threshold, 4:1
+        effects_chain_init(&voice_chain[c]);
+        effects_chain_add(&voice_chain[c], feedback_suppress_process, &mic_feedback[c]);
+        effects_chain_add(&voice_chain[c], effect_compressor_process, &mic_compressor[c]);
+        effect_pitch_correct_init(&mic_pitch[c], MIC_SAMPLE_RATE, EFFECTS_UNITY, EFFECTS_UNITY / 2); // full snap, half glide
+        mic_pitch_slot = effects_chain_add(&voice_chain[c], effect_pitch_correct_process, &mic_pitch[c]);
+        effects_chain_set_enabled(&voice_chain[c], mic_pitch_slot, false);
     }
 
-    // set all initial buffers to free
-    for (uint8_t i = 0; i < DMA_BUFFER_COUNT; i++) {
-        int32_t* p = global_buffer[i];
-        xQueueSend(i2s_queue_free, &p, portMAX_DELAY);
+    mixer_output_init(&mix_output, MIXER_GAIN_UNITY, MIXER_BUS_ONE / 32 * 31, SAMPLE_RATE / 20); // ~-0.3 dBFS ceiling, ~50 ms release
+
+    // shared bus: echo -> reverb
+    effect_echo_init(&mic_echo, MIC_SAMPLE_RATE / 8, 9830, 8192); // 125 ms, 0.3 feedback, 0.25 mix
+    effect_reverb_init(&mic_reverb, 27525, 6554, 9830); // 0.84 room, 0.2 damping, 0.3 wet
+    effects_chain_init(&mic_chain);
+    mic_echo_slot = effects_chain_add(&mic_chain, effect_echo_process, &mic_echo);
+    mic_reverb_slot = effects_chain_add(&mic_chain, effect_reverb_process, &mic_reverb);
+
+    pitch_shift_init(&music_pitch); // no key change until one is requested
+    vocal_cancel_init(&music_vocal_cancel, SAMPLE_RATE, VOCAL_CANCEL_LOW_HZ, VOCAL_CANCEL_HIGH_HZ); // off until selected
+
+    // the write task reads the a2dp path from its first frame, so it has to be ready before the output starts
+    byte_ring_init(&bt_ring, bt_ring_storage, RINGBUFFER_CAPACITY);
+    jitter_buffer_init(&bt_jitter, &bt_ring, SAMPLE_RATE, SAMPLE_RATE, JITTER_MIN_TARGET, JITTER_MAX_TARGET);
+    byte_ring_init(&spp_rx_ring, spp_rx_storage, SPP_RING_CAPACITY);
+    byte_ring_init(&spp_tx_ring, spp_tx_storage, SPP_RING_CAPACITY);
+    sidecar_parser_init(&sidecar_parser);
+    sidecar_sched_init(&sidecar, SAMPLE_RATE);
+
+    // recording blocks go in psram when the module has it
+    size_t record_block_bytes = RECORD_BLOCK_BYTES;
+    uint8_t* record_storage = heap_caps_malloc(RECORD_BLOCKS * record_block_bytes, MALLOC_CAP_SPIRAM);
+    if (record_storage == NULL) {
+        record_block_bytes = RECORD_FALLBACK_BLOCK_BYTES;
+        record_storage = heap_caps_malloc(RECORD_BLOCKS * record_block_bytes, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
     }
+    recorder_init(&recorder, record_storage, record_block_bytes, RECORD_BLOCKS); // stays idle without storage
 
-    // queue for outstream i2s data
-    i2s_queue_busy = xQueueCreate(DMA_BUFFER_COUNT, sizeof(int32_t*)); // store pointers to i2s data buffers
-    if (i2s_queue_busy == NULL) {
-        ESP_LOGE(TAG_MAIN, "%s busy queue create failed", __func__);
-        vQueueDelete(i2s_queue_free);
-        return;
+    // the one nvs init, for the tune below and for the bluetooth stack's bonding keys
+    esp_err_t ret = nvs_flash_init();
+    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        ret = nvs_flash_init();
     }
+    ESP_ERROR_CHECK(ret);
 
-    // init i2s
-    i2s_init(&i2s_in_handle, &i2s_out_handle, SAMPLE_RATE, FRAME_SIZE, DMA_BUFFER_COUNT);
+    // buffer sizes from an earlier tune, if there is one
+    calibrate_setting_t setting = { .frame_size = FRAME_SIZE, .dma_count = DMA_BUFFER_COUNT };
+#if CALIBRATE_MODE == 1
+    bool tuned = tune_load(&setting);
+#endif
+
+    // write task fills tx dma buffers in place, so it has to exist before the output starts
+    xTaskCreatePinnedToCore(i2s_write_task, "i2s_write_task", WRITE_TASK_STACK, NULL, WRITE_TASK_PRIORITY, &write_task_handle, AUDIO_CORE);
+    ESP_LOGI(TAG_MAIN, "I2S Write Task has begun");
+    audio_configure(setting.frame_size, setting.dma_count);
 
     ESP_ERROR_CHECK(i2s_channel_enable(i2s_in_handle));
     ESP_ERROR_CHECK(i2s_channel_enable(i2s_out_handle));
     ESP_LOGI(TAG_MAIN, "I2S enabled");
-    xTaskCreate(i2s_write_task, "i2s_write_task", 4096, NULL, 5, NULL);
-    ESP_LOGI(TAG_MAIN, "I2S Write Task has begun");
-    xTaskCreate(i2s_read_task, "i2s_read_task", 4096, NULL, 5, NULL);
+    xTaskCreatePinnedToCore(i2s_read_task, "i2s_read_task", READ_TASK_STACK, NULL, READ_TASK_PRIORITY, &read_task_handle, AUDIO_CORE);
     ESP_LOGI(TAG_MAIN, "I2S Read Task has begun");
 
-    bt_init(&bt_ringbuf, RINGBUFFER_CAPACITY, &bt_playing);
+    // tune before bluetooth comes up so the burst doesn't land on top of a song
+#if CALIBRATE_MODE == 1
+    if (!tuned) tune_save(tune_latency());
+#elif CALIBRATE_MODE == 2
+    tune_latency();
+#endif
+
+    // app_main runs on core 0, so the bluetooth stack and its a2dp callback come up on BT_CORE
+    bt_init(&bt_ring, &bt_playing, &bt_sample_rate, &spp_rx_ring);
+    if (record_storage != NULL) { // before remote_task, which notifies it through the handle
+        xTaskCreatePinnedToCore(record_task, "record_task", RECORD_TASK_STACK, NULL, RECORD_TASK_PRIORITY, &record_task_handle, BT_CORE);
+    }
+    xTaskCreatePinnedToCore(remote_task, "remote_task", REMOTE_TASK_STACK, NULL, REMOTE_TASK_PRIORITY, NULL, BT_CORE);
+    xTaskCreatePinnedToCore(sidecar_task, "sidecar_task", SIDECAR_TASK_STACK, NULL, SIDECAR_TASK_PRIORITY, NULL, BT_CORE);
+    xTaskCreatePinnedToCore(stats_task, "stats_task", STATS_TASK_STACK, NULL, STATS_TASK_PRIORITY, NULL, BT_CORE);
 }
\ No newline at end of file
@@ -0,0 +1,61 @@
+#!/usr/bin/env python3
+# decodes the LATENCY_DUMP packets (see lib/Latency/Latency.h) out of a raw console capture, e.g.
+#   python3 tools/latency_decode.py capture.bin
+# and prints per-stage latency stats. the capture is the serial port saved byte for byte, log lines included.
+import struct
+import sys
+
+STAGES = ["capture", "read", "mix", "play"]
+
+
+def packets(data):
+    i = data.find(b"LTCY")
+    while i >= 0:
+        if i + 6 <= len(data):
+            (count,) = struct.unpack_from("<H", data, i + 4)
+            end = i + 6 + count * 7
+            if end + 2 <= len(data):
+                (checksum,) = struct.unpack_from("<H", data, end)
+                if sum(data[i:end]) & 0xFFFF == checksum:
+                    yield [struct.unpack_from("<IHB", data, i + 6 + n * 7) for n in range(count)]
+                    i = data.find(b"LTCY", end + 2)
+                    continue
+        i = data.find(b"LTCY", i + 1)
+
+
+def stats(name, values):
+    if not values:
+        print(f"{name:>16}: no samples")
+        return
+    values = sorted(values)
+    p99 = values[min(len(values) - 1, int(len(values) * 0.99))]
+    avg = sum(values) / len(values)
+    print(f"{name:>16}: min {values[0]:6d}  avg {avg:8.0f}  p99 {p99:6d}  max {values[-1]:6d} us  ({len(values)} frames)")
+
+
+def main():
+    with open(sys.argv[1], "rb") as f:
+        data = f.read()
+    frames = {}  # frame id -> {stage: stamp}. ids wrap at 16 bits, so only pair events close together
+    for packet in packets(data):
+        for stamp, frame, stage in packet:
+            frames.setdefault(frame, {})[stage] = stamp
+            if stage == 0:
+                frames[frame] = {0: stamp}  # a new capture starts the frame over after an id wrap
+
+    def delta(a, b):
+        out = []
+        for s in frames.values():
+            if a in s and b in s:
+                d = (s[b] - s[a]) & 0xFFFFFFFF
+                if d < 1_000_000:
+                    out.append(d)
+        return out
+
+    for a, b in zip(range(3), range(1, 4)):
+        stats(f"{STAGES[a]}->{STAGES[b]}", delta(a, b))
+    stats("mic->speaker", delta(0, 3))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,104 @@
+#!/usr/bin/env python3
+# streams an .lrc lyric file to the device over the spp sidecar (see lib/Sidecar/Sidecar.h), e.g.
+#   python3 tools/lrc_send.py song.lrc /dev/rfcomm0
+#   python3 tools/lrc_send.py song.lrc tcp:localhost:7000
+# the song should start playing when this starts: it sends CLEAR and CLOCK 0, then keeps a few lines queued ahead of
+# the song position and resends CLOCK every few seconds. [key:+2], [vocal:1] style tags become timed parameter changes.
+# lines the device shows are printed as they come back.
+import re
+import select
+import socket
+import struct
+import sys
+import time
+
+SOF = 0x7E
+CLOCK, LYRIC, PARAM, CLEAR, SHOW = 0x01, 0x02, 0x03, 0x04, 0x82
+PARAMS = {"key": 0, "vocal": 1, "music": 2, "mic": 3, "echo": 4, "reverb": 5, "tune": 6}
+MAX_PAYLOAD = 100
+LOOKAHEAD_S = 4.0
+CLOCK_EVERY_S = 2.0
+
+
+def crc8(data):
+    crc = 0
+    for b in data:
+        crc ^= b
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x07) & 0xFF if crc & 0x80 else (crc << 1) & 0xFF
+    return crc
+
+
+def frame(kind, payload=b""):
+    body = bytes([kind, len(payload)]) + payload
+    return bytes([SOF]) + body + bytes([crc8(body)])
+
+
+def parse_lrc(path):
+    events = []  # (ms, frame bytes)
+    stamp = re.compile(r"\[(\d+):(\d+(?:\.\d+)?)\]")
+    tag = re.compile(r"\[(\w+):([+-]?\d+)\]")
+    with open(path, encoding="utf-8") as f:
+        for line in f:
+            stamps = [(int(m) * 60 + float(s)) for m, s in stamp.findall(line)]
+            text = stamp.sub("", line).strip()
+            for ms in (round(t * 1000) for t in stamps):
+                for name, value in tag.findall(text):
+                    if name in PARAMS:
+                        events.append((ms, frame(PARAM, struct.pack("<IBh", ms, PARAMS[name], int(value)))))
+                line_text = tag.sub("", text).strip().encode("utf-8")[: MAX_PAYLOAD - 4]
+                events.append((ms, frame(LYRIC, struct.pack("<I", ms) + line_text)))
+    return sorted(events, key=lambda e: e[0])
+
+
+def shown(buffer):
+    # pulls SHOW frames out of what the device sent back, returns the unparsed tail
+    while True:
+        i = buffer.find(bytes([SOF]))
+        if i < 0:
+            return b""
+        if len(buffer) < i + 4 or len(buffer) < i + 4 + buffer[i + 2]:
+            return buffer[i:]
+        end = i + 3 + buffer[i + 2]
+        if buffer[i + 1] == SHOW and crc8(buffer[i + 1 : end]) == buffer[end]:
+            (ms,) = struct.unpack_from("<I", buffer, i + 3)
+            print(f"{ms / 1000:8.2f}  {buffer[i + 7 : end].decode('utf-8', 'replace')}")
+            buffer = buffer[end + 1 :]
+        else:
+            buffer = buffer[i + 1 :]
+
+
+def open_link(target):
+    if target.startswith("tcp:"):
+        _, host, port = target.split(":")
+        sock = socket.create_connection((host, int(port)))
+        return sock.sendall, sock.recv, sock.fileno()
+    f = open(target, "r+b", buffering=0)
+    return f.write, f.read, f.fileno()
+
+
+def main():
+    events = parse_lrc(sys.argv[1])
+    send, recv, fd = open_link(sys.argv[2])
+    send(frame(CLEAR))
+    start = time.monotonic()
+    send(frame(CLOCK, struct.pack("<I", 0)))
+    last_clock = start
+    pending = b""
+    end = events[-1][0] / 1000 + 2 if events else 0
+    while time.monotonic() - start < end:
+        now = time.monotonic()
+        while events and events[0][0] / 1000 < now - start + LOOKAHEAD_S:
+            send(events.pop(0)[1])
+        if now - last_clock > CLOCK_EVERY_S:
+            send(frame(CLOCK, struct.pack("<I", round((now - start) * 1000))))
+            last_clock = now
+        if select.select([fd], [], [], 0.05)[0]:
+            data = recv(256)
+            if not data:
+                break
+            pending = shown(pending + data)
+
+
+if __name__ == "__main__":
+    main()
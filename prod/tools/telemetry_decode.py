@@ -0,0 +1,83 @@
+#!/usr/bin/env python3
+# decodes the TELEMETRY_DUMP packets (see lib/Telemetry/Telemetry.h) out of a raw console capture, e.g.
+#   python3 tools/telemetry_decode.py capture.bin          one json object per packet
+#   python3 tools/telemetry_decode.py capture.bin --table  the last packet as a table
+# the capture is the serial port saved byte for byte, log lines and latency packets included.
+import json
+import struct
+import sys
+
+# telemetry_id_t, in order
+IDS = [
+    "i2s_read_timeout", "i2s_read_error", "mic_overrun", "mic_late", "dsp_overrun", "dsp_worst_us",
+    "tx_late", "tx_dropped", "bt_overrun_bytes", "jitter_underrun", "record_dropped", "bt_callback_worst_us",
+    "mic_dropped", "music_late",
+]
+NAME_LEN = 12
+
+
+def packets(data):
+    i = data.find(b"TLMY")
+    while i >= 0:
+        packet = parse(data, i)
+        if packet is not None:
+            yield packet
+        i = data.find(b"TLMY", i + 1)
+
+
+def parse(data, i):
+    try:
+        version, uptime, heap_free, heap_min, heap_largest, psram = struct.unpack_from("<BIIIII", data, i + 4)
+        n = i + 25
+        (id_count,) = struct.unpack_from("<B", data, n)
+        counters = {}
+        for k in range(id_count):
+            count, arg = struct.unpack_from("<II", data, n + 1 + k * 8)
+            counters[IDS[k] if k < len(IDS) else f"id{k}"] = {"count": count, "arg": arg}
+        n += 1 + id_count * 8
+        (task_count,) = struct.unpack_from("<B", data, n)
+        n += 1
+        tasks = []
+        for _ in range(task_count):
+            name = data[n : n + NAME_LEN].split(b"\0")[0].decode("ascii", "replace")
+            stack_free, cpu, priority = struct.unpack_from("<HHB", data, n + NAME_LEN)
+            tasks.append({"name": name, "priority": priority, "stack_free": stack_free, "cpu_pct": cpu / 10})
+            n += NAME_LEN + 5
+        (checksum,) = struct.unpack_from("<H", data, n)
+    except struct.error:
+        return None  # cut off at the end of the capture
+    if version != 1 or sum(data[i:n]) & 0xFFFF != checksum:
+        return None
+    return {
+        "uptime_ms": uptime,
+        "heap": {"free": heap_free, "min_free": heap_min, "largest": heap_largest, "psram_free": psram},
+        "counters": counters,
+        "tasks": tasks,
+    }
+
+
+def table(packet):
+    heap = packet["heap"]
+    print(f"uptime {packet['uptime_ms'] / 1000:.1f} s  heap free {heap['free']} (min {heap['min_free']}, "
+          f"largest {heap['largest']})  psram free {heap['psram_free']}")
+    for task in sorted(packet["tasks"], key=lambda t: -t["priority"]):
+        print(f"  {task['name']:<{NAME_LEN}} prio {task['priority']:2d}  stack free {task['stack_free']:6d}  cpu {task['cpu_pct']:5.1f}%")
+    for name, counter in packet["counters"].items():
+        if counter["count"]:
+            print(f"  {name:<22} {counter['count']:10d}  (last arg {counter['arg']})")
+
+
+def main():
+    with open(sys.argv[1], "rb") as f:
+        data = f.read()
+    decoded = list(packets(data))
+    if "--table" in sys.argv[2:]:
+        if decoded:
+            table(decoded[-1])
+        return
+    for packet in decoded:
+        print(json.dumps(packet))
+
+
+if __name__ == "__main__":
+    main()
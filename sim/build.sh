@@ -0,0 +1,21 @@
+#!/bin/sh
+# builds one firmware variant against the simulator, e.g.
+#   sim/build.sh prod                  -> ./sim_prod
+#   CC=clang CFLAGS=-fsanitize=thread sim/build.sh digital_1b
+# run from the repo root. the firmware is built as is, with ESP_PLATFORM set so it takes its esp-idf paths
+set -e
+variant=${1:?usage: sim/build.sh analog_1a|digital_1b|prod}
+variant=${variant%/}
+[ -d "$variant/src" ] || { echo "no $variant/src here, run from the repo root" >&2; exit 1; }
+
+includes="-Isim/include -I$variant/include"
+for lib in "$variant"/lib/*/; do
+    includes="$includes -I${lib%/}"
+done
+
+# newlib's stdio.h brings the stdint types along and some of the firmware leans on that, glibc's doesn't.
+# _GNU_SOURCE is for the sim's own cpu affinity calls
+${CC:-cc} -std=gnu11 -O2 -g -Wall -DESP_PLATFORM -D_GNU_SOURCE -include stdint.h $includes $CFLAGS \
+    "$variant"/src/*.c "$variant"/lib/*/*.c sim/src/*.c \
+    -o "sim_$variant" -lpthread -lm
+echo "built sim_$variant"
@@ -0,0 +1,18 @@
+#ifndef DRIVER_SDMMC_TYPES_H
+#define DRIVER_SDMMC_TYPES_H
+
+#include <stdint.h>
+
+typedef struct {
+    uint32_t flags;
+    int slot;
+    int max_freq_khz;
+} sdmmc_host_t;
+
+typedef struct {
+    sdmmc_host_t host;
+    uint32_t capacity; // sectors
+    uint32_t sector_size;
+} sdmmc_card_t;
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef ESP_A2DP_API_H
+#define ESP_A2DP_API_H
+
+// a2dp sink fed from --a2dp: after --a2dp-connect ms the "phone" connects, configures sbc at the file's rate and
+// starts streaming --a2dp-packet frames per data callback, each up to --jitter ms late
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_bt_defs.h"
+
+#define ESP_A2D_MCT_SBC 0
+#define ESP_A2D_MCT_M12 1
+#define ESP_A2D_MCT_M24 2
+#define ESP_A2D_MCT_ATRAC 4
+#define ESP_A2D_MCT_NON_A2DP 0xff
+typedef uint8_t esp_a2d_mct_t;
+
+typedef struct {
+    esp_a2d_mct_t type;
+    union {
+        uint8_t sbc[4];
+        uint8_t m12[4];
+        uint8_t m24[6];
+        uint8_t atrac[7];
+    } cie;
+} esp_a2d_mcc_t;
+
+typedef enum {
+    ESP_A2D_CONNECTION_STATE_DISCONNECTED = 0,
+    ESP_A2D_CONNECTION_STATE_CONNECTING,
+    ESP_A2D_CONNECTION_STATE_CONNECTED,
+    ESP_A2D_CONNECTION_STATE_DISCONNECTING,
+} esp_a2d_connection_state_t;
+
+typedef enum {
+    ESP_A2D_AUDIO_STATE_SUSPEND = 0,
+    ESP_A2D_AUDIO_STATE_STARTED,
+    ESP_A2D_AUDIO_STATE_STOPPED = ESP_A2D_AUDIO_STATE_SUSPEND,
+    ESP_A2D_AUDIO_STATE_REMOTE_SUSPEND = ESP_A2D_AUDIO_STATE_SUSPEND,
+} esp_a2d_audio_state_t;
+
+typedef enum {
+    ESP_A2D_CONNECTION_STATE_EVT = 0,
+    ESP_A2D_AUDIO_STATE_EVT,
+    ESP_A2D_AUDIO_CFG_EVT,
+    ESP_A2D_MEDIA_CTRL_ACK_EVT,
+    ESP_A2D_PROF_STATE_EVT,
+} esp_a2d_cb_event_t;
+
+typedef union {
+    struct {
+        esp_a2d_connection_state_t state;
+        esp_bd_addr_t remote_bda;
+    } conn_stat;
+    struct {
+        esp_a2d_audio_state_t state;
+        esp_bd_addr_t remote_bda;
+    } audio_stat;
+    struct {
+        esp_bd_addr_t remote_bda;
+        esp_a2d_mcc_t mcc;
+    } audio_cfg;
+} esp_a2d_cb_param_t;
+
+typedef void (*esp_a2d_cb_t)(esp_a2d_cb_event_t event, esp_a2d_cb_param_t* param);
+typedef void (*esp_a2d_sink_data_cb_t)(const uint8_t* buf, uint32_t len);
+
+esp_err_t esp_a2d_register_callback(esp_a2d_cb_t callback);
+esp_err_t esp_a2d_sink_register_data_callback(esp_a2d_sink_data_cb_t callback);
+esp_err_t esp_a2d_sink_init(void);
+esp_err_t esp_a2d_sink_deinit(void);
+
+#endif
@@ -0,0 +1,144 @@
+#ifndef ESP_AVRC_API_H
+#define ESP_AVRC_API_H
+
+// avrcp with a simulated phone: it connects together with a2dp, offers track and play status notifications,
+// answers metadata with the --a2dp file name and pauses/resumes the stream on passthrough play/pause
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_bt_defs.h"
+
+#define ESP_AVRC_MD_ATTR_TITLE 0x1
+#define ESP_AVRC_MD_ATTR_ARTIST 0x2
+#define ESP_AVRC_MD_ATTR_ALBUM 0x4
+#define ESP_AVRC_MD_ATTR_TRACK_NUM 0x8
+#define ESP_AVRC_MD_ATTR_NUM_TRACKS 0x10
+#define ESP_AVRC_MD_ATTR_GENRE 0x20
+#define ESP_AVRC_MD_ATTR_PLAYING_TIME 0x40
+
+typedef enum {
+    ESP_AVRC_PT_CMD_PLAY = 0x44,
+    ESP_AVRC_PT_CMD_STOP = 0x45,
+    ESP_AVRC_PT_CMD_PAUSE = 0x46,
+    ESP_AVRC_PT_CMD_FORWARD = 0x4B,
+    ESP_AVRC_PT_CMD_BACKWARD = 0x4C,
+} esp_avrc_pt_cmd_t;
+
+typedef enum { ESP_AVRC_PT_CMD_STATE_PRESSED = 0, ESP_AVRC_PT_CMD_STATE_RELEASED = 1 } esp_avrc_pt_cmd_state_t;
+
+typedef enum {
+    ESP_AVRC_RN_PLAY_STATUS_CHANGE = 0x01,
+    ESP_AVRC_RN_TRACK_CHANGE = 0x02,
+    ESP_AVRC_RN_TRACK_REACHED_END = 0x03,
+    ESP_AVRC_RN_TRACK_REACHED_START = 0x04,
+    ESP_AVRC_RN_PLAY_POS_CHANGED = 0x05,
+    ESP_AVRC_RN_BATTERY_STATUS_CHANGE = 0x06,
+    ESP_AVRC_RN_SYSTEM_STATUS_CHANGE = 0x07,
+    ESP_AVRC_RN_APP_SETTING_CHANGE = 0x08,
+    ESP_AVRC_RN_NOW_PLAYING_CHANGE = 0x09,
+    ESP_AVRC_RN_AVAILABLE_PLAYERS_CHANGE = 0x0a,
+    ESP_AVRC_RN_ADDRESSED_PLAYER_CHANGE = 0x0b,
+    ESP_AVRC_RN_UIDS_CHANGE = 0x0c,
+    ESP_AVRC_RN_VOLUME_CHANGE = 0x0d,
+    ESP_AVRC_RN_MAX_EVT,
+} esp_avrc_rn_event_ids_t;
+
+typedef enum {
+    ESP_AVRC_PLAYBACK_STOPPED = 0,
+    ESP_AVRC_PLAYBACK_PLAYING = 1,
+    ESP_AVRC_PLAYBACK_PAUSED = 2,
+    ESP_AVRC_PLAYBACK_FWD_SEEK = 3,
+    ESP_AVRC_PLAYBACK_REV_SEEK = 4,
+    ESP_AVRC_PLAYBACK_ERROR = 0xFF,
+} esp_avrc_playback_stat_t;
+
+typedef enum { ESP_AVRC_BIT_MASK_OP_TEST = 0, ESP_AVRC_BIT_MASK_OP_SET = 1, ESP_AVRC_BIT_MASK_OP_CLEAR = 2 } esp_avrc_bit_mask_op_t;
+typedef enum { ESP_AVRC_RN_RSP_INTERIM = 13, ESP_AVRC_RN_RSP_CHANGED = 15 } esp_avrc_rn_rsp_t;
+
+typedef struct {
+    uint16_t bits;
+} esp_avrc_rn_evt_cap_mask_t;
+
+typedef union {
+    uint8_t volume;
+    esp_avrc_playback_stat_t playback;
+    uint8_t elm_id[8];
+    uint32_t play_pos;
+} esp_avrc_rn_param_t;
+
+typedef enum {
+    ESP_AVRC_CT_CONNECTION_STATE_EVT = 0,
+    ESP_AVRC_CT_PASSTHROUGH_RSP_EVT = 1,
+    ESP_AVRC_CT_METADATA_RSP_EVT = 2,
+    ESP_AVRC_CT_PLAY_STATUS_RSP_EVT = 3,
+    ESP_AVRC_CT_CHANGE_NOTIFY_EVT = 4,
+    ESP_AVRC_CT_REMOTE_FEATURES_EVT = 5,
+    ESP_AVRC_CT_GET_RN_CAPABILITIES_RSP_EVT = 6,
+    ESP_AVRC_CT_SET_ABSOLUTE_VOLUME_RSP_EVT = 7,
+} esp_avrc_ct_cb_event_t;
+
+typedef union {
+    struct {
+        bool connected;
+        esp_bd_addr_t remote_bda;
+    } conn_stat;
+    struct {
+        uint8_t tl;
+        uint8_t key_code;
+        uint8_t key_state;
+        uint8_t rsp_code;
+    } psth_rsp;
+    struct {
+        uint8_t attr_id;
+        uint8_t* attr_text;
+        int attr_length;
+    } meta_rsp;
+    struct {
+        uint8_t event_id;
+        esp_avrc_rn_param_t event_parameter;
+    } change_ntf;
+    struct {
+        uint8_t cap_count;
+        esp_avrc_rn_evt_cap_mask_t evt_set;
+    } get_rn_caps_rsp;
+} esp_avrc_ct_cb_param_t;
+
+typedef enum {
+    ESP_AVRC_TG_CONNECTION_STATE_EVT = 0,
+    ESP_AVRC_TG_REMOTE_FEATURES_EVT = 1,
+    ESP_AVRC_TG_PASSTHROUGH_CMD_EVT = 2,
+    ESP_AVRC_TG_SET_ABSOLUTE_VOLUME_CMD_EVT = 4,
+    ESP_AVRC_TG_REGISTER_NOTIFICATION_EVT = 5,
+    ESP_AVRC_TG_SET_PLAYER_APP_VALUE_EVT = 6,
+} esp_avrc_tg_cb_event_t;
+
+typedef union {
+    struct {
+        bool connected;
+        esp_bd_addr_t remote_bda;
+    } conn_stat;
+    struct {
+        uint8_t volume;
+    } set_abs_vol;
+    struct {
+        uint8_t event_id;
+        uint32_t event_parameter;
+    } reg_ntf;
+} esp_avrc_tg_cb_param_t;
+
+typedef void (*esp_avrc_ct_cb_t)(esp_avrc_ct_cb_event_t event, esp_avrc_ct_cb_param_t* param);
+typedef void (*esp_avrc_tg_cb_t)(esp_avrc_tg_cb_event_t event, esp_avrc_tg_cb_param_t* param);
+
+esp_err_t esp_avrc_ct_register_callback(esp_avrc_ct_cb_t callback);
+esp_err_t esp_avrc_ct_init(void);
+esp_err_t esp_avrc_tg_register_callback(esp_avrc_tg_cb_t callback);
+esp_err_t esp_avrc_tg_init(void);
+bool esp_avrc_rn_evt_bit_mask_operation(esp_avrc_bit_mask_op_t op, esp_avrc_rn_evt_cap_mask_t* events, esp_avrc_rn_event_ids_t event_id);
+esp_err_t esp_avrc_tg_set_rn_evt_cap(const esp_avrc_rn_evt_cap_mask_t* evt_set);
+esp_err_t esp_avrc_ct_send_get_rn_capabilities_cmd(uint8_t tl);
+esp_err_t esp_avrc_ct_send_register_notification_cmd(uint8_t tl, uint8_t event_id, uint32_t event_parameter);
+esp_err_t esp_avrc_ct_send_metadata_cmd(uint8_t tl, uint8_t attr_mask);
+esp_err_t esp_avrc_ct_send_passthrough_cmd(uint8_t tl, uint8_t key_code, uint8_t key_state);
+esp_err_t esp_avrc_tg_send_rn_rsp(esp_avrc_rn_event_ids_t event_id, esp_avrc_rn_rsp_t rsp, esp_avrc_rn_param_t* param);
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef ESP_BT_H
+#define ESP_BT_H
+
+// the controller is a no-op, the simulated host stack behind esp_bluedroid_enable does the work
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_bt_defs.h"
+
+typedef enum {
+    ESP_BT_MODE_IDLE = 0,
+    ESP_BT_MODE_BLE = 1,
+    ESP_BT_MODE_CLASSIC_BT = 2,
+    ESP_BT_MODE_BTDM = 3,
+} esp_bt_mode_t;
+
+typedef struct {
+    uint16_t controller_task_stack_size;
+    uint8_t controller_task_prio;
+    uint8_t mode;
+} esp_bt_controller_config_t;
+
+#define BT_CONTROLLER_INIT_CONFIG_DEFAULT() { .controller_task_stack_size = 4096, .controller_task_prio = 23, .mode = ESP_BT_MODE_BTDM }
+
+esp_err_t esp_bt_controller_mem_release(esp_bt_mode_t mode);
+esp_err_t esp_bt_controller_init(esp_bt_controller_config_t* cfg);
+esp_err_t esp_bt_controller_enable(esp_bt_mode_t mode);
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef ESP_BT_DEVICE_H
+#define ESP_BT_DEVICE_H
+
+#include "esp_bt_defs.h"
+
+const uint8_t* esp_bt_dev_get_address(void);
+
+#endif
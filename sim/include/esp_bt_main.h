@@ -0,0 +1,10 @@
+#ifndef ESP_BT_MAIN_H
+#define ESP_BT_MAIN_H
+
+#include "esp_err.h"
+
+// starts the simulated bluedroid task. profile callbacks all run on it, like the real BTC_TASK
+esp_err_t esp_bluedroid_init(void);
+esp_err_t esp_bluedroid_enable(void);
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef ESP_TIMER_H
+#define ESP_TIMER_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+// microseconds of simulated time since boot. runs --speed times faster than the wall clock
+int64_t esp_timer_get_time(void);
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef ESP_VFS_FAT_H
+#define ESP_VFS_FAT_H
+
+// the "card" is the --sd directory: once mounted, paths under the mount point are redirected into it.
+// without --sd the mount fails like a missing card
+#include <stdio.h>
+#include <stdbool.h>
+#include <sys/stat.h>
+#include "esp_err.h"
+#include "driver/sdmmc_types.h"
+#include "driver/sdspi_host.h"
+
+typedef struct {
+    bool format_if_mount_failed;
+    int max_files;
+    size_t allocation_unit_size;
+    bool disk_status_check_enable;
+} esp_vfs_fat_mount_config_t;
+typedef esp_vfs_fat_mount_config_t esp_vfs_fat_sdmmc_mount_config_t;
+
+esp_err_t esp_vfs_fat_sdspi_mount(const char* base_path, const sdmmc_host_t* host_config_input, const sdspi_device_config_t* slot_config,
+                                  const esp_vfs_fat_mount_config_t* mount_config, sdmmc_card_t** out_card);
+esp_err_t esp_vfs_fat_sdcard_unmount(const char* base_path, sdmmc_card_t* card);
+
+FILE* sim_vfs_fopen(const char* path, const char* mode);
+int sim_vfs_stat(const char* path, struct stat* st);
+int sim_vfs_remove(const char* path);
+#define fopen(path, mode) sim_vfs_fopen(path, mode)
+#define stat(path, st) sim_vfs_stat(path, st)
+#define remove(path) sim_vfs_remove(path)
+
+#endif
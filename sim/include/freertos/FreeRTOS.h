@@ -0,0 +1,40 @@
+#ifndef FREERTOS_H
+#define FREERTOS_H
+
+// freertos on posix threads. tasks are threads, priorities and core pinning are recorded but the host scheduler
+// decides who runs. time is the simulated clock (see esp_timer.h), so ticks pass --speed times faster
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "sdkconfig.h"
+#include "esp_attr.h"
+#include "esp_err.h"
+#include "freertos/FreeRTOSConfig.h"
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+typedef uint8_t StackType_t; // esp-idf counts stacks in bytes
+
+#define pdFALSE ((BaseType_t)0)
+#define pdTRUE ((BaseType_t)1)
+#define pdPASS pdTRUE
+#define pdFAIL pdFALSE
+#define errQUEUE_EMPTY ((BaseType_t)0)
+#define errQUEUE_FULL ((BaseType_t)0)
+
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#define portTICK_PERIOD_MS ((TickType_t)1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms) ((TickType_t)(((TickType_t)(ms) * (TickType_t)configTICK_RATE_HZ) / (TickType_t)1000U))
+#define pdTICKS_TO_MS(ticks) ((TickType_t)(((uint64_t)(ticks) * 1000U) / configTICK_RATE_HZ))
+#define portNUM_PROCESSORS configNUMBER_OF_CORES
+#define tskNO_AFFINITY ((BaseType_t)0x7FFFFFFF)
+
+// an "isr" here is one of the simulated dma threads, it may call the FromISR functions. there is no preemption to ask for
+#define portYIELD_FROM_ISR(...) ((void)0)
+#define portYIELD() sched_yield()
+#define taskYIELD() sched_yield()
+#include <sched.h>
+
+#endif
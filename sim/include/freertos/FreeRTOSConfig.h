@@ -0,0 +1,14 @@
+#ifndef FREERTOS_CONFIG_H
+#define FREERTOS_CONFIG_H
+
+#include "sdkconfig.h"
+
+#define configTICK_RATE_HZ CONFIG_FREERTOS_HZ
+#define configMAX_PRIORITIES 25
+#define configMAX_TASK_NAME_LEN 16
+#define configMINIMAL_STACK_SIZE 768
+#define configUSE_TRACE_FACILITY CONFIG_FREERTOS_USE_TRACE_FACILITY
+#define configGENERATE_RUN_TIME_STATS CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+#define configNUMBER_OF_CORES 2
+
+#endif
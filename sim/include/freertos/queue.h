@@ -0,0 +1,25 @@
+#ifndef FREERTOS_QUEUE_H
+#define FREERTOS_QUEUE_H
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct QueueDefinition* QueueHandle_t;
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size);
+void vQueueDelete(QueueHandle_t queue);
+BaseType_t xQueueGenericSend(QueueHandle_t queue, const void* item, TickType_t ticks, BaseType_t to_front);
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t ticks);
+BaseType_t xQueuePeek(QueueHandle_t queue, void* item, TickType_t ticks);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue);
+BaseType_t xQueueReset(QueueHandle_t queue);
+
+#define xQueueSend(queue, item, ticks) xQueueGenericSend((queue), (item), (ticks), pdFALSE)
+#define xQueueSendToBack(queue, item, ticks) xQueueGenericSend((queue), (item), (ticks), pdFALSE)
+#define xQueueSendToFront(queue, item, ticks) xQueueGenericSend((queue), (item), (ticks), pdTRUE)
+#define xQueueSendFromISR(queue, item, woken) \
+    (((woken) != NULL ? (void)(*(BaseType_t*)(woken) = pdFALSE) : (void)0), xQueueGenericSend((queue), (item), 0, pdFALSE))
+#define xQueueReceiveFromISR(queue, item, woken) \
+    (((woken) != NULL ? (void)(*(BaseType_t*)(woken) = pdFALSE) : (void)0), xQueueReceive((queue), (item), 0))
+
+#endif
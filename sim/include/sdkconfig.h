@@ -0,0 +1,16 @@
+#ifndef SDKCONFIG_H
+#define SDKCONFIG_H
+
+// the defaults of a dual core esp32 with bluedroid, as far as the firmware looks at them
+#define CONFIG_IDF_TARGET_ESP32 1
+#define CONFIG_FREERTOS_HZ 100
+#define CONFIG_FREERTOS_UNICORE 0
+#define CONFIG_FREERTOS_USE_TRACE_FACILITY 1
+#define CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS 1
+#define CONFIG_BT_ENABLED 1
+#define CONFIG_BT_BLUEDROID_ENABLED 1
+#define CONFIG_BT_BLUEDROID_PINNED_TO_CORE 0
+#define CONFIG_ESP_MAIN_TASK_STACK_SIZE 3584
+#define CONFIG_LOG_DEFAULT_LEVEL 3
+
+#endif
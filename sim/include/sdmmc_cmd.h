@@ -0,0 +1,10 @@
+#ifndef SDMMC_CMD_H
+#define SDMMC_CMD_H
+
+#include <stdio.h>
+#include "esp_err.h"
+#include "driver/sdmmc_types.h"
+
+void sdmmc_card_print_info(FILE* stream, const sdmmc_card_t* card);
+
+#endif
@@ -0,0 +1,72 @@
+#!/bin/sh
+# the host tests and all three sims under the sanitizers, once built with asan+ubsan and once with tsan, e.g.
+#   sim/soak.sh                      every test, then each sim for 30 simulated seconds
+#   SOAK_SECONDS=300 sim/soak.sh     a longer soak of the sims
+# the sims run at --speed 1 on generated inputs: prod with the mic, an a2dp stream with jitter and drift, a recording
+# to a card and an rx stall, digital_1b with the mic and analog_1a with the line in. run from the repo root. exits 1
+# if anything failed or a sanitizer said anything, the findings are printed
+set -e
+[ -d sim/test ] || { echo "no sim/test here, run from the repo root" >&2; exit 1; }
+seconds=${SOAK_SECONDS:-30}
+
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+mkdir "$work/card"
+
+# a sung-ish mic (a vibrato tone over a little noise), a stereo song and a line in, each as long as the run
+python3 - "$work" "$seconds" <<'EOF'
+import math, random, struct, sys, wave
+work, seconds = sys.argv[1], int(sys.argv[2])
+def write(name, rate, channels, sample):
+    with wave.open(f"{work}/{name}", "wb") as w:
+        w.setnchannels(channels)
+        w.setsampwidth(2)
+        w.setframerate(rate)
+        w.writeframes(b"".join(struct.pack("<h", max(-32768, min(32767, int(v))))
+                               for n in range(rate * seconds) for v in sample(n / rate)))
+random.seed(1)
+write("mic.wav", 44100, 1, lambda t: [8000 * math.sin(2 * math.pi * (220 * t + 3 * math.sin(2 * math.pi * 5 * t))) +
+                                      random.gauss(0, 300)])
+write("song.wav", 44100, 2, lambda t: [6000 * math.sin(2 * math.pi * 330 * t), 6000 * math.sin(2 * math.pi * 440 * t)])
+write("line.wav", 32000, 1, lambda t: [12000 * math.sin(2 * math.pi * 1000 * t)])
+EOF
+
+prod_args="--mic $work/mic.wav --a2dp $work/song.wav --jitter 10 --drift 50 --sd $work/card --psram 4194304
+    --press 27@$((seconds / 3)) --press 27@$((seconds * 2 / 3)) --rx-stall $((seconds / 2)):200
+    --nvs tune.frame=u16:256 --nvs tune.count=u8:8"
+digital_1b_args="--mic $work/mic.wav"
+analog_1a_args="--adc $work/line.wav"
+
+failed=0
+for sanitizer in asan tsan; do
+    case $sanitizer in
+        asan) flags="-fsanitize=address,undefined -fno-sanitize-recover=all -O1" ;;
+        tsan) flags="-fsanitize=thread -O1" ;;
+    esac
+    log=$work/$sanitizer.log
+    echo "$sanitizer: tests"
+    if ! CFLAGS="$flags" sim/test.sh >"$log" 2>&1; then
+        grep -B 4 "FAILED" "$log" >&2
+        echo "$sanitizer: tests FAILED" >&2
+        failed=1
+    fi
+    for variant in prod digital_1b analog_1a; do
+        echo "$sanitizer: sim_$variant for $seconds s"
+        eval "args=\$${variant}_args"
+        if ! CFLAGS="$flags" sim/build.sh $variant >>"$log" 2>&1; then
+            echo "$sanitizer: sim_$variant failed to build" >&2
+            failed=1
+            continue
+        fi
+        ./sim_$variant --seconds $seconds --speed 1 --out "$work/out.wav" $args >>"$log" 2>&1 ||
+            { echo "$sanitizer: sim_$variant FAILED" >&2; failed=1; }
+    done
+    if grep -q -e "runtime error" -e "ERROR: AddressSanitizer" -e "WARNING: ThreadSanitizer" "$log"; then
+        grep -A 20 -e "runtime error" -e "ERROR: AddressSanitizer" -e "WARNING: ThreadSanitizer" "$log" >&2
+        echo "$sanitizer: findings above" >&2
+        failed=1
+    fi
+done
+rm -f sim_prod sim_digital_1b sim_analog_1a # sanitized builds, not what sim/build.sh would leave
+[ $failed -eq 0 ] && echo "soak: ok"
+exit $failed
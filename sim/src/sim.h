@@ -0,0 +1,149 @@
+#ifndef SIM_H
+#define SIM_H
+
+// shared between the simulator's sources. the firmware only ever sees the esp-idf headers in sim/include
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <time.h>
+#include <pthread.h>
+
+#define SIM_MAX_PRESSES 16
+#define SIM_PRESS_US 200000 // how long a --press holds the button down
+#define SIM_MAX_RX_STALLS 16
+#define SIM_MAX_NVS_PRESETS 16
+#define SIM_MAX_PREEMPTS 16
+
+typedef struct {
+    char ns[16];
+    char key[16];
+    char type[4]; // u8, u16, u32 or i32
+    int64_t value;
+} sim_nvs_preset_t;
+
+typedef struct {
+    double speed; // simulated seconds per wall clock second
+    double seconds; // simulated run time
+    double warmup; // simulated seconds not counted by --strict
+    bool strict; // exit 1 on any overrun or underrun after the warmup
+    bool pin; // pin tasks created on a core to a host cpu
+    const char* mic_path; // i2s rx source
+    const char* out_path; // i2s tx capture
+    const char* adc_path; // adc continuous source
+    const char* a2dp_path; // a2dp source, wav or raw s16le stereo
+    uint32_t a2dp_rate; // raw a2dp files only
+    uint32_t a2dp_packet; // stereo frames per data callback
+    double a2dp_connect_ms;
+    double jitter_ms; // each packet comes up to this much after its due time
+    double drift_ppm; // phone clock against ours, positive sends faster
+    int spp_port; // 0: no spp client can connect
+    const char* sd_dir; // NULL: no card
+    size_t psram_bytes;
+    struct {
+        int gpio;
+        int64_t at_us;
+    } presses[SIM_MAX_PRESSES];
+    int press_count;
+    struct {
+        int64_t at_us;
+        int64_t len_us;
+    } rx_stalls[SIM_MAX_RX_STALLS]; // the i2s rx dma stops, like a mic losing its clock
+    int rx_stall_count;
+    struct {
+        char task[16];
+        int64_t at_us;
+        int64_t len_us;
+        bool done; // only touched by the task's own thread
+    } preempts[SIM_MAX_PREEMPTS]; // the task's first wake-up after at_us comes len_us late, as if something had the cpu
+    int preempt_count;
+    sim_nvs_preset_t nvs_presets[SIM_MAX_NVS_PRESETS]; // in nvs from the first nvs_flash_init, as a previous boot left them
+    int nvs_preset_count;
+} sim_config_t;
+
+extern sim_config_t sim_config;
+
+// simulated time runs sim_config.speed times faster than the wall clock from sim_clock_start on
+void sim_clock_start(void);
+int64_t sim_now_us(void);
+int64_t sim_wall_us(void); // wall clock since sim_clock_start
+struct timespec sim_deadline(int64_t sim_us); // CLOCK_MONOTONIC time at which the simulated clock reads sim_us
+void sim_sleep_until(int64_t sim_us);
+
+// condition variables on CLOCK_MONOTONIC. deadline NULL waits forever, returns false on timeout
+void sim_cond_init(pthread_cond_t* cond);
+bool sim_cond_wait(pthread_cond_t* cond, pthread_mutex_t* lock, const struct timespec* deadline);
+
+// wav files, 16 bit pcm only. readers loop back to the start at the end of the data
+typedef struct {
+    FILE* file;
+    uint16_t channels;
+    uint16_t bits;
+    uint32_t rate;
+    long data_start;
+    uint32_t data_bytes;
+    uint32_t pos; // bytes into the data, reader
+    bool created; // by sim_wav_create, the header is rewritten on close
+} sim_wav_t;
+
+// a file without a RIFF header is taken as raw s16le with raw_channels at raw_rate
+bool sim_wav_open(sim_wav_t* wav, const char* path, uint32_t raw_rate, uint16_t raw_channels);
+// reads frames (wav->channels samples each), wrapping around. an empty file reads as silence
+void sim_wav_read(sim_wav_t* wav, int16_t* out, size_t frames);
+bool sim_wav_create(sim_wav_t* wav, const char* path, uint16_t channels, uint16_t bits, uint32_t rate);
+void sim_wav_write(sim_wav_t* wav, const void* data, size_t bytes);
+void sim_wav_close(sim_wav_t* wav); // rewrites the header of a created file
+
+// sd card as a block device over a host file, see sim_sd.c
+#define SIM_SD_SECTOR 512
+
+typedef struct {
+    int64_t write_us; // per write command
+    uint32_t bytes_per_ms; // sustained rate after it, 0 instant
+    uint32_t stall_every; // every n'th write the card also stops for stall_us to erase, 0 never
+    int64_t stall_us;
+    uint64_t capacity; // bytes, writes past it come back short. 0 no limit
+    void (*wait)(int64_t us); // called with each write's time, NULL only counts it
+} sim_sd_timing_t;
+
+typedef struct {
+    uint64_t writes;
+    uint64_t bytes;
+    uint64_t unaligned; // writes not starting on a sector or not whole sectors, a read-modify-write on a card
+    uint64_t largest;
+    int64_t busy_us; // card time charged
+    int64_t worst_us; // longest single write
+} sim_sd_stats_t;
+
+// fopen's modes. timing NULL is an instant card, stats NULL keeps no count
+FILE* sim_sd_open(const char* path, const char* mode, const sim_sd_timing_t* timing, sim_sd_stats_t* stats);
+void sim_sd_stats_copy(sim_sd_stats_t* out, const sim_sd_stats_t* stats); // while files may still be writing
+void sim_sd_report(FILE* out); // the --sd card's writes, if there were any
+
+// device counters for the report and --strict
+typedef struct {
+    uint32_t rx_buffers;
+    uint32_t rx_overruns; // filled buffers the driver dropped because nobody read them in time
+    uint32_t rx_stalled; // buffer periods an --rx-stall skipped
+    uint32_t tx_buffers;
+    uint32_t tx_underruns; // buffers played again without a new i2s_channel_write since their last turn
+    uint32_t tx_torn; // buffers that changed while the dma was playing them, written too late
+    uint32_t adc_frames;
+    uint32_t adc_overflows; // conversion frames dropped with the pool full
+    uint32_t a2dp_packets;
+    uint64_t a2dp_bytes;
+    int64_t dma_late_worst_us; // simulated time a dma thread woke after its buffer was due
+    int64_t a2dp_late_worst_us; // beyond the injected jitter
+} sim_stats_t;
+
+void sim_stats(sim_stats_t* stats);
+void sim_i2s_stats(sim_stats_t* stats);
+void sim_adc_stats(sim_stats_t* stats);
+void sim_bt_stats(sim_stats_t* stats);
+void sim_dma_late(int64_t late_us);
+
+void sim_i2s_finish(void); // closes the tx capture
+void sim_task_report(FILE* out);
+void sim_run_app_main(void);
+
+#endif
@@ -0,0 +1,183 @@
+#include <string.h>
+#include <stdatomic.h>
+#include "sim.h"
+#include "esp_adc/adc_continuous.h"
+
+static _Atomic uint32_t adc_frames, adc_overflows;
+
+struct adc_continuous_ctx_t {
+    uint32_t pool_bytes;
+    uint32_t frame_bytes;
+    bool flush_pool; // drop the oldest frame instead of the new one when full
+    uint32_t rate;
+    uint32_t pattern_num;
+    adc_digi_pattern_config_t pattern[SOC_ADC_PATT_LEN_MAX];
+    bool configured;
+    sim_wav_t wav;
+    pthread_t dma;
+    _Atomic bool running;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    uint8_t* pool; // ring of pool_bytes
+    uint32_t head, count;
+};
+
+static void pool_drop(adc_continuous_handle_t adc, uint32_t n) {
+    adc->head = (adc->head + n) % adc->pool_bytes;
+    adc->count -= n;
+}
+
+static void pool_put(adc_continuous_handle_t adc, const uint8_t* src, uint32_t n) {
+    uint32_t tail = (adc->head + adc->count) % adc->pool_bytes;
+    uint32_t first = adc->pool_bytes - tail;
+    if (first > n) first = n;
+    memcpy(adc->pool + tail, src, first);
+    memcpy(adc->pool, src + first, n - first);
+    adc->count += n;
+}
+
+// one conversion frame: pattern entry p is channel p of the file, every full pattern pass reads the next file frame
+static void convert(adc_continuous_handle_t adc, uint8_t* out, uint32_t* pattern_pos, int16_t* frame) {
+    uint32_t channels = (adc->wav.file != NULL) ? adc->wav.channels : 1;
+    for (uint32_t i = 0; i + SOC_ADC_DIGI_RESULT_BYTES <= adc->frame_bytes; i += SOC_ADC_DIGI_RESULT_BYTES) {
+        uint32_t p = *pattern_pos;
+        if (p == 0) {
+            if (adc->wav.file != NULL) sim_wav_read(&adc->wav, frame, 1);
+            else memset(frame, 0, sizeof(int16_t));
+        }
+        adc_digi_output_data_t d = { 0 };
+        d.type1.channel = adc->pattern[p].channel & 0xf;
+        d.type1.data = (uint16_t)((frame[p % channels] + 32768) >> 4); // idles at mid-scale like the biased input
+        out[i] = (uint8_t)d.val;
+        out[i + 1] = (uint8_t)(d.val >> 8);
+        *pattern_pos = (p + 1) % adc->pattern_num;
+    }
+}
+
+static void* dma_thread(void* arg) {
+    adc_continuous_handle_t adc = arg;
+    uint8_t* frame = malloc(adc->frame_bytes);
+    int16_t wav_frame[16] = { 0 }; // enough for any sane channel count
+    uint32_t pattern_pos = 0;
+    uint32_t conversions = adc->frame_bytes / SOC_ADC_DIGI_RESULT_BYTES;
+    int64_t start = sim_now_us();
+    for (uint64_t k = 1; atomic_load(&adc->running); k++) {
+        int64_t due = start + (int64_t)(k * conversions * 1000000ULL / adc->rate);
+        sim_sleep_until(due);
+        if (!atomic_load(&adc->running)) break;
+        sim_dma_late(sim_now_us() - due);
+        convert(adc, frame, &pattern_pos, wav_frame);
+
+        pthread_mutex_lock(&adc->lock);
+        if (adc->count + adc->frame_bytes > adc->pool_bytes) {
+            atomic_fetch_add(&adc_overflows, 1);
+            if (adc->flush_pool) pool_drop(adc, adc->frame_bytes);
+        }
+        if (adc->count + adc->frame_bytes <= adc->pool_bytes) pool_put(adc, frame, adc->frame_bytes);
+        atomic_fetch_add(&adc_frames, 1);
+        pthread_cond_broadcast(&adc->changed);
+        pthread_mutex_unlock(&adc->lock);
+    }
+    free(frame);
+    return NULL;
+}
+
+esp_err_t adc_continuous_new_handle(const adc_continuous_handle_cfg_t* hdl_config, adc_continuous_handle_t* ret_handle) {
+    if (hdl_config == NULL || ret_handle == NULL || hdl_config->conv_frame_size == 0
+        || hdl_config->conv_frame_size % SOC_ADC_DIGI_DATA_BYTES_PER_CONV != 0
+        || hdl_config->max_store_buf_size < hdl_config->conv_frame_size) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    adc_continuous_handle_t adc = calloc(1, sizeof(*adc));
+    if (adc == NULL) return ESP_ERR_NO_MEM;
+    adc->pool_bytes = hdl_config->max_store_buf_size;
+    adc->frame_bytes = hdl_config->conv_frame_size;
+    adc->flush_pool = hdl_config->flags.flush_pool;
+    adc->pool = malloc(adc->pool_bytes);
+    if (adc->pool == NULL) {
+        free(adc);
+        return ESP_ERR_NO_MEM;
+    }
+    pthread_mutex_init(&adc->lock, NULL);
+    sim_cond_init(&adc->changed);
+    *ret_handle = adc;
+    return ESP_OK;
+}
+
+esp_err_t adc_continuous_config(adc_continuous_handle_t adc, const adc_continuous_config_t* config) {
+    if (atomic_load(&adc->running)) return ESP_ERR_INVALID_STATE;
+    if (config->pattern_num == 0 || config->pattern_num > SOC_ADC_PATT_LEN_MAX || config->adc_pattern == NULL
+        || config->sample_freq_hz < SOC_ADC_SAMPLE_FREQ_THRES_LOW || config->sample_freq_hz > SOC_ADC_SAMPLE_FREQ_THRES_HIGH
+        || config->format != ADC_DIGI_OUTPUT_FORMAT_TYPE1) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    adc->rate = config->sample_freq_hz;
+    adc->pattern_num = config->pattern_num;
+    memcpy(adc->pattern, config->adc_pattern, config->pattern_num * sizeof(adc_digi_pattern_config_t));
+    adc->configured = true;
+    return ESP_OK;
+}
+
+esp_err_t adc_continuous_start(adc_continuous_handle_t adc) {
+    if (!adc->configured || atomic_load(&adc->running)) return ESP_ERR_INVALID_STATE;
+    if (adc->wav.file == NULL && sim_config.adc_path != NULL) {
+        sim_wav_open(&adc->wav, sim_config.adc_path, adc->rate / adc->pattern_num, 1);
+        if (adc->wav.file != NULL && adc->wav.channels > 16) sim_wav_close(&adc->wav);
+    }
+    atomic_store(&adc->running, true);
+    if (pthread_create(&adc->dma, NULL, dma_thread, adc) != 0) return ESP_FAIL;
+    return ESP_OK;
+}
+
+esp_err_t adc_continuous_stop(adc_continuous_handle_t adc) {
+    if (!atomic_load(&adc->running)) return ESP_ERR_INVALID_STATE;
+    atomic_store(&adc->running, false);
+    pthread_join(adc->dma, NULL);
+    return ESP_OK;
+}
+
+esp_err_t adc_continuous_read(adc_continuous_handle_t adc, uint8_t* buf, uint32_t length_max, uint32_t* out_length, uint32_t timeout_ms) {
+    struct timespec ts;
+    if (timeout_ms != ADC_MAX_DELAY) ts = sim_deadline(sim_now_us() + (int64_t)timeout_ms * 1000);
+    pthread_mutex_lock(&adc->lock);
+    while (adc->count == 0) {
+        if (!sim_cond_wait(&adc->changed, &adc->lock, (timeout_ms != ADC_MAX_DELAY) ? &ts : NULL) && adc->count == 0) {
+            pthread_mutex_unlock(&adc->lock);
+            *out_length = 0;
+            return ESP_ERR_TIMEOUT;
+        }
+    }
+    // same as the driver: whatever is there up to length_max, in whole results
+    uint32_t n = (adc->count < length_max) ? adc->count : length_max;
+    n -= n % SOC_ADC_DIGI_RESULT_BYTES;
+    uint32_t first = adc->pool_bytes - adc->head;
+    if (first > n) first = n;
+    memcpy(buf, adc->pool + adc->head, first);
+    memcpy(buf + first, adc->pool, n - first);
+    pool_drop(adc, n);
+    pthread_mutex_unlock(&adc->lock);
+    *out_length = n;
+    return ESP_OK;
+}
+
+esp_err_t adc_continuous_flush_pool(adc_continuous_handle_t adc) {
+    pthread_mutex_lock(&adc->lock);
+    adc->head = adc->count = 0;
+    pthread_mutex_unlock(&adc->lock);
+    return ESP_OK;
+}
+
+esp_err_t adc_continuous_deinit(adc_continuous_handle_t adc) {
+    if (atomic_load(&adc->running)) return ESP_ERR_INVALID_STATE;
+    sim_wav_close(&adc->wav);
+    pthread_mutex_destroy(&adc->lock);
+    pthread_cond_destroy(&adc->changed);
+    free(adc->pool);
+    free(adc);
+    return ESP_OK;
+}
+
+void sim_adc_stats(sim_stats_t* stats) {
+    stats->adc_frames = atomic_load(&adc_frames);
+    stats->adc_overflows = atomic_load(&adc_overflows);
+}
@@ -0,0 +1,431 @@
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include "sim.h"
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_bt.h"
+#include "esp_bt_main.h"
+#include "esp_bt_device.h"
+#include "esp_gap_bt_api.h"
+#include "esp_a2dp_api.h"
+#include "esp_avrc_api.h"
+#include "esp_spp_api.h"
+
+#define SPP_HANDLE 0x81
+#define SPP_MTU 990 // what a phone's rfcomm usually settles on
+#define POLL_US 5000 // spp and connect checks between packets, simulated
+
+static const esp_bd_addr_t phone = { 0x02, 0x51, 0x4d, 0x00, 0x00, 0x01 };
+
+static esp_bt_gap_cb_t gap_cb;
+static esp_a2d_cb_t a2d_cb;
+static esp_a2d_sink_data_cb_t a2d_data_cb;
+static esp_avrc_ct_cb_t ct_cb;
+static esp_avrc_tg_cb_t tg_cb;
+static esp_spp_cb_t spp_cb;
+
+static _Atomic uint32_t a2dp_packets;
+static _Atomic uint64_t a2dp_bytes;
+static _Atomic int64_t a2dp_late_worst;
+
+// api calls from any task are queued and answered on the bluedroid task, like the real btc message queue
+typedef enum {
+    CMD_SPP_INIT,
+    CMD_SPP_START,
+    CMD_CAPS,
+    CMD_REGISTER,
+    CMD_METADATA,
+    CMD_PASSTHROUGH,
+} cmd_kind_t;
+
+typedef struct {
+    cmd_kind_t kind;
+    uint8_t a, b;
+} cmd_t;
+
+#define CMD_QUEUE_LEN 32
+static pthread_mutex_t cmd_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cmd_cond;
+static cmd_t cmd_queue[CMD_QUEUE_LEN];
+static uint32_t cmd_head, cmd_count;
+static bool sink_ready = false;
+static int64_t connect_at = -1; // simulated us, set by esp_a2d_sink_init
+
+static int spp_listen_fd = -1;
+static _Atomic int spp_client_fd = -1;
+
+static esp_err_t post(cmd_kind_t kind, uint8_t a, uint8_t b) {
+    esp_err_t ret = ESP_OK;
+    pthread_mutex_lock(&cmd_lock);
+    if (cmd_count == CMD_QUEUE_LEN) {
+        ret = ESP_FAIL; // the real api fails the same way when btc's queue is full
+    } else {
+        cmd_queue[(cmd_head + cmd_count++) % CMD_QUEUE_LEN] = (cmd_t){ kind, a, b };
+        pthread_cond_signal(&cmd_cond);
+    }
+    pthread_mutex_unlock(&cmd_lock);
+    return ret;
+}
+
+// the phone's side of the stream
+static struct {
+    bool connected;
+    bool playing;
+    sim_wav_t wav;
+    uint32_t rate;
+    uint8_t* packet;
+    size_t packet_bytes;
+    int16_t* frames;
+    int64_t start; // simulated us of packet 0 since the last (re)start
+    uint64_t sent; // packets since start
+    int64_t due; // of the next packet, jitter included
+    uint16_t registered; // avrcp notifications the firmware is waiting for, one-shot
+    uint64_t rng;
+} ph;
+
+static uint32_t rng_next(void) { // xorshift, so runs are repeatable
+    ph.rng ^= ph.rng << 13;
+    ph.rng ^= ph.rng >> 7;
+    ph.rng ^= ph.rng << 17;
+    return (uint32_t)(ph.rng >> 32);
+}
+
+static void schedule_next(void) {
+    double rate = ph.rate * (1.0 + sim_config.drift_ppm / 1e6);
+    int64_t due = ph.start + (int64_t)((double)ph.sent * sim_config.a2dp_packet * 1e6 / rate);
+    if (sim_config.jitter_ms > 0) due += (int64_t)(rng_next() % (uint32_t)(sim_config.jitter_ms * 1000 + 1));
+    ph.due = (due > ph.due) ? due : ph.due; // a late packet holds back the ones after it, never reorders
+}
+
+static void notify(uint8_t event_id, esp_avrc_rn_param_t value) {
+    if (ct_cb == NULL || !(ph.registered & (1u << event_id))) return;
+    ph.registered &= ~(1u << event_id);
+    esp_avrc_ct_cb_param_t p = { .change_ntf = { .event_id = event_id, .event_parameter = value } };
+    ct_cb(ESP_AVRC_CT_CHANGE_NOTIFY_EVT, &p);
+}
+
+static void set_playing(bool playing) {
+    if (playing == ph.playing) return;
+    ph.playing = playing;
+    if (playing) {
+        ph.start = ph.due = sim_now_us();
+        ph.sent = 0;
+        schedule_next();
+    }
+    if (a2d_cb != NULL) {
+        esp_a2d_cb_param_t p = { 0 };
+        p.audio_stat.state = playing ? ESP_A2D_AUDIO_STATE_STARTED : ESP_A2D_AUDIO_STATE_SUSPEND;
+        memcpy(p.audio_stat.remote_bda, phone, sizeof(esp_bd_addr_t));
+        a2d_cb(ESP_A2D_AUDIO_STATE_EVT, &p);
+    }
+    notify(ESP_AVRC_RN_PLAY_STATUS_CHANGE, (esp_avrc_rn_param_t){ .playback = playing ? ESP_AVRC_PLAYBACK_PLAYING : ESP_AVRC_PLAYBACK_PAUSED });
+}
+
+static uint8_t sbc_rate_bits(uint32_t rate) {
+    switch (rate) {
+        case 16000: return 1 << 7;
+        case 32000: return 1 << 6;
+        case 44100: return 1 << 5;
+        case 48000: return 1 << 4;
+        default:
+            fprintf(stderr, "sim: sbc has no %lu Hz, the firmware is told 44100\n", (unsigned long)rate);
+            return 1 << 5;
+    }
+}
+
+static void phone_connect(void) {
+    if (!sim_wav_open(&ph.wav, sim_config.a2dp_path, sim_config.a2dp_rate, 2)) return;
+    ph.rate = ph.wav.rate;
+    ph.packet_bytes = (size_t)sim_config.a2dp_packet * 4;
+    ph.packet = malloc(ph.packet_bytes);
+    ph.frames = malloc((size_t)sim_config.a2dp_packet * ph.wav.channels * sizeof(int16_t));
+    ph.rng = 0x9e3779b97f4a7c15ULL;
+    ph.connected = true;
+
+    if (gap_cb != NULL) {
+        esp_bt_gap_cb_param_t p = { 0 };
+        memcpy(p.auth_cmpl.bda, phone, sizeof(esp_bd_addr_t));
+        p.auth_cmpl.stat = ESP_BT_STATUS_SUCCESS;
+        strcpy((char*)p.auth_cmpl.device_name, "sim phone");
+        gap_cb(ESP_BT_GAP_AUTH_CMPL_EVT, &p);
+    }
+    if (a2d_cb != NULL) {
+        esp_a2d_cb_param_t p = { 0 };
+        p.conn_stat.state = ESP_A2D_CONNECTION_STATE_CONNECTED;
+        memcpy(p.conn_stat.remote_bda, phone, sizeof(esp_bd_addr_t));
+        a2d_cb(ESP_A2D_CONNECTION_STATE_EVT, &p);
+    }
+    if (ct_cb != NULL) {
+        esp_avrc_ct_cb_param_t p = { .conn_stat = { .connected = true } };
+        memcpy(p.conn_stat.remote_bda, phone, sizeof(esp_bd_addr_t));
+        ct_cb(ESP_AVRC_CT_CONNECTION_STATE_EVT, &p);
+    }
+    if (tg_cb != NULL) {
+        esp_avrc_tg_cb_param_t p = { .conn_stat = { .connected = true } };
+        memcpy(p.conn_stat.remote_bda, phone, sizeof(esp_bd_addr_t));
+        tg_cb(ESP_AVRC_TG_CONNECTION_STATE_EVT, &p);
+    }
+    if (a2d_cb != NULL) {
+        esp_a2d_cb_param_t p = { 0 };
+        p.audio_cfg.mcc.type = ESP_A2D_MCT_SBC;
+        p.audio_cfg.mcc.cie.sbc[0] = sbc_rate_bits(ph.rate) | 0x01; // joint stereo
+        memcpy(p.audio_cfg.remote_bda, phone, sizeof(esp_bd_addr_t));
+        a2d_cb(ESP_A2D_AUDIO_CFG_EVT, &p);
+    }
+    set_playing(true);
+}
+
+// one decoded sbc packet's worth, always stereo s16le like the real sink
+static void send_packet(void) {
+    int64_t late = sim_now_us() - ph.due;
+    if (late > atomic_load(&a2dp_late_worst)) atomic_store(&a2dp_late_worst, late);
+    sim_wav_read(&ph.wav, ph.frames, sim_config.a2dp_packet);
+    int16_t* out = (int16_t*)ph.packet;
+    for (uint32_t i = 0; i < sim_config.a2dp_packet; i++) {
+        out[2 * i] = ph.frames[i * ph.wav.channels];
+        out[2 * i + 1] = ph.frames[i * ph.wav.channels + (ph.wav.channels > 1)];
+    }
+    if (a2d_data_cb != NULL) a2d_data_cb(ph.packet, (uint32_t)ph.packet_bytes);
+    atomic_fetch_add(&a2dp_packets, 1);
+    atomic_fetch_add(&a2dp_bytes, ph.packet_bytes);
+    ph.sent++;
+    schedule_next();
+}
+
+static void metadata(uint8_t mask) {
+    if (ct_cb == NULL) return;
+    const char* path = (sim_config.a2dp_path != NULL) ? sim_config.a2dp_path : "";
+    const char* title = strrchr(path, '/');
+    title = (title != NULL) ? title + 1 : path;
+    for (uint8_t bit = ESP_AVRC_MD_ATTR_TITLE; bit <= ESP_AVRC_MD_ATTR_PLAYING_TIME; bit <<= 1) {
+        if (!(mask & bit)) continue;
+        const char* text = (bit == ESP_AVRC_MD_ATTR_TITLE) ? title : (bit == ESP_AVRC_MD_ATTR_ARTIST) ? "sim" : "";
+        esp_avrc_ct_cb_param_t p = { .meta_rsp = { .attr_id = bit, .attr_text = (uint8_t*)text, .attr_length = (int)strlen(text) } };
+        ct_cb(ESP_AVRC_CT_METADATA_RSP_EVT, &p);
+    }
+}
+
+static void passthrough(uint8_t key, uint8_t state) {
+    if (state != ESP_AVRC_PT_CMD_STATE_PRESSED || !ph.connected) return;
+    switch (key) {
+        case ESP_AVRC_PT_CMD_PLAY:
+            set_playing(true);
+            break;
+        case ESP_AVRC_PT_CMD_PAUSE:
+        case ESP_AVRC_PT_CMD_STOP:
+            set_playing(false);
+            break;
+        case ESP_AVRC_PT_CMD_FORWARD:
+        case ESP_AVRC_PT_CMD_BACKWARD:
+            ph.wav.pos = 0; // one song, "next" and "previous" both start it over
+            notify(ESP_AVRC_RN_TRACK_CHANGE, (esp_avrc_rn_param_t){ .elm_id = { 0 } });
+            break;
+        default:
+            break;
+    }
+}
+
+static void spp_start(void) {
+    esp_spp_cb_param_t p = { .start = { .status = ESP_SPP_FAILURE } };
+    if (sim_config.spp_port != 0) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons((uint16_t)sim_config.spp_port),
+                                    .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+        if (fd >= 0 && bind(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0 && listen(fd, 1) == 0) {
+            fcntl(fd, F_SETFL, O_NONBLOCK);
+            spp_listen_fd = fd;
+            p.start.status = ESP_SPP_SUCCESS;
+            p.start.handle = SPP_HANDLE;
+            fprintf(stderr, "sim: spp listening on localhost:%d\n", sim_config.spp_port);
+        } else {
+            fprintf(stderr, "sim: spp can't listen on port %d: %s\n", sim_config.spp_port, strerror(errno));
+            if (fd >= 0) close(fd);
+        }
+    }
+    if (spp_cb != NULL) spp_cb(ESP_SPP_START_EVT, &p);
+}
+
+static void spp_poll(void) {
+    if (spp_listen_fd < 0 || spp_cb == NULL) return;
+    int client = atomic_load(&spp_client_fd);
+    if (client < 0) {
+        client = accept(spp_listen_fd, NULL, NULL);
+        if (client < 0) return;
+        fcntl(client, F_SETFL, O_NONBLOCK);
+        atomic_store(&spp_client_fd, client);
+        esp_spp_cb_param_t p = { .srv_open = { .status = ESP_SPP_SUCCESS, .handle = SPP_HANDLE, .new_listen_handle = SPP_HANDLE + 1 } };
+        memcpy(p.srv_open.rem_bda, phone, sizeof(esp_bd_addr_t));
+        spp_cb(ESP_SPP_SRV_OPEN_EVT, &p);
+    }
+    uint8_t buf[SPP_MTU];
+    while (1) {
+        ssize_t n = recv(client, buf, sizeof(buf), 0);
+        if (n > 0) {
+            esp_spp_cb_param_t p = { .data_ind = { .status = ESP_SPP_SUCCESS, .handle = SPP_HANDLE, .len = (uint16_t)n, .data = buf } };
+            spp_cb(ESP_SPP_DATA_IND_EVT, &p);
+        } else if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            atomic_store(&spp_client_fd, -1);
+            close(client);
+            esp_spp_cb_param_t p = { .close = { .status = ESP_SPP_SUCCESS, .handle = SPP_HANDLE } };
+            spp_cb(ESP_SPP_CLOSE_EVT, &p);
+            return;
+        } else {
+            return;
+        }
+    }
+}
+
+static void run(const cmd_t* cmd) {
+    switch (cmd->kind) {
+        case CMD_SPP_INIT:
+            if (spp_cb != NULL) spp_cb(ESP_SPP_INIT_EVT, &(esp_spp_cb_param_t){ .init = { .status = ESP_SPP_SUCCESS } });
+            break;
+        case CMD_SPP_START:
+            spp_start();
+            break;
+        case CMD_CAPS:
+            if (ct_cb != NULL && ph.connected) {
+                esp_avrc_ct_cb_param_t p = { .get_rn_caps_rsp = { .cap_count = 2 } };
+                p.get_rn_caps_rsp.evt_set.bits = (1u << ESP_AVRC_RN_PLAY_STATUS_CHANGE) | (1u << ESP_AVRC_RN_TRACK_CHANGE);
+                ct_cb(ESP_AVRC_CT_GET_RN_CAPABILITIES_RSP_EVT, &p);
+            }
+            break;
+        case CMD_REGISTER:
+            if (cmd->a < 16) ph.registered |= 1u << cmd->a; // no interim response, the firmware doesn't need one
+            break;
+        case CMD_METADATA:
+            metadata(cmd->a);
+            break;
+        case CMD_PASSTHROUGH:
+            passthrough(cmd->a, cmd->b);
+            break;
+    }
+}
+
+static void bt_task(void* param) {
+    while (1) {
+        int64_t now = sim_now_us();
+        int64_t wake = now + POLL_US;
+        if (ph.playing && ph.due < wake) wake = ph.due;
+        if (!ph.connected && connect_at >= 0 && connect_at < wake) wake = connect_at;
+        struct timespec deadline = sim_deadline(wake);
+
+        pthread_mutex_lock(&cmd_lock);
+        if (cmd_count == 0) sim_cond_wait(&cmd_cond, &cmd_lock, &deadline);
+        while (cmd_count > 0) {
+            cmd_t cmd = cmd_queue[cmd_head];
+            cmd_head = (cmd_head + 1) % CMD_QUEUE_LEN;
+            cmd_count--;
+            pthread_mutex_unlock(&cmd_lock); // callbacks may post more
+            run(&cmd);
+            pthread_mutex_lock(&cmd_lock);
+        }
+        pthread_mutex_unlock(&cmd_lock);
+
+        now = sim_now_us();
+        if (!ph.connected && connect_at >= 0 && now >= connect_at) {
+            connect_at = -1;
+            phone_connect();
+        }
+        while (ph.playing && now >= ph.due) send_packet();
+        spp_poll();
+    }
+}
+
+esp_err_t esp_bt_controller_mem_release(esp_bt_mode_t mode) { return ESP_OK; }
+esp_err_t esp_bt_controller_init(esp_bt_controller_config_t* cfg) { return ESP_OK; }
+esp_err_t esp_bt_controller_enable(esp_bt_mode_t mode) { return ESP_OK; }
+esp_err_t esp_bluedroid_init(void) { return ESP_OK; }
+
+esp_err_t esp_bluedroid_enable(void) {
+    sim_cond_init(&cmd_cond);
+    // same name, priority and core as bluedroid's btc task, so the task report lines up with the real one
+    if (xTaskCreatePinnedToCore(bt_task, "BTC_TASK", 4096, NULL, 19, NULL, CONFIG_BT_BLUEDROID_PINNED_TO_CORE) != pdPASS) {
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+const uint8_t* esp_bt_dev_get_address(void) {
+    static const esp_bd_addr_t own = { 0x24, 0x0a, 0xc4, 0x00, 0x00, 0x01 };
+    return own;
+}
+
+esp_err_t esp_bt_gap_register_callback(esp_bt_gap_cb_t callback) { gap_cb = callback; return ESP_OK; }
+esp_err_t esp_bt_gap_set_device_name(const char* name) { return ESP_OK; }
+esp_err_t esp_bt_gap_set_scan_mode(esp_bt_connection_mode_t c_mode, esp_bt_discovery_mode_t d_mode) { return ESP_OK; }
+esp_err_t esp_bt_gap_set_security_param(esp_bt_sp_param_t param_type, void* value, uint8_t len) { return ESP_OK; }
+esp_err_t esp_bt_gap_set_pin(esp_bt_pin_type_t pin_type, uint8_t pin_code_len, esp_bt_pin_code_t pin_code) { return ESP_OK; }
+esp_err_t esp_bt_gap_pin_reply(esp_bd_addr_t bd_addr, bool accept, uint8_t pin_code_len, esp_bt_pin_code_t pin_code) { return ESP_OK; }
+esp_err_t esp_bt_gap_ssp_confirm_reply(esp_bd_addr_t bd_addr, bool accept) { return ESP_OK; }
+
+esp_err_t esp_a2d_register_callback(esp_a2d_cb_t callback) { a2d_cb = callback; return ESP_OK; }
+esp_err_t esp_a2d_sink_register_data_callback(esp_a2d_sink_data_cb_t callback) { a2d_data_cb = callback; return ESP_OK; }
+
+esp_err_t esp_a2d_sink_init(void) {
+    if (sink_ready) return ESP_ERR_INVALID_STATE;
+    sink_ready = true;
+    pthread_mutex_lock(&cmd_lock);
+    if (sim_config.a2dp_path != NULL) connect_at = sim_now_us() + (int64_t)(sim_config.a2dp_connect_ms * 1000);
+    pthread_cond_signal(&cmd_cond);
+    pthread_mutex_unlock(&cmd_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_a2d_sink_deinit(void) {
+    sink_ready = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_avrc_ct_register_callback(esp_avrc_ct_cb_t callback) { ct_cb = callback; return ESP_OK; }
+esp_err_t esp_avrc_ct_init(void) { return ESP_OK; }
+esp_err_t esp_avrc_tg_register_callback(esp_avrc_tg_cb_t callback) { tg_cb = callback; return ESP_OK; }
+esp_err_t esp_avrc_tg_init(void) { return ESP_OK; }
+esp_err_t esp_avrc_tg_set_rn_evt_cap(const esp_avrc_rn_evt_cap_mask_t* evt_set) { return ESP_OK; }
+esp_err_t esp_avrc_tg_send_rn_rsp(esp_avrc_rn_event_ids_t event_id, esp_avrc_rn_rsp_t rsp, esp_avrc_rn_param_t* param) { return ESP_OK; }
+
+bool esp_avrc_rn_evt_bit_mask_operation(esp_avrc_bit_mask_op_t op, esp_avrc_rn_evt_cap_mask_t* events, esp_avrc_rn_event_ids_t event_id) {
+    if (events == NULL || event_id >= ESP_AVRC_RN_MAX_EVT) return false;
+    uint16_t bit = (uint16_t)(1u << event_id);
+    switch (op) {
+        case ESP_AVRC_BIT_MASK_OP_SET: events->bits |= bit; return true;
+        case ESP_AVRC_BIT_MASK_OP_CLEAR: events->bits &= ~bit; return true;
+        default: return (events->bits & bit) != 0;
+    }
+}
+
+esp_err_t esp_avrc_ct_send_get_rn_capabilities_cmd(uint8_t tl) { return post(CMD_CAPS, 0, 0); }
+esp_err_t esp_avrc_ct_send_register_notification_cmd(uint8_t tl, uint8_t event_id, uint32_t event_parameter) { return post(CMD_REGISTER, event_id, 0); }
+esp_err_t esp_avrc_ct_send_metadata_cmd(uint8_t tl, uint8_t attr_mask) { return post(CMD_METADATA, attr_mask, 0); }
+esp_err_t esp_avrc_ct_send_passthrough_cmd(uint8_t tl, uint8_t key_code, uint8_t key_state) { return post(CMD_PASSTHROUGH, key_code, key_state); }
+
+esp_err_t esp_spp_register_callback(esp_spp_cb_t callback) { spp_cb = callback; return ESP_OK; }
+esp_err_t esp_spp_enhanced_init(const esp_spp_cfg_t* cfg) { return post(CMD_SPP_INIT, 0, 0); }
+esp_err_t esp_spp_start_srv(esp_spp_sec_t sec_mask, esp_spp_role_t role, uint8_t local_scn, const char* name) { return post(CMD_SPP_START, 0, 0); }
+
+esp_err_t esp_spp_write(uint32_t handle, int len, uint8_t* p_data) {
+    int fd = atomic_load(&spp_client_fd);
+    if (handle != SPP_HANDLE || fd < 0) return ESP_ERR_INVALID_STATE;
+    while (len > 0) {
+        ssize_t n = send(fd, p_data, (size_t)len, MSG_NOSIGNAL);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return ESP_FAIL; // congested
+        if (n < 0) return ESP_FAIL;
+        p_data += n;
+        len -= (int)n;
+    }
+    return ESP_OK;
+}
+
+void sim_bt_stats(sim_stats_t* stats) {
+    stats->a2dp_packets = atomic_load(&a2dp_packets);
+    stats->a2dp_bytes = atomic_load(&a2dp_bytes);
+    stats->a2dp_late_worst_us = atomic_load(&a2dp_late_worst);
+}
@@ -0,0 +1,374 @@
+#include <string.h>
+#include <stdatomic.h>
+#include "sim.h"
+#include "driver/i2s_std.h"
+
+// one rx source and one tx capture for the whole run, shared by whichever channels come and go
+static pthread_mutex_t io_lock = PTHREAD_MUTEX_INITIALIZER;
+static sim_wav_t mic_wav;
+static bool mic_opened = false;
+static sim_wav_t out_wav;
+static bool out_created = false;
+
+static _Atomic uint32_t rx_buffers, rx_overruns, rx_stalled, tx_buffers, tx_underruns, tx_torn;
+static bool port_used[I2S_NUM_MAX][2]; // [port][tx]
+
+struct i2s_channel_obj_t {
+    i2s_port_t port;
+    bool tx;
+    uint32_t desc_num;
+    uint32_t frame_num;
+    bool clear_before_cb;
+    bool configured;
+    uint32_t rate;
+    uint32_t slots; // 1 mono, 2 stereo
+    uint32_t sample_bytes; // per slot
+    size_t buf_bytes;
+    uint8_t* storage; // desc_num dma buffers back to back
+    uint8_t* playing; // tx: the buffer being played as it was when the dma got to it
+    i2s_event_callbacks_t cbs;
+    void* user;
+    pthread_t dma;
+    _Atomic bool running;
+    bool enabled;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    // buffers handed from the dma to the api: filled ones for rx, finished ones for tx. like the driver's message
+    // queue it holds desc_num - 1, when it is full the oldest is dropped
+    uint32_t* queue;
+    uint32_t queue_head, queue_count, queue_len;
+    int32_t curr; // buffer the api is partway through, -1 for none
+    size_t curr_pos;
+    bool* written; // tx: filled by i2s_channel_write since it last played
+    bool writer; // tx: i2s_channel_write has been used, so unwritten buffers count as underruns
+};
+
+static void queue_push(i2s_chan_handle_t ch, uint32_t buf, bool* dropped) {
+    *dropped = ch->queue_count == ch->queue_len;
+    if (*dropped) {
+        ch->queue_head = (ch->queue_head + 1) % ch->queue_len;
+        ch->queue_count--;
+    }
+    ch->queue[(ch->queue_head + ch->queue_count) % ch->queue_len] = buf;
+    ch->queue_count++;
+}
+
+static uint32_t queue_pop(i2s_chan_handle_t ch) {
+    uint32_t buf = ch->queue[ch->queue_head];
+    ch->queue_head = (ch->queue_head + 1) % ch->queue_len;
+    ch->queue_count--;
+    return buf;
+}
+
+// an inmp441 puts its 24 bits at the top of the 32 bit slot. a mono --mic file feeds the left slot only, a second
+// mic on the right stays silent
+static void fill_rx(i2s_chan_handle_t ch, uint8_t* buf) {
+    static int16_t frames[4096];
+    uint32_t left = ch->frame_num;
+    pthread_mutex_lock(&io_lock);
+    if (!mic_opened) {
+        mic_opened = true;
+        if (sim_config.mic_path != NULL && sim_wav_open(&mic_wav, sim_config.mic_path, ch->rate, 1) && mic_wav.rate != ch->rate) {
+            fprintf(stderr, "sim: %s is %lu Hz, the mic runs at %lu Hz\n", sim_config.mic_path, (unsigned long)mic_wav.rate, (unsigned long)ch->rate);
+        }
+    }
+    uint32_t channels = (mic_wav.file != NULL) ? mic_wav.channels : 1;
+    while (left > 0) {
+        uint32_t n = (uint32_t)(sizeof(frames) / sizeof(frames[0]) / channels);
+        if (n > left) n = left;
+        if (mic_wav.file != NULL) sim_wav_read(&mic_wav, frames, n);
+        else memset(frames, 0, n * channels * sizeof(int16_t));
+        for (uint32_t f = 0; f < n; f++) {
+            for (uint32_t s = 0; s < ch->slots; s++) {
+                int16_t v = (s < channels) ? frames[f * channels + s] : 0;
+                if (ch->sample_bytes == 4) {
+                    int32_t w = (int32_t)((uint32_t)(uint16_t)v << 16);
+                    memcpy(buf, &w, 4);
+                } else {
+                    memcpy(buf, &v, 2);
+                }
+                buf += ch->sample_bytes;
+            }
+        }
+        left -= n;
+    }
+    pthread_mutex_unlock(&io_lock);
+}
+
+static void capture_tx(i2s_chan_handle_t ch, const uint8_t* buf) {
+    pthread_mutex_lock(&io_lock);
+    if (!out_created && sim_config.out_path != NULL) {
+        out_created = true;
+        sim_wav_create(&out_wav, sim_config.out_path, (uint16_t)ch->slots, (uint16_t)(ch->sample_bytes * 8), ch->rate);
+    }
+    if (out_wav.file != NULL && out_wav.channels == ch->slots && out_wav.bits == ch->sample_bytes * 8) {
+        sim_wav_write(&out_wav, buf, ch->buf_bytes);
+    }
+    pthread_mutex_unlock(&io_lock);
+}
+
+// the tx dma reads and clears a buffer whenever it gets to it, with no lock against the write task, as the hardware
+// does. a write landing while it plays is what tx_torn counts, so these accesses are kept out of tsan's sight. byte
+// loops through volatile, because memcpy, memcmp and memset would be intercepted
+#if defined(__SANITIZE_THREAD__)
+#define DMA_ACCESS __attribute__((no_sanitize_thread, noinline))
+#elif defined(__has_feature)
+#if __has_feature(thread_sanitizer)
+#define DMA_ACCESS __attribute__((no_sanitize("thread"), noinline))
+#endif
+#endif
+#ifndef DMA_ACCESS
+#define DMA_ACCESS
+#endif
+
+static DMA_ACCESS void dma_read(uint8_t* to, const volatile uint8_t* buf, size_t len) {
+    for (size_t i = 0; i < len; i++) to[i] = buf[i];
+}
+
+static DMA_ACCESS bool dma_changed(const volatile uint8_t* buf, const uint8_t* played, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (buf[i] != played[i]) return true;
+    }
+    return false;
+}
+
+static DMA_ACCESS void dma_clear(volatile uint8_t* buf, size_t len) {
+    for (size_t i = 0; i < len; i++) buf[i] = 0;
+}
+
+// steps through the descriptors one buffer period at a time, on an absolute schedule so it never drifts
+static bool rx_stall(int64_t now) {
+    for (int i = 0; i < sim_config.rx_stall_count; i++) {
+        if (now >= sim_config.rx_stalls[i].at_us && now < sim_config.rx_stalls[i].at_us + sim_config.rx_stalls[i].len_us) return true;
+    }
+    return false;
+}
+
+static void* dma_thread(void* arg) {
+    i2s_chan_handle_t ch = arg;
+    int64_t start = sim_now_us();
+    uint32_t pos = 0;
+    for (uint64_t k = 1; atomic_load(&ch->running); k++) {
+        int64_t due = start + (int64_t)(k * ch->frame_num * 1000000ULL / ch->rate);
+        sim_sleep_until(due);
+        if (!atomic_load(&ch->running)) break;
+        sim_dma_late(sim_now_us() - due);
+        if (!ch->tx && rx_stall(due)) { // nothing clocked in, no buffer and no callback
+            atomic_fetch_add(&rx_stalled, 1);
+            continue;
+        }
+
+        uint8_t* buf = ch->storage + pos * ch->buf_bytes;
+        bool dropped;
+        pthread_mutex_lock(&ch->lock);
+        if (ch->tx) {
+            if (ch->writer && !ch->written[pos]) atomic_fetch_add(&tx_underruns, 1);
+            if (dma_changed(buf, ch->playing, ch->buf_bytes)) atomic_fetch_add(&tx_torn, 1); // half old, half new
+            ch->written[pos] = false;
+            capture_tx(ch, ch->playing); // what the dma read, as the write task may still be at buf
+            if (ch->clear_before_cb) dma_clear(buf, ch->buf_bytes);
+            queue_push(ch, pos, &dropped);
+            dma_read(ch->playing, ch->storage + (pos + 1) % ch->desc_num * ch->buf_bytes, ch->buf_bytes); // up next
+            atomic_fetch_add(&tx_buffers, 1);
+        } else {
+            fill_rx(ch, buf);
+            queue_push(ch, pos, &dropped);
+            if (dropped) atomic_fetch_add(&rx_overruns, 1);
+            atomic_fetch_add(&rx_buffers, 1);
+        }
+        pthread_cond_broadcast(&ch->changed);
+        pthread_mutex_unlock(&ch->lock);
+
+        // the "isr": callbacks run right here on the dma thread
+        i2s_event_data_t event = { .data = buf, .dma_buf = buf, .size = ch->buf_bytes };
+        if (ch->tx) {
+            if (dropped && ch->cbs.on_send_q_ovf != NULL) ch->cbs.on_send_q_ovf(ch, &event, ch->user);
+            if (ch->cbs.on_sent != NULL) ch->cbs.on_sent(ch, &event, ch->user);
+        } else {
+            if (dropped && ch->cbs.on_recv_q_ovf != NULL) ch->cbs.on_recv_q_ovf(ch, &event, ch->user);
+            if (ch->cbs.on_recv != NULL) ch->cbs.on_recv(ch, &event, ch->user);
+        }
+        pos = (pos + 1) % ch->desc_num;
+    }
+    return NULL;
+}
+
+static esp_err_t new_channel(const i2s_chan_config_t* cfg, i2s_port_t port, bool tx, i2s_chan_handle_t* ret) {
+    i2s_chan_handle_t ch = calloc(1, sizeof(*ch));
+    if (ch == NULL) return ESP_ERR_NO_MEM;
+    ch->port = port;
+    ch->tx = tx;
+    ch->desc_num = cfg->dma_desc_num;
+    ch->frame_num = cfg->dma_frame_num;
+    ch->clear_before_cb = cfg->auto_clear_before_cb;
+    ch->queue_len = (ch->desc_num > 1) ? ch->desc_num - 1 : 1;
+    ch->queue = calloc(ch->queue_len, sizeof(uint32_t));
+    ch->written = calloc(ch->desc_num, sizeof(bool));
+    ch->curr = -1;
+    pthread_mutex_init(&ch->lock, NULL);
+    sim_cond_init(&ch->changed);
+    port_used[port][tx] = true;
+    *ret = ch;
+    return ESP_OK;
+}
+
+esp_err_t i2s_new_channel(const i2s_chan_config_t* cfg, i2s_chan_handle_t* ret_tx_handle, i2s_chan_handle_t* ret_rx_handle) {
+    if (cfg == NULL || (ret_tx_handle == NULL && ret_rx_handle == NULL) || cfg->dma_desc_num < 2 || cfg->dma_frame_num == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    i2s_port_t port = cfg->id;
+    if (port == I2S_NUM_AUTO) {
+        for (port = I2S_NUM_0; port < I2S_NUM_MAX; port++) {
+            if ((ret_tx_handle == NULL || !port_used[port][1]) && (ret_rx_handle == NULL || !port_used[port][0])) break;
+        }
+        if (port == I2S_NUM_MAX) return ESP_ERR_NOT_FOUND;
+    } else if (port >= I2S_NUM_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    } else if ((ret_tx_handle != NULL && port_used[port][1]) || (ret_rx_handle != NULL && port_used[port][0])) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (ret_tx_handle != NULL) ESP_ERROR_CHECK(new_channel(cfg, port, true, ret_tx_handle));
+    if (ret_rx_handle != NULL) ESP_ERROR_CHECK(new_channel(cfg, port, false, ret_rx_handle));
+    return ESP_OK;
+}
+
+esp_err_t i2s_channel_init_std_mode(i2s_chan_handle_t ch, const i2s_std_config_t* std_cfg) {
+    if (ch->enabled) return ESP_ERR_INVALID_STATE;
+    ch->rate = std_cfg->clk_cfg.sample_rate_hz;
+    ch->slots = (std_cfg->slot_cfg.slot_mode == I2S_SLOT_MODE_STEREO) ? 2 : 1;
+    ch->sample_bytes = (std_cfg->slot_cfg.data_bit_width <= 16) ? 2 : 4; // 24 bit data sits in a 32 bit slot
+    ch->buf_bytes = (size_t)ch->frame_num * ch->slots * ch->sample_bytes;
+    free(ch->storage);
+    free(ch->playing);
+    ch->storage = calloc(ch->desc_num, ch->buf_bytes);
+    ch->playing = calloc(1, ch->buf_bytes);
+    if (ch->rate == 0 || ch->storage == NULL || ch->playing == NULL) return ESP_ERR_INVALID_ARG;
+    ch->configured = true;
+    return ESP_OK;
+}
+
+esp_err_t i2s_channel_register_event_callback(i2s_chan_handle_t ch, const i2s_event_callbacks_t* callbacks, void* user_data) {
+    if (ch->enabled) return ESP_ERR_INVALID_STATE; // same rule as the driver
+    if (callbacks != NULL) ch->cbs = *callbacks;
+    else memset(&ch->cbs, 0, sizeof(ch->cbs));
+    ch->user = user_data;
+    return ESP_OK;
+}
+
+esp_err_t i2s_channel_enable(i2s_chan_handle_t ch) {
+    if (!ch->configured || ch->enabled) return ESP_ERR_INVALID_STATE;
+    memset(ch->storage, 0, ch->desc_num * ch->buf_bytes);
+    memset(ch->playing, 0, ch->buf_bytes);
+    memset(ch->written, 0, ch->desc_num * sizeof(bool));
+    ch->queue_head = ch->queue_count = 0;
+    ch->curr = -1;
+    ch->writer = false;
+    ch->enabled = true;
+    atomic_store(&ch->running, true);
+    if (pthread_create(&ch->dma, NULL, dma_thread, ch) != 0) return ESP_FAIL;
+    return ESP_OK;
+}
+
+esp_err_t i2s_channel_disable(i2s_chan_handle_t ch) {
+    if (!ch->enabled) return ESP_ERR_INVALID_STATE;
+    atomic_store(&ch->running, false);
+    pthread_join(ch->dma, NULL);
+    pthread_mutex_lock(&ch->lock);
+    ch->enabled = false;
+    pthread_cond_broadcast(&ch->changed);
+    pthread_mutex_unlock(&ch->lock);
+    return ESP_OK;
+}
+
+esp_err_t i2s_del_channel(i2s_chan_handle_t ch) {
+    if (ch->enabled) return ESP_ERR_INVALID_STATE;
+    port_used[ch->port][ch->tx] = false;
+    pthread_mutex_destroy(&ch->lock);
+    pthread_cond_destroy(&ch->changed);
+    free(ch->storage);
+    free(ch->playing);
+    free(ch->queue);
+    free(ch->written);
+    free(ch);
+    return ESP_OK;
+}
+
+// next buffer off the queue into ch->curr, waiting until deadline. ESP_OK, ESP_ERR_TIMEOUT or ESP_ERR_INVALID_STATE
+static esp_err_t take_buffer(i2s_chan_handle_t ch, const struct timespec* deadline) {
+    while (ch->queue_count == 0) {
+        if (!ch->enabled) return ESP_ERR_INVALID_STATE;
+        if (!sim_cond_wait(&ch->changed, &ch->lock, deadline) && ch->queue_count == 0) return ESP_ERR_TIMEOUT;
+    }
+    ch->curr = (int32_t)queue_pop(ch);
+    ch->curr_pos = 0;
+    return ESP_OK;
+}
+
+static const struct timespec* ms_deadline(uint32_t timeout_ms, struct timespec* ts) {
+    if (timeout_ms == UINT32_MAX) return NULL;
+    *ts = sim_deadline(sim_now_us() + (int64_t)timeout_ms * 1000);
+    return ts;
+}
+
+esp_err_t i2s_channel_read(i2s_chan_handle_t ch, void* dest, size_t size, size_t* bytes_read, uint32_t timeout_ms) {
+    if (ch->tx) return ESP_ERR_INVALID_ARG;
+    struct timespec ts;
+    const struct timespec* deadline = ms_deadline(timeout_ms, &ts);
+    esp_err_t ret = ESP_OK;
+    size_t done = 0;
+    pthread_mutex_lock(&ch->lock);
+    if (!ch->enabled) ret = ESP_ERR_INVALID_STATE;
+    while (ret == ESP_OK && done < size) {
+        if (ch->curr < 0 && (ret = take_buffer(ch, deadline)) != ESP_OK) break;
+        size_t n = ch->buf_bytes - ch->curr_pos;
+        if (n > size - done) n = size - done;
+        memcpy((uint8_t*)dest + done, ch->storage + ch->curr * ch->buf_bytes + ch->curr_pos, n);
+        done += n;
+        ch->curr_pos += n;
+        if (ch->curr_pos == ch->buf_bytes) ch->curr = -1;
+    }
+    pthread_mutex_unlock(&ch->lock);
+    if (bytes_read != NULL) *bytes_read = done;
+    return ret;
+}
+
+esp_err_t i2s_channel_write(i2s_chan_handle_t ch, const void* src, size_t size, size_t* bytes_written, uint32_t timeout_ms) {
+    if (!ch->tx) return ESP_ERR_INVALID_ARG;
+    struct timespec ts;
+    const struct timespec* deadline = ms_deadline(timeout_ms, &ts);
+    esp_err_t ret = ESP_OK;
+    size_t done = 0;
+    pthread_mutex_lock(&ch->lock);
+    if (!ch->enabled) ret = ESP_ERR_INVALID_STATE;
+    ch->writer = true;
+    while (ret == ESP_OK && done < size) {
+        if (ch->curr < 0 && (ret = take_buffer(ch, deadline)) != ESP_OK) break;
+        size_t n = ch->buf_bytes - ch->curr_pos;
+        if (n > size - done) n = size - done;
+        memcpy(ch->storage + ch->curr * ch->buf_bytes + ch->curr_pos, (const uint8_t*)src + done, n);
+        done += n;
+        ch->curr_pos += n;
+        if (ch->curr_pos == ch->buf_bytes) {
+            ch->written[ch->curr] = true;
+            ch->curr = -1;
+        }
+    }
+    pthread_mutex_unlock(&ch->lock);
+    if (bytes_written != NULL) *bytes_written = done;
+    return ret;
+}
+
+void sim_i2s_stats(sim_stats_t* stats) {
+    stats->rx_buffers = atomic_load(&rx_buffers);
+    stats->rx_overruns = atomic_load(&rx_overruns);
+    stats->rx_stalled = atomic_load(&rx_stalled);
+    stats->tx_buffers = atomic_load(&tx_buffers);
+    stats->tx_underruns = atomic_load(&tx_underruns);
+    stats->tx_torn = atomic_load(&tx_torn);
+}
+
+void sim_i2s_finish(void) {
+    pthread_mutex_lock(&io_lock);
+    sim_wav_close(&out_wav); // later buffers are no longer captured
+    pthread_mutex_unlock(&io_lock);
+}
@@ -0,0 +1,231 @@
+// host simulator entry point: parses the options, boots app_main like esp-idf would, and reports on the way out
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include "sim.h"
+
+sim_config_t sim_config = {
+    .speed = 1.0,
+    .seconds = 10.0,
+    .warmup = 2.0,
+    .a2dp_rate = 44100,
+    .a2dp_packet = 512, // about what a phone's sbc frames decode to
+    .a2dp_connect_ms = 500,
+};
+
+static _Atomic int64_t dma_late_worst = 0;
+
+void sim_dma_late(int64_t late_us) {
+    if (late_us > atomic_load(&dma_late_worst)) atomic_store(&dma_late_worst, late_us);
+}
+
+void sim_stats(sim_stats_t* stats) {
+    memset(stats, 0, sizeof(*stats));
+    sim_i2s_stats(stats);
+    sim_adc_stats(stats);
+    sim_bt_stats(stats);
+    stats->dma_late_worst_us = atomic_load(&dma_late_worst);
+}
+
+static void usage(const char* argv0) {
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "  --seconds S         simulated run time (10)\n"
+        "  --speed X           simulated seconds per real second (1)\n"
+        "  --warmup S          start-up seconds --strict ignores (2)\n"
+        "  --strict            exit 1 on an i2s or adc overrun/underrun after the warmup\n"
+        "  --pin               pin tasks with a core to that host cpu\n"
+        "  --mic FILE          i2s rx input, wav or raw s16le mono (silence)\n"
+        "  --out FILE          i2s tx capture, wav\n"
+        "  --adc FILE          adc continuous input, one channel per pattern entry (silence)\n"
+        "  --a2dp FILE         a phone streams this over a2dp (no phone)\n"
+        "  --a2dp-rate HZ      rate of a raw --a2dp file (44100)\n"
+        "  --a2dp-packet N     stereo frames per a2dp data callback (512)\n"
+        "  --a2dp-connect MS   when the phone connects after the sink is up (500)\n"
+        "  --jitter MS         each a2dp packet arrives up to this late (0)\n"
+        "  --drift PPM         phone clock against ours, + sends faster (0)\n"
+        "  --spp PORT          spp client connections on localhost:PORT\n"
+        "  --sd DIR            sd card contents (no card)\n"
+        "  --psram BYTES       psram size (none)\n"
+        "  --press GPIO@S      hold a button low for %d ms at S simulated seconds, repeatable\n"
+        "  --rx-stall S:MS     stop the i2s rx dma for MS ms at S simulated seconds, repeatable\n"
+        "  --nvs NS.KEY=T:V    nvs holds V as type T (u8, u16, u32, i32) at boot, repeatable\n"
+        "  --preempt TASK@S:MS the task's first wake-up after S simulated seconds comes MS ms late, repeatable\n",
+        argv0, SIM_PRESS_US / 1000);
+}
+
+static bool parse_press(const char* arg) {
+    int gpio;
+    double at;
+    if (sim_config.press_count == SIM_MAX_PRESSES || sscanf(arg, "%d@%lf", &gpio, &at) != 2 || gpio < 0 || gpio >= 40 || at < 0) {
+        return false;
+    }
+    sim_config.presses[sim_config.press_count].gpio = gpio;
+    sim_config.presses[sim_config.press_count].at_us = (int64_t)(at * 1e6);
+    sim_config.press_count++;
+    return true;
+}
+
+static bool parse_rx_stall(const char* arg) {
+    double at, len;
+    if (sim_config.rx_stall_count == SIM_MAX_RX_STALLS || sscanf(arg, "%lf:%lf", &at, &len) != 2 || at < 0 || len <= 0) {
+        return false;
+    }
+    sim_config.rx_stalls[sim_config.rx_stall_count].at_us = (int64_t)(at * 1e6);
+    sim_config.rx_stalls[sim_config.rx_stall_count].len_us = (int64_t)(len * 1e3);
+    sim_config.rx_stall_count++;
+    return true;
+}
+
+static bool parse_preempt(const char* arg) {
+    if (sim_config.preempt_count == SIM_MAX_PREEMPTS) return false;
+    double at, len;
+    int end = 0;
+    char* task = sim_config.preempts[sim_config.preempt_count].task;
+    if (sscanf(arg, "%15[^@]@%lf:%lf%n", task, &at, &len, &end) != 3 || arg[end] != '\0' || at < 0 || len <= 0) {
+        return false;
+    }
+    sim_config.preempts[sim_config.preempt_count].at_us = (int64_t)(at * 1e6);
+    sim_config.preempts[sim_config.preempt_count].len_us = (int64_t)(len * 1e3);
+    sim_config.preempt_count++;
+    return true;
+}
+
+static bool parse_nvs(const char* arg) {
+    if (sim_config.nvs_preset_count == SIM_MAX_NVS_PRESETS) return false;
+    sim_nvs_preset_t* p = &sim_config.nvs_presets[sim_config.nvs_preset_count];
+    long long value;
+    int end = 0;
+    if (sscanf(arg, "%15[^.].%15[^=]=%3[^:]:%lld%n", p->ns, p->key, p->type, &value, &end) != 4 || arg[end] != '\0') {
+        return false;
+    }
+    if (strcmp(p->type, "u8") != 0 && strcmp(p->type, "u16") != 0 && strcmp(p->type, "u32") != 0 && strcmp(p->type, "i32") != 0) {
+        return false;
+    }
+    p->value = value;
+    sim_config.nvs_preset_count++;
+    return true;
+}
+
+static void report(const char* what, const sim_stats_t* s, const sim_stats_t* base) {
+    fprintf(stderr, "sim: %-8s i2s rx %lu buffers, %lu overruns, %lu stalled  tx %lu buffers, %lu underruns, %lu torn  adc %lu frames, %lu overflows"
+        "  a2dp %lu packets\n", what,
+        (unsigned long)(s->rx_buffers - base->rx_buffers), (unsigned long)(s->rx_overruns - base->rx_overruns),
+        (unsigned long)(s->rx_stalled - base->rx_stalled),
+        (unsigned long)(s->tx_buffers - base->tx_buffers), (unsigned long)(s->tx_underruns - base->tx_underruns),
+        (unsigned long)(s->tx_torn - base->tx_torn),
+        (unsigned long)(s->adc_frames - base->adc_frames), (unsigned long)(s->adc_overflows - base->adc_overflows),
+        (unsigned long)(s->a2dp_packets - base->a2dp_packets));
+}
+
+int main(int argc, char** argv) {
+    enum { OPT_A2DP_RATE = 256, OPT_A2DP_PACKET, OPT_A2DP_CONNECT, OPT_RX_STALL, OPT_NVS, OPT_PREEMPT };
+    static const struct option options[] = {
+        { "seconds", required_argument, NULL, 't' },
+        { "speed", required_argument, NULL, 'x' },
+        { "warmup", required_argument, NULL, 'w' },
+        { "strict", no_argument, NULL, 's' },
+        { "pin", no_argument, NULL, 'P' },
+        { "mic", required_argument, NULL, 'm' },
+        { "out", required_argument, NULL, 'o' },
+        { "adc", required_argument, NULL, 'a' },
+        { "a2dp", required_argument, NULL, 'b' },
+        { "a2dp-rate", required_argument, NULL, OPT_A2DP_RATE },
+        { "a2dp-packet", required_argument, NULL, OPT_A2DP_PACKET },
+        { "a2dp-connect", required_argument, NULL, OPT_A2DP_CONNECT },
+        { "jitter", required_argument, NULL, 'j' },
+        { "drift", required_argument, NULL, 'd' },
+        { "spp", required_argument, NULL, 'p' },
+        { "sd", required_argument, NULL, 'c' },
+        { "psram", required_argument, NULL, 'r' },
+        { "press", required_argument, NULL, 'k' },
+        { "rx-stall", required_argument, NULL, OPT_RX_STALL },
+        { "nvs", required_argument, NULL, OPT_NVS },
+        { "preempt", required_argument, NULL, OPT_PREEMPT },
+        { "help", no_argument, NULL, 'h' },
+        { NULL, 0, NULL, 0 },
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "h", options, NULL)) != -1) {
+        switch (opt) {
+            case 't': sim_config.seconds = atof(optarg); break;
+            case 'x': sim_config.speed = atof(optarg); break;
+            case 'w': sim_config.warmup = atof(optarg); break;
+            case 's': sim_config.strict = true; break;
+            case 'P': sim_config.pin = true; break;
+            case 'm': sim_config.mic_path = optarg; break;
+            case 'o': sim_config.out_path = optarg; break;
+            case 'a': sim_config.adc_path = optarg; break;
+            case 'b': sim_config.a2dp_path = optarg; break;
+            case OPT_A2DP_RATE: sim_config.a2dp_rate = (uint32_t)atol(optarg); break;
+            case OPT_A2DP_PACKET: sim_config.a2dp_packet = (uint32_t)atol(optarg); break;
+            case OPT_A2DP_CONNECT: sim_config.a2dp_connect_ms = atof(optarg); break;
+            case 'j': sim_config.jitter_ms = atof(optarg); break;
+            case 'd': sim_config.drift_ppm = atof(optarg); break;
+            case 'p': sim_config.spp_port = atoi(optarg); break;
+            case 'c': sim_config.sd_dir = optarg; break;
+            case 'r': sim_config.psram_bytes = (size_t)atoll(optarg); break;
+            case 'k':
+                if (!parse_press(optarg)) {
+                    fprintf(stderr, "sim: bad --press %s, want GPIO@SECONDS\n", optarg);
+                    return 2;
+                }
+                break;
+            case OPT_RX_STALL:
+                if (!parse_rx_stall(optarg)) {
+                    fprintf(stderr, "sim: bad --rx-stall %s, want SECONDS:MS\n", optarg);
+                    return 2;
+                }
+                break;
+            case OPT_NVS:
+                if (!parse_nvs(optarg)) {
+                    fprintf(stderr, "sim: bad --nvs %s, want NAMESPACE.KEY=u8|u16|u32|i32:VALUE\n", optarg);
+                    return 2;
+                }
+                break;
+            case OPT_PREEMPT:
+                if (!parse_preempt(optarg)) {
+                    fprintf(stderr, "sim: bad --preempt %s, want TASK@SECONDS:MS\n", optarg);
+                    return 2;
+                }
+                break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : 2;
+        }
+    }
+    if (optind != argc || sim_config.speed <= 0 || sim_config.seconds <= 0 || sim_config.a2dp_packet == 0 || sim_config.a2dp_rate == 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    sim_clock_start();
+    sim_run_app_main();
+
+    sim_stats_t zero = { 0 }, warm = { 0 }, end;
+    int64_t warmup_us = (int64_t)(sim_config.warmup * 1e6);
+    int64_t end_us = (int64_t)(sim_config.seconds * 1e6);
+    if (warmup_us < end_us) {
+        sim_sleep_until(warmup_us);
+        sim_stats(&warm);
+    }
+    sim_sleep_until(end_us);
+    sim_stats(&end);
+    sim_i2s_finish();
+
+    fprintf(stderr, "sim: %.1f s simulated in %.1f s\n", sim_now_us() / 1e6, sim_wall_us() / 1e6);
+    report("total", &end, &zero);
+    if (warmup_us < end_us) report("warm", &end, &warm);
+    fprintf(stderr, "sim: worst dma wake-up %lld us late, a2dp packet %lld us late (past jitter)\n",
+        (long long)end.dma_late_worst_us, (long long)end.a2dp_late_worst_us);
+    sim_sd_report(stderr);
+    sim_task_report(stderr);
+
+    fflush(stdout);
+    fflush(stderr);
+    bool xrun = end.rx_overruns != warm.rx_overruns || end.tx_underruns != warm.tx_underruns || end.tx_torn != warm.tx_torn ||
+        end.adc_overflows != warm.adc_overflows;
+    _exit((sim_config.strict && xrun) ? 1 : 0); // the firmware's tasks never end, so don't wait on them or run atexit
+}
@@ -0,0 +1,390 @@
+// everything that isn't audio: logging, heap accounting, gpio buttons, nvs, and the sd card
+#include <string.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include "sim.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "driver/gpio.h"
+#include "nvs_flash.h"
+#include "driver/spi_common.h"
+#include "esp_vfs_fat.h"
+#include "sdmmc_cmd.h"
+
+// the firmware's own fopen/stat/remove are redirected, these need the real ones
+#undef fopen
+#undef stat
+#undef remove
+
+const char* esp_err_to_name(esp_err_t code) {
+    switch (code) {
+        case ESP_OK: return "ESP_OK";
+        case ESP_FAIL: return "ESP_FAIL";
+        case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+        case ESP_ERR_INVALID_SIZE: return "ESP_ERR_INVALID_SIZE";
+        case ESP_ERR_NOT_FOUND: return "ESP_ERR_NOT_FOUND";
+        case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+        case ESP_ERR_TIMEOUT: return "ESP_ERR_TIMEOUT";
+        case ESP_ERR_NVS_NOT_INITIALIZED: return "ESP_ERR_NVS_NOT_INITIALIZED";
+        case ESP_ERR_NVS_NOT_FOUND: return "ESP_ERR_NVS_NOT_FOUND";
+        case ESP_ERR_NVS_TYPE_MISMATCH: return "ESP_ERR_NVS_TYPE_MISMATCH";
+        case ESP_ERR_NVS_INVALID_HANDLE: return "ESP_ERR_NVS_INVALID_HANDLE";
+        default: return "ERROR";
+    }
+}
+
+// logging. stdout is the console uart, the sim's own messages go to stderr
+
+static esp_log_level_t log_level = ESP_LOG_INFO;
+
+void esp_log_level_set(const char* tag, esp_log_level_t level) {
+    if (strcmp(tag, "*") == 0) log_level = level; // per tag levels aren't kept
+}
+
+void esp_log_write(esp_log_level_t level, const char* tag, const char* format, ...) {
+    if (level > log_level) return;
+    va_list args;
+    va_start(args, format);
+    flockfile(stdout); // one line at a time, the telemetry packets share the stream
+    vfprintf(stdout, format, args);
+    funlockfile(stdout);
+    va_end(args);
+}
+
+uint32_t esp_log_timestamp(void) {
+    return (uint32_t)(sim_now_us() / 1000);
+}
+
+void esp_log_buffer_hex(const char* tag, const void* buffer, uint16_t len) {
+    const uint8_t* p = buffer;
+    for (uint16_t i = 0; i < len; i += 16) {
+        char line[16 * 3 + 1];
+        size_t n = 0;
+        for (uint16_t k = i; k < len && k < i + 16; k++) n += (size_t)snprintf(line + n, sizeof(line) - n, "%02x ", p[k]);
+        ESP_LOGI(tag, "%s", line);
+    }
+}
+
+// heap. a header in front of each block remembers its size and which region it came from
+
+typedef struct {
+    size_t size;
+    uint32_t spiram;
+    uint32_t pad; // keeps the payload 16 byte aligned
+} block_t;
+
+static pthread_mutex_t heap_lock = PTHREAD_MUTEX_INITIALIZER;
+static size_t heap_used[2], heap_peak[2]; // [spiram]
+
+static size_t heap_capacity(int spiram) {
+    return spiram ? sim_config.psram_bytes : SIM_HEAP_INTERNAL;
+}
+
+void* heap_caps_malloc(size_t size, uint32_t caps) {
+    int spiram = (caps & MALLOC_CAP_SPIRAM) != 0;
+    pthread_mutex_lock(&heap_lock);
+    bool fits = size <= heap_capacity(spiram) - heap_used[spiram] && (!spiram || !(caps & MALLOC_CAP_DMA)); // no dma from psram
+    if (fits) {
+        heap_used[spiram] += size;
+        if (heap_used[spiram] > heap_peak[spiram]) heap_peak[spiram] = heap_used[spiram];
+    }
+    pthread_mutex_unlock(&heap_lock);
+    if (!fits) return NULL;
+    block_t* b = malloc(sizeof(block_t) + size);
+    if (b == NULL) return NULL;
+    b->size = size;
+    b->spiram = (uint32_t)spiram;
+    return b + 1;
+}
+
+void* heap_caps_calloc(size_t n, size_t size, uint32_t caps) {
+    if (size != 0 && n > SIZE_MAX / size) return NULL;
+    void* p = heap_caps_malloc(n * size, caps);
+    if (p != NULL) memset(p, 0, n * size);
+    return p;
+}
+
+void heap_caps_free(void* ptr) {
+    if (ptr == NULL) return;
+    block_t* b = (block_t*)ptr - 1;
+    pthread_mutex_lock(&heap_lock);
+    heap_used[b->spiram] -= b->size;
+    pthread_mutex_unlock(&heap_lock);
+    free(b);
+}
+
+size_t heap_caps_get_free_size(uint32_t caps) {
+    int spiram = (caps & MALLOC_CAP_SPIRAM) != 0;
+    pthread_mutex_lock(&heap_lock);
+    size_t free_bytes = heap_capacity(spiram) - heap_used[spiram];
+    pthread_mutex_unlock(&heap_lock);
+    return free_bytes;
+}
+
+size_t heap_caps_get_minimum_free_size(uint32_t caps) {
+    int spiram = (caps & MALLOC_CAP_SPIRAM) != 0;
+    pthread_mutex_lock(&heap_lock);
+    size_t min_free = heap_capacity(spiram) - heap_peak[spiram];
+    pthread_mutex_unlock(&heap_lock);
+    return min_free;
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t caps) {
+    return heap_caps_get_free_size(caps); // the host heap doesn't fragment the way ours would, so this is optimistic
+}
+
+// gpio. buttons are inputs with pull-ups, held low for SIM_PRESS_US by each --press
+
+static uint64_t pulled_up;
+
+esp_err_t gpio_config(const gpio_config_t* config) {
+    if (config->pull_up_en) pulled_up |= config->pin_bit_mask;
+    else pulled_up &= ~config->pin_bit_mask;
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio) {
+    if (gpio < 0 || gpio >= GPIO_NUM_MAX) return 0;
+    int64_t now = sim_now_us();
+    for (int i = 0; i < sim_config.press_count; i++) {
+        if (sim_config.presses[i].gpio == gpio && now >= sim_config.presses[i].at_us && now < sim_config.presses[i].at_us + SIM_PRESS_US) {
+            return 0;
+        }
+    }
+    return (pulled_up >> gpio) & 1;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio, uint32_t level) {
+    return ESP_OK;
+}
+
+// nvs. a flat list of namespace/key/value, enough for a few settings
+
+#define NVS_MAX_ENTRIES 64
+#define NVS_MAX_NAMESPACES 8
+#define NVS_KEY_LEN 16
+
+typedef enum { NVS_U8, NVS_U16, NVS_U32, NVS_I32 } nvs_type_t;
+
+static struct {
+    uint8_t ns; // namespace index + 1, 0 for a free entry
+    char key[NVS_KEY_LEN];
+    nvs_type_t type;
+    uint32_t value;
+} nvs_entries[NVS_MAX_ENTRIES];
+static char nvs_namespaces[NVS_MAX_NAMESPACES][NVS_KEY_LEN];
+static bool nvs_ready = false;
+static pthread_mutex_t nvs_lock = PTHREAD_MUTEX_INITIALIZER;
+
+esp_err_t nvs_flash_init(void) {
+    if (nvs_ready) return ESP_OK;
+    nvs_ready = true;
+    for (int i = 0; i < sim_config.nvs_preset_count; i++) { // --nvs
+        const sim_nvs_preset_t* p = &sim_config.nvs_presets[i];
+        nvs_handle_t handle;
+        if (nvs_open(p->ns, NVS_READWRITE, &handle) != ESP_OK) continue;
+        if (strcmp(p->type, "u8") == 0) nvs_set_u8(handle, p->key, (uint8_t)p->value);
+        else if (strcmp(p->type, "u16") == 0) nvs_set_u16(handle, p->key, (uint16_t)p->value);
+        else if (strcmp(p->type, "u32") == 0) nvs_set_u32(handle, p->key, (uint32_t)p->value);
+        else nvs_set_i32(handle, p->key, (int32_t)p->value);
+        nvs_close(handle);
+    }
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void) {
+    pthread_mutex_lock(&nvs_lock);
+    memset(nvs_entries, 0, sizeof(nvs_entries));
+    memset(nvs_namespaces, 0, sizeof(nvs_namespaces));
+    pthread_mutex_unlock(&nvs_lock);
+    return ESP_OK;
+}
+
+// handle is namespace index + 1, with bit 8 set when it may write
+esp_err_t nvs_open(const char* name, nvs_open_mode_t open_mode, nvs_handle_t* out_handle) {
+    if (!nvs_ready) return ESP_ERR_NVS_NOT_INITIALIZED;
+    if (strlen(name) >= NVS_KEY_LEN) return ESP_ERR_NVS_INVALID_NAME;
+    esp_err_t ret = ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+    pthread_mutex_lock(&nvs_lock);
+    for (int i = 0; i < NVS_MAX_NAMESPACES; i++) {
+        if (strcmp(nvs_namespaces[i], name) == 0 || nvs_namespaces[i][0] == '\0') {
+            if (nvs_namespaces[i][0] == '\0') {
+                if (open_mode == NVS_READONLY) { // a read-only open doesn't create it
+                    ret = ESP_ERR_NVS_NOT_FOUND;
+                    break;
+                }
+                strcpy(nvs_namespaces[i], name);
+            }
+            *out_handle = (nvs_handle_t)(i + 1) | ((open_mode == NVS_READWRITE) ? 0x100 : 0);
+            ret = ESP_OK;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&nvs_lock);
+    return ret;
+}
+
+void nvs_close(nvs_handle_t handle) {}
+
+esp_err_t nvs_commit(nvs_handle_t handle) {
+    return ESP_OK;
+}
+
+static int nvs_find(nvs_handle_t handle, const char* key) {
+    for (int i = 0; i < NVS_MAX_ENTRIES; i++) {
+        if (nvs_entries[i].ns == (handle & 0xff) && strcmp(nvs_entries[i].key, key) == 0) return i;
+    }
+    return -1;
+}
+
+static esp_err_t nvs_set(nvs_handle_t handle, const char* key, nvs_type_t type, uint32_t value) {
+    if ((handle & 0xff) == 0 || (handle & 0xff) > NVS_MAX_NAMESPACES) return ESP_ERR_NVS_INVALID_HANDLE;
+    if (!(handle & 0x100)) return ESP_ERR_NVS_READ_ONLY;
+    if (strlen(key) >= NVS_KEY_LEN) return ESP_ERR_NVS_INVALID_NAME;
+    esp_err_t ret = ESP_OK;
+    pthread_mutex_lock(&nvs_lock);
+    int i = nvs_find(handle, key);
+    if (i < 0) i = nvs_find(0, "");
+    if (i < 0) {
+        ret = ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+    } else {
+        nvs_entries[i].ns = (uint8_t)(handle & 0xff);
+        strcpy(nvs_entries[i].key, key);
+        nvs_entries[i].type = type;
+        nvs_entries[i].value = value;
+    }
+    pthread_mutex_unlock(&nvs_lock);
+    return ret;
+}
+
+static esp_err_t nvs_get(nvs_handle_t handle, const char* key, nvs_type_t type, uint32_t* value) {
+    if ((handle & 0xff) == 0 || (handle & 0xff) > NVS_MAX_NAMESPACES) return ESP_ERR_NVS_INVALID_HANDLE;
+    esp_err_t ret = ESP_OK;
+    pthread_mutex_lock(&nvs_lock);
+    int i = nvs_find(handle, key);
+    if (i < 0) ret = ESP_ERR_NVS_NOT_FOUND;
+    else if (nvs_entries[i].type != type) ret = ESP_ERR_NVS_TYPE_MISMATCH;
+    else *value = nvs_entries[i].value;
+    pthread_mutex_unlock(&nvs_lock);
+    return ret;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char* key) {
+    if (!(handle & 0x100)) return ESP_ERR_NVS_READ_ONLY;
+    pthread_mutex_lock(&nvs_lock);
+    int i = nvs_find(handle, key);
+    if (i >= 0) memset(&nvs_entries[i], 0, sizeof(nvs_entries[i]));
+    pthread_mutex_unlock(&nvs_lock);
+    return (i >= 0) ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_set_u8(nvs_handle_t handle, const char* key, uint8_t value) { return nvs_set(handle, key, NVS_U8, value); }
+esp_err_t nvs_set_u16(nvs_handle_t handle, const char* key, uint16_t value) { return nvs_set(handle, key, NVS_U16, value); }
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char* key, uint32_t value) { return nvs_set(handle, key, NVS_U32, value); }
+esp_err_t nvs_set_i32(nvs_handle_t handle, const char* key, int32_t value) { return nvs_set(handle, key, NVS_I32, (uint32_t)value); }
+
+esp_err_t nvs_get_u8(nvs_handle_t handle, const char* key, uint8_t* out_value) {
+    uint32_t v;
+    esp_err_t ret = nvs_get(handle, key, NVS_U8, &v);
+    if (ret == ESP_OK) *out_value = (uint8_t)v;
+    return ret;
+}
+
+esp_err_t nvs_get_u16(nvs_handle_t handle, const char* key, uint16_t* out_value) {
+    uint32_t v;
+    esp_err_t ret = nvs_get(handle, key, NVS_U16, &v);
+    if (ret == ESP_OK) *out_value = (uint16_t)v;
+    return ret;
+}
+
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char* key, uint32_t* out_value) {
+    return nvs_get(handle, key, NVS_U32, out_value);
+}
+
+esp_err_t nvs_get_i32(nvs_handle_t handle, const char* key, int32_t* out_value) {
+    uint32_t v;
+    esp_err_t ret = nvs_get(handle, key, NVS_I32, &v);
+    if (ret == ESP_OK) *out_value = (int32_t)v;
+    return ret;
+}
+
+// sd card. the spi bus is a no-op, the mount point maps onto --sd
+
+static char mount_point[32];
+static sdmmc_card_t card = { .capacity = 8u * 1024 * 1024 * 2, .sector_size = 512 }; // 8 GB, it's never checked
+
+esp_err_t spi_bus_initialize(spi_host_device_t host_id, const spi_bus_config_t* bus_config, spi_common_dma_t dma_chan) {
+    return ESP_OK;
+}
+
+esp_err_t spi_bus_free(spi_host_device_t host_id) {
+    return ESP_OK;
+}
+
+esp_err_t esp_vfs_fat_sdspi_mount(const char* base_path, const sdmmc_host_t* host_config_input, const sdspi_device_config_t* slot_config,
+                                  const esp_vfs_fat_mount_config_t* mount_config, sdmmc_card_t** out_card) {
+    if (sim_config.sd_dir == NULL) return ESP_ERR_TIMEOUT; // what a missing card looks like over spi
+    if (mount_point[0] != '\0') return ESP_ERR_INVALID_STATE;
+    snprintf(mount_point, sizeof(mount_point), "%s", base_path);
+    card.host = *host_config_input;
+    if (out_card != NULL) *out_card = &card;
+    return ESP_OK;
+}
+
+esp_err_t esp_vfs_fat_sdcard_unmount(const char* base_path, sdmmc_card_t* unmounted) {
+    if (strcmp(base_path, mount_point) != 0) return ESP_ERR_INVALID_STATE;
+    mount_point[0] = '\0';
+    return ESP_OK;
+}
+
+void sdmmc_card_print_info(FILE* stream, const sdmmc_card_t* info) {
+    fprintf(stream, "Name: sim\nSpeed: %d kHz\nSize: %luMB\n", info->host.max_freq_khz,
+        (unsigned long)((uint64_t)info->capacity * info->sector_size / (1024 * 1024)));
+}
+
+// files on the card are its block device. a class 10 card over spi at 20 MHz: a millisecond per write command,
+// ~2 MB/s after it, and every 64th write the card stops for 250 ms to erase, which is what the recorder's blocks cover
+static void card_wait(int64_t us) {
+    sim_sleep_until(sim_now_us() + us);
+}
+
+static const sim_sd_timing_t card_timing = { .write_us = 1000, .bytes_per_ms = 2000, .stall_every = 64, .stall_us = 250000,
+    .wait = card_wait };
+static sim_sd_stats_t card_stats;
+
+void sim_sd_report(FILE* out) {
+    sim_sd_stats_t s;
+    sim_sd_stats_copy(&s, &card_stats);
+    if (s.writes == 0) return;
+    fprintf(out, "sim: sd card %llu writes, %.1f MB, %llu not whole sectors, largest %llu bytes, busy %.1f s, worst %lld ms\n",
+        (unsigned long long)s.writes, s.bytes / 1e6, (unsigned long long)s.unaligned, (unsigned long long)s.largest,
+        s.busy_us / 1e6, (long long)(s.worst_us / 1000));
+}
+
+// path on the host for a firmware path, unchanged outside the mount point
+static const char* host_path(const char* path, char* out, size_t out_len) {
+    size_t n = strlen(mount_point);
+    if (n == 0 || strncmp(path, mount_point, n) != 0 || (path[n] != '/' && path[n] != '\0')) return path;
+    snprintf(out, out_len, "%s%s", sim_config.sd_dir, path + n);
+    return out;
+}
+
+FILE* sim_vfs_fopen(const char* path, const char* mode) {
+    char buf[512];
+    const char* host = host_path(path, buf, sizeof(buf));
+    if (host == path) return fopen(path, mode);
+    return sim_sd_open(host, mode, &card_timing, &card_stats);
+}
+
+int sim_vfs_stat(const char* path, struct stat* st) {
+    char buf[512];
+    return stat(host_path(path, buf, sizeof(buf)), st);
+}
+
+int sim_vfs_remove(const char* path) {
+    char buf[512];
+    return remove(host_path(path, buf, sizeof(buf)));
+}
@@ -0,0 +1,512 @@
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include "sim.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_timer.h"
+
+// clock
+
+static struct timespec clock_origin;
+
+void sim_clock_start(void) {
+    clock_gettime(CLOCK_MONOTONIC, &clock_origin);
+}
+
+static int64_t wall_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)(ts.tv_sec - clock_origin.tv_sec) * 1000000000 + (ts.tv_nsec - clock_origin.tv_nsec);
+}
+
+int64_t sim_wall_us(void) {
+    return wall_ns() / 1000;
+}
+
+int64_t sim_now_us(void) {
+    return (int64_t)((double)wall_ns() * sim_config.speed / 1000.0);
+}
+
+struct timespec sim_deadline(int64_t sim_us) {
+    int64_t ns = (int64_t)((double)sim_us * 1000.0 / sim_config.speed);
+    struct timespec ts = clock_origin;
+    ts.tv_sec += ns / 1000000000;
+    ts.tv_nsec += ns % 1000000000;
+    if (ts.tv_nsec >= 1000000000) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+    }
+    return ts;
+}
+
+void sim_sleep_until(int64_t sim_us) {
+    struct timespec ts = sim_deadline(sim_us);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {}
+}
+
+int64_t esp_timer_get_time(void) {
+    return sim_now_us();
+}
+
+void sim_cond_init(pthread_cond_t* cond) {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+bool sim_cond_wait(pthread_cond_t* cond, pthread_mutex_t* lock, const struct timespec* deadline) {
+    if (deadline == NULL) {
+        pthread_cond_wait(cond, lock);
+        return true;
+    }
+    return pthread_cond_timedwait(cond, lock, deadline) != ETIMEDOUT;
+}
+
+// ticks are counted from simulated time. false for portMAX_DELAY, which never times out
+static bool tick_deadline(TickType_t ticks, struct timespec* deadline) {
+    if (ticks == portMAX_DELAY) return false;
+    *deadline = sim_deadline(sim_now_us() + (int64_t)ticks * 1000000 / configTICK_RATE_HZ);
+    return true;
+}
+
+TickType_t xTaskGetTickCount(void) {
+    return (TickType_t)(sim_now_us() * configTICK_RATE_HZ / 1000000);
+}
+
+TickType_t xTaskGetTickCountFromISR(void) {
+    return xTaskGetTickCount();
+}
+
+void vTaskDelay(TickType_t ticks) {
+    sim_sleep_until(sim_now_us() + (int64_t)ticks * 1000000 / configTICK_RATE_HZ);
+}
+
+void vTaskDelayUntil(TickType_t* previous_wake, TickType_t increment) {
+    *previous_wake += increment;
+    sim_sleep_until((int64_t)*previous_wake * 1000000 / configTICK_RATE_HZ);
+}
+
+// tasks
+
+#define MAX_TASKS 64
+#define STACK_FILL 0xA5
+#if defined(__SANITIZE_THREAD__) || defined(__SANITIZE_ADDRESS__)
+#define STACK_SLACK (1024 * 1024) // the sanitizers refuse smaller thread stacks
+#elif defined(__has_feature)
+#if __has_feature(thread_sanitizer) || __has_feature(address_sanitizer)
+#define STACK_SLACK (1024 * 1024)
+#endif
+#endif
+#ifndef STACK_SLACK
+#define STACK_SLACK (64 * 1024)
+#endif
+
+struct tskTaskControlBlock {
+    pthread_t thread;
+    char name[configMAX_TASK_NAME_LEN];
+    UBaseType_t priority;
+    UBaseType_t number;
+    BaseType_t core;
+    TaskFunction_t fn;
+    void* param;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t notify_value;
+    bool notify_pending;
+    _Atomic int state; // eTaskState
+    uint8_t* map; // stack mapping, guard page at the bottom
+    size_t map_bytes;
+    uint8_t* stack; // usable part, grows down from stack + stack_bytes
+    size_t stack_bytes;
+    uint32_t requested; // what the firmware asked for
+    size_t base_used; // host thread start-up (tls, glibc) already on the stack before the task function ran
+    clockid_t cpu_clock;
+};
+
+static pthread_mutex_t tasks_lock = PTHREAD_MUTEX_INITIALIZER;
+static TaskHandle_t tasks[MAX_TASKS];
+static UBaseType_t task_count = 0;
+static __thread TaskHandle_t current_task = NULL;
+
+static void* task_entry(void* arg) {
+    TaskHandle_t task = arg;
+    current_task = task;
+    volatile uint8_t here = 0;
+    task->base_used = (size_t)(task->stack + task->stack_bytes - (uint8_t*)&here);
+    atomic_store(&task->state, eRunning);
+    task->fn(task->param);
+    // freertos tasks must never return, esp-idf aborts when one does
+    fprintf(stderr, "sim: task %s returned from its function\n", task->name);
+    abort();
+    return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char* name, uint32_t stack_depth, void* param,
+                                   UBaseType_t priority, TaskHandle_t* created, BaseType_t core_id) {
+    TaskHandle_t task = calloc(1, sizeof(*task));
+    if (task == NULL) return pdFAIL;
+    strncpy(task->name, name, sizeof(task->name) - 1);
+    task->priority = (priority < configMAX_PRIORITIES) ? priority : configMAX_PRIORITIES - 1;
+    task->core = core_id;
+    task->fn = fn;
+    task->param = param;
+    task->requested = stack_depth;
+    pthread_mutex_init(&task->lock, NULL);
+    sim_cond_init(&task->cond);
+    atomic_init(&task->state, eReady);
+
+    // host frames are bigger than xtensa ones and glibc wants room of its own, so the real stack is a lot larger.
+    // it is prefilled so the high water mark can be read back like freertos does
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    task->stack_bytes = ((size_t)stack_depth * 4 + STACK_SLACK + page - 1) / page * page;
+    task->map_bytes = task->stack_bytes + page;
+    task->map = mmap(NULL, task->map_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+    if (task->map == MAP_FAILED) {
+        free(task);
+        return pdFAIL;
+    }
+    mprotect(task->map, page, PROT_NONE);
+    task->stack = task->map + page;
+    memset(task->stack, STACK_FILL, task->stack_bytes);
+
+    pthread_mutex_lock(&tasks_lock);
+    if (task_count == MAX_TASKS) {
+        pthread_mutex_unlock(&tasks_lock);
+        munmap(task->map, task->map_bytes);
+        free(task);
+        return pdFAIL;
+    }
+    task->number = task_count + 1;
+    tasks[task_count++] = task;
+    if (created != NULL) *created = task; // before the task runs, it may hand its own handle around
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstack(&attr, task->stack, task->stack_bytes);
+    int err = pthread_create(&task->thread, &attr, task_entry, task);
+    pthread_attr_destroy(&attr);
+    if (err != 0) {
+        fprintf(stderr, "sim: can't start task %s: %s\n", name, strerror(err));
+        abort();
+    }
+    pthread_getcpuclockid(task->thread, &task->cpu_clock);
+    if (sim_config.pin && core_id != tskNO_AFFINITY) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET((int)(core_id % sysconf(_SC_NPROCESSORS_ONLN)), &cpus);
+        pthread_setaffinity_np(task->thread, sizeof(cpus), &cpus);
+    }
+    pthread_detach(task->thread); // nothing joins a task, vTaskDelete just ends its thread
+    pthread_mutex_unlock(&tasks_lock);
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task) {
+    if (task == NULL) task = current_task;
+    if (task != current_task) {
+        fprintf(stderr, "sim: vTaskDelete of another task (%s) is not supported\n", task->name);
+        abort();
+    }
+    atomic_store(&task->state, eDeleted);
+    pthread_exit(NULL);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+    return current_task;
+}
+
+char* pcTaskGetName(TaskHandle_t task) {
+    if (task == NULL) task = current_task;
+    return (task != NULL) ? task->name : NULL;
+}
+
+UBaseType_t uxTaskPriorityGet(TaskHandle_t task) {
+    if (task == NULL) task = current_task;
+    return (task != NULL) ? task->priority : 0;
+}
+
+UBaseType_t uxTaskGetNumberOfTasks(void) {
+    pthread_mutex_lock(&tasks_lock);
+    UBaseType_t alive = 0;
+    for (UBaseType_t i = 0; i < task_count; i++) alive += atomic_load(&tasks[i]->state) != eDeleted;
+    pthread_mutex_unlock(&tasks_lock);
+    return alive;
+}
+
+// deepest the task itself has been into its stack, the host thread's start-up not counted
+static size_t stack_used(TaskHandle_t task) {
+    size_t untouched = 0;
+    while (untouched < task->stack_bytes && task->stack[untouched] == STACK_FILL) untouched++;
+    size_t used = task->stack_bytes - untouched;
+    return (used > task->base_used) ? used - task->base_used : 0;
+}
+
+// bytes of the requested stack never touched
+static uint32_t stack_free(TaskHandle_t task) {
+    size_t used = stack_used(task);
+    return (used < task->requested) ? (uint32_t)(task->requested - used) : 0;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+    if (task == NULL) task = current_task;
+    return (task != NULL) ? stack_free(task) : 0;
+}
+
+static uint32_t cpu_us(TaskHandle_t task) {
+    struct timespec ts;
+    if (atomic_load(&task->state) == eDeleted || clock_gettime(task->cpu_clock, &ts) != 0) return 0;
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+}
+
+UBaseType_t uxTaskGetSystemState(TaskStatus_t* status, UBaseType_t max, uint32_t* total_run_time) {
+    pthread_mutex_lock(&tasks_lock);
+    UBaseType_t count = 0;
+    for (UBaseType_t i = 0; i < task_count; i++) {
+        TaskHandle_t task = tasks[i];
+        if (atomic_load(&task->state) == eDeleted) continue;
+        if (count == max) {
+            count = 0; // like freertos: nothing if the array is too small
+            break;
+        }
+        TaskStatus_t* s = &status[count++];
+        s->xHandle = task;
+        s->pcTaskName = task->name;
+        s->xTaskNumber = task->number;
+        s->eCurrentState = (eTaskState)atomic_load(&task->state);
+        s->uxCurrentPriority = task->priority;
+        s->uxBasePriority = task->priority;
+        s->ulRunTimeCounter = cpu_us(task);
+        s->pxStackBase = task->stack;
+        s->usStackHighWaterMark = stack_free(task);
+        s->xCoreID = task->core;
+    }
+    pthread_mutex_unlock(&tasks_lock);
+    // run time is host cpu time, so the total is wall clock: a task's share is of one host core
+    if (total_run_time != NULL) *total_run_time = (uint32_t)sim_wall_us();
+    return count;
+}
+
+void sim_task_report(FILE* out) {
+    int64_t wall = sim_wall_us();
+    fprintf(out, "sim: %-16s %4s %4s %7s %15s\n", "task", "prio", "core", "cpu", "stack used");
+    pthread_mutex_lock(&tasks_lock);
+    for (UBaseType_t i = 0; i < task_count; i++) {
+        TaskHandle_t task = tasks[i];
+        if (atomic_load(&task->state) == eDeleted) continue;
+        char core[12] = "-";
+        if (task->core != tskNO_AFFINITY) snprintf(core, sizeof(core), "%d", task->core);
+        // can go past the request, the real stack is bigger. a host printf alone takes a few kB
+        fprintf(out, "sim:   %-14s %4u %4s %6.1f%% %7lu/%-7lu\n", task->name, task->priority, core,
+            (wall > 0) ? 100.0 * cpu_us(task) / wall : 0.0,
+            (unsigned long)stack_used(task), (unsigned long)task->requested);
+    }
+    pthread_mutex_unlock(&tasks_lock);
+}
+
+// esp-idf starts app_main in a task of its own, which is deleted when it returns
+extern void app_main(void);
+
+static void main_task(void* param) {
+    app_main();
+    vTaskDelete(NULL);
+}
+
+void sim_run_app_main(void) {
+    xTaskCreatePinnedToCore(main_task, "main", CONFIG_ESP_MAIN_TASK_STACK_SIZE, NULL, 1, NULL, 0);
+}
+
+// notifications
+
+BaseType_t xTaskGenericNotify(TaskHandle_t task, uint32_t value, eNotifyAction action, uint32_t* previous) {
+    if (task == NULL) {
+        fprintf(stderr, "sim: notify of a NULL task\n");
+        abort();
+    }
+    BaseType_t ret = pdPASS;
+    pthread_mutex_lock(&task->lock);
+    if (previous != NULL) *previous = task->notify_value;
+    switch (action) {
+        case eSetBits:
+            task->notify_value |= value;
+            break;
+        case eIncrement:
+            task->notify_value++;
+            break;
+        case eSetValueWithOverwrite:
+            task->notify_value = value;
+            break;
+        case eSetValueWithoutOverwrite:
+            if (task->notify_pending) ret = pdFAIL;
+            else task->notify_value = value;
+            break;
+        case eNoAction:
+            break;
+    }
+    task->notify_pending = true;
+    pthread_cond_signal(&task->cond);
+    pthread_mutex_unlock(&task->lock);
+    return ret;
+}
+
+// a --preempt for this task that is due: the wake-up comes that much later
+static void preempt_point(TaskHandle_t task) {
+    for (int i = 0; i < sim_config.preempt_count; i++) {
+        if (sim_config.preempts[i].done || strcmp(sim_config.preempts[i].task, task->name) != 0) continue;
+        int64_t now = sim_now_us();
+        if (now < sim_config.preempts[i].at_us) continue;
+        sim_config.preempts[i].done = true;
+        sim_sleep_until(now + sim_config.preempts[i].len_us);
+    }
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks) {
+    TaskHandle_t task = current_task;
+    struct timespec deadline;
+    bool timed = tick_deadline(ticks, &deadline);
+    pthread_mutex_lock(&task->lock);
+    atomic_store(&task->state, eBlocked);
+    while (task->notify_value == 0 && ticks != 0) {
+        if (!sim_cond_wait(&task->cond, &task->lock, timed ? &deadline : NULL)) break;
+    }
+    atomic_store(&task->state, eRunning);
+    uint32_t value = task->notify_value;
+    if (value != 0) task->notify_value = clear_on_exit ? 0 : value - 1;
+    task->notify_pending = false;
+    pthread_mutex_unlock(&task->lock);
+    preempt_point(task);
+    return value;
+}
+
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit, uint32_t* value, TickType_t ticks) {
+    TaskHandle_t task = current_task;
+    struct timespec deadline;
+    bool timed = tick_deadline(ticks, &deadline);
+    pthread_mutex_lock(&task->lock);
+    if (!task->notify_pending) task->notify_value &= ~clear_on_entry;
+    atomic_store(&task->state, eBlocked);
+    while (!task->notify_pending && ticks != 0) {
+        if (!sim_cond_wait(&task->cond, &task->lock, timed ? &deadline : NULL)) break;
+    }
+    atomic_store(&task->state, eRunning);
+    if (value != NULL) *value = task->notify_value;
+    BaseType_t ret = task->notify_pending ? pdTRUE : pdFALSE;
+    if (ret == pdTRUE) task->notify_value &= ~clear_on_exit;
+    task->notify_pending = false;
+    pthread_mutex_unlock(&task->lock);
+    preempt_point(task);
+    return ret;
+}
+
+// queues
+
+struct QueueDefinition {
+    pthread_mutex_t lock;
+    pthread_cond_t changed; // items came or went
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t head;
+    UBaseType_t count;
+    uint8_t* items;
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+    if (length == 0) return NULL;
+    QueueHandle_t q = calloc(1, sizeof(*q) + (size_t)length * item_size);
+    if (q == NULL) return NULL;
+    pthread_mutex_init(&q->lock, NULL);
+    sim_cond_init(&q->changed);
+    q->length = length;
+    q->item_size = item_size;
+    q->items = (uint8_t*)(q + 1);
+    return q;
+}
+
+void vQueueDelete(QueueHandle_t q) {
+    pthread_mutex_destroy(&q->lock);
+    pthread_cond_destroy(&q->changed);
+    free(q);
+}
+
+BaseType_t xQueueGenericSend(QueueHandle_t q, const void* item, TickType_t ticks, BaseType_t to_front) {
+    struct timespec deadline;
+    bool timed = tick_deadline(ticks, &deadline);
+    pthread_mutex_lock(&q->lock);
+    while (q->count == q->length) {
+        if (ticks == 0 || !sim_cond_wait(&q->changed, &q->lock, timed ? &deadline : NULL)) {
+            if (q->count < q->length) break;
+            pthread_mutex_unlock(&q->lock);
+            return errQUEUE_FULL;
+        }
+    }
+    UBaseType_t slot;
+    if (to_front) {
+        q->head = (q->head + q->length - 1) % q->length;
+        slot = q->head;
+    } else {
+        slot = (q->head + q->count) % q->length;
+    }
+    memcpy(q->items + (size_t)slot * q->item_size, item, q->item_size);
+    q->count++;
+    pthread_cond_broadcast(&q->changed);
+    pthread_mutex_unlock(&q->lock);
+    return pdPASS;
+}
+
+static BaseType_t queue_take(QueueHandle_t q, void* item, TickType_t ticks, bool remove) {
+    struct timespec deadline;
+    bool timed = tick_deadline(ticks, &deadline);
+    pthread_mutex_lock(&q->lock);
+    while (q->count == 0) {
+        if (ticks == 0 || !sim_cond_wait(&q->changed, &q->lock, timed ? &deadline : NULL)) {
+            if (q->count > 0) break;
+            pthread_mutex_unlock(&q->lock);
+            return errQUEUE_EMPTY;
+        }
+    }
+    memcpy(item, q->items + (size_t)q->head * q->item_size, q->item_size);
+    if (remove) {
+        q->head = (q->head + 1) % q->length;
+        q->count--;
+        pthread_cond_broadcast(&q->changed);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return pdPASS;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void* item, TickType_t ticks) {
+    return queue_take(q, item, ticks, true);
+}
+
+BaseType_t xQueuePeek(QueueHandle_t q, void* item, TickType_t ticks) {
+    return queue_take(q, item, ticks, false);
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q) {
+    pthread_mutex_lock(&q->lock);
+    UBaseType_t count = q->count;
+    pthread_mutex_unlock(&q->lock);
+    return count;
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t q) {
+    pthread_mutex_lock(&q->lock);
+    UBaseType_t spaces = q->length - q->count;
+    pthread_mutex_unlock(&q->lock);
+    return spaces;
+}
+
+BaseType_t xQueueReset(QueueHandle_t q) {
+    pthread_mutex_lock(&q->lock);
+    q->head = 0;
+    q->count = 0;
+    pthread_cond_broadcast(&q->changed);
+    pthread_mutex_unlock(&q->lock);
+    return pdPASS;
+}
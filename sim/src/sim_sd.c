@@ -0,0 +1,94 @@
+// sd card as a block device: a host file behind a stdio FILE, so the firmware's fwrite/fseek/fflush run unchanged.
+// every write lands at its offset in the host file, is counted in 512 byte sectors and is charged the time a card
+// would take for it
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "sim.h"
+
+typedef struct {
+    int fd;
+    off_t pos;
+    sim_sd_timing_t timing;
+    sim_sd_stats_t* stats;
+    sim_sd_stats_t own; // when the caller doesn't want them
+} sd_file_t;
+
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER; // the report reads them while a task writes
+
+static ssize_t sd_read(void* cookie, char* buf, size_t size) {
+    sd_file_t* f = cookie;
+    ssize_t n = pread(f->fd, buf, size, f->pos);
+    if (n > 0) f->pos += n;
+    return n;
+}
+
+static ssize_t sd_write(void* cookie, const char* buf, size_t size) {
+    sd_file_t* f = cookie;
+    const sim_sd_timing_t* t = &f->timing;
+    if (t->capacity != 0) { // full card: short, then nothing
+        if ((uint64_t)f->pos >= t->capacity) return 0;
+        if ((uint64_t)f->pos + size > t->capacity) size = (size_t)(t->capacity - (uint64_t)f->pos);
+    }
+    ssize_t n = pwrite(f->fd, buf, size, f->pos);
+    if (n <= 0) return 0;
+
+    int64_t us = t->write_us + (t->bytes_per_ms ? (int64_t)n * 1000 / t->bytes_per_ms : 0);
+    sim_sd_stats_t* s = f->stats;
+    pthread_mutex_lock(&stats_lock);
+    s->writes++;
+    s->bytes += (uint64_t)n;
+    if (f->pos % SIM_SD_SECTOR != 0 || n % SIM_SD_SECTOR != 0) s->unaligned++;
+    s->largest = ((uint64_t)n > s->largest) ? (uint64_t)n : s->largest;
+    if (t->stall_every != 0 && s->writes % t->stall_every == 0) us += t->stall_us;
+    s->busy_us += us;
+    s->worst_us = (us > s->worst_us) ? us : s->worst_us;
+    pthread_mutex_unlock(&stats_lock);
+    if (t->wait != NULL && us > 0) t->wait(us);
+    f->pos += n;
+    return n;
+}
+
+static int sd_seek(void* cookie, off64_t* offset, int whence) {
+    sd_file_t* f = cookie;
+    off_t base = (whence == SEEK_SET) ? 0 : (whence == SEEK_CUR) ? f->pos : lseek(f->fd, 0, SEEK_END);
+    if (base < 0 || base + *offset < 0) return -1;
+    f->pos = base + *offset;
+    *offset = f->pos;
+    return 0;
+}
+
+static int sd_close(void* cookie) {
+    sd_file_t* f = cookie;
+    int ret = close(f->fd);
+    free(f);
+    return ret;
+}
+
+FILE* sim_sd_open(const char* path, const char* mode, const sim_sd_timing_t* timing, sim_sd_stats_t* stats) {
+    int flags = O_RDONLY;
+    if (mode[0] == 'w') flags = O_WRONLY | O_CREAT | O_TRUNC;
+    else if (mode[0] == 'a') flags = O_WRONLY | O_CREAT;
+    if (strchr(mode, '+') != NULL) flags = (flags & ~(O_RDONLY | O_WRONLY)) | O_RDWR;
+    sd_file_t* f = calloc(1, sizeof(*f));
+    if (f == NULL) return NULL;
+    f->fd = open(path, flags, 0644);
+    if (f->fd < 0) {
+        free(f);
+        return NULL;
+    }
+    if (mode[0] == 'a') f->pos = lseek(f->fd, 0, SEEK_END);
+    if (timing != NULL) f->timing = *timing;
+    f->stats = (stats != NULL) ? stats : &f->own;
+    cookie_io_functions_t io = { .read = sd_read, .write = sd_write, .seek = sd_seek, .close = sd_close };
+    FILE* file = fopencookie(f, mode, io);
+    if (file == NULL) sd_close(f);
+    return file;
+}
+
+void sim_sd_stats_copy(sim_sd_stats_t* out, const sim_sd_stats_t* stats) {
+    pthread_mutex_lock(&stats_lock);
+    *out = *stats;
+    pthread_mutex_unlock(&stats_lock);
+}
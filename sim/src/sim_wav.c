@@ -0,0 +1,142 @@
+#include <string.h>
+#include "sim.h"
+
+static uint16_t get16(const uint8_t* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get32(const uint8_t* p) {
+    return get16(p) | ((uint32_t)get16(p + 2) << 16);
+}
+
+static void put16(uint8_t* p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put32(uint8_t* p, uint32_t v) {
+    put16(p, (uint16_t)v);
+    put16(p + 2, (uint16_t)(v >> 16));
+}
+
+bool sim_wav_open(sim_wav_t* wav, const char* path, uint32_t raw_rate, uint16_t raw_channels) {
+    memset(wav, 0, sizeof(*wav));
+    wav->file = fopen(path, "rb");
+    if (wav->file == NULL) {
+        fprintf(stderr, "sim: can't open %s\n", path);
+        return false;
+    }
+    uint8_t h[12];
+    if (fread(h, 1, sizeof(h), wav->file) != sizeof(h) || memcmp(h, "RIFF", 4) != 0 || memcmp(h + 8, "WAVE", 4) != 0) {
+        fseek(wav->file, 0, SEEK_END);
+        wav->channels = raw_channels;
+        wav->bits = 16;
+        wav->rate = raw_rate;
+        wav->data_start = 0;
+        wav->data_bytes = (uint32_t)ftell(wav->file);
+        fseek(wav->file, 0, SEEK_SET);
+        return true;
+    }
+    // walk the chunks for fmt and data, anything else is skipped
+    bool have_fmt = false;
+    uint8_t c[8];
+    while (fread(c, 1, sizeof(c), wav->file) == sizeof(c)) {
+        uint32_t len = get32(c + 4);
+        if (memcmp(c, "fmt ", 4) == 0) {
+            uint8_t f[16];
+            if (len < sizeof(f) || fread(f, 1, sizeof(f), wav->file) != sizeof(f)) break;
+            uint16_t format = get16(f);
+            wav->channels = get16(f + 2);
+            wav->rate = get32(f + 4);
+            wav->bits = get16(f + 14);
+            if ((format != 1 && format != 0xFFFE) || wav->bits != 16 || wav->channels == 0) {
+                fprintf(stderr, "sim: %s is not 16 bit pcm\n", path);
+                break;
+            }
+            have_fmt = true;
+            fseek(wav->file, (long)(len - sizeof(f) + (len & 1)), SEEK_CUR);
+        } else if (memcmp(c, "data", 4) == 0 && have_fmt) {
+            wav->data_start = ftell(wav->file);
+            wav->data_bytes = len / (2u * wav->channels) * (2u * wav->channels);
+            return true;
+        } else {
+            fseek(wav->file, (long)(len + (len & 1)), SEEK_CUR);
+        }
+    }
+    fprintf(stderr, "sim: %s has no usable data\n", path);
+    fclose(wav->file);
+    wav->file = NULL;
+    return false;
+}
+
+void sim_wav_read(sim_wav_t* wav, int16_t* out, size_t frames) {
+    size_t frame_bytes = 2u * wav->channels;
+    if (wav->file == NULL || wav->data_bytes < frame_bytes) {
+        memset(out, 0, frames * frame_bytes);
+        return;
+    }
+    uint8_t* dst = (uint8_t*)out;
+    size_t want = frames * frame_bytes;
+    while (want > 0) {
+        if (wav->pos >= wav->data_bytes) wav->pos = 0;
+        size_t n = wav->data_bytes - wav->pos;
+        if (n > want) n = want;
+        fseek(wav->file, wav->data_start + (long)wav->pos, SEEK_SET);
+        size_t got = fread(dst, 1, n, wav->file);
+        if (got == 0) { // cut short under us, play silence from here
+            memset(dst, 0, want);
+            return;
+        }
+        wav->pos += (uint32_t)got;
+        dst += got;
+        want -= got;
+    }
+}
+
+static bool write_header(sim_wav_t* wav) {
+    uint8_t h[44];
+    memcpy(h, "RIFF", 4);
+    put32(h + 4, 36 + wav->data_bytes);
+    memcpy(h + 8, "WAVEfmt ", 8);
+    put32(h + 16, 16);
+    put16(h + 20, 1);
+    put16(h + 22, wav->channels);
+    put32(h + 24, wav->rate);
+    put32(h + 28, wav->rate * wav->channels * (wav->bits / 8));
+    put16(h + 32, (uint16_t)(wav->channels * (wav->bits / 8)));
+    put16(h + 34, wav->bits);
+    memcpy(h + 36, "data", 4);
+    put32(h + 40, wav->data_bytes);
+    return fwrite(h, 1, sizeof(h), wav->file) == sizeof(h);
+}
+
+bool sim_wav_create(sim_wav_t* wav, const char* path, uint16_t channels, uint16_t bits, uint32_t rate) {
+    memset(wav, 0, sizeof(*wav));
+    wav->channels = channels;
+    wav->bits = bits;
+    wav->rate = rate;
+    wav->created = true;
+    wav->file = fopen(path, "wb");
+    if (wav->file == NULL || !write_header(wav)) {
+        fprintf(stderr, "sim: can't write %s\n", path);
+        if (wav->file != NULL) fclose(wav->file);
+        wav->file = NULL;
+        return false;
+    }
+    return true;
+}
+
+void sim_wav_write(sim_wav_t* wav, const void* data, size_t bytes) {
+    if (wav->file == NULL) return;
+    wav->data_bytes += (uint32_t)fwrite(data, 1, bytes, wav->file);
+}
+
+void sim_wav_close(sim_wav_t* wav) {
+    if (wav->file == NULL) return;
+    if (wav->created) {
+        fseek(wav->file, 0, SEEK_SET);
+        write_header(wav);
+    }
+    fclose(wav->file);
+    wav->file = NULL;
+}
@@ -0,0 +1,58 @@
+#!/bin/sh
+# host tests and benchmarks for the firmware libs, built the same way sim/build.sh builds the firmware, e.g.
+#   sim/test.sh                      every sim/test/test_*.c, then the test_*.sh scripts
+#   sim/test.sh mixer_exact          just sim/test/test_mixer_exact.c
+#   sim/test.sh --bench              the bench_*.c timings instead, best run on an idle box
+#   CFLAGS="-fsanitize=address,undefined -fno-sanitize-recover=all" sim/test.sh
+# each source names what it links on a "// uses:" line, variant/Lib for a firmware lib and sim/file for a sim
+# source. run from the repo root. exits 1 if anything failed to build or failed
+set -e
+kind=test
+if [ "$1" = "--bench" ]; then
+    kind=bench
+    shift
+fi
+[ -d sim/test ] || { echo "no sim/test here, run from the repo root" >&2; exit 1; }
+
+out=$(mktemp -d)
+trap 'rm -rf "$out"' EXIT
+
+if [ $# -eq 0 ]; then
+    set -- $(cd sim/test && ls ${kind}_*.c ${kind}_*.sh 2>/dev/null)
+fi
+
+failed=0
+for name in "$@"; do
+    name=${name#${kind}_}
+    name=${name%.c}
+    name=${name%.sh}
+    src=sim/test/${kind}_$name
+    if [ -f "$src.sh" ]; then
+        sh "$src.sh" || { echo "$name: FAILED" >&2; failed=1; }
+        continue
+    fi
+    [ -f "$src.c" ] || { echo "no $src.c" >&2; failed=1; continue; }
+
+    includes="-Isim/test -Isim/include"
+    sources=
+    for use in $(sed -n 's|^// uses: ||p' "$src.c"); do
+        variant=${use%%/*}
+        lib=${use#*/}
+        if [ "$variant" = sim ]; then
+            includes="$includes -Isim/src"
+            sources="$sources sim/src/$lib.c"
+        else
+            includes="$includes -I$variant/include -I$variant/lib/$lib"
+            sources="$sources $variant/lib/$lib/*.c"
+        fi
+    done
+    # same flags as the firmware build, minus ESP_PLATFORM so the libs take their host paths
+    if ! ${CC:-cc} -std=gnu11 -O2 -g -Wall -D_GNU_SOURCE -include stdint.h $includes $CFLAGS \
+        "$src.c" $sources -o "$out/$name" -lpthread -lm; then
+        echo "$name: did not build" >&2
+        failed=1
+        continue
+    fi
+    "$out/$name" || failed=1
+done
+exit $failed
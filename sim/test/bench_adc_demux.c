@@ -0,0 +1,100 @@
+// uses: analog_1a/AdcInput
+// adc_demux_process on analog_1a's scan frames, ADC_FRAME_SIZE/2 results of mic, aux and a knob in turn, against the
+// two pass way of doing it: split by channel into scratch buffers, then adc_input_process on each. and a mic-only
+// frame through the demux against adc_input_process, for what the routing costs when there is nothing to route
+#include "check.h"
+#include "constants.h"
+#include "AdcInput.h"
+
+#define FRAME (FRAME_SIZE/2) // samples per stream
+#define RESULTS (FRAME * 3)
+#define FRAMES 20000
+#define VARIANTS 16 // distinct input frames, cycled
+
+static const uint8_t pattern[9] = { 0, 3, 6, 0, 3, 7, 0, 3, 4 };
+static _Alignas(4) uint8_t scan[VARIANTS][RESULTS * 2];
+static _Alignas(4) uint8_t mic_only[VARIANTS][FRAME * 2];
+static _Alignas(4) uint8_t split[2][FRAME * 2];
+static int16_t mic[FRAME], aux[FRAME];
+
+static void setup(adc_demux_t* demux, bool scan) {
+    adc_demux_init(demux);
+    adc_demux_add_stream(demux, 0, 12, 0);
+    if (!scan) return;
+    adc_demux_add_stream(demux, 3, 12, 0);
+    for (int k = 0; k < 3; k++) adc_demux_add_control(demux, pattern[2 + 3 * k], 5, 3);
+}
+
+static void report(const char* what, int64_t ns, uint64_t cycles, int results) {
+    printf("adc demux, %-36s %.2f ns, %.1f cycles per result, %.1f us per frame\n", what, (double)ns / results,
+        (double)cycles / results, (double)ns / FRAMES / 1000);
+}
+
+int main(void) {
+    uint32_t rng = 5;
+    for (int v = 0; v < VARIANTS; v++) {
+        for (int i = 0; i < RESULTS; i++) {
+            uint8_t ch = pattern[i % 9];
+            uint16_t r = (uint16_t)(ch << 12 | (1500 + check_rand(&rng) % 1000));
+            scan[v][2 * i] = (uint8_t)r;
+            scan[v][2 * i + 1] = (uint8_t)(r >> 8);
+            if (i < FRAME) {
+                mic_only[v][2 * i] = (uint8_t)(r & 0xFFF);
+                mic_only[v][2 * i + 1] = (uint8_t)((r & 0xFFF) >> 8);
+            }
+        }
+    }
+    int16_t* streams[2] = { mic, aux };
+    size_t got[2];
+    uint32_t sum = 0;
+
+    adc_demux_t demux;
+    setup(&demux, true);
+    int64_t start = bench_ns();
+    uint64_t c0 = bench_cycles();
+    for (int f = 0; f < FRAMES; f++) {
+        adc_demux_process(&demux, scan[f % VARIANTS], RESULTS, streams, FRAME, got);
+        sum += (uint16_t)mic[f % FRAME] + (uint16_t)aux[f % FRAME];
+    }
+    report("scan, one pass:", bench_ns() - start, bench_cycles() - c0, FRAMES * RESULTS);
+
+    adc_input_t in[2];
+    adc_input_init(&in[0], 12, 0);
+    adc_input_init(&in[1], 12, 0);
+    start = bench_ns();
+    c0 = bench_cycles();
+    for (int f = 0; f < FRAMES; f++) {
+        const uint16_t* words = (const uint16_t*)scan[f % VARIANTS];
+        uint16_t* to[2] = { (uint16_t*)split[0], (uint16_t*)split[1] };
+        size_t n[2] = { 0, 0 };
+        for (int i = 0; i < RESULTS; i++) {
+            uint8_t ch = words[i] >> 12;
+            if (ch == 0) to[0][n[0]++] = words[i];
+            else if (ch == 3) to[1][n[1]++] = words[i];
+        }
+        adc_input_process(&in[0], split[0], mic, n[0]);
+        adc_input_process(&in[1], split[1], aux, n[1]);
+        sum += (uint16_t)mic[f % FRAME] + (uint16_t)aux[f % FRAME];
+    }
+    report("scan, split then adc_input_process:", bench_ns() - start, bench_cycles() - c0, FRAMES * RESULTS);
+
+    setup(&demux, false);
+    start = bench_ns();
+    c0 = bench_cycles();
+    for (int f = 0; f < FRAMES; f++) {
+        adc_demux_process(&demux, mic_only[f % VARIANTS], FRAME, streams, FRAME, got);
+        sum += (uint16_t)mic[f % FRAME];
+    }
+    report("mic only, demux:", bench_ns() - start, bench_cycles() - c0, FRAMES * FRAME);
+
+    adc_input_init(&in[0], 12, 0);
+    start = bench_ns();
+    c0 = bench_cycles();
+    for (int f = 0; f < FRAMES; f++) {
+        adc_input_process(&in[0], mic_only[f % VARIANTS], mic, FRAME);
+        sum += (uint16_t)mic[f % FRAME];
+    }
+    report("mic only, adc_input_process:", bench_ns() - start, bench_cycles() - c0, FRAMES * FRAME);
+    bench_sink = sum;
+    return 0;
+}
@@ -0,0 +1,54 @@
+// uses: analog_1a/AdcInput analog_1a/utils
+// the analog board's adc to pcm step as it was, convert_adc_sample and scale_adc_to_i2s per sample with a division
+// each, against adc_input_process over the same frames of FRAME_SIZE/2 results. the scan split is in bench_adc_demux
+#include "check.h"
+#include "constants.h"
+#include "AdcInput.h"
+#include "utils.h"
+
+#define FRAME (FRAME_SIZE/2)
+#define FRAMES 20000
+#define VARIANTS 16 // distinct input frames, cycled
+
+static _Alignas(4) uint8_t raw[VARIANTS][FRAME * 2];
+static int16_t out[FRAME];
+
+static void report(const char* what, int64_t ns, uint64_t cycles, int samples) {
+    printf("adc input, %-28s %.2f ns, %.1f cycles per sample, %.1f us per frame\n", what, (double)ns / samples,
+        (double)cycles / samples, (double)ns / FRAMES / 1000);
+}
+
+int main(void) {
+    uint32_t rng = 11;
+    for (int v = 0; v < VARIANTS; v++) {
+        for (int i = 0; i < FRAME; i++) {
+            uint16_t mic = (uint16_t)(1800 + check_rand(&rng) % 500);
+            raw[v][2 * i] = (uint8_t)mic;
+            raw[v][2 * i + 1] = (uint8_t)(mic >> 8);
+        }
+    }
+
+    uint16_t idle = find_idle_value(raw[0], FRAME * 2);
+    uint32_t sum = 0;
+    int64_t start = bench_ns();
+    uint64_t c0 = bench_cycles();
+    for (int f = 0; f < FRAMES; f++) {
+        const uint8_t* bytes = raw[f % VARIANTS];
+        for (int i = 0; i < FRAME * 2; i += 2) out[i / 2] = scale_adc_to_i2s(convert_adc_sample(bytes[i], bytes[i + 1]), idle);
+        sum += (uint16_t)out[f % FRAME];
+    }
+    report("convert + scale_adc_to_i2s:", bench_ns() - start, bench_cycles() - c0, FRAMES * FRAME);
+
+    adc_input_t in;
+    adc_input_init(&in, 12, 0);
+    start = bench_ns();
+    c0 = bench_cycles();
+    for (int f = 0; f < FRAMES; f++) {
+        adc_input_process(&in, raw[f % VARIANTS], out, FRAME);
+        sum += (uint16_t)out[f % FRAME];
+    }
+    report("adc_input_process:", bench_ns() - start, bench_cycles() - c0, FRAMES * FRAME);
+
+    bench_sink = sum;
+    return 0;
+}
@@ -0,0 +1,74 @@
+// uses: prod/Effects
+// cycles per sample of each vocal effect on its own, then the whole mic chain, over a sung voice at the mic rate.
+// pitch correction is timed on a voice off the note so the shifter and the estimate both run
+#include <string.h>
+#include "check.h"
+#include "Effects.h"
+
+#define RATE 44100
+#define FRAME 256
+#define SECONDS 10
+#define FRAMES (RATE * SECONDS / FRAME)
+
+static int32_t input[FRAMES * FRAME];
+static int32_t frame[FRAME];
+
+static void bench(const char* name, effect_process_fn fn, void* state) {
+    uint64_t cycles = 0, worst = 0;
+    uint32_t sum = 0;
+    for (int f = 0; f < FRAMES; f++) {
+        memcpy(frame, input + f * FRAME, sizeof(frame));
+        uint64_t c0 = bench_cycles();
+        fn(state, frame, FRAME);
+        uint64_t c = bench_cycles() - c0;
+        cycles += c;
+        if (c > worst && f > 0) worst = c;
+        sum += (uint32_t)frame[f & (FRAME - 1)];
+    }
+    bench_sink = sum;
+    printf("  %-14s %7.2f cycles/sample, worst frame %6.2f cycles/sample\n", name, (double)cycles / ((double)FRAMES * FRAME),
+        (double)worst / FRAME);
+}
+
+static void chain_process(void* state, int32_t* x, size_t n) {
+    effects_chain_process(state, x, n);
+}
+
+int main(void) {
+    double phase = 0;
+    for (int i = 0; i < FRAMES * FRAME; i++) {
+        double s = 0;
+        for (int h = 1; h <= 6; h++) s += sin(phase * h) / h;
+        double level = 0.05 + 0.4 * fabs(sin(M_PI * i / (2.0 * RATE))); // swells every 2 s
+        input[i] = (int32_t)(level * 2147483647.0 * s / 2.45);
+        phase += 2 * M_PI * 227.0 / RATE; // 27 cents sharp of a3
+    }
+
+    static effect_echo_t echo;
+    static effect_reverb_t reverb;
+    static effect_compressor_t comp;
+    static effect_pitch_correct_t pc;
+    static effects_chain_t chain;
+    printf("effects: %d samples/frame at %d Hz\n", FRAME, RATE);
+    effect_echo_init(&echo, RATE / 8, 9830, 8192);
+    bench("echo", effect_echo_process, &echo);
+    effect_reverb_init(&reverb, 27525, 6554, 9830);
+    bench("reverb", effect_reverb_process, &reverb);
+    effect_compressor_init(&comp, 0x20000000, 4, 1000, 20, EFFECTS_UNITY);
+    bench("compressor", effect_compressor_process, &comp);
+    effect_pitch_correct_init(&pc, RATE, EFFECTS_UNITY, EFFECTS_UNITY / 2);
+    bench("pitch correct", effect_pitch_correct_process, &pc);
+
+    // main.c's order, one mic: compressor -> pitch correction, then echo -> reverb on the bus
+    effect_echo_init(&echo, RATE / 8, 9830, 8192);
+    effect_reverb_init(&reverb, 27525, 6554, 9830);
+    effect_compressor_init(&comp, 0x20000000, 4, 1000, 20, EFFECTS_UNITY);
+    effect_pitch_correct_init(&pc, RATE, EFFECTS_UNITY, EFFECTS_UNITY / 2);
+    effects_chain_init(&chain);
+    effects_chain_add(&chain, effect_compressor_process, &comp);
+    effects_chain_add(&chain, effect_pitch_correct_process, &pc);
+    effects_chain_add(&chain, effect_echo_process, &echo);
+    effects_chain_add(&chain, effect_reverb_process, &reverb);
+    bench("chain", chain_process, &chain);
+    return 0;
+}
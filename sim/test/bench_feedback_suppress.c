@@ -0,0 +1,59 @@
+// uses: prod/FeedbackSuppress prod/Biquad
+// the howl suppressor over 10 s of a talker, a mic frame at a time as the write task runs it, with no notches, half
+// the bank and all of it placed. every frame is a hop, so every frame pays for the fft. cycles per frame, to set
+// against the rest of the voice chain
+#include <string.h>
+#include "check.h"
+#include "FeedbackSuppress.h"
+
+#define RATE 44100
+#define FRAME 256
+#define SECONDS 10
+#define FRAMES (RATE * SECONDS / FRAME)
+
+static int32_t voice[FRAMES * FRAME];
+static int32_t frame[FRAME];
+
+static void bench(int notches) {
+    static feedback_suppress_t fs;
+    feedback_suppress_init(&fs, RATE);
+    for (int n = 0; n < notches; n++) {
+        feedback_notch_t* notch = &fs.notches[n];
+        notch->freq = 500.0f + 900.0f * n;
+        notch->q = 30.0f;
+        notch->active = true;
+        biquad_notch(&notch->bq, RATE, notch->freq, notch->q);
+        biquad_reset(&notch->bq);
+    }
+    uint64_t cycles = 0, worst = 0;
+    int64_t total = 0;
+    uint32_t sum = 0;
+    for (int f = 0; f < FRAMES; f++) {
+        memcpy(frame, voice + f * FRAME, sizeof(frame));
+        int64_t start = bench_ns();
+        uint64_t c0 = bench_cycles();
+        feedback_suppress_process(&fs, frame, FRAME);
+        uint64_t c = bench_cycles() - c0;
+        total += bench_ns() - start;
+        cycles += c;
+        if (c > worst && f > 0) worst = c;
+        sum += (uint32_t)frame[f & (FRAME - 1)];
+    }
+    bench_sink = sum;
+    printf("feedback_suppress, %d notches: %.0f cycles/frame (%.1f/sample), worst frame %llu cycles, %.0f ns/frame "
+        "(%.2f%% of the %.0f us period)\n", notches, (double)cycles / FRAMES, (double)cycles / FRAMES / FRAME,
+        (unsigned long long)worst, (double)total / FRAMES, 100.0 * total / FRAMES / (1e9 * FRAME / RATE), 1e6 * FRAME / RATE);
+}
+
+int main(void) {
+    for (int i = 0; i < FRAMES * FRAME; i++) {
+        double t = (double)i / RATE;
+        double s = 0;
+        for (int h = 1; h <= 5; h++) s += sin(2 * M_PI * 180 * h * t + 3 * sin(2 * M_PI * 4 * t)) / h;
+        voice[i] = (int32_t)(s * (1 << 28));
+    }
+    bench(0);
+    bench(FEEDBACK_MAX_NOTCHES / 2);
+    bench(FEEDBACK_MAX_NOTCHES);
+    return 0;
+}
@@ -0,0 +1,88 @@
+// uses: analog_1a/Filter
+// the analog board's 7 kHz lowpass as it was, a function call per sample with a % 7 ring, against fir_process over
+// the same taps a frame at a time, at 256 samples and at the 1024 of FRAME_SIZE/2. an 80 Hz highpass section and
+// a decimator by 3 for scale
+#include <string.h>
+#include "check.h"
+#include "Filter.h"
+
+#define RATE 32000
+#define SECONDS 10
+#define SAMPLES (RATE * SECONDS)
+
+static int16_t signal[SAMPLES];
+static int16_t frame[1024];
+
+// the per-sample filter lowpass_7kHz replaced, as it was in analog_1a/src/main.c
+static const int16_t fir7_half[4] = { 175, 603, 886, 1024 };
+static int16_t lowpass_delay[7];
+static uint8_t idx = 0;
+
+__attribute__((noinline)) static int16_t lowpass_7kHz(int16_t x) {
+    lowpass_delay[idx] = x;
+    int32_t acc =  fir7_half[3] * lowpass_delay[idx]
+                 + fir7_half[2] * (lowpass_delay[(idx+6)%7] + lowpass_delay[(idx+1)%7])
+                 + fir7_half[1] * (lowpass_delay[(idx+5)%7] + lowpass_delay[(idx+2)%7])
+                 + fir7_half[0] * (lowpass_delay[(idx+4)%7] + lowpass_delay[(idx+3)%7]);
+    idx = (idx + 1) % 7;
+    return (int16_t)(acc >> 15);
+}
+
+static const int16_t fir7[7] = { 175, 603, 886, 1024, 886, 603, 175 };
+
+typedef enum { OLD_LOWPASS, BLOCK_FIR, RUMBLE, DECIMATE } kind_t;
+static const char* const names[] = { "lowpass_7kHz per sample", "fir_process, 7 taps", "biquad cascade, 1 section",
+    "decimator by 3, 7 taps" };
+
+static void bench(kind_t kind, size_t block) {
+    static fir_t fir;
+    static biquad_cascade_t bc;
+    static decimator_t dec;
+    fir_init(&fir, fir7, 7);
+    biquad_cascade_init(&bc);
+    biquad_cascade_add_highpass(&bc, RATE, 80, 0.7071f);
+    decimator_init(&dec, fir7, 7, 3);
+
+    size_t blocks = SAMPLES / block;
+    uint64_t cycles = 0;
+    int64_t total = 0;
+    uint32_t sum = 0;
+    for (size_t b = 0; b < blocks; b++) {
+        memcpy(frame, signal + b * block, block * sizeof(int16_t));
+        int64_t start = bench_ns();
+        uint64_t c0 = bench_cycles();
+        switch (kind) {
+        case OLD_LOWPASS:
+            for (size_t i = 0; i < block; i++) frame[i] = lowpass_7kHz(frame[i]);
+            break;
+        case BLOCK_FIR:
+            fir_process(&fir, frame, frame, block);
+            break;
+        case RUMBLE:
+            biquad_cascade_process(&bc, frame, frame, block);
+            break;
+        case DECIMATE:
+            decimator_process(&dec, frame, frame, block);
+            break;
+        }
+        cycles += bench_cycles() - c0;
+        total += bench_ns() - start;
+        sum += (uint16_t)frame[b & (block - 1)];
+    }
+    bench_sink = sum;
+    printf("filter %-26s %4zu samples: %.1f cycles/sample, %.2f ns/sample\n", names[kind], block,
+        (double)cycles / (blocks * block), (double)total / (blocks * block));
+}
+
+int main(void) {
+    uint32_t rng = 1;
+    for (int i = 0; i < SAMPLES; i++) {
+        double t = (double)i / RATE;
+        signal[i] = (int16_t)(9000 * sin(2 * M_PI * 220 * t) + 3000 * sin(2 * M_PI * 9000 * t) + (int16_t)check_rand(&rng) / 64);
+    }
+    static const size_t blocks[] = { 256, 1024 };
+    for (size_t b = 0; b < 2; b++) {
+        for (int kind = OLD_LOWPASS; kind <= DECIMATE; kind++) bench((kind_t)kind, blocks[b]);
+    }
+    return 0;
+}
@@ -0,0 +1,125 @@
+// uses: analog_1a/FramePool
+// the analog board's frame pools against the heap they replaced: an alloc and free back to back on one thread, and
+// the read task to processor hand-off, frames allocated on one thread and freed on another. then what the heap is
+// left with after the two frame sizes are held and freed in a random pattern, which the pools can't fragment.
+// glibc's per-thread cache flatters malloc on one thread, the idf heap takes a lock on every call instead
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include "check.h"
+#include "constants.h"
+#include "FramePool.h"
+
+typedef struct { _Alignas(4) uint8_t bytes[ADC_FRAME_SIZE]; } adc_frame_t; // as main.c has them
+typedef struct { int16_t samples[FRAME_SIZE/2]; } pcm_frame_t;
+FRAME_POOL_TYPED(adc_pool, adc_frame_t)
+FRAME_POOL_TYPED(pcm_pool, pcm_frame_t)
+
+#define POOL_FRAMES (FRAME_QUEUE_LEN + 2)
+#define OPS 20000000
+#define HANDOFFS 2000000
+
+static adc_frame_t adc_frames[POOL_FRAMES];
+static pcm_frame_t pcm_frames[POOL_FRAMES];
+static adc_pool_t adc_pool;
+static pcm_pool_t pcm_pool;
+
+static void bench_pair(bool pool) {
+    uint32_t sum = 0;
+    int64_t start = bench_ns();
+    uint64_t c0 = bench_cycles();
+    for (int i = 0; i < OPS; i++) {
+        pcm_frame_t* frame = pool ? pcm_pool_alloc(&pcm_pool) : malloc(sizeof(pcm_frame_t));
+        __asm__ volatile("" : : "r"(frame) : "memory"); // or the compiler drops the malloc and free
+        frame->samples[0] = (int16_t)i;
+        sum += (uint16_t)frame->samples[0];
+        if (pool) pcm_pool_free(&pcm_pool, frame);
+        else free(frame);
+    }
+    uint64_t cycles = bench_cycles() - c0;
+    int64_t ns = bench_ns() - start;
+    bench_sink = sum;
+    printf("frame pool, alloc+free on one thread, %-6s %.1f ns, %.0f cycles per pair\n", pool ? "pool:" : "heap:",
+        (double)ns / OPS, (double)cycles / OPS);
+}
+
+// a frame queue's worth of pointers between two threads, single producer, single consumer
+static void* _Atomic slots[FRAME_QUEUE_LEN];
+static _Atomic uint32_t sent, received;
+static bool use_pool;
+
+static void* producer(void* arg) {
+    (void)arg;
+    for (uint32_t i = 0; i < HANDOFFS; i++) {
+        adc_frame_t* frame;
+        while ((frame = use_pool ? adc_pool_alloc(&adc_pool) : malloc(sizeof(adc_frame_t))) == NULL) sched_yield();
+        frame->bytes[0] = (uint8_t)i;
+        while (i - atomic_load_explicit(&received, memory_order_acquire) == FRAME_QUEUE_LEN) sched_yield();
+        atomic_store_explicit(&slots[i % FRAME_QUEUE_LEN], frame, memory_order_relaxed);
+        atomic_store_explicit(&sent, i + 1, memory_order_release);
+    }
+    return NULL;
+}
+
+static void bench_handoff(bool pool) {
+    use_pool = pool;
+    atomic_store(&sent, 0);
+    atomic_store(&received, 0);
+    uint32_t sum = 0;
+    pthread_t thread;
+    int64_t start = bench_ns();
+    pthread_create(&thread, NULL, producer, NULL);
+    for (uint32_t i = 0; i < HANDOFFS; i++) {
+        while (atomic_load_explicit(&sent, memory_order_acquire) == i) sched_yield();
+        adc_frame_t* frame = atomic_load_explicit(&slots[i % FRAME_QUEUE_LEN], memory_order_relaxed);
+        sum += frame->bytes[0];
+        if (pool) adc_pool_free(&adc_pool, frame);
+        else free(frame);
+        atomic_store_explicit(&received, i + 1, memory_order_release);
+    }
+    pthread_join(thread, NULL);
+    int64_t ns = bench_ns() - start;
+    bench_sink = sum;
+    printf("frame pool, alloc on one thread, free on another, %-6s %.1f ns per frame\n", pool ? "pool:" : "heap:",
+        (double)ns / HANDOFFS);
+}
+
+// both frame sizes held for a random while, a few other allocations of the size the rest of the firmware makes
+// in between, then everything but a handful freed: how much of the heap is left free in how many pieces
+static void bench_fragmentation(void) {
+    enum { HELD = 64, ROUNDS = 200000 };
+    void* held[HELD] = { 0 };
+    uint32_t rng = 3;
+    for (int r = 0; r < ROUNDS; r++) {
+        int k = (int)(check_rand(&rng) % HELD);
+        free(held[k]);
+        uint32_t kind = check_rand(&rng) % 8;
+        size_t size = (kind < 3) ? sizeof(adc_frame_t) : (kind < 6) ? sizeof(pcm_frame_t) : 64 + check_rand(&rng) % 1024;
+        held[k] = malloc(size);
+    }
+    for (int k = 0; k < HELD; k++) {
+        if (k % 8 != 0) {
+            free(held[k]);
+            held[k] = NULL;
+        }
+    }
+    struct mallinfo2 after = mallinfo2();
+    printf("frame pool, heap after the frame pattern: %zu KB arena, %zu KB of it free in %zu pieces, pools fixed at "
+        "%zu KB\n", after.arena / 1024, after.fordblks / 1024, after.ordblks,
+        (sizeof(adc_frames) + sizeof(pcm_frames)) / 1024);
+    for (int k = 0; k < HELD; k++) free(held[k]);
+}
+
+int main(void) {
+    mallopt(M_MMAP_THRESHOLD, 1 << 20); // the 6 KB adc frames stay on the heap, as they would on the device
+    adc_pool_init(&adc_pool, adc_frames, POOL_FRAMES);
+    pcm_pool_init(&pcm_pool, pcm_frames, POOL_FRAMES);
+    bench_pair(true);
+    bench_pair(false);
+    bench_handoff(true);
+    bench_handoff(false);
+    bench_fragmentation();
+    return 0;
+}
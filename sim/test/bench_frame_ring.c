@@ -0,0 +1,104 @@
+// uses: prod/FrameRing sim/sim_rtos
+// frame hand-off from the read task to the write task: the spsc ring with a task notification to wake the writer,
+// against the free/busy pointer queues it replaced. both run as tasks on the sim's freertos, so the queue side pays
+// for its mutex and condition variable the way the real one pays for its critical sections
+#include <semaphore.h>
+#include "check.h"
+#include "sim.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "FrameRing.h"
+
+#define FRAME 256
+#define SLOTS 8
+#define FRAMES 200000
+
+sim_config_t sim_config = { .speed = 1.0 };
+void app_main(void) {}
+
+static int32_t pool[SLOTS][FRAME];
+static frame_ring_t ring;
+static QueueHandle_t queue_free, queue_busy;
+static TaskHandle_t consumer_task;
+static sem_t done;
+static uint32_t checksum;
+
+static void ring_producer(void* param) {
+    for (uint32_t seq = 0; seq < FRAMES; seq++) {
+        int32_t* frame;
+        while ((frame = frame_ring_acquire(&ring)) == NULL) taskYIELD();
+        frame[0] = (int32_t)seq; // the i2s read fills the rest, the same for both
+        if (frame_ring_publish(&ring)) xTaskNotifyGive(consumer_task);
+    }
+    vTaskDelete(NULL);
+}
+
+static void ring_consumer(void* param) {
+    uint32_t sum = 0;
+    for (uint32_t seq = 0; seq < FRAMES; seq++) {
+        int32_t* frame;
+        while ((frame = frame_ring_prepare_wait(&ring)) == NULL) ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        sum += (uint32_t)frame[0];
+        frame_ring_release(&ring);
+    }
+    checksum = sum;
+    sem_post(&done);
+    vTaskDelete(NULL);
+}
+
+static void queue_producer(void* param) {
+    for (uint32_t seq = 0; seq < FRAMES; seq++) {
+        int32_t* frame;
+        xQueueReceive(queue_free, &frame, portMAX_DELAY);
+        frame[0] = (int32_t)seq;
+        xQueueSend(queue_busy, &frame, portMAX_DELAY);
+    }
+    vTaskDelete(NULL);
+}
+
+static void queue_consumer(void* param) {
+    uint32_t sum = 0;
+    for (uint32_t seq = 0; seq < FRAMES; seq++) {
+        int32_t* frame;
+        xQueueReceive(queue_busy, &frame, portMAX_DELAY);
+        sum += (uint32_t)frame[0];
+        xQueueSend(queue_free, &frame, portMAX_DELAY);
+    }
+    checksum = sum;
+    sem_post(&done);
+    vTaskDelete(NULL);
+}
+
+static double run(TaskFunction_t producer, TaskFunction_t consumer) {
+    int64_t start = bench_ns();
+    xTaskCreatePinnedToCore(consumer, "consumer", 4096, NULL, 6, &consumer_task, 1);
+    xTaskCreatePinnedToCore(producer, "producer", 4096, NULL, 5, NULL, 1);
+    sem_wait(&done);
+    double ns = (double)(bench_ns() - start) / FRAMES;
+    uint32_t expected = 0;
+    for (uint32_t seq = 0; seq < FRAMES; seq++) expected += seq;
+    if (checksum != expected) printf("frame_ring: lost frames\n");
+    return ns;
+}
+
+int main(void) {
+    sim_clock_start();
+    sem_init(&done, 0, 0);
+
+    frame_ring_init(&ring, &pool[0][0], FRAME, SLOTS);
+    double ring_ns = run(ring_producer, ring_consumer);
+
+    queue_free = xQueueCreate(SLOTS, sizeof(int32_t*));
+    queue_busy = xQueueCreate(SLOTS, sizeof(int32_t*));
+    for (int i = 0; i < SLOTS; i++) {
+        int32_t* frame = pool[i];
+        xQueueSend(queue_free, &frame, 0);
+    }
+    double queue_ns = run(queue_producer, queue_consumer);
+
+    printf("frame_ring: %d frames of %d samples through %d slots, ring %.0f ns/frame (max occupancy %u), "
+        "free/busy queues %.0f ns/frame, %.1fx\n", FRAMES, FRAME, SLOTS, ring_ns, atomic_load(&ring.max_occupancy),
+        queue_ns, queue_ns / ring_ns);
+    return 0;
+}
@@ -0,0 +1,56 @@
+// uses: prod/Mixer
+// what more singers on the bus cost the write task before their chains run: the interleaved i2s frame split into a
+// buffer per mic with its gain, and the buffers summed back onto one after the chains. 2 mics take the duet fast
+// path, 4 the general loop the kernels keep for wider buses
+#include <string.h>
+#include "check.h"
+#include "Mixer.h"
+
+#define FRAME 256
+#define RATE 44100
+#define SECONDS 10
+#define FRAMES (RATE * SECONDS / FRAME)
+#define MAX_MICS 4
+
+static int32_t interleaved[FRAME * MAX_MICS * 64]; // 64 distinct frames, cycled
+static int32_t split[MAX_MICS][FRAME];
+
+static void bench(uint32_t mics) {
+    int32_t* channels[MAX_MICS];
+    uint16_t gains[MAX_MICS];
+    for (uint32_t c = 0; c < MAX_MICS; c++) {
+        channels[c] = split[c];
+        gains[c] = (uint16_t)(MIXER_GAIN_UNITY - 3000 * c);
+    }
+    uint64_t split_cycles = 0, sum_cycles = 0;
+    int64_t total = 0, worst = 0;
+    uint32_t check = 0;
+    for (int f = 0; f < FRAMES; f++) {
+        const int32_t* frame = interleaved + (f & 63) * FRAME * mics;
+        int64_t start = bench_ns();
+        uint64_t c0 = bench_cycles();
+        mixer_split_mics(channels, frame, FRAME, mics, gains);
+        uint64_t c1 = bench_cycles();
+        mixer_sum_mics(split[0], channels, FRAME, mics); // in place onto mic 0, as the write task does
+        uint64_t c2 = bench_cycles();
+        int64_t ns = bench_ns() - start;
+        split_cycles += c1 - c0;
+        sum_cycles += c2 - c1;
+        total += ns;
+        if (ns > worst && f > 0) worst = ns;
+        check += (uint32_t)split[0][f & (FRAME - 1)];
+    }
+    bench_sink = check;
+    printf("mic split+sum, %u mic%s: split %.0f + sum %.0f cycles/frame (%.2f/mic sample), %.0f ns/frame, worst %lld ns\n",
+        mics, (mics == 1) ? "" : "s", (double)split_cycles / FRAMES, (double)sum_cycles / FRAMES,
+        (double)(split_cycles + sum_cycles) / FRAMES / (FRAME * mics), (double)total / FRAMES, (long long)worst);
+}
+
+int main(void) {
+    uint32_t rng = 11;
+    for (size_t i = 0; i < sizeof(interleaved) / sizeof(interleaved[0]); i++) interleaved[i] = (int32_t)check_rand(&rng) >> 2;
+    bench(1); // the single mic build, for the baseline
+    bench(2);
+    bench(4);
+    return 0;
+}
@@ -0,0 +1,145 @@
+// uses: prod/Mixer sim/sim_wav
+// the per-frame mix of i2s_write_task: mic and music onto the bus, then the output stage down to 16 bit, against
+// the pipeline it replaced, the packed saturating Q15 mix straight to 16 bit with the mic cut to its top 16 bits.
+// replays a recorded mic and a2dp capture when BENCH_MIC and BENCH_MUSIC name wav files (the sim's --mic and --a2dp
+// inputs work), synthetic voice and music otherwise
+#include <stdlib.h>
+#include <string.h>
+#include "check.h"
+#include "sim.h"
+#include "Mixer.h"
+
+#define FRAME 256
+#define RATE 44100
+#define SECONDS 10
+#define PASSES 5
+#define FRAMES (RATE * SECONDS / FRAME)
+
+static int32_t mic[FRAMES][FRAME]; // Q31, as the i2s rx hands it over
+static int16_t music[FRAMES][FRAME * 2];
+static int32_t bus[FRAME * 2];
+static int16_t out[FRAME * 2];
+
+// the mixer before the bus, as it was in the library
+static inline int32_t sat16(int32_t x) {
+    if (x > INT16_MAX) return INT16_MAX;
+    if (x < INT16_MIN) return INT16_MIN;
+    return x;
+}
+
+static inline uint32_t mix_pair(uint32_t music_pair, int32_t mic, int32_t music_gain) {
+    int32_t left  = (int16_t)(music_pair & 0xFFFF);
+    int32_t right = (int16_t)(music_pair >> 16);
+    left  = sat16(((left * music_gain) >> 15) + mic);
+    right = sat16(((right * music_gain) >> 15) + mic);
+    return ((uint32_t)(uint16_t)left) | ((uint32_t)(uint16_t)right << 16);
+}
+
+static void old_mix_frame(int16_t* output_buffer, const uint8_t* music_bytes, const int32_t* mic_data, size_t frame_size,
+                          const mixer_gains_t* gains) {
+    const int32_t music_gain = gains->music_gain, mic_gain = gains->mic_gain;
+    const uint32_t* music_words = (const uint32_t*)music_bytes;
+    uint32_t* out_words = (uint32_t*)output_buffer;
+    for (size_t i = 0; i + 2 <= frame_size; i += 2) {
+        int32_t mic0 = ((mic_data[i] >> 16) * mic_gain) >> 15;
+        int32_t mic1 = ((mic_data[i+1] >> 16) * mic_gain) >> 15;
+        out_words[i] = mix_pair(music_words[i], mic0, music_gain);
+        out_words[i+1] = mix_pair(music_words[i+1], mic1, music_gain);
+    }
+}
+
+static void load(const char* mic_path, const char* music_path) {
+    static int16_t buf[FRAME * 2];
+    sim_wav_t wav;
+    if (mic_path != NULL && sim_wav_open(&wav, mic_path, RATE, 1)) {
+        for (int f = 0; f < FRAMES; f++) {
+            sim_wav_read(&wav, buf, FRAME);
+            for (int i = 0; i < FRAME; i++) mic[f][i] = (int32_t)buf[i * wav.channels] * 65536;
+        }
+        fclose(wav.file);
+    } else {
+        uint32_t rng = 1;
+        for (int f = 0; f < FRAMES; f++) {
+            for (int i = 0; i < FRAME; i++) {
+                double t = (double)(f * FRAME + i) / RATE;
+                mic[f][i] = (int32_t)(0.4 * 2147483647.0 * sin(2 * M_PI * 220 * t) * sin(M_PI * t)) +
+                    (int32_t)(check_rand(&rng) >> 8) - (1 << 23);
+            }
+        }
+    }
+    if (music_path != NULL && sim_wav_open(&wav, music_path, RATE, 2)) {
+        for (int f = 0; f < FRAMES; f++) {
+            sim_wav_read(&wav, buf, FRAME);
+            for (int i = 0; i < FRAME; i++) {
+                music[f][2*i] = buf[i * wav.channels];
+                music[f][2*i+1] = buf[i * wav.channels + (wav.channels > 1)];
+            }
+        }
+        fclose(wav.file);
+    } else {
+        for (int f = 0; f < FRAMES; f++) {
+            for (int i = 0; i < FRAME; i++) {
+                double t = (double)(f * FRAME + i) / RATE;
+                music[f][2*i] = (int16_t)(12000 * sin(2 * M_PI * 110 * t) + 6000 * sin(2 * M_PI * 1760 * t));
+                music[f][2*i+1] = (int16_t)(12000 * sin(2 * M_PI * 165 * t) + 6000 * sin(2 * M_PI * 2640 * t));
+            }
+        }
+    }
+}
+
+typedef struct {
+    int64_t total, worst;
+    uint64_t cycles;
+} timing_t;
+
+static void add(timing_t* t, int64_t ns, uint64_t cycles, int pass) {
+    t->total += ns;
+    t->cycles += cycles;
+    if (ns > t->worst && pass > 0) t->worst = ns; // the first pass warms the caches
+}
+
+static void report(const char* what, const timing_t* t) {
+    double frames = (double)PASSES * FRAMES;
+    double budget_ns = 1e9 * FRAME / RATE;
+    printf("mixer, %-22s %5.0f ns/frame (%.3f%% of the %.0f us period), %5.2f cycles/sample, worst frame %lld ns\n",
+        what, t->total / frames, 100.0 * t->total / frames / budget_ns, budget_ns / 1000,
+        (double)t->cycles / (frames * FRAME), (long long)t->worst);
+}
+
+int main(void) {
+    load(getenv("BENCH_MIC"), getenv("BENCH_MUSIC"));
+    mixer_gains_t gains = { .music_gain = 26000, .mic_gain = MIXER_GAIN_UNITY };
+    mixer_output_t output;
+    mixer_output_init(&output, MIXER_GAIN_UNITY, MIXER_BUS_ONE - MIXER_BUS_ONE / 16, RATE / 20);
+
+    timing_t mix = { 0 }, stage = { 0 }, old = { 0 };
+    uint32_t sum = 0;
+    for (int pass = 0; pass < PASSES; pass++) { // interleaved frame by frame, so all of them see the same host
+        for (int f = 0; f < FRAMES; f++) {
+            int64_t t0 = bench_ns();
+            uint64_t c0 = bench_cycles();
+            mixer_mix_bus(bus, (const uint8_t*)music[f], sizeof(music[f]), mic[f], FRAME, &gains);
+            uint64_t c1 = bench_cycles();
+            int64_t t1 = bench_ns();
+            mixer_output_process(&output, out, bus, FRAME);
+            uint64_t c2 = bench_cycles();
+            int64_t t2 = bench_ns();
+            sum += (uint16_t)out[f & (FRAME * 2 - 1)];
+            old_mix_frame(out, (const uint8_t*)music[f], mic[f], FRAME, &gains);
+            uint64_t c3 = bench_cycles();
+            int64_t t3 = bench_ns();
+            sum += (uint16_t)out[f & (FRAME * 2 - 1)];
+            add(&mix, t1 - t0, c1 - c0, pass);
+            add(&stage, t2 - t1, c2 - c1, pass);
+            add(&old, t3 - t2, c3 - c2, pass);
+        }
+    }
+    bench_sink = sum;
+
+    report("bus mix:", &mix);
+    report("output stage:", &stage);
+    report("old 16 bit mix:", &old);
+    printf("mixer: bus mix %.2fx the old mix, with the output stage %.2fx, %lu samples limited\n",
+        (double)mix.cycles / old.cycles, (double)(mix.cycles + stage.cycles) / old.cycles, (unsigned long)output.limited);
+    return 0;
+}
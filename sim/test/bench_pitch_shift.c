@@ -0,0 +1,53 @@
+// uses: prod/PitchShift
+// key change at 44.1 kHz stereo, packet by packet as the write task runs it over music. reports the share of one
+// core it takes to keep up, here and at the esp32's 240 MHz for the same cycle count (a floor, the esp32 needs
+// more cycles than the host for the same code). +-12 restarts the taps most often, so it pays the most search
+#include <string.h>
+#include "check.h"
+#include "PitchShift.h"
+
+#define RATE 44100
+#define PACKET 512
+#define SECONDS 10
+#define PACKETS (RATE * SECONDS / PACKET)
+
+static int16_t music[PACKETS * PACKET * 2];
+static int16_t out[PACKET * 2];
+
+int main(void) {
+    uint32_t rng = 3;
+    for (int i = 0; i < PACKETS * PACKET; i++) {
+        double t = (double)i / RATE;
+        int32_t noise = (int32_t)(check_rand(&rng) >> 22) - 512;
+        music[2*i] = (int16_t)(9000 * sin(2 * M_PI * 110 * t) + 5000 * sin(2 * M_PI * 659 * t) + noise);
+        music[2*i+1] = (int16_t)(9000 * sin(2 * M_PI * 165 * t) + 5000 * sin(2 * M_PI * 880 * t) + noise);
+    }
+
+    static pitch_shift_t ps;
+    static const int8_t keys[] = { 2, -3, 7, 12, -12 };
+    printf("pitch_shift: %d stereo frames/packet at %d Hz\n", PACKET, RATE);
+    for (size_t k = 0; k < sizeof(keys); k++) {
+        pitch_shift_init(&ps);
+        pitch_shift_set_semitones(&ps, keys[k]);
+        int64_t total = 0, worst = 0;
+        uint64_t cycles = 0;
+        uint32_t sum = 0;
+        for (int p = 0; p < PACKETS; p++) {
+            int64_t start = bench_ns();
+            uint64_t c0 = bench_cycles();
+            pitch_shift_process(&ps, out, (const uint8_t*)(music + p * PACKET * 2), PACKET * 4);
+            cycles += bench_cycles() - c0;
+            int64_t ns = bench_ns() - start;
+            total += ns;
+            if (ns > worst && p > 0) worst = ns;
+            sum += (uint16_t)out[p & (PACKET * 2 - 1)];
+        }
+        bench_sink = sum;
+        double per_sample = (double)cycles / ((double)PACKETS * PACKET);
+        double audio_ns = 1e9 * PACKETS * PACKET / RATE;
+        printf("  %+3d semitones: %.2f%% of a core, %.1f cycles/stereo sample (%.2f%% of a 240 MHz core), worst packet %.1f of %.0f us\n",
+            keys[k], 100.0 * total / audio_ns, per_sample, 100.0 * per_sample * RATE / 240e6, worst / 1000.0,
+            1e6 * PACKET / RATE);
+    }
+    return 0;
+}
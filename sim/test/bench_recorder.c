@@ -0,0 +1,74 @@
+// uses: prod/Recorder sim/sim_sd
+// sustained recording throughput onto a file-backed sd card with no card time charged, so this is the writer's own
+// cost: a minute of pcm and of adpcm through record_task's loop, against the 176 KB/s real time needs. and what
+// recorder_push costs the write task per frame
+#include <string.h>
+#include <unistd.h>
+#include "check.h"
+#include "sim.h"
+#include "Recorder.h"
+
+#define RATE 44100
+#define FRAME 256
+#define SECONDS 60
+#define FRAMES (RATE * SECONDS / FRAME)
+
+static uint8_t storage[4 * 64 * 1024];
+static recorder_t rec;
+static recorder_writer_t writer;
+static int16_t signal[FRAME * 2 * 64]; // 64 distinct frames, cycled
+
+static void bench(recorder_format_t format, const char* path) {
+    sim_sd_stats_t card = { 0 };
+    FILE* file = sim_sd_open(path, "wb", NULL, &card);
+    setvbuf(file, NULL, _IONBF, 0);
+    recorder_init(&rec, storage, 64 * 1024, 4);
+    recorder_writer_open(&writer, file, format, RATE);
+    recorder_start(&rec);
+    uint64_t push_cycles = 0, write_cycles = 0;
+    int64_t write_ns = 0;
+    for (int f = 0; f <= FRAMES; f++) {
+        uint64_t c0 = bench_cycles();
+        if (f == FRAMES) recorder_stop(&rec);
+        recorder_push(&rec, signal + (f & 63) * FRAME * 2, FRAME);
+        push_cycles += bench_cycles() - c0;
+
+        size_t len;
+        const uint8_t* block;
+        int64_t start = bench_ns();
+        c0 = bench_cycles();
+        while ((block = recorder_peek(&rec, &len)) != NULL) {
+            recorder_writer_write(&writer, (const int16_t*)block, len / 4);
+            recorder_release(&rec);
+        }
+        write_cycles += bench_cycles() - c0;
+        write_ns += bench_ns() - start;
+    }
+    int64_t start = bench_ns();
+    recorder_writer_close(&writer);
+    fclose(file);
+    write_ns += bench_ns() - start;
+    bench_sink = writer.frames;
+
+    double in_mb = (double)writer.frames * 4 / 1e6;
+    printf("recorder %-5s %d s take: writer %.0f MB/s of pcm in (%.0fx real time), %.2f cycles/frame, %llu card writes "
+        "of up to %llu bytes | push %.0f cycles per %d frames\n",
+        (format == RECORDER_PCM16) ? "pcm" : "adpcm", SECONDS, in_mb / (write_ns / 1e9),
+        (double)SECONDS * 1e9 / write_ns, (double)write_cycles / writer.frames, (unsigned long long)card.writes,
+        (unsigned long long)card.largest, (double)push_cycles / (FRAMES + 1), FRAME);
+}
+
+int main(void) {
+    uint32_t rng = 7;
+    for (int i = 0; i < FRAME * 64; i++) {
+        double t = (double)i / RATE;
+        signal[2 * i] = (int16_t)(8000 * sin(2 * M_PI * 220 * t) + (int16_t)check_rand(&rng) / 16);
+        signal[2 * i + 1] = (int16_t)(6000 * sin(2 * M_PI * 330 * t) + (int16_t)check_rand(&rng) / 16);
+    }
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/bench_recorder_%d.wav", (int)getpid());
+    bench(RECORDER_PCM16, path);
+    bench(RECORDER_IMA_ADPCM, path);
+    remove(path);
+    return 0;
+}
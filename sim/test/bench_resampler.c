@@ -0,0 +1,55 @@
+// uses: prod/Resampler
+// the a2dp rate converter over 10 s of output at each source rate the jitter buffer sets up, a 256 frame read at a
+// time as the write task pulls it. cycles per output stereo sample, the 44.1 kHz row being what every stream pays
+// for drift correction
+#include <string.h>
+#include "check.h"
+#include "Resampler.h"
+
+#define OUT_RATE 44100
+#define FRAME 256
+#define SECONDS 10
+#define FRAMES (OUT_RATE * SECONDS / FRAME)
+
+static int16_t music[48000 * (SECONDS + 1) * 2];
+static int16_t frame[FRAME * 2];
+
+static void bench(uint32_t in_rate) {
+    for (uint32_t i = 0; i < in_rate * (SECONDS + 1); i++) {
+        double t = (double)i / in_rate;
+        music[2*i] = (int16_t)(9000 * sin(2 * M_PI * 220 * t) + 4000 * sin(2 * M_PI * 5000 * t));
+        music[2*i+1] = (int16_t)(9000 * sin(2 * M_PI * 330 * t) - 4000 * sin(2 * M_PI * 11000 * t));
+    }
+
+    static resampler_t rs;
+    resampler_init(&rs, (in_rate > OUT_RATE) ? 0.85 * OUT_RATE / in_rate : 0.9);
+    resampler_set_step(&rs, ((uint64_t)in_rate << 32) / OUT_RATE + 4295); // +1 ppm, the drift loop is never exact
+    uint64_t cycles = 0, worst = 0;
+    int64_t total = 0;
+    uint32_t sum = 0;
+    size_t at = 0;
+    for (int f = 0; f < FRAMES; f++) {
+        size_t used;
+        int64_t start = bench_ns();
+        uint64_t c0 = bench_cycles();
+        size_t got = resampler_process(&rs, music + 2 * at, in_rate * (SECONDS + 1) - at, frame, FRAME, &used);
+        uint64_t c = bench_cycles() - c0;
+        total += bench_ns() - start;
+        cycles += c;
+        if (c > worst && f > 0) worst = c;
+        at += used;
+        sum += (uint16_t)frame[f & (FRAME * 2 - 1)] + (uint32_t)got;
+    }
+    bench_sink = sum;
+    printf("resampler %u -> %d: %d taps, %.0f cycles/frame (%.1f/stereo sample), worst frame %llu cycles, "
+        "%.0f ns/frame (%.2f%% of the %.0f us period)\n", in_rate, OUT_RATE, RESAMPLER_TAPS, (double)cycles / FRAMES,
+        (double)cycles / FRAMES / FRAME, (unsigned long long)worst, (double)total / FRAMES,
+        100.0 * total / FRAMES / (1e9 * FRAME / OUT_RATE), 1e6 * FRAME / OUT_RATE);
+}
+
+int main(void) {
+    bench(48000);
+    bench(32000);
+    bench(44100);
+    return 0;
+}
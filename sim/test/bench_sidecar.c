@@ -0,0 +1,100 @@
+// uses: prod/Sidecar
+// what the sidecar costs the write task: parsing a stream of lyric lines at main.c's budget of SIDECAR_PARSE_BUDGET
+// bytes a frame, and in the large reads a fast link hands over, then a full queue's worth of lines inserted out of
+// order and popped as they come due
+#include <string.h>
+#include "check.h"
+#include "constants.h"
+#include "Sidecar.h"
+
+#define STREAM_BYTES (1 << 20)
+#define ROUNDS 20
+
+static uint8_t stream[STREAM_BYTES];
+
+// typical lines, 20..60 characters, with a CLOCK every 8
+static size_t build(uint32_t* lines) {
+    uint32_t rng = 3;
+    size_t len = 0;
+    uint8_t payload[SIDECAR_MAX_PAYLOAD];
+    *lines = 0;
+    while (len + SIDECAR_FRAME_LEN(SIDECAR_MAX_PAYLOAD) <= STREAM_BYTES) {
+        uint32_t ms = *lines * 2000;
+        for (int b = 0; b < 4; b++) payload[b] = (uint8_t)(ms >> (8 * b));
+        size_t text = 20 + check_rand(&rng) % 41;
+        for (size_t i = 0; i < text; i++) payload[4 + i] = (uint8_t)('a' + check_rand(&rng) % 26);
+        len += sidecar_encode(stream + len, SIDECAR_MSG_LYRIC, payload, 4 + text);
+        if (++*lines % 8 == 0) len += sidecar_encode(stream + len, SIDECAR_MSG_CLOCK, payload, 4);
+    }
+    return len;
+}
+
+static void bench_parse(size_t len, size_t chunk, uint32_t lines) {
+    static sidecar_parser_t p;
+    uint64_t cycles = 0;
+    int64_t total = 0;
+    uint32_t frames = 0;
+    for (int r = 0; r < ROUNDS; r++) {
+        sidecar_parser_init(&p);
+        int64_t start = bench_ns();
+        uint64_t c0 = bench_cycles();
+        size_t at = 0;
+        while (at < len) {
+            size_t n = (len - at < chunk) ? len - at : chunk;
+            bool complete;
+            size_t used = sidecar_parse(&p, stream + at, n, &complete);
+            at += used;
+            frames += complete;
+        }
+        cycles += bench_cycles() - c0;
+        total += bench_ns() - start;
+    }
+    bench_sink = frames;
+    double bytes = (double)len * ROUNDS;
+    printf("sidecar parse, %4zu byte reads: %.2f cycles/byte, %.0f MB/s, %.0f ns/line, %.0f cycles per %d byte frame budget\n",
+        chunk, (double)cycles / bytes, bytes / ((double)total / 1e9) / 1e6, (double)total / ((double)lines * ROUNDS),
+        (double)cycles / bytes * SIDECAR_PARSE_BUDGET, SIDECAR_PARSE_BUDGET);
+}
+
+static void bench_sched(void) {
+    static sidecar_parser_t p;
+    static sidecar_sched_t s;
+    static uint8_t frame[SIDECAR_FRAME_LEN(SIDECAR_MAX_PAYLOAD)];
+    uint8_t payload[40] = "    a line of about the usual length";
+    uint32_t rng = 5;
+    uint64_t insert_cycles = 0, pop_cycles = 0;
+    uint32_t events = 0;
+    sidecar_parser_init(&p);
+    sidecar_sched_init(&s, SAMPLE_RATE);
+    for (int b = 0; b < 4; b++) payload[b] = 0;
+    sidecar_parse(&p, frame, sidecar_encode(frame, SIDECAR_MSG_CLOCK, payload, 4), &(bool){ false });
+    sidecar_sched_handle(&s, &p, 0);
+    for (int r = 0; r < 20000; r++) {
+        uint32_t base = (uint32_t)(r % 400) * 100000; // under 2^31 samples
+        for (int i = 0; i < SIDECAR_QUEUE_LEN; i++) { // the phone's few lines ahead, not quite in order
+            uint32_t ms = base + check_rand(&rng) % 50000;
+            for (int b = 0; b < 4; b++) payload[b] = (uint8_t)(ms >> (8 * b));
+            bool complete;
+            sidecar_parse(&p, frame, sidecar_encode(frame, SIDECAR_MSG_LYRIC, payload, sizeof(payload)), &complete);
+            uint64_t c0 = bench_cycles();
+            sidecar_sched_handle(&s, &p, 0);
+            insert_cycles += bench_cycles() - c0;
+        }
+        uint64_t c0 = bench_cycles();
+        uint32_t now = (uint32_t)((uint64_t)(base + 50000) * SAMPLE_RATE / 1000);
+        while (sidecar_sched_pop_due(&s, now) != NULL) events++;
+        pop_cycles += bench_cycles() - c0;
+    }
+    bench_sink = events;
+    printf("sidecar queue, %d deep: %.0f cycles/insert, %.0f cycles/pop\n", SIDECAR_QUEUE_LEN,
+        (double)insert_cycles / events, (double)pop_cycles / events);
+}
+
+int main(void) {
+    uint32_t lines;
+    size_t len = build(&lines);
+    bench_parse(len, SIDECAR_PARSE_BUDGET, lines);
+    bench_parse(len, 990, lines); // an rfcomm frame's worth
+    bench_sched();
+    return 0;
+}
@@ -0,0 +1,46 @@
+// uses: prod/VocalCancel prod/Biquad
+// vocal removal over 10 s of music, a frame at a time in place as the write task runs it. cycles per frame, to set
+// against the mic chain on the same core
+#include <string.h>
+#include "check.h"
+#include "VocalCancel.h"
+
+#define RATE 44100
+#define FRAME 256
+#define SECONDS 10
+#define FRAMES (RATE * SECONDS / FRAME)
+
+static int16_t music[FRAMES * FRAME * 2];
+static int16_t frame[FRAME * 2];
+
+int main(void) {
+    for (int i = 0; i < FRAMES * FRAME; i++) {
+        double t = (double)i / RATE;
+        double voice = 7000 * sin(2 * M_PI * 330 * t + 2 * sin(2 * M_PI * 5 * t));
+        music[2*i] = (int16_t)(voice + 8000 * sin(2 * M_PI * 55 * t) + 3000 * sin(2 * M_PI * 7000 * t));
+        music[2*i+1] = (int16_t)(voice + 8000 * sin(2 * M_PI * 55 * t) - 3000 * sin(2 * M_PI * 9000 * t));
+    }
+
+    static vocal_cancel_t vc;
+    vocal_cancel_init(&vc, RATE, VOCAL_CANCEL_LOW_HZ, VOCAL_CANCEL_HIGH_HZ);
+    vocal_cancel_set_enabled(&vc, true);
+    uint64_t cycles = 0, worst = 0;
+    int64_t total = 0;
+    uint32_t sum = 0;
+    for (int f = 0; f < FRAMES; f++) {
+        memcpy(frame, music + f * FRAME * 2, sizeof(frame));
+        int64_t start = bench_ns();
+        uint64_t c0 = bench_cycles();
+        vocal_cancel_process(&vc, frame, (const uint8_t*)frame, sizeof(frame));
+        uint64_t c = bench_cycles() - c0;
+        total += bench_ns() - start;
+        cycles += c;
+        if (c > worst && f > 0) worst = c;
+        sum += (uint16_t)frame[f & (FRAME * 2 - 1)];
+    }
+    bench_sink = sum;
+    printf("vocal_cancel: %d stereo samples/frame, %.0f cycles/frame (%.1f/stereo sample), worst frame %llu cycles, "
+        "%.0f ns/frame (%.2f%% of the %.0f us period)\n", FRAME, (double)cycles / FRAMES, (double)cycles / FRAMES / FRAME,
+        (unsigned long long)worst, (double)total / FRAMES, 100.0 * total / FRAMES / (1e9 * FRAME / RATE), 1e6 * FRAME / RATE);
+    return 0;
+}
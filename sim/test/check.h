@@ -0,0 +1,57 @@
+#ifndef CHECK_H
+#define CHECK_H
+
+// shared by the host tests and benchmarks in sim/test. each is a single source with its own main, built and run by
+// sim/test.sh. a test prints one line per case and returns 1 if any CHECK failed
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+#include <time.h>
+
+static int check_failures;
+
+#define CHECK(cond, ...) do { \
+        if (!(cond)) { \
+            check_failures++; \
+            fprintf(stderr, "%s:%d: %s: ", __FILE__, __LINE__, #cond); \
+            fprintf(stderr, __VA_ARGS__); \
+            fputc('\n', stderr); \
+        } \
+    } while (0)
+
+// returns main's exit code
+static inline int check_done(const char* name) {
+    printf("%s: %s\n", name, check_failures ? "FAILED" : "ok");
+    return check_failures ? 1 : 0;
+}
+
+// deterministic noise, so every run sees the same input
+static inline uint32_t check_rand(uint32_t* state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+static inline int64_t bench_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// host cycles where there is a cycle counter, ns elsewhere. the esp32 runs at 240 MHz with no simd or out of order
+// execution, so expect several times the host figure there
+static inline uint64_t bench_cycles(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    return (uint64_t)bench_ns();
+#endif
+}
+
+// keeps a benchmark's result alive without a printf in the loop
+static volatile uint32_t bench_sink;
+
+#endif
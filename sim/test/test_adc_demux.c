@@ -0,0 +1,131 @@
+// uses: analog_1a/AdcInput
+// the scan demux on synthetic frames laid out like analog_1a's 9 entry pattern, mic and aux every third result and
+// the three knobs between. frames are cut at random lengths so the pattern starts mid-way, and each stream has to
+// come out bit-exact against adc_input_process fed that channel alone. the knobs have to read back what they were
+// set to and follow a step, stray channels are counted, and a corrupt frame that is all mic can't write past the
+// room the caller gave
+#include <string.h>
+#include <stdlib.h>
+#include "check.h"
+#include "constants.h"
+#include "AdcInput.h"
+
+#define FRAMES 400
+#define CAPACITY (FRAME_SIZE/2) // samples per stream per frame, as main.c's buffers hold
+#define MAX_RESULTS (CAPACITY * 3)
+#define GUARD 64
+
+static const uint8_t pattern[9] = { 0, 3, 6, 0, 3, 7, 0, 3, 4 }; // mic, aux, knob in turn, as main.c's adc_scan
+enum { MIC = 0, AUX = 3, KNOB_MIC = 6, KNOB_MUSIC = 7, KNOB_ECHO = 4 };
+
+static _Alignas(4) uint8_t frame[MAX_RESULTS * 2];
+static _Alignas(4) uint8_t alone[2][MAX_RESULTS * 2];
+static int16_t outs[2][CAPACITY + GUARD], want[2][MAX_RESULTS];
+
+static void put(uint8_t* bytes, size_t i, uint8_t channel, uint16_t value) {
+    uint16_t r = (uint16_t)(channel << 12 | (value & ADC_INPUT_MAX));
+    bytes[2 * i] = (uint8_t)r;
+    bytes[2 * i + 1] = (uint8_t)(r >> 8);
+}
+
+static void setup(adc_demux_t* demux) {
+    adc_demux_init(demux);
+    adc_demux_add_stream(demux, MIC, 12, 0);
+    adc_demux_add_stream(demux, AUX, 12, 300);
+    adc_demux_add_control(demux, KNOB_MIC, 5, 3);
+    adc_demux_add_control(demux, KNOB_MUSIC, 5, 3);
+    adc_demux_add_control(demux, KNOB_ECHO, 5, 3);
+}
+
+static void test_streams(void) {
+    adc_demux_t demux;
+    setup(&demux);
+    adc_input_t ref[2];
+    adc_input_init(&ref[0], 12, 0);
+    adc_input_init(&ref[1], 12, 300);
+    uint32_t rng = 99, slot = 0, n = 0;
+    const uint16_t knobs[3] = { 1000, 2000, 3000 };
+    int mismatched = 0, short_counts = 0;
+    for (int f = 0; f < FRAMES; f++) {
+        // a multiple of 6 results, so each audio stream gets an even count as adc_input_process needs
+        size_t len = (f % 5 == 0) ? MAX_RESULTS : 6 * (1 + check_rand(&rng) % (MAX_RESULTS / 6));
+        size_t per[2] = { 0, 0 };
+        for (size_t i = 0; i < len; i++, slot = (slot + 1) % 9, n++) {
+            uint8_t ch = pattern[slot];
+            uint16_t v;
+            if (ch == MIC) v = (uint16_t)(1900 + 700 * sin(n * 0.01) + check_rand(&rng) % 64);
+            else if (ch == AUX) v = (uint16_t)(2100 + 1500 * sin(n * 0.003) + check_rand(&rng) % 16);
+            else v = knobs[ch == KNOB_MIC ? 0 : ch == KNOB_MUSIC ? 1 : 2];
+            put(frame, i, ch, v);
+            if (ch == MIC || ch == AUX) {
+                int s = (ch == AUX);
+                put(alone[s], per[s]++, ch, v);
+            }
+        }
+        int16_t* out[2] = { outs[0], outs[1] };
+        size_t got[2];
+        adc_demux_process(&demux, frame, len, out, CAPACITY, got);
+        for (int s = 0; s < 2; s++) {
+            adc_input_process(&ref[s], alone[s], want[s], per[s]);
+            short_counts += (got[s] != per[s]);
+            mismatched += (got[s] == per[s] && memcmp(outs[s], want[s], per[s] * sizeof(int16_t)) != 0);
+        }
+    }
+    CHECK(short_counts == 0 && mismatched == 0, "%d frames with the wrong count, %d not bit-exact", short_counts,
+        mismatched);
+    for (int k = 0; k < 3; k++) {
+        CHECK(abs(adc_demux_control(&demux, k) - knobs[k]) <= 1, "knob %d reads %u, set to %u", k,
+            adc_demux_control(&demux, k), knobs[k]);
+    }
+    CHECK(demux.unrouted == 0 && demux.overflowed == 0, "%u unrouted, %u overflowed", demux.unrouted, demux.overflowed);
+}
+
+static void test_knob_step(void) {
+    adc_demux_t demux;
+    setup(&demux);
+    int16_t* out[2] = { outs[0], outs[1] };
+    size_t got[2];
+    for (int f = 0; f < 7; f++) {
+        uint16_t v = (f < 2) ? 1000 : 3500;
+        for (size_t i = 0; i < MAX_RESULTS; i++) put(frame, i, pattern[i % 9], (pattern[i % 9] == KNOB_ECHO) ? v : 2048);
+        adc_demux_process(&demux, frame, MAX_RESULTS, out, CAPACITY, got);
+        if (f == 5) { // the ~25 ms smoothing takes 4.6 time constants, about 3.5 frames, to settle within 1%
+            int read = adc_demux_control(&demux, 2);
+            CHECK(abs(read - 3500) < 35, "echo knob at %d four frames after a step to 3500", read);
+        }
+    }
+}
+
+static void test_stray_and_overflow(void) {
+    adc_demux_t demux;
+    setup(&demux);
+    int16_t* out[2] = { outs[0], outs[1] };
+    size_t got[2];
+    for (size_t i = 0; i < MAX_RESULTS; i++) put(frame, i, (i % 4 == 0) ? 9 : pattern[i % 9], 2048);
+    adc_demux_process(&demux, frame, MAX_RESULTS, out, CAPACITY, got);
+    uint32_t strays = (MAX_RESULTS + 3) / 4;
+    CHECK(demux.unrouted == strays, "%u unrouted, %u sent", demux.unrouted, strays);
+
+    // a corrupt read that is all mic: three frames' worth of results for one frame's room
+    for (int s = 0; s < 2; s++) memset(outs[s], 0x5A, sizeof(outs[s]));
+    for (size_t i = 0; i < MAX_RESULTS; i++) put(frame, i, MIC, (uint16_t)(2048 + (i % 100)));
+    adc_input_t ref = demux.streams[0];
+    adc_demux_process(&demux, frame, MAX_RESULTS, out, CAPACITY, got);
+    adc_input_process(&ref, frame, want[0], MAX_RESULTS);
+    bool guard_intact = true;
+    for (int s = 0; s < 2; s++) {
+        for (int i = CAPACITY; i < CAPACITY + GUARD; i++) guard_intact &= (uint16_t)outs[s][i] == 0x5A5A;
+    }
+    CHECK(guard_intact, "wrote past the capacity");
+    CHECK(got[0] == CAPACITY && got[1] == 0 && demux.overflowed == MAX_RESULTS - CAPACITY,
+        "got %zu and %zu, %u overflowed", got[0], got[1], demux.overflowed);
+    CHECK(memcmp(outs[0], want[0], CAPACITY * sizeof(int16_t)) == 0 && demux.streams[0].dc == ref.dc,
+        "the kept samples or the dc tracker differ from the stream fed alone");
+}
+
+int main(void) {
+    test_streams();
+    test_knob_step();
+    test_stray_and_overflow();
+    return check_done("adc_demux");
+}
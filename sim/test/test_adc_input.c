@@ -0,0 +1,110 @@
+// uses: analog_1a/AdcInput analog_1a/utils
+// the fused adc kernel against the convert_adc_sample and scale_adc_to_i2s path it replaced: with the dc held at
+// every idle value the old helper takes and every 12 bit input, the reciprocal scaling has to land within 1 LSB of
+// its division. then two minutes of a tone riding on a drifting bias, where the tracker has to keep the output
+// centred that the boot calibration lets wander off, at the level the old path gave. and the gate field still zeroes
+// what it is asked to
+#include <string.h>
+#include <stdlib.h>
+#include "check.h"
+#include "AdcInput.h"
+#include "utils.h"
+
+#define RATE 32000 // analog_1a's SAMPLE_RATE
+#define FRAME 1024 // FRAME_SIZE/2 results
+#define SECONDS 120
+
+static _Alignas(4) uint8_t raw[FRAME * 2];
+static int16_t out[FRAME];
+
+static void put(int i, uint16_t sample) {
+    raw[2 * i] = (uint8_t)sample;
+    raw[2 * i + 1] = (uint8_t)(sample >> 8); // channel 0 in the top 4 bits
+}
+
+static void test_exact(void) {
+    adc_input_t in;
+    adc_input_init(&in, 12, 0);
+    in.seeded = true;
+    uint64_t cases = 0, exact = 0;
+    int worst = 0, worst_idle = 0, worst_sample = 0;
+    for (int idle = 2; idle <= ADC_INPUT_MAX - 2; idle++) {
+        for (int sample = 0; sample <= ADC_INPUT_MAX; sample++) {
+            in.dc = (uint32_t)idle << 16; // held, only the first result of the pair is looked at
+            put(0, (uint16_t)sample);
+            put(1, (uint16_t)sample);
+            adc_input_process(&in, raw, out, 2);
+            uint8_t bytes[2] = { (uint8_t)sample, (uint8_t)(sample >> 8) };
+            int want = scale_adc_to_i2s(convert_adc_sample(bytes[0], bytes[1]), (uint16_t)idle);
+            int err = abs(out[0] - want);
+            exact += (err == 0);
+            cases++;
+            if (err > worst) {
+                worst = err;
+                worst_idle = idle;
+                worst_sample = sample;
+            }
+        }
+    }
+    printf("  %llu cases, %.1f%% bit exact, worst %d LSB\n", (unsigned long long)cases, 100.0 * exact / cases, worst);
+    CHECK(worst <= 1, "%d LSB off the old helper at idle %d, input %d", worst, worst_idle, worst_sample);
+}
+
+// a 1 kHz tone of 600 LSB on a bias that drifts 200 LSB over the take, as the part warms up
+static uint16_t drifting(int n) {
+    double t = (double)n / RATE;
+    double v = 2048 + 200 * t / SECONDS + 600 * sin(2 * M_PI * 1000 * t);
+    return (uint16_t)lrint(v);
+}
+
+static void test_drift(void) {
+    adc_input_t in;
+    adc_input_init(&in, 12, 0);
+    uint16_t idle = 0;
+    double old_sum = 0, new_sum = 0, true_sum = 0, old_peak = 0, new_peak = 0;
+    const int frames = SECONDS * RATE / FRAME, last = RATE / FRAME;
+    for (int f = 0; f < frames; f++) {
+        for (int i = 0; i < FRAME; i++) put(i, drifting(f * FRAME + i));
+        if (f == 0) idle = find_idle_value(raw, FRAME * 2); // the boot calibration the tracker replaced
+        adc_input_process(&in, raw, out, FRAME);
+        for (int i = 0; i < FRAME; i++) {
+            int old = scale_adc_to_i2s(convert_adc_sample(raw[2 * i], raw[2 * i + 1]), idle);
+            if (f >= frames - last) {
+                old_sum += old;
+                new_sum += out[i];
+                // the old helper given the bias as it is by now: what the asymmetric side gains leave on their own
+                true_sum += scale_adc_to_i2s(convert_adc_sample(raw[2 * i], raw[2 * i + 1]), 2048 + 200);
+            }
+            if (f == 1) { // the first second, before the drift adds up
+                if (fabs(old) > old_peak) old_peak = fabs(old);
+                if (abs(out[i]) > new_peak) new_peak = abs(out[i]);
+            }
+        }
+    }
+    double old_dc = old_sum / (last * FRAME), new_dc = new_sum / (last * FRAME), true_dc = true_sum / (last * FRAME);
+    printf("  after %d s of drift: output dc %.0f LSB with the boot calibration, %.0f tracking, %.0f calibrated to the "
+        "bias as it is now; peak %.0f against %.0f\n", SECONDS, old_dc, new_dc, true_dc, new_peak, old_peak);
+    CHECK(fabs(new_dc - true_dc) < 50 && old_dc - true_dc > 2000, "dc %.0f tracking, %.0f calibrated once, %.0f "
+        "calibrated now", new_dc, old_dc, true_dc);
+    CHECK(fabs(new_peak - old_peak) < old_peak * 0.01, "peak %.0f, the old path gave %.0f", new_peak, old_peak);
+}
+
+static void test_gate(void) {
+    adc_input_t in;
+    adc_input_init(&in, 12, 500);
+    in.seeded = true;
+    in.dc = 2048u << 16;
+    for (int i = 0; i < FRAME; i++) put(i, (uint16_t)(2048 + (i % 32) - 16)); // well under 500 once scaled
+    put(10, 2048 + 100);
+    adc_input_process(&in, raw, out, FRAME);
+    int nonzero = 0;
+    for (int i = 0; i < FRAME; i++) nonzero += (out[i] != 0);
+    CHECK(nonzero == 1 && out[10] > 500, "%d outputs through the gate, want just the spike, %d", nonzero, out[10]);
+}
+
+int main(void) {
+    test_exact();
+    test_drift();
+    test_gate();
+    return check_done("adc_input");
+}
@@ -0,0 +1,76 @@
+// uses: prod/Calibrate
+// the boot tuner's loopback on two threads, as on the device: a write task thread plays the mls into an output that
+// comes back through a delay line and some noise as the mic, while the tuner polls for the recording and finds the
+// round trip. and the buffer search converges on the smallest setting that passes
+#include <pthread.h>
+#include <stdlib.h>
+#include "check.h"
+#include "Calibrate.h"
+
+#define FRAME 64
+#define LEVEL 6000
+
+static calibrate_loopback_t lb;
+static _Atomic bool stop;
+static uint32_t round_trip;
+
+// the write task: a frame out, the frame round_trip samples ago back in, until the tuner is done with it
+static void* write_task(void* arg) {
+    (void)arg;
+    static int16_t line[CALIBRATE_MAX_LAG + FRAME];
+    static int16_t out[FRAME * 2];
+    static int32_t mic[FRAME];
+    static uint32_t rng = 5;
+    uint32_t pos = 0;
+    while (!atomic_load(&stop)) {
+        if (!atomic_load_explicit(&lb.active, memory_order_acquire)) continue;
+        calibrate_play(&lb, out, FRAME);
+        for (int i = 0; i < FRAME; i++, pos++) {
+            line[pos % (CALIBRATE_MAX_LAG + FRAME)] = out[2 * i];
+            int32_t back = (pos >= round_trip) ? line[(pos - round_trip) % (CALIBRATE_MAX_LAG + FRAME)] / 4 : 0;
+            mic[i] = (back + (int32_t)(check_rand(&rng) % 801) - 400) * 65536; // speaker to mic loses 12 dB, plus noise
+        }
+        calibrate_capture(&lb, (pos / FRAME % 7 == 3) ? NULL : mic, FRAME); // the odd late frame
+    }
+    return NULL;
+}
+
+int main(void) {
+    static const uint32_t trips[] = { 0, 300, 2049, 7000 };
+    for (size_t t = 0; t < sizeof(trips) / sizeof(trips[0]); t++) {
+        // each trial reconfigures the pipeline, so the write task is stopped around calibrate_start as audio_pause does
+        pthread_t writer;
+        round_trip = trips[t];
+        atomic_store(&stop, false);
+        pthread_create(&writer, NULL, write_task, NULL);
+        calibrate_start(&lb, LEVEL, 0);
+        while (!calibrate_done(&lb)) sched_yield();
+        int32_t lag = calibrate_find_lag(&lb); // while the write task is still running, as the tuner does
+        atomic_store(&lb.active, false);
+        atomic_store(&stop, true);
+        pthread_join(writer, NULL);
+        CHECK(lag == (int32_t)round_trip, "round trip %u found at %d", round_trip, lag);
+    }
+
+    // nothing heard is no lag rather than a guess
+    calibrate_start(&lb, LEVEL, 0);
+    static int32_t quiet[FRAME];
+    while (!calibrate_done(&lb)) calibrate_capture(&lb, quiet, FRAME);
+    CHECK(calibrate_find_lag(&lb) == -1, "silence gave lag %d", calibrate_find_lag(&lb));
+
+    // smallest buffering that passes, then the margin on top
+    static calibrate_search_t search;
+    calibrate_search_init(&search, 64, 256, 8);
+    calibrate_setting_t setting;
+    int trials = 0;
+    while (calibrate_search_next(&search, &setting)) {
+        calibrate_search_report(&search, setting.frame_size * setting.dma_count >= 700);
+        trials++;
+    }
+    calibrate_setting_t best = calibrate_search_result(&search, 0);
+    CHECK(best.frame_size * best.dma_count == 768, "search settled on %u x %u", best.frame_size, best.dma_count);
+    CHECK(trials <= 5, "%d trials over %u settings", trials, search.count);
+    setting = calibrate_search_result(&search, 1);
+    CHECK(setting.frame_size * setting.dma_count >= 768, "margin stepped down to %u x %u", setting.frame_size, setting.dma_count);
+    return check_done("calibrate");
+}
@@ -0,0 +1,192 @@
+// uses: prod/DmaSched
+// the tx buffer handoff between the i2s on_sent isr and the write task, against a simulated ring of desc_num dma
+// descriptors that plays them in order: buffers come back in the order they finished, with their seq and stamp; one
+// the dma is about to come back around to (since + 2 > desc_num) is skipped and counted late, as is a held one that
+// went stale; a full list of posts nobody takes is counted dropped; and the free running head, tail and seq wrap
+// past 2^32 without losing a buffer. then a thread posts as the dma would while the task takes at an uneven pace,
+// and every post has to be accounted for exactly once
+#include <string.h>
+#include <pthread.h>
+#include "check.h"
+#include "DmaSched.h"
+
+#define POSTS 20000 // by the dma thread
+#define PERIOD_NS 20000 // between its posts, host sleeps make it longer
+
+typedef struct {
+    dma_sched_t sched;
+    uint32_t desc_num;
+    uint32_t played; // buffers the dma has finished
+    int16_t bufs[DMA_SCHED_MAX_DESC][4];
+} ring_t;
+
+static void ring_init(ring_t* ring, uint32_t desc_num) {
+    dma_sched_init(&ring->sched, desc_num);
+    ring->desc_num = desc_num;
+    ring->played = 0;
+}
+
+// the dma finishes the next descriptor in its circular list and on_sent posts it, stamped with its place in the run
+static bool ring_play(ring_t* ring) {
+    void* buf = ring->bufs[ring->played % ring->desc_num];
+    return dma_sched_post(&ring->sched, buf, ring->played++);
+}
+
+// the buffer and stamp a take should get for the post numbered seq since init
+static bool is_post(ring_t* ring, void* buf, uint32_t stamp, uint32_t seq) {
+    return buf == ring->bufs[(seq - 1) % ring->desc_num] && stamp == seq - 1;
+}
+
+static void test_in_order(uint32_t desc_num) {
+    static ring_t ring;
+    ring_init(&ring, desc_num);
+    bool ok = true;
+    // one behind, and as far behind as is still safe
+    for (uint32_t lag = 1; lag <= desc_num - 2; lag++) {
+        for (uint32_t i = 0; i < lag; i++) ring_play(&ring);
+        for (uint32_t i = 0; i < lag; i++) {
+            uint32_t stamp, seq;
+            void* buf = dma_sched_take(&ring.sched, &stamp, &seq);
+            ok &= buf != NULL && seq == ring.played - lag + 1 + i && is_post(&ring, buf, stamp, seq);
+        }
+        ok &= dma_sched_take(&ring.sched, NULL, NULL) == NULL;
+    }
+    CHECK(ok, "desc_num %u: buffers out of order", desc_num);
+    CHECK(ring.sched.late == 0 && ring.sched.dropped == 0, "desc_num %u: %u late, %u dropped keeping up", desc_num,
+        ring.sched.late, ring.sched.dropped);
+}
+
+static void test_late(uint32_t desc_num) {
+    static ring_t ring;
+    ring_init(&ring, desc_num);
+    // desc_num posts untaken: the oldest is about to play again, the next still has a period of margin
+    for (uint32_t i = 0; i < desc_num; i++) ring_play(&ring);
+    uint32_t stamp, seq;
+    void* buf = dma_sched_take(&ring.sched, &stamp, &seq);
+    CHECK(buf != NULL && seq == 2 && is_post(&ring, buf, stamp, seq), "desc_num %u: took seq %u, want 2", desc_num, seq);
+    CHECK(ring.sched.late == 1, "desc_num %u: %u late, want the oldest", desc_num, ring.sched.late);
+    CHECK(dma_sched_still_safe(&ring.sched, seq), "desc_num %u: the taken buffer went stale with nothing posted", desc_num);
+    // held across one more post, it is now the one the dma is about to play
+    ring_play(&ring);
+    CHECK(!dma_sched_still_safe(&ring.sched, seq), "desc_num %u: held buffer still safe a period later", desc_num);
+    CHECK(ring.sched.late == 2, "desc_num %u: %u late after dropping the held buffer", desc_num, ring.sched.late);
+    // what is left is taken in order, skipping the rest of the stale ones
+    uint32_t want = ring.played - desc_num + 2;
+    buf = dma_sched_take(&ring.sched, &stamp, &seq);
+    CHECK(buf != NULL && seq == want && is_post(&ring, buf, stamp, seq), "desc_num %u: took seq %u, want %u", desc_num,
+        seq, want);
+    CHECK(ring.sched.late == 2, "desc_num %u: %u late, want 2", desc_num, ring.sched.late);
+    CHECK(ring.sched.dropped == 0, "desc_num %u: %u dropped", desc_num, ring.sched.dropped);
+}
+
+static void test_dropped(uint32_t desc_num) {
+    static ring_t ring;
+    ring_init(&ring, desc_num);
+    bool accepted = true;
+    for (int i = 0; i < DMA_SCHED_MAX_DESC; i++) accepted &= ring_play(&ring);
+    CHECK(accepted, "desc_num %u: refused a post before the list was full", desc_num);
+    CHECK(!ring_play(&ring) && !ring_play(&ring), "desc_num %u: took posts past a full list", desc_num);
+    CHECK(ring.sched.dropped == 2, "desc_num %u: %u dropped, want 2", desc_num, ring.sched.dropped);
+    CHECK(dma_sched_pending(&ring.sched) == DMA_SCHED_MAX_DESC, "desc_num %u: %u pending", desc_num,
+        dma_sched_pending(&ring.sched));
+    // the dropped posts still moved the sequence on, so the take skips everything the dma has come back around to
+    uint32_t first = DMA_SCHED_MAX_DESC + 2 + 2 - desc_num; // oldest seq with since + 2 <= desc_num
+    uint32_t stamp, seq = 0;
+    void* buf = dma_sched_take(&ring.sched, &stamp, &seq);
+    if (first > DMA_SCHED_MAX_DESC) CHECK(buf == NULL, "desc_num %u: handed out stale seq %u", desc_num, seq);
+    else CHECK(buf != NULL && seq == first && is_post(&ring, buf, stamp, seq), "desc_num %u: took seq %u, want %u",
+        desc_num, seq, first);
+    uint32_t stale = (first > DMA_SCHED_MAX_DESC) ? DMA_SCHED_MAX_DESC : first - 1;
+    CHECK(ring.sched.late == stale, "desc_num %u: %u late, want %u", desc_num, ring.sched.late, stale);
+    while (dma_sched_take(&ring.sched, NULL, NULL) != NULL) {}
+    // and it recovers
+    ring_play(&ring);
+    buf = dma_sched_take(&ring.sched, &stamp, &seq);
+    CHECK(buf != NULL && is_post(&ring, buf, stamp, seq), "desc_num %u: nothing after catching up", desc_num);
+}
+
+// head, tail and sent_count start just short of 2^32 and run well past it, with the list a few posts deep
+static void test_wrap(uint32_t desc_num) {
+    static ring_t ring;
+    ring_init(&ring, desc_num);
+    const uint32_t start = UINT32_MAX - 2 * DMA_SCHED_MAX_DESC;
+    atomic_store(&ring.sched.head, start);
+    atomic_store(&ring.sched.tail, start);
+    atomic_store(&ring.sched.sent_count, start);
+    ring.played = start;
+    bool ok = true;
+    uint32_t lag = desc_num - 2, taken = 0;
+    for (uint32_t i = 0; i < lag; i++) ring_play(&ring);
+    for (int i = 0; i < 8 * DMA_SCHED_MAX_DESC; i++) {
+        ring_play(&ring);
+        uint32_t stamp, seq;
+        void* buf = dma_sched_take(&ring.sched, &stamp, &seq);
+        ok &= buf == ring.bufs[(seq - 1) % desc_num] && stamp == seq - 1 && seq == ring.played - lag;
+        taken += buf != NULL;
+    }
+    CHECK(ok && taken == 8 * DMA_SCHED_MAX_DESC, "desc_num %u: %u of %d taken in order across the wrap", desc_num, taken,
+        8 * DMA_SCHED_MAX_DESC);
+    CHECK(ring.sched.late == 0 && ring.sched.dropped == 0, "desc_num %u: %u late, %u dropped across the wrap", desc_num,
+        ring.sched.late, ring.sched.dropped);
+}
+
+static ring_t threaded;
+static _Atomic bool dma_done;
+
+static void* dma_thread(void* arg) {
+    (void)arg;
+    struct timespec period = { 0, PERIOD_NS };
+    for (int i = 0; i < POSTS; i++) {
+        ring_play(&threaded);
+        nanosleep(&period, NULL);
+    }
+    atomic_store(&dma_done, true);
+    return NULL;
+}
+
+static void test_threaded(uint32_t desc_num) {
+    ring_init(&threaded, desc_num);
+    atomic_store(&dma_done, false);
+    pthread_t thread;
+    pthread_create(&thread, NULL, dma_thread, NULL);
+    uint32_t rand = 1, taken = 0, last = 0;
+    bool ok = true;
+    for (;;) {
+        bool done = atomic_load(&dma_done); // read before the take, so the final drain sees every post
+        uint32_t stamp, seq;
+        void* buf = dma_sched_take(&threaded.sched, &stamp, &seq);
+        if (buf != NULL) {
+            ok &= seq > last && buf == threaded.bufs[(seq - 1) % desc_num] && stamp == seq - 1;
+            last = seq;
+            taken++;
+            // mostly quick, now and then up to a couple of periods past the ring, so some fall behind it
+            if (check_rand(&rand) % 16 == 0) {
+                uint32_t until = atomic_load(&threaded.sched.sent_count) + check_rand(&rand) % (desc_num + 2);
+                while ((int32_t)(atomic_load(&threaded.sched.sent_count) - until) < 0 && !atomic_load(&dma_done)) sched_yield();
+            }
+        } else if (done) {
+            break;
+        } else {
+            sched_yield();
+        }
+    }
+    pthread_join(thread, NULL);
+    uint32_t late = threaded.sched.late, dropped = threaded.sched.dropped;
+    printf("  desc_num %u threaded: %d posts, %u taken, %u late, %u dropped\n", desc_num, POSTS, taken, late, dropped);
+    CHECK(ok, "desc_num %u: taken out of order or the wrong buffer", desc_num);
+    CHECK(taken + late + dropped == POSTS, "desc_num %u: %u taken + %u late + %u dropped of %d posts", desc_num, taken,
+        late, dropped, POSTS);
+}
+
+int main(void) {
+    for (uint32_t desc_num = 3; desc_num <= DMA_SCHED_MAX_DESC; desc_num++) {
+        test_in_order(desc_num);
+        test_late(desc_num);
+        test_dropped(desc_num);
+        test_wrap(desc_num);
+    }
+    printf("  desc_num 3..%d: in order, late skips, drops and the 2^32 wrap\n", DMA_SCHED_MAX_DESC);
+    test_threaded(3);
+    test_threaded(8);
+    return check_done("dma_sched");
+}
@@ -0,0 +1,237 @@
+// uses: prod/Effects
+// the vocal effects: echo, reverb and compressor against what they are meant to do, pitch correction against sung
+// tones off the note, and a golden hash of the whole chain over a fixed input so any change to the output shows.
+// a deliberate change to the sound updates GOLDEN_CHAIN with the value this prints
+#include <string.h>
+#include <stdlib.h>
+#include "check.h"
+#include "constants.h"
+#include "Effects.h"
+
+#define RATE 44100
+#define FRAME 256
+#define GOLDEN_CHAIN 0xc3b40500u
+
+static int32_t buf[RATE * 5];
+
+// a sung vowel: fundamental and 5 harmonics rolling off, level in Q31 full scale
+static void voice(int32_t* out, size_t n, double hz, double level, double* phase) {
+    for (size_t i = 0; i < n; i++) {
+        double s = 0;
+        for (int h = 1; h <= 6; h++) s += sin(*phase * h) / h;
+        out[i] = (int32_t)(level * 2147483647.0 * s / 2.45);
+        *phase += 2 * M_PI * hz / RATE;
+    }
+}
+
+static void run(effect_process_fn fn, void* state, int32_t* x, size_t n) {
+    for (size_t i = 0; i < n; i += FRAME) fn(state, x + i, (n - i < FRAME) ? n - i : FRAME);
+}
+
+// pitch of x by normalized autocorrelation, searched within 20% of near_hz and interpolated
+static double measure_hz(const int32_t* x, size_t n, double near_hz) {
+    int lo = (int)(RATE / near_hz / 1.2), hi = (int)(RATE / near_hz * 1.2) + 1;
+    double best = -2, r[3] = { 0 };
+    int best_lag = lo;
+    double ra[2048];
+    for (int lag = lo - 1; lag <= hi + 1; lag++) {
+        double xy = 0, xx = 0, yy = 0;
+        for (size_t i = 0; i + lag < n; i++) {
+            xy += (double)x[i] * x[i + lag];
+            xx += (double)x[i] * x[i];
+            yy += (double)x[i + lag] * x[i + lag];
+        }
+        ra[lag] = xy / sqrt(xx * yy + 1);
+    }
+    for (int lag = lo; lag <= hi; lag++) {
+        if (ra[lag] > best) {
+            best = ra[lag];
+            best_lag = lag;
+        }
+    }
+    r[0] = ra[best_lag - 1], r[1] = ra[best_lag], r[2] = ra[best_lag + 1];
+    double den = r[0] - 2 * r[1] + r[2];
+    double lag = best_lag + ((den < 0) ? 0.5 * (r[0] - r[2]) / den : 0);
+    return RATE / lag;
+}
+
+static double cents(double hz, double ref) {
+    return 1200 * log2(hz / ref);
+}
+
+static void test_echo(void) {
+    static effect_echo_t echo;
+    effect_echo_init(&echo, 1000, EFFECTS_UNITY / 2, EFFECTS_UNITY / 4);
+    memset(buf, 0, sizeof(int32_t) * 5000);
+    buf[0] = 1 << 30; // half scale click
+    run(effect_echo_process, &echo, buf, 5000);
+    CHECK(buf[0] == 1 << 30, "dry passes untouched: %ld", (long)buf[0]);
+    // repeats at the delay, a quarter of the level, then halving
+    long want[] = { (1L << 30) / 4, (1L << 30) / 8, (1L << 30) / 16 };
+    for (int k = 1; k <= 3; k++) {
+        long got = buf[1000 * k];
+        CHECK(labs(got - want[k - 1]) < (1 << 17), "repeat %d is %ld, want %ld", k, got, want[k - 1]);
+        CHECK(buf[1000 * k - 1] == 0 && buf[1000 * k + 1] == 0, "repeat %d is one sample", k);
+    }
+}
+
+static void test_reverb(void) {
+    static effect_reverb_t reverb;
+    effect_reverb_init(&reverb, 27525, 6554, 9830);
+    double phase = 0;
+    voice(buf, RATE / 2, 220, 0.5, &phase);
+    memset(buf + RATE / 2, 0, sizeof(int32_t) * (RATE * 4 - RATE / 2));
+    run(effect_reverb_process, &reverb, buf, RATE * 4);
+
+    // a tail after the voice stops, decaying to exact silence, not a dc limit cycle
+    double tail = 0;
+    for (int i = RATE / 2; i < RATE / 2 + RATE / 10; i++) tail += fabs((double)buf[i]);
+    CHECK(tail / (RATE / 10) > 1e6, "no tail: mean %.0f", tail / (RATE / 10));
+    int nonzero = 0;
+    for (int i = RATE * 3; i < RATE * 4; i++) nonzero += (buf[i] != 0);
+    CHECK(nonzero == 0, "%d samples still nonzero 2.5 s after the input stopped", nonzero);
+}
+
+static void test_compressor(void) {
+    static effect_compressor_t comp;
+    const int32_t threshold = 0x10000000; // -18 dBFS
+    effect_compressor_init(&comp, threshold, 4, 1000, 20, EFFECTS_UNITY);
+    double phase = 0;
+    for (size_t i = 0; i < RATE; i++) {
+        buf[i] = (int32_t)(0.5 * 2147483647.0 * sin(phase)); // -6 dBFS, 12 dB over
+        phase += 2 * M_PI * 440 / RATE;
+    }
+    run(effect_compressor_process, &comp, buf, RATE);
+    int32_t peak = 0;
+    for (int i = RATE / 2; i < RATE; i++) peak = (abs(buf[i]) > peak) ? abs(buf[i]) : peak;
+    double want = threshold + (0.5 * 2147483647.0 - threshold) / 4; // 4:1 above the threshold
+    CHECK(fabs(peak - want) < want * 0.1, "settled peak %ld, want about %.0f", (long)peak, want);
+
+    effect_compressor_init(&comp, threshold, 4, 1000, 20, EFFECTS_UNITY);
+    for (int i = 0; i < RATE / 10; i++) buf[i] = (i & 1) ? 0x01000000 : -0x01000000; // well under
+    int32_t before = buf[7];
+    run(effect_compressor_process, &comp, buf, RATE / 10);
+    CHECK(buf[7] == before, "below the threshold is untouched");
+}
+
+static void test_pitch_correct(void) {
+    static effect_pitch_correct_t pc;
+    struct { double sung, note; } cases[] = {
+        { 450.0, 440.0 }, // a4, 39 cents sharp
+        { 430.0, 440.0 }, // 40 cents flat
+        { 261.63, 261.63 }, // c4, on the note
+        { 160.0, 155.56 }, // d#3, 49 cents sharp, just short of the midpoint to e3
+        { 120.0, 123.47 }, // b2, 49 cents flat
+        { 700.0, 698.46 }, // f5
+        { 95.0, 92.50 }, // f#2, 46 cents sharp
+    };
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        effect_pitch_correct_init(&pc, RATE, EFFECTS_UNITY, EFFECTS_UNITY / 2);
+        double phase = 0;
+        voice(buf, RATE, cases[c].sung, 0.3, &phase);
+        run(effect_pitch_correct_process, &pc, buf, RATE);
+        double hz = measure_hz(buf + RATE / 2, RATE / 2, cases[c].note);
+        double sung_hz = (pc.period != 0) ? RATE * 256.0 / pc.period : 0;
+        CHECK(fabs(cents(hz, cases[c].note)) < 5, "sung %.2f Hz came out at %.2f Hz, %.1f cents off %.2f Hz",
+            cases[c].sung, hz, cents(hz, cases[c].note), cases[c].note);
+        CHECK(fabs(cents(sung_hz, cases[c].sung)) < 15, "sung %.2f Hz estimated at %.2f Hz", cases[c].sung, sung_hz);
+    }
+
+    // strength 0 leaves the pitch alone, and silence comes back out as silence
+    effect_pitch_correct_init(&pc, RATE, 0, EFFECTS_UNITY / 2);
+    double phase = 0;
+    voice(buf, RATE, 450, 0.3, &phase);
+    run(effect_pitch_correct_process, &pc, buf, RATE);
+    double hz = measure_hz(buf + RATE / 2, RATE / 2, 450);
+    CHECK(fabs(cents(hz, 450)) < 2, "strength 0 moved 450 Hz to %.2f Hz", hz);
+    memset(buf, 0, sizeof(int32_t) * RATE);
+    run(effect_pitch_correct_process, &pc, buf, RATE);
+    int nonzero = 0;
+    for (int i = RATE / 2; i < RATE; i++) nonzero += (buf[i] != 0);
+    CHECK(nonzero == 0, "%d nonzero samples from silence", nonzero);
+
+    // unvoiced noise glides back to no shift, which is the input delayed by half a window, exactly
+    effect_pitch_correct_init(&pc, RATE, EFFECTS_UNITY, EFFECTS_UNITY / 2);
+    phase = 0;
+    voice(buf, RATE / 2, 450, 0.3, &phase);
+    run(effect_pitch_correct_process, &pc, buf, RATE / 2);
+    uint32_t rng = 7;
+    static int32_t noise[RATE];
+    for (int i = 0; i < RATE; i++) noise[i] = buf[i] = (int32_t)(check_rand(&rng) >> 12) - (1 << 19);
+    run(effect_pitch_correct_process, &pc, buf, RATE);
+    int off = 0;
+    for (int i = RATE / 2; i < RATE; i++) off += (buf[i] != noise[i - PITCH_CORRECT_WINDOW / 2]);
+    CHECK(off == 0 && pc.ratio == 65536, "noise: ratio %ld, %d samples not the delayed input", (long)pc.ratio, off);
+
+    // other mic rates analyse at 11 or 12 kHz
+    effect_pitch_correct_init(&pc, RATE / 2, EFFECTS_UNITY, EFFECTS_UNITY / 2);
+    CHECK(pc.decim_shift == 1, "22050 Hz decimates by %d", 1 << pc.decim_shift);
+    effect_pitch_correct_init(&pc, 48000, EFFECTS_UNITY, EFFECTS_UNITY / 2);
+    CHECK(pc.decim_shift == 2, "48000 Hz decimates by %d", 1 << pc.decim_shift);
+}
+
+// sin of a Q32 phase in Q15, a parabola with one refining step. integer only, so the golden input is the same
+// bits whatever libm the host has
+static int32_t sin_q15(uint32_t phase) {
+    int32_t n = (int32_t)phase >> 16; // -pi..pi as -32768..32767
+    int32_t a = (n < 0) ? -n : n;
+    int32_t y = (int32_t)(((int64_t)4 * n * (32768 - a)) >> 15);
+    int32_t y_abs = (y < 0) ? -y : y;
+    return y + ((7373 * (((y * y_abs) >> 15) - y)) >> 15); // 0.225 of the parabola's error
+}
+
+// voice() from a Q32 phase accumulator, hz in millihertz and level in Q15 of full scale
+static void voice_int(int32_t* out, size_t n, uint32_t millihz, int32_t level, uint32_t* phase) {
+    uint32_t step = (uint32_t)(((uint64_t)millihz << 32) / (MIC_SAMPLE_RATE * 1000ull));
+    for (size_t i = 0; i < n; i++) {
+        int32_t s = 0;
+        for (uint32_t h = 1; h <= 6; h++) s += sin_q15(*phase * h) / (int32_t)h;
+        out[i] = (int32_t)((int64_t)s * level * 200 / 245);
+        *phase += step;
+    }
+}
+
+// the effects main.c runs on a mic, in the same order and settings: compressor -> pitch correction on the mic's own
+// chain, then echo -> reverb on the bus. the feedback suppressor ahead of them is float over libm tables and has its
+// own test. the input is a voice with a level swell, made with integer code
+static void test_golden(void) {
+    static effect_compressor_t comp;
+    static effect_pitch_correct_t pc;
+    static effect_echo_t echo;
+    static effect_reverb_t reverb;
+    static effects_chain_t voice_chain, mic_chain;
+    effect_compressor_init(&comp, 0x20000000, 4, 1000, 20, EFFECTS_UNITY);
+    effect_pitch_correct_init(&pc, MIC_SAMPLE_RATE, EFFECTS_UNITY, EFFECTS_UNITY / 2);
+    effect_echo_init(&echo, MIC_SAMPLE_RATE / 8, 9830, 8192);
+    effect_reverb_init(&reverb, 27525, 6554, 9830);
+    effects_chain_init(&voice_chain);
+    effects_chain_add(&voice_chain, effect_compressor_process, &comp);
+    effects_chain_add(&voice_chain, effect_pitch_correct_process, &pc);
+    effects_chain_init(&mic_chain);
+    effects_chain_add(&mic_chain, effect_echo_process, &echo);
+    effects_chain_add(&mic_chain, effect_reverb_process, &reverb);
+
+    uint32_t phase = 0;
+    static const int32_t levels[3] = { 3277, 14746, 26214 }; // 0.1, 0.45, 0.8
+    for (int s = 0; s < 3; s++) voice_int(buf + s * RATE, RATE, 202600 * (s + 1), levels[s], &phase); // a bit sharp
+    memset(buf + 3 * RATE, 0, sizeof(int32_t) * RATE);
+    uint32_t hash = 2166136261u; // fnv-1a over the output bytes
+    for (int i = 0; i < 4 * RATE; i += FRAME) {
+        effects_chain_process(&voice_chain, buf + i, FRAME);
+        effects_chain_process(&mic_chain, buf + i, FRAME);
+        for (int j = 0; j < FRAME * 4; j++) {
+            hash ^= ((const uint8_t*)(buf + i))[j];
+            hash *= 16777619u;
+        }
+    }
+    CHECK(hash == GOLDEN_CHAIN, "chain output hash 0x%08x, golden 0x%08x", hash, GOLDEN_CHAIN);
+}
+
+int main(void) {
+    test_echo();
+    test_reverb();
+    test_compressor();
+    test_pitch_correct();
+    test_golden();
+    return check_done("effects");
+}
@@ -0,0 +1,154 @@
+// uses: prod/FeedbackSuppress prod/Biquad
+// the howl suppressor in a simulated room: the mic hears a quiet talker plus the speaker, a resonant path with a
+// loop gain above 1 at one frequency and the pipeline's delay. without the suppressor that howls to full scale,
+// with it the howl has to be caught and held down quickly. a sung note must not get notched, and the biquads under
+// it have to saturate rather than wrap and retune without a click
+#include <string.h>
+#include <stdlib.h>
+#include "check.h"
+#include "FeedbackSuppress.h"
+
+#define RATE 44100
+#define FRAME 256 // mic_frame_size at the full rate
+#define SECONDS 3
+#define FRAMES (RATE * SECONDS / FRAME)
+#define DELAY 700 // speaker to mic and back through the buffers, ~16 ms
+#define RESONANCE_HZ 2400.0
+#define LOOP_GAIN 1.25 // at the resonance, the room's peak
+#define ROOM_Q 30.0 // one sharp peak, ~80 Hz wide, so a single mode runs away
+#define FULL_SCALE 2147483648.0
+
+static int32_t out_line[DELAY + FRAME * FRAMES];
+static double frame_db[FRAMES];
+
+static double dbfs(const int32_t* x, size_t n) {
+    double sum = 0;
+    for (size_t i = 0; i < n; i++) sum += (double)x[i] * x[i];
+    return 10 * log10(sum / n / (FULL_SCALE * FULL_SCALE) + 1e-20);
+}
+
+// the room's speaker to mic path, a resonance in double, normalized to 1 at its peak
+typedef struct { double b0, b2, a1, a2, x1, x2, y1, y2; } room_t;
+
+static void room_init(room_t* r) {
+    double w0 = 2 * M_PI * RESONANCE_HZ / RATE, alpha = sin(w0) / (2 * ROOM_Q), a0 = 1 + alpha;
+    *r = (room_t){ .b0 = alpha / a0, .b2 = -alpha / a0, .a1 = -2 * cos(w0) / a0, .a2 = (1 - alpha) / a0 };
+}
+
+static double room(room_t* r, double x) {
+    double y = r->b0 * x + r->b2 * r->x2 - r->a1 * r->y1 - r->a2 * r->y2;
+    r->x2 = r->x1; r->x1 = x;
+    r->y2 = r->y1; r->y1 = y;
+    return y;
+}
+
+// runs the loop for SECONDS, frame_db[] gets the level of what reaches the speaker. returns the frame the first
+// notch went in at, or -1
+static int run_room(feedback_suppress_t* fs) {
+    static int32_t frame[FRAME];
+    room_t r;
+    room_init(&r);
+    uint32_t rng = 17;
+    memset(out_line, 0, sizeof(out_line));
+    int caught = -1;
+    for (int f = 0; f < FRAMES; f++) {
+        for (int i = 0; i < FRAME; i++) {
+            size_t n = (size_t)f * FRAME + i;
+            double talker = ((int32_t)(check_rand(&rng) % 2001) - 1000) * (FULL_SCALE / 1000 / 300); // ~ -55 dBFS
+            double mic = talker + LOOP_GAIN * room(&r, out_line[n]); // out_line[n] left the speaker DELAY samples ago
+            frame[i] = (int32_t)fmax(-FULL_SCALE, fmin(FULL_SCALE - 1, mic)); // the adc clips
+        }
+        if (fs != NULL) feedback_suppress_process(fs, frame, FRAME);
+        if (fs != NULL && caught < 0 && fs->detections > 0) caught = f;
+        memcpy(&out_line[DELAY + (size_t)f * FRAME], frame, sizeof(frame));
+        frame_db[f] = dbfs(frame, FRAME);
+    }
+    return caught;
+}
+
+static void test_room(void) {
+    // the room on its own howls up to the rails
+    run_room(NULL);
+    double loudest = -200;
+    for (int f = 0; f < FRAMES; f++) loudest = fmax(loudest, frame_db[f]);
+    CHECK(loudest > -6, "no suppressor and the room peaks at %.1f dBFS, not a howl", loudest);
+
+    // with it: how long from the loop closing until a notch lands, how loud the howl got first, and that it stays down
+    static feedback_suppress_t fs;
+    feedback_suppress_init(&fs, RATE);
+    int caught = run_room(&fs);
+    double suppress_ms = 1000.0 * (caught + 1) * FRAME / RATE;
+    loudest = -200;
+    for (int f = 0; f < FRAMES; f++) loudest = fmax(loudest, frame_db[f]);
+    double settle_db = -200;
+    for (int f = FRAMES - RATE / FRAME; f < FRAMES; f++) settle_db = fmax(settle_db, frame_db[f]); // the last second
+    uint32_t notches = feedback_suppress_active(&fs);
+    printf("  howl at %.0f Hz: notched %.0f ms after the loop closed, peak %.1f dBFS, %u notch%s, last second under %.1f dBFS\n",
+        RESONANCE_HZ, suppress_ms, loudest, notches, (notches == 1) ? "" : "es", settle_db);
+    CHECK(caught >= 0 && suppress_ms < 500, "no notch %.0f ms in", suppress_ms);
+    CHECK(loudest < -40, "howl reached %.1f dBFS before it was caught", loudest);
+    CHECK(settle_db < -50, "still at %.1f dBFS after it was caught", settle_db);
+    bool near = false;
+    for (int n = 0; n < FEEDBACK_MAX_NOTCHES; n++) {
+        if (fs.notches[n].active && fabs(fs.notches[n].freq - RESONANCE_HZ) < 150) near = true;
+    }
+    CHECK(notches >= 1 && near, "%u notches, none at the %.0f Hz resonance", notches, RESONANCE_HZ);
+}
+
+// a sung note is a harmonic series, not a howl, however long it's held
+static void test_sung_note(void) {
+    static feedback_suppress_t fs;
+    static int32_t frame[FRAME];
+    feedback_suppress_init(&fs, RATE);
+    for (int f = 0; f < FRAMES; f++) {
+        for (int i = 0; i < FRAME; i++) {
+            double t = (double)(f * FRAME + i) / RATE, s = 0;
+            for (int h = 1; h <= 6; h++) s += sin(2 * M_PI * 330 * h * t) / h;
+            frame[i] = (int32_t)(s * FULL_SCALE / 8);
+        }
+        feedback_suppress_process(&fs, frame, FRAME);
+    }
+    CHECK(feedback_suppress_active(&fs) == 0 && fs.detections == 0, "a held 330 Hz vowel got %u notches", fs.detections);
+}
+
+static void test_biquad(void) {
+    // a resonant lowpass overshoots a step near full scale: the output pins at the rail, it doesn't wrap negative
+    static biquad_t bq;
+    static int32_t data[2048];
+    biquad_lowpass(&bq, RATE, 1000, 4);
+    biquad_reset(&bq);
+    for (int i = 0; i < 2048; i++) data[i] = (i < 16) ? 0 : INT32_MAX / 10 * 9;
+    biquad_process(&bq, data, 2048);
+    int32_t lowest = INT32_MAX, highest = 0;
+    for (int i = 16; i < 2048; i++) {
+        lowest = (data[i] < lowest) ? data[i] : lowest;
+        highest = (data[i] > highest) ? data[i] : highest;
+    }
+    CHECK(lowest >= 0 && highest == INT32_MAX, "step overshoot: %d..%d", lowest, highest);
+
+    // retuning a notch mid tone keeps the history, so the output carries straight on
+    int32_t steady = 0, at_retune = 0, prev = 0;
+    biquad_notch(&bq, RATE, 3000, 20);
+    biquad_reset(&bq);
+    for (int block = 0; block < 16; block++) {
+        for (int i = 0; i < 256; i++) data[i] = (int32_t)(sin(2 * M_PI * 1500 * (block * 256 + i) / RATE) * FULL_SCALE / 4);
+        if (block == 8) biquad_notch(&bq, RATE, 3050, 10);
+        int32_t x1 = bq.x1, y1 = bq.y1;
+        biquad_process(&bq, data, 256);
+        if (block == 8) CHECK(x1 != 0 && y1 != 0, "retune cleared the history");
+        for (int i = 0; i < 256; i++) {
+            int32_t jump = abs(data[i] / 2 - prev / 2);
+            if (block == 8 && i < 8) at_retune = (jump > at_retune) ? jump : at_retune;
+            else if (block > 1) steady = (jump > steady) ? jump : steady;
+            prev = data[i];
+        }
+    }
+    CHECK(at_retune <= steady + steady / 20, "retune jumps %d, %d anywhere else", at_retune, steady);
+}
+
+int main(void) {
+    test_room();
+    test_sung_note();
+    test_biquad();
+    return check_done("feedback_suppress");
+}
@@ -0,0 +1,200 @@
+// uses: analog_1a/Filter
+// the analog board's block filters: the fir against a direct convolution, the decimator against the fir it skips
+// outputs of, the float biquad cascade against the same sections in double and against its cookbook response, and
+// the echo comb. in place and split into uneven calls, the way frames arrive
+#include <string.h>
+#include <stdlib.h>
+#include "check.h"
+#include "Filter.h"
+
+#define RATE 32000 // analog_1a's SAMPLE_RATE
+#define LEN 4096
+
+static int16_t in[LEN], out[LEN], again[LEN];
+static const int16_t fir7[7] = { 175, 603, 886, 1024, 886, 603, 175 }; // main.c's 7 kHz lowpass
+
+static void noise(uint32_t seed) {
+    for (int i = 0; i < LEN; i++) in[i] = (int16_t)check_rand(&seed);
+}
+
+static int32_t max_abs_diff(const int16_t* a, const int16_t* b, size_t n) {
+    int32_t worst = 0;
+    for (size_t i = 0; i < n; i++) worst = (abs(a[i] - b[i]) > worst) ? abs(a[i] - b[i]) : worst;
+    return worst;
+}
+
+// feeds in[] through process in pieces of 1..max_chunk, returns outputs written
+typedef size_t (*chunk_fn)(void* state, const int16_t* in, int16_t* out, size_t count);
+
+static size_t split(chunk_fn fn, void* state, int16_t* dst, size_t max_chunk, uint32_t seed) {
+    size_t at = 0, written = 0;
+    while (at < LEN) {
+        size_t n = 1 + check_rand(&seed) % max_chunk;
+        if (n > LEN - at) n = LEN - at;
+        written += fn(state, in + at, dst + written, n);
+        at += n;
+    }
+    return written;
+}
+
+static size_t fir_chunk(void* state, const int16_t* src, int16_t* dst, size_t count) {
+    fir_process(state, src, dst, count);
+    return count;
+}
+
+static size_t decimator_chunk(void* state, const int16_t* src, int16_t* dst, size_t count) {
+    return decimator_process(state, src, dst, count);
+}
+
+static size_t cascade_chunk(void* state, const int16_t* src, int16_t* dst, size_t count) {
+    biquad_cascade_process(state, src, dst, count);
+    return count;
+}
+
+static void test_fir(void) {
+    static fir_t fir;
+    static int16_t taps[FIR_MAX_TAPS];
+    uint32_t rng = 3;
+    for (int k = 0; k < FIR_MAX_TAPS; k++) taps[k] = (int16_t)((int32_t)(check_rand(&rng) % 1001) - 500); // sum |h| < 1
+
+    static const uint16_t lengths[] = { 1, 7, 16, 33, FIR_MAX_TAPS };
+    for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+        uint16_t n = lengths[l];
+        const int16_t* h = (n == 7) ? fir7 : taps;
+        noise(n);
+        // coeffs[k] multiplies the sample k back, rounded
+        for (int i = 0; i < LEN; i++) {
+            int32_t acc = 1 << 14;
+            for (int k = 0; k < n && k <= i; k++) acc += h[k] * in[i - k];
+            again[i] = (int16_t)(acc >> 15);
+        }
+        fir_init(&fir, h, n);
+        split(fir_chunk, &fir, out, 300, n);
+        CHECK(memcmp(out, again, sizeof(out)) == 0, "%u taps: %d lsb from the convolution", n, max_abs_diff(out, again, LEN));
+        fir_init(&fir, h, n);
+        memcpy(out, in, sizeof(in));
+        fir_process(&fir, out, out, LEN); // in place, as main.c runs it
+        CHECK(memcmp(out, again, sizeof(out)) == 0, "%u taps in place differs", n);
+    }
+
+    // full scale against every coefficient's sign saturates instead of wrapping
+    static const int16_t big[2] = { 32767, 32767 };
+    fir_init(&fir, big, 2);
+    int16_t loud[4] = { 30000, 30000, -30000, -30000 };
+    fir_process(&fir, loud, loud, 4);
+    CHECK(loud[1] == INT16_MAX && loud[3] == INT16_MIN, "2x gain gave %d, %d", loud[1], loud[3]);
+}
+
+static void test_decimator(void) {
+    static fir_t fir;
+    static decimator_t dec;
+    static const uint16_t factors[] = { 1, 2, 3, 4, 7 };
+    for (size_t f = 0; f < sizeof(factors) / sizeof(factors[0]); f++) {
+        uint16_t factor = factors[f];
+        noise(factor);
+        fir_init(&fir, fir7, 7);
+        fir_process(&fir, in, again, LEN);
+        // the kept outputs are the fir's at every factor'th input, counting from the factor'th
+        decimator_init(&dec, fir7, 7, factor);
+        size_t written = split(decimator_chunk, &dec, out, 200, factor);
+        CHECK(written == LEN / factor, "by %u: %zu outputs from %d inputs", factor, written, LEN);
+        int32_t worst = 0;
+        for (size_t i = 0; i < written; i++) {
+            int32_t diff = abs(out[i] - again[(i + 1) * factor - 1]);
+            worst = (diff > worst) ? diff : worst;
+        }
+        CHECK(worst == 0, "by %u: %d lsb from the full rate fir", factor, worst);
+    }
+    decimator_init(&dec, fir7, 7, 0);
+    CHECK(dec.factor == 1, "factor 0 became %u", dec.factor);
+}
+
+// the same tdf-ii sections in double, fed the same 16 bit input
+static void cascade_reference(const biquad_cascade_t* bc, int16_t* dst) {
+    double s[BIQUAD_MAX_SECTIONS][2] = { { 0 } };
+    for (int i = 0; i < LEN; i++) {
+        double x = in[i];
+        for (int k = 0; k < bc->sections; k++) {
+            const float* c = bc->coeffs[k];
+            double y = c[0] * x + s[k][0];
+            s[k][0] = c[1] * x - c[3] * y + s[k][1];
+            s[k][1] = c[2] * x - c[4] * y;
+            x = y;
+        }
+        dst[i] = (int16_t)fmax(INT16_MIN, fmin(INT16_MAX, lrint(x)));
+    }
+}
+
+// gain in dB of a tone through a fresh cascade, measured after it settles
+static double cascade_gain(biquad_cascade_t* bc, double hz) {
+    for (int i = 0; i < LEN; i++) in[i] = (int16_t)lrint(10000 * sin(2 * M_PI * hz * i / RATE));
+    for (int k = 0; k < bc->sections; k++) bc->state[k][0] = bc->state[k][1] = 0;
+    biquad_cascade_process(bc, in, out, LEN);
+    double sum = 0;
+    for (int i = LEN / 2; i < LEN; i++) sum += (double)out[i] * out[i];
+    return 20 * log10(sqrt(2 * sum / (LEN / 2)) / 10000);
+}
+
+static void test_cascade(void) {
+    static biquad_cascade_t bc;
+    biquad_cascade_init(&bc);
+    // 4th order butterworth lowpass at 4 kHz, then a 2nd order highpass at 80 Hz. the bilinear transform squeezes the
+    // octave above the lowpass' corner, 30.6 dB down rather than an analog 24
+    CHECK(biquad_cascade_add_lowpass(&bc, RATE, 4000, 0.5412f) == 0, "first section not at 0");
+    CHECK(biquad_cascade_add_lowpass(&bc, RATE, 4000, 1.3066f) == 1, "second section not at 1");
+    CHECK(biquad_cascade_add_highpass(&bc, RATE, 80, 0.7071f) == 2, "third section not at 2");
+    struct { double hz, min_db, max_db; } points[] = {
+        { 1000, -0.2, 0.2 }, { 4000, -3.3, -2.7 }, { 8000, -31.6, -29.6 }, { 12000, -200, -40 }, // the lowpass
+        { 80, -3.3, -2.7 }, { 40, -12.8, -11.5 }, // the highpass
+    };
+    for (size_t p = 0; p < sizeof(points) / sizeof(points[0]); p++) {
+        double gain = cascade_gain(&bc, points[p].hz);
+        CHECK(gain >= points[p].min_db && gain <= points[p].max_db, "%.0f Hz: %.2f dB, want %.1f..%.1f", points[p].hz, gain,
+            points[p].min_db, points[p].max_db);
+    }
+
+    // float against double over more than a block, in uneven calls, then in place
+    noise(7);
+    for (int i = 0; i < LEN; i++) in[i] /= 2; // the lowpass' peak gain rings past the rails otherwise
+    for (int k = 0; k < bc.sections; k++) bc.state[k][0] = bc.state[k][1] = 0;
+    cascade_reference(&bc, again);
+    split(cascade_chunk, &bc, out, 3 * FILTER_BLOCK, 8);
+    int32_t worst = max_abs_diff(out, again, LEN);
+    CHECK(worst <= 1, "%d lsb from the double sections", worst);
+    for (int k = 0; k < bc.sections; k++) bc.state[k][0] = bc.state[k][1] = 0;
+    memcpy(out, in, sizeof(in));
+    biquad_cascade_process(&bc, out, out, LEN);
+    CHECK(max_abs_diff(out, again, LEN) <= 1, "in place %d lsb from the double sections", max_abs_diff(out, again, LEN));
+
+    CHECK(biquad_cascade_add_highpass(&bc, RATE, 80, 0.7071f) == 3, "fourth section not at 3");
+    CHECK(biquad_cascade_add_lowpass(&bc, RATE, 80, 0.7071f) == -1, "a fifth section fit");
+
+    // no sections passes through
+    biquad_cascade_init(&bc);
+    noise(9);
+    biquad_cascade_process(&bc, in, out, LEN);
+    CHECK(memcmp(in, out, sizeof(in)) == 0, "empty cascade changed the signal");
+}
+
+static void test_comb(void) {
+    static comb_t comb;
+    static int16_t line[100];
+    comb_init(&comb, line, 100, 16384); // an echo every 100 samples, each half the last
+    memset(in, 0, sizeof(in));
+    in[0] = 16000;
+    comb_process(&comb, in, out, 250);
+    comb_process(&comb, in + 250, out + 250, 250);
+    CHECK(out[0] == 16000 && out[100] == 8000 && out[200] == 4000 && out[300] == 2000 && out[400] == 1000,
+        "echoes %d %d %d %d %d", out[0], out[100], out[200], out[300], out[400]);
+    int nonzero = 0;
+    for (int i = 0; i < 500; i++) nonzero += (out[i] != 0);
+    CHECK(nonzero == 5, "%d nonzero samples, want the 5 echoes", nonzero);
+}
+
+int main(void) {
+    test_fir();
+    test_decimator();
+    test_cascade();
+    test_comb();
+    return check_done("filter");
+}
@@ -0,0 +1,159 @@
+// uses: analog_1a/FramePool
+// the analog board's frame pools: exhaustion and every kind of bad free counted and refused, then a soak of four
+// threads allocating and freeing at random while a 5 kHz timer signal plays an isr that grabs bursts of blocks in
+// the middle of their compare-and-swaps. every block carries an owner word, so a block handed to two holders at
+// once is caught, and at the end all of them have to be back on the free list
+#include <string.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include "check.h"
+#include "constants.h"
+#include "FramePool.h"
+
+typedef struct { _Alignas(4) uint8_t bytes[ADC_FRAME_SIZE]; } adc_frame_t; // as main.c has them
+typedef struct { int16_t samples[FRAME_SIZE/2]; } pcm_frame_t;
+FRAME_POOL_TYPED(adc_pool, adc_frame_t)
+FRAME_POOL_TYPED(pcm_pool, pcm_frame_t)
+
+#define BLOCKS 16 // fewer than the threads and the isr can hold between them, so it runs dry
+#define THREADS 4
+#define OPS 4000000 // per thread
+#define HOLD 6 // most blocks a thread holds at once
+#define ISR_ID 100
+
+static pcm_frame_t storage[BLOCKS];
+static pcm_pool_t pool;
+static _Atomic uint32_t double_handouts, wrong_owner, isr_runs, isr_blocks, refused_expected;
+
+static bool take(pcm_frame_t* frame, uint32_t id) {
+    if (atomic_exchange((_Atomic uint32_t*)frame->samples, id) == 0) return true;
+    atomic_fetch_add(&double_handouts, 1);
+    return false;
+}
+
+static void give_back(pcm_frame_t* frame, uint32_t id) {
+    if (atomic_exchange((_Atomic uint32_t*)frame->samples, 0) != id) atomic_fetch_add(&wrong_owner, 1);
+    pcm_pool_free(&pool, frame);
+}
+
+static void isr(int sig) {
+    (void)sig;
+    pcm_frame_t* held[4];
+    uint32_t n = 1 + atomic_load_explicit(&isr_runs, memory_order_relaxed) % 4, got = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        if ((held[got] = pcm_pool_alloc(&pool)) != NULL && take(held[got], ISR_ID)) got++;
+    }
+    while (got > 0) give_back(held[--got], ISR_ID);
+    atomic_fetch_add_explicit(&isr_runs, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&isr_blocks, n, memory_order_relaxed);
+}
+
+static void* worker(void* arg) {
+    uint32_t id = (uint32_t)(uintptr_t)arg;
+    uint32_t rng = 0x9E3779B9u * id;
+    pcm_frame_t* held[HOLD];
+    int count = 0;
+    uint32_t refused = 0;
+    for (int op = 0; op < OPS; op++) {
+        uint32_t r = check_rand(&rng);
+        if (count < HOLD && (count == 0 || r % 2)) {
+            pcm_frame_t* frame = pcm_pool_alloc(&pool);
+            if (frame != NULL && take(frame, id)) held[count++] = frame;
+        } else {
+            int k = (int)(r >> 8) % count;
+            if (r % 64 == 2) { // a pointer into the middle of a held block, refused before it is looked at
+                pcm_pool_free(&pool, (pcm_frame_t*)((uint8_t*)held[k] + 2));
+                refused++;
+            }
+            give_back(held[k], id);
+            held[k] = held[--count];
+        }
+        if (r % 1024 == 5) { // a frame that was never the pool's
+            static _Thread_local pcm_frame_t foreign;
+            pcm_pool_free(&pool, &foreign);
+            refused++;
+        }
+    }
+    while (count > 0) give_back(held[--count], id);
+    atomic_fetch_add(&refused_expected, refused);
+    return NULL;
+}
+
+static void test_basics(void) {
+    static adc_frame_t adc_storage[FRAME_QUEUE_LEN + 2];
+    static adc_pool_t adc;
+    adc_pool_init(&adc, adc_storage, FRAME_QUEUE_LEN + 2);
+    adc_frame_t* frames[FRAME_QUEUE_LEN + 2];
+    for (int i = 0; i < FRAME_QUEUE_LEN + 2; i++) frames[i] = adc_pool_alloc(&adc);
+    bool distinct = true;
+    for (int i = 0; i < FRAME_QUEUE_LEN + 2; i++) {
+        distinct &= frames[i] >= adc_storage && frames[i] < adc_storage + FRAME_QUEUE_LEN + 2;
+        for (int k = 0; k < i; k++) distinct &= frames[i] != frames[k];
+    }
+    CHECK(distinct, "blocks handed out twice or from outside the storage");
+    CHECK(adc_pool_alloc(&adc) == NULL && adc.pool.exhausted == 1, "alloc past the end gave a block");
+    CHECK(adc.pool.in_use == FRAME_QUEUE_LEN + 2 && adc.pool.max_in_use == FRAME_QUEUE_LEN + 2, "in use %u, max %u",
+        adc.pool.in_use, adc.pool.max_in_use);
+
+    static adc_frame_t other;
+    adc_pool_free(&adc, frames[3]);
+    adc_pool_free(&adc, frames[3]); // double
+    adc_pool_free(&adc, &other); // foreign
+    adc_pool_free(&adc, (adc_frame_t*)(frames[4]->bytes + 4)); // inside a block
+    adc_pool_free(&adc, NULL); // ignored, not bad
+    CHECK(adc.pool.bad_frees == 3 && adc.pool.in_use == FRAME_QUEUE_LEN + 1, "%u bad frees, %u in use",
+        adc.pool.bad_frees, adc.pool.in_use);
+    CHECK(adc_pool_alloc(&adc) == frames[3], "the freed block didn't come back first");
+    for (int i = 0; i < FRAME_QUEUE_LEN + 2; i++) adc_pool_free(&adc, frames[i]);
+    CHECK(adc.pool.in_use == 0 && adc.pool.bad_frees == 3, "%u in use after freeing all", adc.pool.in_use);
+
+    static uint8_t big[(FRAME_POOL_MAX_BLOCKS + 4) * 16];
+    static frame_pool_t capped;
+    frame_pool_init(&capped, big, 16, FRAME_POOL_MAX_BLOCKS + 4);
+    int n = 0;
+    while (frame_pool_alloc(&capped) != NULL) n++;
+    CHECK(n == FRAME_POOL_MAX_BLOCKS, "%d blocks from a pool capped at %d", n, FRAME_POOL_MAX_BLOCKS);
+    static frame_pool_t empty;
+    frame_pool_init(&empty, big, 16, 0);
+    CHECK(frame_pool_alloc(&empty) == NULL, "an empty pool gave a block");
+}
+
+static void test_soak(void) {
+    pcm_pool_init(&pool, storage, BLOCKS);
+    struct sigaction sa = { .sa_handler = isr };
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART;
+    sigaction(SIGALRM, &sa, NULL);
+    struct itimerval every = { .it_interval = { 0, 200 }, .it_value = { 0, 200 } };
+    setitimer(ITIMER_REAL, &every, NULL);
+
+    pthread_t threads[THREADS];
+    for (uintptr_t t = 0; t < THREADS; t++) pthread_create(&threads[t], NULL, worker, (void*)(t + 1));
+    for (int t = 0; t < THREADS; t++) pthread_join(threads[t], NULL);
+    struct itimerval off = { 0 };
+    setitimer(ITIMER_REAL, &off, NULL);
+    signal(SIGALRM, SIG_IGN);
+
+    printf("  soak: %d threads x %d ops, %u isr bursts taking %u blocks, %u allocs found it empty, peak %u of %d\n",
+        THREADS, OPS, isr_runs, isr_blocks, pool.pool.exhausted, pool.pool.max_in_use, BLOCKS);
+    CHECK(double_handouts == 0 && wrong_owner == 0, "%u blocks handed out twice, %u freed under another owner",
+        double_handouts, wrong_owner);
+    CHECK(pool.pool.bad_frees == refused_expected, "%u bad frees counted, %u made", pool.pool.bad_frees, refused_expected);
+    CHECK(pool.pool.in_use == 0, "%u still in use", pool.pool.in_use);
+    // the free list holds every block exactly once
+    pcm_frame_t* all[BLOCKS + 1];
+    int n = 0;
+    while (n <= BLOCKS && (all[n] = pcm_pool_alloc(&pool)) != NULL) n++;
+    bool distinct = true;
+    for (int i = 0; i < n; i++) {
+        for (int k = 0; k < i; k++) distinct &= all[i] != all[k];
+    }
+    CHECK(n == BLOCKS && distinct, "%d blocks on the free list, want %d, distinct %d", n, BLOCKS, distinct);
+}
+
+int main(void) {
+    test_basics();
+    test_soak();
+    return check_done("frame_pool");
+}
@@ -0,0 +1,142 @@
+// uses: prod/FrameRing
+// spsc stress: a producer and a consumer thread pass numbered frames through rings of 1 to 8 slots as fast as they
+// can, the consumer sleeping on a semaphore whenever frame_ring_prepare_wait finds the ring empty, like the write task
+// on its notification. every frame has to arrive once, in order and intact, and no wake-up may be lost. then the
+// counters start at every position up to the last before they wrap, and a single thread fills and drains the ring
+// at random for hundreds of laps: the producer must never get a slot the consumer still holds, the consumer gets
+// them oldest first, and head and tail stay inside their 2*slot_count range instead of running up to 2^32, where a
+// slot_count like 3, 5, 6 or 7 would have reused a slot early.
+// digital_1b has its own copy of the ring, test_frame_ring_1b.c runs this against it
+#include <pthread.h>
+#include <semaphore.h>
+#include <errno.h>
+#include "check.h"
+#include "FrameRing.h"
+
+#define FRAME 64
+#define MAX_SLOTS 8
+#define FRAMES 100000
+#ifndef TEST_NAME
+#define TEST_NAME "frame_ring"
+#endif
+
+static int32_t pool[MAX_SLOTS * FRAME];
+static frame_ring_t ring;
+static sem_t wake;
+static _Atomic uint32_t producer_spins;
+
+static void* producer(void* arg) {
+    uint32_t slots = *(uint32_t*)arg;
+    for (uint32_t seq = 0; seq < FRAMES; seq++) {
+        int32_t* frame;
+        while ((frame = frame_ring_acquire(&ring)) == NULL) {
+            atomic_fetch_add_explicit(&producer_spins, 1, memory_order_relaxed); // the real read task would drop it
+            sched_yield();
+        }
+        for (int i = 0; i < FRAME; i++) frame[i] = (int32_t)(seq * 2654435761u + i);
+        if (frame_ring_publish(&ring)) sem_post(&wake);
+        CHECK(frame_ring_occupancy(&ring) <= slots, "%u frames in a %u slot ring", frame_ring_occupancy(&ring), slots);
+    }
+    return NULL;
+}
+
+static bool run(uint32_t slots) {
+    frame_ring_init(&ring, pool, FRAME, slots);
+    sem_init(&wake, 0, 0);
+    atomic_store(&producer_spins, 0);
+    pthread_t thread;
+    pthread_create(&thread, NULL, producer, &slots);
+
+    uint32_t sleeps = 0, lost = 0, corrupt = 0;
+    for (uint32_t seq = 0; seq < FRAMES; seq++) {
+        int32_t* frame;
+        while ((frame = frame_ring_prepare_wait(&ring)) == NULL) {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_sec += 2;
+            sleeps++;
+            if (sem_timedwait(&wake, &deadline) != 0 && errno == ETIMEDOUT) {
+                lost++; // a publish went by without asking for the wake-up
+                break;
+            }
+        }
+        if (frame == NULL) {
+            if (lost > 3) break;
+            seq--;
+            continue;
+        }
+        for (int i = 0; i < FRAME; i++) {
+            if (frame[i] != (int32_t)(seq * 2654435761u + i)) {
+                if (corrupt++ < 3) CHECK(0, "%u slots: frame %u sample %d is %ld", slots, seq, i, (long)frame[i]);
+                break;
+            }
+        }
+        frame_ring_release(&ring);
+    }
+    pthread_join(thread, NULL);
+    sem_destroy(&wake);
+
+    CHECK(lost == 0, "%u slots: %u wake-ups lost", slots, lost);
+    CHECK(corrupt == 0, "%u slots: %u frames out of order or torn", slots, corrupt);
+    CHECK(frame_ring_occupancy(&ring) == 0, "%u slots: %u frames left over", slots, frame_ring_occupancy(&ring));
+    CHECK(atomic_load(&ring.max_occupancy) <= slots, "%u slots: max occupancy %u", slots, atomic_load(&ring.max_occupancy));
+    printf("  %u slots: %u frames, consumer slept %u times, producer found the ring full %u times\n",
+        slots, FRAMES, sleeps, atomic_load(&producer_spins));
+    return lost == 0 && corrupt == 0;
+}
+
+static void laps(uint32_t slots) {
+    uint32_t rng = 77, bad = 0;
+    for (uint32_t start = 0; start < 2 * slots; start++) {
+        frame_ring_init(&ring, pool, FRAME, slots);
+        atomic_store(&ring.head, start);
+        atomic_store(&ring.tail, start);
+        int32_t* held[MAX_SLOTS]; // published and not released yet, oldest first
+        uint32_t count = 0;
+        for (int op = 0; op < 2000 * (int)slots; op++) {
+            if (check_rand(&rng) % 2) {
+                int32_t* frame = frame_ring_acquire(&ring);
+                if (count == slots) {
+                    bad += frame != NULL;
+                    continue;
+                }
+                for (uint32_t i = 0; i < count; i++) bad += frame == held[i];
+                bad += frame == NULL;
+                if (frame == NULL) continue;
+                held[count++] = frame;
+                frame_ring_publish(&ring);
+            } else {
+                int32_t* frame = frame_ring_peek(&ring);
+                bad += frame != ((count != 0) ? held[0] : NULL);
+                if (frame == NULL) continue;
+                frame_ring_release(&ring);
+                for (uint32_t i = 1; i < count; i++) held[i - 1] = held[i];
+                count--;
+            }
+            bad += frame_ring_occupancy(&ring) != count;
+            bad += atomic_load(&ring.head) >= 2 * slots || atomic_load(&ring.tail) >= 2 * slots;
+        }
+    }
+    CHECK(bad == 0, "%u slots: %u wrong slots or counts over the laps", slots, bad);
+}
+
+int main(void) {
+    for (uint32_t slots = 1; slots <= MAX_SLOTS; slots++) {
+        if (!run(slots)) break;
+    }
+    for (uint32_t slots = 1; slots <= MAX_SLOTS; slots++) laps(slots);
+    printf("  1..%d slots: no slot handed out twice over the laps from any start\n", MAX_SLOTS);
+
+    // overrun accounting: a full ring refuses the producer and counts it
+    frame_ring_init(&ring, pool, FRAME, 3);
+    for (int i = 0; i < 3; i++) {
+        CHECK(frame_ring_acquire(&ring) != NULL, "slot %d", i);
+        frame_ring_publish(&ring);
+    }
+    CHECK(frame_ring_acquire(&ring) == NULL, "a fourth slot out of three");
+    CHECK(atomic_load(&ring.overruns) == 1, "%u overruns", atomic_load(&ring.overruns));
+    CHECK(frame_ring_peek(&ring) == pool, "oldest first");
+    frame_ring_release(&ring);
+    CHECK(frame_ring_acquire(&ring) == pool, "the released slot comes back");
+    return check_done(TEST_NAME);
+}
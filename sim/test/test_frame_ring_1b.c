@@ -0,0 +1,4 @@
+// uses: digital_1b/FrameRing
+// the same stress test against the digital_1b copy of the ring
+#define TEST_NAME "frame_ring_1b"
+#include "test_frame_ring.c"
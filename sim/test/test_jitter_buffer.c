@@ -0,0 +1,136 @@
+// uses: prod/JitterBuffer prod/ByteRing prod/Resampler
+// the a2dp path in simulated time: a phone whose clock drifts against ours sends packets that arrive late by a
+// random amount and sometimes in bursts after a radio stall, into the byte ring at main.c's size, while the
+// write task reads a frame every frame period. once settled there must be no underruns, no ring overruns and no
+// gaps or splices in the tone, and the resampler ratio has to have found the drift
+#include <string.h>
+#include <stdlib.h>
+#include "check.h"
+#include "constants.h"
+#include "JitterBuffer.h"
+
+#define PACKET 512 // stereo frames per a2dp packet, the sim's default
+#define SECONDS 300
+#define SETTLE_S 60
+#define TONE_HZ 441.0
+#define LEVEL 12000
+
+static uint8_t storage[RINGBUFFER_CAPACITY];
+static byte_ring_t ring;
+static jitter_buffer_t jb;
+
+typedef struct {
+    uint32_t in_rate;
+    double ppm; // phone clock against ours, + sends faster
+    double jitter_ms; // each packet up to this late
+    double stall_ms; // every 3 s the radio holds packets this long, then they all land at once
+} source_t;
+
+typedef struct {
+    uint32_t underruns;
+    uint32_t overrun_bytes;
+    uint32_t splices; // output samples that jump more than the tone can
+    double ratio_ppm; // mean over the settled part
+    uint32_t fill_min, fill_max, target_max;
+} result_t;
+
+static result_t simulate(const source_t* src, double one_stall_ms) {
+    byte_ring_init(&ring, storage, sizeof(storage));
+    jitter_buffer_init(&jb, &ring, src->in_rate, SAMPLE_RATE, JITTER_MIN_TARGET, JITTER_MAX_TARGET);
+    uint32_t rng = 99;
+    result_t r = { .fill_min = UINT32_MAX };
+
+    const double send_period = PACKET / (src->in_rate * (1 + src->ppm * 1e-6));
+    const double read_period = (double)FRAME_SIZE / SAMPLE_RATE;
+    double arrival = 0, next_read = read_period;
+    uint64_t packet = 0, reads = 0;
+    double phase = 0, ratio_sum = 0;
+    uint32_t ratio_reads = 0, underruns_at_settle = 0, overruns_at_settle = 0;
+    int16_t last = 0;
+    bool have_last = false;
+    static int16_t pcm[PACKET * 2], out[FRAME_SIZE * 2];
+
+    while (next_read < SECONDS) {
+        // next packet's arrival: sent on the phone's clock, delayed, never overtaking the one before
+        double sent = packet * send_period;
+        double delay = (check_rand(&rng) % 1000) * src->jitter_ms / 1000 * 1e-3;
+        double cycle = fmod(sent, 3.0);
+        if (src->stall_ms > 0 && cycle < src->stall_ms * 1e-3) delay += src->stall_ms * 1e-3 - cycle;
+        if (one_stall_ms > 0 && sent >= 200 && sent < 200 + one_stall_ms * 1e-3) delay += 200 + one_stall_ms * 1e-3 - sent;
+        double next_arrival = (sent + delay > arrival) ? sent + delay : arrival;
+
+        if (next_arrival <= next_read) {
+            arrival = next_arrival;
+            for (int i = 0; i < PACKET; i++) {
+                pcm[2*i] = pcm[2*i+1] = (int16_t)lrint(LEVEL * sin(phase));
+                phase += 2 * M_PI * TONE_HZ / src->in_rate;
+            }
+            phase = fmod(phase, 2 * M_PI);
+            byte_ring_write(&ring, (const uint8_t*)pcm, sizeof(pcm));
+            packet++;
+            continue;
+        }
+
+        size_t got = jitter_buffer_read(&jb, out, FRAME_SIZE);
+        reads++;
+        next_read = (reads + 1) * read_period;
+        bool settled = next_read >= SETTLE_S;
+        if (!settled) {
+            underruns_at_settle = jb.underruns;
+            overruns_at_settle = atomic_load(&ring.overrun_bytes);
+            have_last = (got == FRAME_SIZE);
+            last = out[2 * FRAME_SIZE - 2];
+            continue;
+        }
+        // a 441 Hz tone moves at most LEVEL * 2 pi 441 / 44100 per sample, a dropped or padded stretch jumps further
+        for (int i = 0; i < FRAME_SIZE; i++) {
+            if (have_last && abs(out[2*i] - last) > LEVEL * 2 * M_PI * TONE_HZ / SAMPLE_RATE * 1.2) r.splices++;
+            last = out[2*i];
+            have_last = true;
+        }
+        ratio_sum += jb.ratio_ppm;
+        ratio_reads++;
+        r.fill_min = (jb.fill_frames < r.fill_min) ? jb.fill_frames : r.fill_min;
+        r.fill_max = (jb.fill_frames > r.fill_max) ? jb.fill_frames : r.fill_max;
+        r.target_max = (jb.target_frames > r.target_max) ? jb.target_frames : r.target_max;
+    }
+    r.underruns = jb.underruns - underruns_at_settle;
+    r.overrun_bytes = atomic_load(&ring.overrun_bytes) - overruns_at_settle;
+    r.ratio_ppm = ratio_sum / ratio_reads;
+    return r;
+}
+
+int main(void) {
+    static const source_t sources[] = {
+        { 44100, 0, 5, 0 },
+        { 44100, 300, 20, 0 }, // phone fast
+        { 44100, -300, 20, 0 }, // phone slow
+        { 44100, 120, 10, 50 }, // radio stalls
+        { 44100, -600, 15, 30 }, // a poor crystal, leaves the loop 400 ppm to steer the fill with
+        { 48000, -150, 20, 40 }, // resampled
+    };
+    result_t calm = { 0 }, stalled = { 0 };
+    for (size_t s = 0; s < sizeof(sources) / sizeof(sources[0]); s++) {
+        const source_t* src = &sources[s];
+        result_t r = simulate(src, 0);
+        printf("  %u Hz %+5.0f ppm, %2.0f ms jitter, %2.0f ms stalls: ratio %+6.1f ppm, fill %u..%u, target up to %u\n",
+            src->in_rate, src->ppm, src->jitter_ms, src->stall_ms, r.ratio_ppm, r.fill_min, r.fill_max, r.target_max);
+        CHECK(r.underruns == 0, "source %zu: %u underruns after settling", s, r.underruns);
+        CHECK(r.overrun_bytes == 0, "source %zu: ring dropped %u bytes after settling", s, r.overrun_bytes);
+        CHECK(r.splices == 0, "source %zu: %u splices in the tone", s, r.splices);
+        CHECK(fabs(r.ratio_ppm - src->ppm) < 30, "source %zu: ratio settled at %+.1f ppm, drift is %+.0f", s, r.ratio_ppm, src->ppm);
+        if (s == 1) calm = r;
+        if (s == 3) stalled = r;
+    }
+    // the target follows the arrival jitter: stalls keep more buffered than steady arrivals do
+    CHECK(stalled.target_max > calm.target_max, "target %u with stalls, %u without", stalled.target_max, calm.target_max);
+
+    // one stall longer than the whole ring: a single underrun, counted, then it primes again and plays on. the
+    // backlog landing all at once is more than the ring holds, so the producer's drop is counted too
+    const source_t once = { 44100, 200, 10, 0 };
+    result_t r = simulate(&once, 250);
+    CHECK(r.underruns == 1, "a 250 ms stall: %u underruns", r.underruns);
+    CHECK(r.overrun_bytes > 0, "a 250 ms backlog fit a %zu byte ring", (size_t)RINGBUFFER_CAPACITY);
+    printf("  250 ms stall at 200 s: %u underruns, %u bytes dropped\n", r.underruns, r.overrun_bytes);
+    return check_done("jitter_buffer");
+}
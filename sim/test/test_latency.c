@@ -0,0 +1,166 @@
+// uses: prod/Latency
+// the latency tracer: histogram summaries of known samples, min, avg, p99 (the upper edge of its bin) and max, with
+// samples past the last bin; a trace ring written three times over before the reader drains it, which keeps the
+// newest LATENCY_TRACE_LEN events and counts the rest lost, and a slot caught mid write or reused under the reader;
+// then a run of frames through every stage, encoded with latency_encode between console log lines, against
+// tools/latency_decode.py. the decoder has to print the same per stage stats the test works out from the stamps, and
+// skip a packet with a bad checksum and one cut off at the end
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "check.h"
+#include "Latency.h"
+
+#define FRAMES 300
+#define PER_PACKET 40 // events, so the run takes several of main.c's dumps
+
+static latency_tracker_t lt;
+
+static void test_hist(void) {
+    static latency_hist_t hist;
+    latency_summary_t s;
+    latency_hist_init(&hist, 10);
+    latency_hist_summary(&hist, &s);
+    CHECK(s.count == 0 && s.min_us == 0 && s.max_us == 0, "empty: %u samples, min %u, max %u", s.count, s.min_us, s.max_us);
+
+    // 0..999 us in 10 us bins: the 990th sample is 989, in the bin that ends at 990
+    for (uint32_t us = 0; us < 1000; us++) latency_hist_add(&hist, (us * 7919) % 1000); // out of order
+    latency_hist_summary(&hist, &s);
+    CHECK(s.count == 1000 && s.min_us == 0 && s.avg_us == 499 && s.p99_us == 990 && s.max_us == 999,
+        "0..999: %u samples, min %u avg %u p99 %u max %u, want 1000, 0, 499, 990, 999", s.count, s.min_us, s.avg_us,
+        s.p99_us, s.max_us);
+
+    // 20 more far past the last bin: the p99 lands in the overflow bin and is reported as the max
+    for (uint32_t i = 0; i < 20; i++) latency_hist_add(&hist, 100000 + i);
+    latency_hist_summary(&hist, &s);
+    uint32_t avg = (uint32_t)((499500 + 20 * 100000 + 190) / 1020);
+    CHECK(s.count == 1020 && s.min_us == 0 && s.avg_us == avg && s.p99_us == 100019 && s.max_us == 100019,
+        "with 20 long ones: %u samples, min %u avg %u p99 %u max %u, want 1020, 0, %u, 100019, 100019", s.count, s.min_us,
+        s.avg_us, s.p99_us, s.max_us, avg);
+    printf("  histogram: 0..999 us and 20 past the bins give min %u avg %u p99 %u max %u\n", s.min_us, s.avg_us, s.p99_us,
+        s.max_us);
+}
+
+static void test_ring(void) {
+    static latency_event_t out[LATENCY_TRACE_LEN * 2];
+    latency_init(&lt);
+    const uint32_t written = 3 * LATENCY_TRACE_LEN + 10;
+    for (uint32_t i = 0; i < written; i++) latency_trace(&lt, (uint16_t)i, (latency_stage_t)(i % LATENCY_STAGE_COUNT), i);
+    size_t n = latency_trace_drain(&lt, out, LATENCY_TRACE_LEN * 2);
+    bool newest = n == LATENCY_TRACE_LEN;
+    for (size_t i = 0; i < n && newest; i++) {
+        uint32_t want = written - LATENCY_TRACE_LEN + (uint32_t)i;
+        newest = out[i].stamp == want && out[i].frame == (uint16_t)want && out[i].stage == want % LATENCY_STAGE_COUNT;
+    }
+    CHECK(newest, "overflowed: drained %zu events, not the newest %d in order", n, LATENCY_TRACE_LEN);
+    CHECK(lt.lost == written - LATENCY_TRACE_LEN, "overflowed: %u lost, want %u", lt.lost, written - LATENCY_TRACE_LEN);
+    CHECK(latency_trace_drain(&lt, out, LATENCY_TRACE_LEN) == 0, "drained twice");
+
+    // a writer still filling its slot in: the reader stops there and picks it up on the next drain
+    for (uint32_t i = 0; i < 4; i++) latency_trace(&lt, 1, LATENCY_READ, 1000 + i);
+    latency_event_t* slot = &lt.events[(written + 2) & (LATENCY_TRACE_LEN - 1)];
+    atomic_store(&slot->seq, 0);
+    n = latency_trace_drain(&lt, out, LATENCY_TRACE_LEN);
+    CHECK(n == 2, "drained %zu events past one being written, want 2", n);
+    atomic_store(&slot->seq, written + 3);
+    n = latency_trace_drain(&lt, out, LATENCY_TRACE_LEN);
+    CHECK(n == 2 && out[0].stamp == 1002 && out[1].stamp == 1003, "after the write finished: %zu events", n);
+
+    // a slot a writer a full ring ahead has reused under the reader is counted lost, not copied
+    uint32_t lost = lt.lost;
+    latency_trace(&lt, 2, LATENCY_MIX, 2000);
+    latency_trace(&lt, 2, LATENCY_MIX, 2001);
+    slot = &lt.events[(written + 4) & (LATENCY_TRACE_LEN - 1)];
+    atomic_store(&slot->seq, written + 5 + LATENCY_TRACE_LEN);
+    n = latency_trace_drain(&lt, out, LATENCY_TRACE_LEN);
+    CHECK(n == 1 && out[0].stamp == 2001 && lt.lost == lost + 1, "reused slot: %zu events, %u lost", n, lt.lost - lost);
+    printf("  trace ring: %u written into %d slots, the newest kept and %u lost\n", written, LATENCY_TRACE_LEN,
+        written - LATENCY_TRACE_LEN);
+}
+
+static int cmp_u32(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+// the decoder's line for one stage pair, worked out the way it does
+static void stats_line(char* line, size_t len, const char* name, uint32_t* values, size_t n) {
+    qsort(values, n, sizeof(values[0]), cmp_u32);
+    double sum = 0;
+    for (size_t i = 0; i < n; i++) sum += values[i];
+    size_t p99 = (size_t)(n * 0.99);
+    if (p99 > n - 1) p99 = n - 1;
+    snprintf(line, len, "%16s: min %6u  avg %8.0f  p99 %6u  max %6u us  (%zu frames)\n", name, values[0], sum / n,
+        values[p99], values[n - 1], n);
+}
+
+static void test_decode(void) {
+    static const char* names[] = { "capture->read", "read->mix", "mix->play", "mic->speaker" };
+    static uint32_t deltas[4][FRAMES];
+    static latency_event_t events[FRAMES * LATENCY_STAGE_COUNT];
+    static uint8_t packet[LATENCY_PACKET_LEN(PER_PACKET)];
+    latency_init(&lt);
+    uint32_t rng = 2024, clock = 0xFFFF0000u; // the stamps wrap mid run
+    size_t count = 0;
+    for (uint32_t f = 0; f < FRAMES; f++) {
+        uint32_t stamp[LATENCY_STAGE_COUNT];
+        stamp[LATENCY_CAPTURE] = clock += 5805;
+        stamp[LATENCY_READ] = stamp[LATENCY_CAPTURE] + 50 + check_rand(&rng) % 400;
+        stamp[LATENCY_MIX] = stamp[LATENCY_READ] + 100 + check_rand(&rng) % 3000;
+        stamp[LATENCY_PLAY] = stamp[LATENCY_MIX] + 11610 + check_rand(&rng) % 5805;
+        for (int s = 0; s < LATENCY_STAGE_COUNT; s++) {
+            events[count++] = (latency_event_t){ .stamp = stamp[s], .frame = (uint16_t)(60000 + f), .stage = (uint8_t)s };
+        }
+        for (int s = 0; s < 3; s++) deltas[s][f] = stamp[s + 1] - stamp[s];
+        deltas[3][f] = stamp[LATENCY_PLAY] - stamp[LATENCY_CAPTURE];
+    }
+
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/test_latency_%d.bin", (int)getpid());
+    FILE* capture = fopen(path, "wb");
+    CHECK(latency_encode(events, PER_PACKET, packet, LATENCY_PACKET_LEN(PER_PACKET) - 1) == 0, "encoded into too small a buffer");
+    int packets = 0;
+    for (size_t i = 0; i < count; i += PER_PACKET, packets++) {
+        size_t n = (count - i < PER_PACKET) ? count - i : PER_PACKET;
+        size_t len = latency_encode(events + i, n, packet, sizeof(packet));
+        CHECK(len == LATENCY_PACKET_LEN(n), "packet %d: %zu bytes for %zu events", packets, len, n);
+        fprintf(capture, "I (%d) MAIN: latency dump %d\r\n", packets * 100, packets);
+        fwrite(packet, 1, len, capture);
+    }
+    // a copy of the first packet with a stage flipped on the wire, and one the capture stopped in the middle of.
+    // either would add a frame that is not in the stats if it were decoded
+    events[0].frame = events[1].frame = 7;
+    size_t len = latency_encode(events, 2, packet, sizeof(packet));
+    packet[12] ^= 1;
+    fwrite(packet, 1, len, capture);
+    len = latency_encode(events, 2, packet, sizeof(packet));
+    fwrite(packet, 1, len - 3, capture);
+    fclose(capture);
+
+    char want[4][128];
+    for (int s = 0; s < 4; s++) stats_line(want[s], sizeof(want[s]), names[s], deltas[s], FRAMES);
+    char cmd[256];
+    snprintf(cmd, sizeof(cmd), "python3 prod/tools/latency_decode.py %s", path);
+    FILE* decoded = popen(cmd, "r");
+    char line[256];
+    int got = 0, wrong = 0;
+    while (decoded != NULL && fgets(line, sizeof(line), decoded) != NULL) {
+        if (got < 4 && strcmp(line, want[got]) != 0) {
+            fprintf(stderr, "got  %swant %s", line, want[got]);
+            wrong++;
+        }
+        got++;
+    }
+    int status = (decoded != NULL) ? pclose(decoded) : -1;
+    remove(path);
+    printf("  %d packets, %d frames through the decoder: %s", packets, FRAMES, want[3]);
+    CHECK(status == 0, "%s exited with %d", cmd, status);
+    CHECK(got == 4 && wrong == 0, "%d stats lines, %d wrong", got, wrong);
+}
+
+int main(void) {
+    test_hist();
+    test_ring();
+    test_decode();
+    return check_done("latency");
+}
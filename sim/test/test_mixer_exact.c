@@ -0,0 +1,73 @@
+// uses: prod/Mixer
+// mixer_mix_bus reads the a2dp bytes as packed L/R words, two stereo frames per step, with memcpy loads when the
+// pointer isn't word aligned and a scalar tail for an odd frame. checks it and the library's one-byte-at-a-time
+// mixer_mix_bus_ref against a reference written with division, over random frames, gains, lengths and alignments,
+// full scale included
+#include <string.h>
+#include "check.h"
+#include "Mixer.h"
+
+#define FRAME 256
+
+static void mix_ref(int32_t* bus, const uint8_t* bytes, size_t len, const int32_t* mic, size_t frame_size, const mixer_gains_t* gains) {
+    size_t music_frames = len / 4;
+    for (size_t i = 0; i < frame_size; i++) {
+        int32_t m = (mic != NULL) ? (int32_t)(((int64_t)mic[i] * gains->mic_gain) / (1 << 22)) : 0;
+        if (mic != NULL && ((int64_t)mic[i] * gains->mic_gain) % (1 << 22) < 0) m--; // floor, like >>
+        for (int ch = 0; ch < 2; ch++) {
+            int32_t s = 0;
+            if (i < music_frames) {
+                const uint8_t* b = bytes + 4*i + 2*ch;
+                s = (int16_t)(b[1] << 8 | b[0]) * (int32_t)gains->music_gain / 64;
+                if (((int16_t)(b[1] << 8 | b[0]) * (int32_t)gains->music_gain) % 64 < 0) s--;
+            }
+            bus[2*i + ch] = s + m;
+        }
+    }
+}
+
+int main(void) {
+    static uint8_t storage[FRAME * 4 + 8];
+    static int32_t mic[FRAME];
+    static int32_t bus[FRAME * 2], ref[FRAME * 2];
+    uint32_t rng = 12345;
+    int mismatched = 0, ref_mismatched = 0;
+
+    for (int trial = 0; trial < 20000; trial++) {
+        int extremes = (trial % 4 == 0);
+        for (size_t i = 0; i < sizeof(storage); i++) {
+            storage[i] = extremes ? ((check_rand(&rng) & 1) ? 0x80 : 0x7F) : (uint8_t)check_rand(&rng);
+            if (extremes && (i & 1) == 0) storage[i] = (check_rand(&rng) & 1) ? 0x00 : 0xFF;
+        }
+        for (int i = 0; i < FRAME; i++) {
+            mic[i] = extremes ? ((check_rand(&rng) & 1) ? INT32_MIN : INT32_MAX) : (int32_t)check_rand(&rng);
+        }
+        static const uint16_t gain_edges[] = { 0, 1, MIXER_GAIN_UNITY, 65535 };
+        mixer_gains_t gains = {
+            .music_gain = (trial % 3 == 0) ? gain_edges[check_rand(&rng) & 3] : (uint16_t)check_rand(&rng),
+            .mic_gain = (trial % 5 == 0) ? gain_edges[check_rand(&rng) & 3] : (uint16_t)check_rand(&rng),
+        };
+        size_t offset = check_rand(&rng) & 3; // odd offsets take the memcpy path
+        size_t frame_size = 1 + check_rand(&rng) % FRAME;
+        size_t len = check_rand(&rng) % (FRAME * 4 + 5); // short, partial pairs, and longer than the frame
+        if (offset + len > sizeof(storage)) len = sizeof(storage) - offset;
+        const int32_t* mic_data = (trial % 7 == 0) ? NULL : mic;
+
+        mix_ref(ref, storage + offset, len, mic_data, frame_size, &gains);
+        mixer_mix_bus_ref(bus, storage + offset, len, mic_data, frame_size, &gains);
+        ref_mismatched += memcmp(bus, ref, frame_size * 2 * sizeof(int32_t)) != 0;
+        mixer_mix_bus(bus, storage + offset, len, mic_data, frame_size, &gains);
+        if (memcmp(bus, ref, frame_size * 2 * sizeof(int32_t)) != 0 && mismatched++ < 5) {
+            for (size_t i = 0; i < frame_size * 2; i++) {
+                if (bus[i] != ref[i]) {
+                    CHECK(bus[i] == ref[i], "trial %d sample %zu: %ld, reference %ld (offset %zu, len %zu, gains %u/%u)", trial, i,
+                        (long)bus[i], (long)ref[i], offset, len, gains.music_gain, gains.mic_gain);
+                    break;
+                }
+            }
+        }
+    }
+    CHECK(mismatched == 0, "%d of 20000 frames differ", mismatched);
+    CHECK(ref_mismatched == 0, "mixer_mix_bus_ref differs on %d of 20000 frames", ref_mismatched);
+    return check_done("mixer_exact");
+}
@@ -0,0 +1,176 @@
+// uses: prod/Mixer
+// the output stage's requantization from the Q8.24 bus to the dac's 16 bits: a near full scale tone keeps a 16 bit
+// snr, more of it below 5 kHz where the noise shaping moves the error out of, with no harmonics standing out of the
+// dither. a tone of a lsb and a half stays a sine instead of a square wave, silence stays quiet and centred, and an
+// overdriven bus is limited rather than wrapped. then the mic path against the one it replaced, the Q31 mic cut to
+// its top 16 bits and added onto the music in int16, on the same signals: the error below 5 kHz and a small tone's
+// distortion have to come out clearly lower
+#include <string.h>
+#include <stdlib.h>
+#include "check.h"
+#include "Mixer.h"
+
+#define RATE 44100
+#define N 65536 // analysis length, a power of 2 for the fft
+#define FRAME 256
+#define CYCLES 1486 // tone cycles in N samples, ~1000 Hz, coherent so no window is needed
+#define IN_BAND_HZ 5000.0
+
+static int32_t bus[N * 2];
+static int16_t out[N * 2];
+static double re[N], im[N];
+
+// in place radix-2
+static void fft(void) {
+    for (uint32_t i = 1, j = 0; i < N; i++) {
+        uint32_t bit = N >> 1;
+        for (; j & bit; bit >>= 1) j ^= bit;
+        j |= bit;
+        if (i < j) {
+            double t = re[i]; re[i] = re[j]; re[j] = t;
+            t = im[i]; im[i] = im[j]; im[j] = t;
+        }
+    }
+    for (uint32_t len = 2; len <= N; len <<= 1) {
+        double w = -2 * M_PI / len;
+        for (uint32_t base = 0; base < N; base += len) {
+            for (uint32_t k = 0; k < len / 2; k++) {
+                double wr = cos(w * k), wi = sin(w * k);
+                uint32_t a = base + k, b = a + len / 2;
+                double tr = re[b] * wr - im[b] * wi, ti = re[b] * wi + im[b] * wr;
+                re[b] = re[a] - tr; im[b] = im[a] - ti;
+                re[a] += tr; im[a] += ti;
+            }
+        }
+    }
+}
+
+// a tone of amplitude lsb (16 bit lsbs) on both bus channels, through a fresh output stage a frame at a time,
+// left channel spectrum into re/im
+static void run(double amplitude, int cycles) {
+    static mixer_output_t output;
+    mixer_output_init(&output, MIXER_GAIN_UNITY, MIXER_BUS_ONE - MIXER_BUS_ONE / 32, RATE / 20);
+    for (int i = 0; i < N; i++) {
+        double s = amplitude * sin(2 * M_PI * cycles * i / N) * (1 << MIXER_BUS_SHIFT);
+        bus[2 * i] = bus[2 * i + 1] = (int32_t)lrint(s);
+    }
+    // run once to settle the dither and the error feedback, then analyse the second pass
+    for (int pass = 0; pass < 2; pass++) {
+        for (int f = 0; f < N / FRAME; f++) mixer_output_process(&output, out + f * FRAME * 2, bus + f * FRAME * 2, FRAME);
+    }
+    for (int i = 0; i < N; i++) re[i] = out[2 * i], im[i] = 0;
+    fft();
+}
+
+// the mic path before the bus: >> 16 to the top 16 bits, then a saturating add onto the music
+static int16_t old_mix(int32_t mic, int16_t music) {
+    int32_t x = music + ((mic >> 16) * MIXER_GAIN_UNITY >> 15);
+    return (int16_t)((x > INT16_MAX) ? INT16_MAX : (x < INT16_MIN) ? INT16_MIN : x);
+}
+
+// a mic tone of amplitude lsb with the music silent, through the old path or mixer_mix_bus and the output stage.
+// the left channel's spectrum into re/im, less the exact tone when error is set
+static void run_mic(double amplitude, int old, int error) {
+    static int32_t mic[N];
+    static const int16_t silence[FRAME * 2];
+    static mixer_output_t output;
+    mixer_output_init(&output, MIXER_GAIN_UNITY, MIXER_BUS_ONE - MIXER_BUS_ONE / 32, RATE / 20);
+    mixer_gains_t gains = { .music_gain = MIXER_GAIN_UNITY, .mic_gain = MIXER_GAIN_UNITY };
+    for (int i = 0; i < N; i++) mic[i] = (int32_t)lrint(amplitude * sin(2 * M_PI * CYCLES * i / N) * 65536);
+    for (int pass = 0; pass < 2; pass++) {
+        for (int f = 0; f < N / FRAME; f++) {
+            if (old) {
+                for (int i = 0; i < FRAME; i++) out[(f * FRAME + i) * 2] = old_mix(mic[f * FRAME + i], silence[2 * i]);
+                continue;
+            }
+            mixer_mix_bus(bus, (const uint8_t*)silence, sizeof(silence), mic + f * FRAME, FRAME, &gains);
+            mixer_output_process(&output, out + f * FRAME * 2, bus, FRAME);
+        }
+    }
+    for (int i = 0; i < N; i++) {
+        re[i] = out[2 * i] - (error ? amplitude * sin(2 * M_PI * CYCLES * i / N) : 0);
+        im[i] = 0;
+    }
+    fft();
+}
+
+static double bin_power(int k) {
+    return (re[k] * re[k] + im[k] * im[k]) / ((double)N * N / 4); // a sine of amplitude a gives a * a
+}
+
+// everything but dc and the tone's bin, from lo_hz up to hi_hz, as power in lsb^2
+static double noise_power(int tone, double lo_hz, double hi_hz) {
+    double sum = 0;
+    for (int k = (int)(lo_hz * N / RATE) + 1; k <= (int)(hi_hz * N / RATE) && k < N / 2; k++) {
+        if (k != tone) sum += bin_power(k);
+    }
+    return sum / 2; // bin_power counts a sine's a^2, its power is a^2 / 2
+}
+
+static double db(double x) {
+    return 10 * log10(x + 1e-30);
+}
+
+int main(void) {
+    // -1 dBFS tone
+    double amplitude = 32767 * pow(10, -1 / 20.0);
+    run(amplitude, CYCLES);
+    double signal = bin_power(CYCLES) / 2;
+    double snr = db(signal / noise_power(CYCLES, 0, RATE / 2));
+    double snr_in_band = db(signal / noise_power(CYCLES, 20, IN_BAND_HZ));
+    double worst_harmonic = -300;
+    for (int h = 2; h <= 9; h++) {
+        int k = CYCLES * h;
+        if (k >= N / 2) k = N - k; // folded
+        worst_harmonic = fmax(worst_harmonic, db(bin_power(k) / bin_power(CYCLES)));
+    }
+    printf("  -1 dBFS 1 kHz: snr %.1f dB, %.1f dB up to %.0f Hz, worst harmonic %.1f dB\n", snr, snr_in_band, IN_BAND_HZ,
+        worst_harmonic);
+    // 16 bits with tpdf dither is ~91 dB at this level, the shaping trades some of it for the band below 5 kHz
+    CHECK(snr > 85, "snr %.1f dB", snr);
+    CHECK(snr_in_band > snr + 6, "in band snr %.1f dB, full band %.1f", snr_in_band, snr);
+    CHECK(worst_harmonic < -120, "a harmonic at %.1f dB", worst_harmonic);
+
+    // 1.5 lsb: truncation would make this a square wave with a 3rd harmonic ~10 dB down, the dither keeps it a sine
+    run(1.5, CYCLES);
+    double third = db(bin_power(3 * CYCLES) / bin_power(CYCLES));
+    double level = db(bin_power(CYCLES) / (1.5 * 1.5));
+    printf("  1.5 lsb tone: %.2f dB of its level, 3rd harmonic %.1f dB\n", level, third);
+    CHECK(fabs(level) < 0.5, "1.5 lsb tone came out at %.2f dB", level);
+    CHECK(third < -50, "1.5 lsb tone's 3rd harmonic at %.1f dB", third);
+
+    // silence: dither only, centred, under an lsb rms
+    run(0, 0);
+    double dc = re[0] / N, idle = 0;
+    for (int i = 0; i < N; i++) idle += (double)out[2 * i] * out[2 * i];
+    idle = sqrt(idle / N);
+    CHECK(fabs(dc) < 0.01 && idle < 1.0, "idle: dc %.3f lsb, %.2f lsb rms", dc, idle);
+
+    // 2x over full scale: held at the ceiling give or take the dither, same sign as the bus, never wrapped
+    run(65534, CYCLES);
+    int wrong_sign = 0, highest = 0;
+    for (int i = 0; i < N; i++) {
+        if ((bus[2 * i] >> MIXER_BUS_SHIFT) > 64 && out[2 * i] < 0) wrong_sign++;
+        if ((bus[2 * i] >> MIXER_BUS_SHIFT) < -64 && out[2 * i] > 0) wrong_sign++;
+        highest = (abs(out[2 * i]) > highest) ? abs(out[2 * i]) : highest;
+    }
+    CHECK(wrong_sign == 0 && highest <= 32768 - 32768 / 32 + 2, "overdriven: %d samples flipped, peak %d", wrong_sign, highest);
+
+    // the error against the exact tone below 5 kHz, a -20 dBFS mic with detail under the 16 bit lsb
+    double error[2];
+    for (int old = 0; old < 2; old++) {
+        run_mic(3276.7, old, 1);
+        error[old] = db(noise_power(-1, 20, IN_BAND_HZ));
+    }
+    // and the 1.5 lsb tone again, coming in on the mic
+    double harmonic[2];
+    for (int old = 0; old < 2; old++) {
+        run_mic(1.5, old, 0);
+        harmonic[old] = db(bin_power(3 * CYCLES) / bin_power(CYCLES));
+    }
+    printf("  mic against the old >> 16 path: error below %.0f Hz %.1f dB lsb^2, was %.1f; 1.5 lsb tone's 3rd harmonic "
+        "%.1f dB, was %.1f\n", IN_BAND_HZ, error[0], error[1], harmonic[0], harmonic[1]);
+    CHECK(error[0] < error[1] - 5, "in band error %.1f dB lsb^2, the old path gave %.1f", error[0], error[1]);
+    CHECK(harmonic[0] < harmonic[1] - 30, "3rd harmonic %.1f dB, the old path gave %.1f", harmonic[0], harmonic[1]);
+    return check_done("mixer_output");
+}
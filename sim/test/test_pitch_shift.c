@@ -0,0 +1,188 @@
+// uses: prod/PitchShift
+// key change quality on reference clips synthesized here, a pure tone and a sung vowel, shifted across the whole
+// range. the heard pitch has to land within a few cents, and the output has to repeat as cleanly as the input did
+// rather than roughened by the crossfade splices. the floors sit just under today's shifter, so a change that makes
+// it sound worse fails here
+#include <string.h>
+#include <stdlib.h>
+#include "check.h"
+#include "PitchShift.h"
+
+#define RATE 44100
+#define SECONDS 2
+#define PACKET 512 // stereo frames per call, as main.c hands over an a2dp frame
+#define FRAME 256 // stereo frames per call, main.c's mix frame
+#define LEN (RATE * SECONDS / PACKET * PACKET) // whole packets
+#define ANALYSIS 16384 // stereo frames compared after the first window
+// floors with margin under the current shifter's worst, 0.997 and 0.998. splicing without lining the taps up
+// scored 0.975 and 0.961, and missed the pitch by up to 36 cents
+#define TONE_PERIODICITY 0.99
+#define VOWEL_PERIODICITY 0.99
+
+static int16_t in[LEN * 2], out[LEN * 2];
+
+// normalized autocorrelation of every step'th sample of x at lag
+static double correlation(const int16_t* x, size_t n, int step, int lag) {
+    double xy = 0, xx = 0, yy = 0;
+    for (size_t i = 0; i + lag < n; i++) {
+        double a = x[i * step], b = x[(i + lag) * step];
+        xy += a * b, xx += a * a, yy += b * b;
+    }
+    return xy / sqrt(xx * yy + 1);
+}
+
+// the heard pitch: the strongest period within 10% of near_hz, interpolated. *periodicity gets the correlation
+// there, 1 for a clean repeat, lower the more the crossfade splices roughen it
+static double pitch_hz(const int16_t* x, size_t n, int step, double near_hz, double* periodicity) {
+    int lo = (int)(RATE / near_hz / 1.1), hi = (int)(RATE / near_hz * 1.1) + 1;
+    int best_lag = lo;
+    double best = -2;
+    for (int lag = lo; lag <= hi; lag++) {
+        double r = correlation(x, n, step, lag);
+        if (r > best) best = r, best_lag = lag;
+    }
+    double r0 = correlation(x, n, step, best_lag - 1), r2 = correlation(x, n, step, best_lag + 1);
+    double den = r0 - 2 * best + r2;
+    *periodicity = best;
+    return RATE / (best_lag + ((den < 0) ? 0.5 * (r0 - r2) / den : 0));
+}
+
+static double cents(double hz, double ref) {
+    return 1200 * log2(hz / ref);
+}
+
+static void shift(pitch_shift_t* ps, int8_t semitones, size_t offset) {
+    pitch_shift_init(ps);
+    pitch_shift_set_semitones(ps, semitones);
+    static uint8_t bytes[PACKET * 4 + 1];
+    for (size_t i = 0; i < LEN; i += PACKET) {
+        memcpy(bytes + offset, in + 2 * i, PACKET * 4); // odd offsets, the ringbuffer doesn't align its items
+        size_t got = pitch_shift_process(ps, out + 2 * i, bytes + offset, PACKET * 4 + offset % 2);
+        CHECK(got == PACKET * 4, "wrote %zu bytes of %d", got, PACKET * 4);
+    }
+}
+
+// left: a note, right: a fifth above it, so each channel is checked against its own pitch. a pure tone, or a sung
+// vowel with five harmonics
+static void clip(const double* hz, int voiced) {
+    for (size_t i = 0; i < LEN; i++) {
+        for (int ch = 0; ch < 2; ch++) {
+            double f = *hz * (ch ? 1.5 : 1.0), s = 0;
+            for (int h = 1; h <= (voiced ? 5 : 1); h++) s += sin(2 * M_PI * f * h * i / RATE) / h;
+            in[2 * i + ch] = (int16_t)(12000 * s / (voiced ? 2.3 : 1));
+        }
+    }
+}
+
+int main(void) {
+    static pitch_shift_t ps;
+    // the analysis skips the first window while the delay line fills
+    const int16_t* tail = out + 2 * PITCH_SHIFT_WINDOW;
+
+    // pure tone, the whole range
+    const double tone = 440;
+    clip(&tone, 0);
+    double worst = 1;
+    for (int semi = -PITCH_SHIFT_MAX_SEMITONES; semi <= PITCH_SHIFT_MAX_SEMITONES; semi++) {
+        shift(&ps, (int8_t)semi, (size_t)semi & 1);
+        for (int ch = 0; ch < 2; ch++) {
+            double want = tone * (ch ? 1.5 : 1.0) * pow(2, semi / 12.0), periodicity;
+            double hz = pitch_hz(tail + ch, ANALYSIS, 2, want, &periodicity);
+            CHECK(fabs(cents(hz, want)) < 3, "tone %+d semitones, ch %d: %.2f Hz, want %.2f", semi, ch, hz, want);
+            CHECK(periodicity > TONE_PERIODICITY, "tone %+d semitones, ch %d: periodicity %.3f", semi, ch, periodicity);
+            if (periodicity < worst) worst = periodicity;
+        }
+    }
+    printf("  tone: -12..+12 semitones on pitch, worst periodicity %.3f\n", worst);
+
+    // no key change is bypass, the input bit exact
+    shift(&ps, 0, 0);
+    CHECK(memcmp(out, in, sizeof(in)) == 0, "0 semitones is not the input unchanged");
+
+    // sung vowel, harmonics and all
+    const double vowel = 196; // g3
+    clip(&vowel, 1);
+    static const int8_t vowel_keys[] = { -5, -2, 3, 7 };
+    worst = 1;
+    for (size_t k = 0; k < sizeof(vowel_keys); k++) {
+        shift(&ps, vowel_keys[k], 0);
+        for (int ch = 0; ch < 2; ch++) {
+            double want = vowel * (ch ? 1.5 : 1.0) * pow(2, vowel_keys[k] / 12.0), periodicity;
+            double hz = pitch_hz(tail + ch, ANALYSIS, 2, want, &periodicity);
+            CHECK(fabs(cents(hz, want)) < 3, "vowel %+d semitones, ch %d: %.2f Hz, want %.2f", vowel_keys[k], ch, hz, want);
+            CHECK(periodicity > VOWEL_PERIODICITY, "vowel %+d semitones, ch %d: periodicity %.3f", vowel_keys[k], ch, periodicity);
+            if (periodicity < worst) worst = periodicity;
+        }
+    }
+    printf("  vowel: on pitch, worst periodicity %.3f\n", worst);
+
+    // changing key mid song doesn't click: the crossfade carries on, only the sweep speed changes
+    clip(&tone, 0);
+    pitch_shift_init(&ps);
+    pitch_shift_set_semitones(&ps, 2);
+    int steady = 0, at_change = 0;
+    for (size_t i = 0; i < LEN; i += PACKET) {
+        if (i == LEN / 2 / PACKET * PACKET) pitch_shift_set_semitones(&ps, -3);
+        pitch_shift_process(&ps, out + 2 * i, (const uint8_t*)(in + 2 * i), PACKET * 4);
+    }
+    for (size_t i = PITCH_SHIFT_WINDOW + 1; i < LEN; i++) {
+        int jump = abs(out[2 * i] - out[2 * i - 2]);
+        bool near_change = (i > LEN / 2 - PACKET && i < LEN / 2 + PACKET);
+        if (near_change) at_change = (jump > at_change) ? jump : at_change;
+        else steady = (jump > steady) ? jump : steady;
+    }
+    CHECK(at_change <= steady + steady / 10, "key change jumps %d, %d anywhere else", at_change, steady);
+    double periodicity, want = tone * pow(2, -3 / 12.0);
+    double hz = pitch_hz(out + 2 * (LEN - ANALYSIS), ANALYSIS, 2, want, &periodicity);
+    CHECK(fabs(cents(hz, want)) < 3 && periodicity > TONE_PERIODICITY, "after +2 -> -3: %.2f Hz, want %.2f, periodicity %.3f",
+        hz, want, periodicity);
+
+    // 0 -> +3 -> 0 the way main.c runs it, in place in main.c's frames and feeding the line while bypassed. the
+    // fades neither drop out nor click: every frame keeps at least half the level of the shifted and bypassed parts
+    // around it, and no sample jumps further than the shifted tone does on its own
+    clip(&tone, 0);
+    pitch_shift_init(&ps);
+    const size_t on = LEN / 3 / FRAME * FRAME, off = 2 * LEN / 3 / FRAME * FRAME;
+    for (size_t i = 0; i < LEN; i += FRAME) {
+        if (i == on) pitch_shift_set_semitones(&ps, 3);
+        if (i == off) pitch_shift_set_semitones(&ps, 0);
+        memcpy(out + 2 * i, in + 2 * i, FRAME * 4);
+        if (pitch_shift_active(&ps)) pitch_shift_process(&ps, out + 2 * i, (const uint8_t*)(out + 2 * i), FRAME * 4);
+        else pitch_shift_feed(&ps, (const uint8_t*)(in + 2 * i), FRAME * 4);
+    }
+    CHECK(!pitch_shift_active(&ps), "still shifting a third of a clip after going back to 0");
+    double quietest = 1e9, steady_rms = 1e9;
+    steady = at_change = 0;
+    for (size_t i = FRAME; i < LEN; i += FRAME) {
+        bool near_change = (i + FRAME > on && i < on + 2 * PITCH_SHIFT_WINDOW) || (i + FRAME > off && i < off + 2 * PITCH_SHIFT_WINDOW);
+        double power = 0;
+        for (size_t j = i; j < i + FRAME; j++) {
+            int jump = abs(out[2 * j] - out[2 * j - 2]);
+            if (near_change) at_change = (jump > at_change) ? jump : at_change;
+            else steady = (jump > steady) ? jump : steady;
+            power += (double)out[2 * j] * out[2 * j];
+        }
+        double rms = sqrt(power / FRAME);
+        if (near_change) quietest = (rms < quietest) ? rms : quietest;
+        else steady_rms = (rms < steady_rms) ? rms : steady_rms;
+    }
+    printf("  0 -> +3 -> 0: quietest frame %.0f rms (%.0f elsewhere), largest step %d (%d elsewhere)\n", quietest, steady_rms,
+        at_change, steady);
+    CHECK(quietest > steady_rms / 2, "fading in or out drops to %.0f rms, %.0f elsewhere", quietest, steady_rms);
+    CHECK(at_change <= steady + steady / 10, "fading in or out jumps %d, %d anywhere else", at_change, steady);
+    CHECK(memcmp(out + 2 * (off + 2 * PITCH_SHIFT_WINDOW), in + 2 * (off + 2 * PITCH_SHIFT_WINDOW),
+        sizeof(int16_t) * 2 * (LEN - off - 2 * PITCH_SHIFT_WINDOW)) == 0, "back at 0 the stream is not the input unchanged");
+
+    // clamped to the range, and back to no shift reports inactive once applied
+    pitch_shift_init(&ps);
+    pitch_shift_set_semitones(&ps, 40);
+    CHECK(atomic_load(&ps.target_semitones) == PITCH_SHIFT_MAX_SEMITONES, "+40 clamped to %d", atomic_load(&ps.target_semitones));
+    pitch_shift_set_semitones(&ps, -40);
+    CHECK(atomic_load(&ps.target_semitones) == -PITCH_SHIFT_MAX_SEMITONES, "-40 clamped to %d", atomic_load(&ps.target_semitones));
+    pitch_shift_process(&ps, out, (const uint8_t*)in, PACKET * 4);
+    pitch_shift_set_semitones(&ps, 0);
+    CHECK(pitch_shift_active(&ps), "still shifting until the next frame picks up 0");
+    pitch_shift_process(&ps, out, (const uint8_t*)in, PACKET * 4);
+    CHECK(!pitch_shift_active(&ps), "0 semitones applied, still active");
+    return check_done("pitch_shift");
+}
@@ -0,0 +1,313 @@
+// uses: prod/Recorder sim/sim_sd
+// the recorder against a file-backed sd card (sim/src/sim_sd.c) in simulated time: the write task pushes a frame
+// every frame period while the writer drains blocks onto a card that takes its time per write and stalls now and
+// then to erase. the psram blocks ride out 900 ms stalls and the internal ram fallback 100 ms ones with nothing
+// dropped, longer stalls drop whole frames and count every one, every write is whole sectors, and the files read
+// back: pcm bit exact, adpcm through an independent ima decoder. a full card fails the take without hanging it,
+// and the two sides on real threads hand over every block
+#include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "check.h"
+#include "sim.h"
+#include "Recorder.h"
+
+#define RATE 44100
+#define FRAME 256
+#define FRAME_US (1e6 * FRAME / RATE)
+
+static uint8_t storage[4 * 64 * 1024];
+static recorder_t rec;
+static recorder_writer_t writer;
+static int16_t frame[FRAME * 2];
+static char path[64];
+
+// pcm frames carry their own index, so what reached the file can be checked frame by frame. the adpcm takes get
+// something closer to music
+static void fill(uint32_t first, bool music) {
+    for (int i = 0; i < FRAME; i++) {
+        uint32_t n = first + (uint32_t)i;
+        if (music) {
+            double t = (double)n / RATE;
+            frame[2 * i] = (int16_t)lrint(9000 * sin(2 * M_PI * 220 * t) + 4000 * sin(2 * M_PI * 1375 * t));
+            frame[2 * i + 1] = (int16_t)lrint(7000 * sin(2 * M_PI * 330 * t + 1) + 3000 * sin(2 * M_PI * 2750 * t));
+        } else {
+            frame[2 * i] = (int16_t)(n & 0xFFFF);
+            frame[2 * i + 1] = (int16_t)(n >> 16);
+        }
+    }
+}
+
+// card time of the writes made since the last call, through the timing's wait hook
+static int64_t charged_us;
+static void charge(int64_t us) {
+    charged_us += us;
+}
+
+typedef struct {
+    const char* name;
+    size_t block_bytes;
+    recorder_format_t format;
+    int64_t stall_us; // every 8th write
+    uint64_t capacity;
+    double seconds;
+} take_t;
+
+typedef struct {
+    uint32_t pushed, dropped, written;
+    sim_sd_stats_t card;
+    bool closed;
+} result_t;
+
+// one take in simulated time. the writer works through a block, then the card's time for it passes before it gets
+// the next. the block goes back to the recorder once its write is done
+static result_t record(const take_t* take) {
+    result_t r = { 0 };
+    sim_sd_timing_t timing = { .write_us = 1000, .bytes_per_ms = 2000, .stall_every = 8, .stall_us = take->stall_us,
+        .capacity = take->capacity, .wait = charge };
+    FILE* file = sim_sd_open(path, "wb", &timing, &r.card);
+    CHECK(file != NULL, "can't open %s", path);
+    setvbuf(file, NULL, _IONBF, 0); // as record_task does
+    recorder_init(&rec, storage, take->block_bytes, 4);
+    charged_us = 0;
+    recorder_writer_open(&writer, file, take->format, RATE);
+    int64_t writer_free_us = charged_us; // the header
+    recorder_start(&rec);
+
+    bool in_flight = false;
+    uint32_t frames = (uint32_t)(take->seconds * RATE / FRAME);
+    for (uint32_t f = 0; !recorder_finished(&rec); f++) {
+        int64_t now = (int64_t)(f * FRAME_US);
+        if (f == frames) recorder_stop(&rec);
+        if (f < frames) {
+            fill(f * FRAME, take->format == RECORDER_IMA_ADPCM);
+            recorder_push(&rec, frame, FRAME);
+            r.pushed += FRAME;
+        } else {
+            recorder_push(&rec, NULL, 0); // the write task's next frame publishes the partial block
+        }
+        size_t len;
+        const uint8_t* block;
+        while (true) {
+            if (in_flight && writer_free_us <= now) {
+                recorder_release(&rec);
+                in_flight = false;
+            }
+            if (in_flight || (block = recorder_peek(&rec, &len)) == NULL) break;
+            charged_us = 0;
+            recorder_writer_write(&writer, (const int16_t*)block, len / 4);
+            if (writer.failed) recorder_stop(&rec);
+            writer_free_us = ((writer_free_us > now) ? writer_free_us : now) + charged_us;
+            in_flight = true;
+        }
+    }
+    r.closed = recorder_writer_close(&writer);
+    fclose(file);
+    r.dropped = atomic_load(&rec.dropped_frames);
+    r.written = writer.frames;
+    return r;
+}
+
+static uint32_t get32(const uint8_t* p) {
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint8_t* slurp(size_t* len) {
+    FILE* f = fopen(path, "rb");
+    fseek(f, 0, SEEK_END);
+    *len = (size_t)ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t* data = malloc(*len);
+    *len = fread(data, 1, *len, f);
+    fclose(f);
+    return data;
+}
+
+// the header's sizes, then the frames' indexes: in order, each block's run unbroken. returns frames read
+static uint32_t check_pcm(const char* name, uint32_t written, bool from_zero) {
+    size_t len;
+    uint8_t* data = slurp(&len);
+    CHECK(len == RECORDER_HEADER_BYTES + (size_t)written * 4, "%s: %zu bytes for %u frames", name, len, written);
+    CHECK(memcmp(data, "RIFF", 4) == 0 && get32(data + 4) == len - 8 && memcmp(data + 8, "WAVE", 4) == 0, "%s: riff", name);
+    CHECK(memcmp(data + 12, "fmt ", 4) == 0 && get32(data + 20 + 4) == RATE && data[20] == 1 && data[22] == 2,
+        "%s: fmt", name);
+    CHECK(memcmp(data + RECORDER_HEADER_BYTES - 8, "data", 4) == 0 && get32(data + RECORDER_HEADER_BYTES - 4) == written * 4,
+        "%s: data chunk", name);
+    uint32_t frames = (uint32_t)((len - RECORDER_HEADER_BYTES) / 4), gaps = 0, backwards = 0;
+    uint32_t last = 0;
+    for (uint32_t i = 0; i < frames; i++) {
+        const uint8_t* p = data + RECORDER_HEADER_BYTES + 4 * i;
+        uint32_t n = (uint32_t)(p[0] | p[1] << 8) | (uint32_t)(p[2] | p[3] << 8) << 16;
+        if (i == 0 ? (from_zero && n != 0) : n != last + 1) {
+            gaps++;
+            backwards += (i > 0 && n <= last);
+        }
+        last = n;
+    }
+    free(data);
+    CHECK(backwards == 0, "%s: %u frames out of order", name, backwards);
+    return from_zero ? gaps : 0;
+}
+
+// ima adpcm as the wav spec has it, written apart from the encoder
+static double adpcm_snr(uint32_t frames) {
+    static const int16_t steps[89] = {
+        7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45, 50, 55, 60, 66, 73, 80, 88, 97, 107,
+        118, 130, 143, 157, 173, 190, 209, 230, 253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+        1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894,
+        6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794,
+        32767 };
+    static const int index_table[16] = { -1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8 };
+    size_t len;
+    uint8_t* data = slurp(&len);
+    const uint8_t* fmt = data + 12;
+    CHECK(fmt[8] == 0x11 && get32(fmt + 12) == RATE && (fmt[20] | fmt[21] << 8) == RECORDER_ADPCM_BLOCK &&
+        (fmt[26] | fmt[27] << 8) == RECORDER_ADPCM_FRAMES, "adpcm fmt chunk");
+    CHECK(memcmp(fmt + 28, "fact", 4) == 0 && get32(fmt + 36) == frames, "fact says %u frames, want %u", get32(fmt + 36),
+        frames);
+    size_t blocks = (len - RECORDER_HEADER_BYTES) / RECORDER_ADPCM_BLOCK;
+    CHECK((len - RECORDER_HEADER_BYTES) % RECORDER_ADPCM_BLOCK == 0 && blocks * RECORDER_ADPCM_FRAMES >= frames,
+        "%zu bytes of adpcm for %u frames", len - RECORDER_HEADER_BYTES, frames);
+    static int16_t out[2][RECORDER_ADPCM_FRAMES];
+    double signal = 0, noise = 0;
+    for (size_t b = 0; b < blocks; b++) {
+        const uint8_t* p = data + RECORDER_HEADER_BYTES + b * RECORDER_ADPCM_BLOCK;
+        int pred[2], index[2];
+        for (int c = 0; c < 2; c++) {
+            pred[c] = (int16_t)(p[4 * c] | p[4 * c + 1] << 8);
+            index[c] = p[4 * c + 2];
+            out[c][0] = (int16_t)pred[c];
+        }
+        p += 8;
+        for (int f = 1; f < RECORDER_ADPCM_FRAMES; f += 8) {
+            for (int c = 0; c < 2; c++) {
+                for (int k = 0; k < 8; k++) {
+                    int nibble = (p[k / 2] >> (4 * (k & 1))) & 15;
+                    int step = steps[index[c]];
+                    int diff = step >> 3;
+                    if (nibble & 4) diff += step;
+                    if (nibble & 2) diff += step >> 1;
+                    if (nibble & 1) diff += step >> 2;
+                    pred[c] += (nibble & 8) ? -diff : diff;
+                    pred[c] = (pred[c] > 32767) ? 32767 : (pred[c] < -32768) ? -32768 : pred[c];
+                    index[c] += index_table[nibble];
+                    index[c] = (index[c] < 0) ? 0 : (index[c] > 88) ? 88 : index[c];
+                    out[c][f + k] = (int16_t)pred[c];
+                }
+                p += 4;
+            }
+        }
+        for (int i = 0; i < RECORDER_ADPCM_FRAMES; i++) {
+            uint32_t n = (uint32_t)(b * RECORDER_ADPCM_FRAMES + (size_t)i);
+            if (n >= frames) break;
+            fill(n, true); // frame[0..1] is frame n
+            for (int c = 0; c < 2; c++) {
+                double e = out[c][i] - frame[c];
+                signal += (double)frame[c] * frame[c];
+                noise += e * e;
+            }
+        }
+    }
+    free(data);
+    return 10 * log10(signal / (noise + 1e-9));
+}
+
+static void test_takes(void) {
+    static const take_t takes[] = {
+        { "psram, 900 ms stalls", 64 * 1024, RECORDER_PCM16, 900000, 0, 30 },
+        { "internal ram, 100 ms stalls", 8 * 1024, RECORDER_PCM16, 100000, 0, 10 },
+        { "adpcm, 900 ms stalls", 64 * 1024, RECORDER_IMA_ADPCM, 900000, 0, 30 },
+        { "psram, 2.5 s stalls", 64 * 1024, RECORDER_PCM16, 2500000, 0, 30 },
+        { "card full at 1 MB", 64 * 1024, RECORDER_PCM16, 0, 1 << 20, 30 },
+    };
+    for (size_t t = 0; t < sizeof(takes) / sizeof(takes[0]); t++) {
+        const take_t* take = &takes[t];
+        result_t r = record(take);
+        printf("  %-28s %7u pushed, %6u dropped, %4llu writes, %llu not whole sectors, card busy %.1f s of %.0f\n",
+            take->name, r.pushed, r.dropped, (unsigned long long)r.card.writes, (unsigned long long)r.card.unaligned,
+            r.card.busy_us / 1e6, take->seconds);
+        CHECK(r.card.unaligned == 0, "%s: %llu writes not whole sectors", take->name, (unsigned long long)r.card.unaligned);
+        if (take->capacity != 0) {
+            CHECK(!r.closed && writer.failed && r.card.bytes <= take->capacity, "%s: closed %d, failed %d", take->name,
+                r.closed, writer.failed);
+            continue;
+        }
+        CHECK(r.closed, "%s: close failed", take->name);
+        CHECK(r.written + r.dropped == r.pushed, "%s: %u written + %u dropped, %u pushed", take->name, r.written, r.dropped,
+            r.pushed);
+        if (take->stall_us > 1000000) {
+            CHECK(r.dropped > 0 && r.dropped % FRAME == 0, "%s: %u dropped", take->name, r.dropped);
+            check_pcm(take->name, r.written, false);
+        } else if (take->format == RECORDER_PCM16) {
+            CHECK(r.dropped == 0, "%s: %u dropped", take->name, r.dropped);
+            uint32_t gaps = check_pcm(take->name, r.written, true);
+            CHECK(gaps == 0, "%s: %u gaps in the file", take->name, gaps);
+        } else {
+            CHECK(r.dropped == 0, "%s: %u dropped", take->name, r.dropped);
+            double snr = adpcm_snr(r.written);
+            printf("  %-28s decodes at %.1f dB snr\n", "", snr);
+            CHECK(snr > 30, "%s: %.1f dB snr", take->name, snr);
+        }
+    }
+}
+
+// the write task and record_task on their own threads, the card instant. the producer waits for a free block
+// rather than dropping, so every frame has to come through in order
+static _Atomic uint32_t threaded_pushed;
+
+static void* write_task(void* arg) {
+    uint32_t frames = *(const uint32_t*)arg;
+    static int16_t buf[FRAME * 2];
+    for (uint32_t f = 0; f < frames; f++) {
+        for (int i = 0; i < FRAME; i++) {
+            uint32_t n = f * FRAME + (uint32_t)i;
+            buf[2 * i] = (int16_t)(n & 0xFFFF);
+            buf[2 * i + 1] = (int16_t)(n >> 16);
+        }
+        while (atomic_load(&rec.filled) - atomic_load(&rec.drained) == rec.block_count) usleep(50);
+        recorder_push(&rec, buf, FRAME);
+        atomic_store(&threaded_pushed, (f + 1) * FRAME);
+    }
+    recorder_stop(&rec);
+    while (atomic_load(&rec.state) == RECORDER_STOPPING) {
+        recorder_push(&rec, buf, FRAME);
+        usleep(50);
+    }
+    return NULL;
+}
+
+static void test_threads(void) {
+    FILE* file = sim_sd_open(path, "wb", NULL, NULL);
+    setvbuf(file, NULL, _IONBF, 0);
+    recorder_init(&rec, storage, 8 * 1024, 4);
+    recorder_writer_open(&writer, file, RECORDER_PCM16, RATE);
+    recorder_start(&rec);
+    uint32_t frames = 3000;
+    pthread_t producer;
+    pthread_create(&producer, NULL, write_task, &frames);
+    while (!recorder_finished(&rec)) {
+        size_t len;
+        const uint8_t* block;
+        while ((block = recorder_peek(&rec, &len)) != NULL) {
+            recorder_writer_write(&writer, (const int16_t*)block, len / 4);
+            recorder_release(&rec);
+        }
+        usleep(200);
+    }
+    pthread_join(producer, NULL);
+    CHECK(recorder_writer_close(&writer), "threads: close failed");
+    fclose(file);
+    CHECK(writer.frames == frames * FRAME && atomic_load(&rec.dropped_frames) == 0, "threads: %u of %u frames, %u dropped",
+        writer.frames, frames * FRAME, atomic_load(&rec.dropped_frames));
+    uint32_t gaps = check_pcm("threads", writer.frames, true);
+    CHECK(gaps == 0, "threads: %u gaps", gaps);
+}
+
+int main(void) {
+    snprintf(path, sizeof(path), "/tmp/test_recorder_%d.wav", (int)getpid());
+    test_takes();
+    test_threads();
+    remove(path);
+    return check_done("recorder");
+}
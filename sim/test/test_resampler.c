@@ -0,0 +1,143 @@
+// uses: prod/Resampler
+// the a2dp rate converter at the ratios the jitter buffer sets up for a 48, 32 or 44.1 kHz phone: tones come out at the
+// same frequency and level, what would alias or image stays down, the integer kernel matches the same filter in
+// double, and how the input is split into calls doesn't change a sample
+#include <string.h>
+#include <stdlib.h>
+#include "check.h"
+#include "Resampler.h"
+
+#define OUT_RATE 44100
+#define IN_MAX (48000 * 2)
+#define SKIP 64 // outputs ignored while the window fills
+
+static int16_t in[IN_MAX * 2], out[OUT_RATE * 2 * 2], again[OUT_RATE * 2 * 2];
+
+// the jitter buffer's setup for a source rate
+static void setup(resampler_t* rs, uint32_t in_rate) {
+    resampler_init(rs, (in_rate > OUT_RATE) ? 0.85 * OUT_RATE / in_rate : 0.9);
+    resampler_set_step(rs, ((uint64_t)in_rate << 32) / OUT_RATE);
+}
+
+// level of the sinusoid at hz in the left channel of out, least squares over whole periods
+static double amplitude(size_t n, double hz) {
+    n = (size_t)((size_t)((n - SKIP) * hz / OUT_RATE) * OUT_RATE / hz);
+    double c = 0, s = 0;
+    for (size_t i = 0; i < n; i++) {
+        double w = 2 * M_PI * hz * i / OUT_RATE;
+        c += out[2 * (SKIP + i)] * cos(w);
+        s += out[2 * (SKIP + i)] * sin(w);
+    }
+    return 2 * sqrt(c * c + s * s) / n;
+}
+
+static size_t convert(uint32_t in_rate, double hz, double level) {
+    static resampler_t rs;
+    setup(&rs, in_rate);
+    for (size_t i = 0; i < in_rate; i++) in[2 * i] = in[2 * i + 1] = (int16_t)lrint(level * sin(2 * M_PI * hz * i / in_rate));
+    size_t used;
+    return resampler_process(&rs, in, in_rate, out, sizeof(out) / 4, &used);
+}
+
+static double db(double x) {
+    return 20 * log10(x);
+}
+
+static void test_rate(uint32_t in_rate, const double* pass, size_t n_pass, double stop_hz, double stop_db) {
+    // one second in comes out as one second at 44.1 kHz, less the window
+    size_t produced = convert(in_rate, 1000, 8000);
+    size_t window = RESAMPLER_TAPS * OUT_RATE / in_rate + 1;
+    CHECK(produced + window >= OUT_RATE && produced <= OUT_RATE, "%u Hz: 1 s in, %zu out", in_rate, produced);
+
+    // in band: the same frequency at the same level
+    for (size_t p = 0; p < n_pass; p++) {
+        produced = convert(in_rate, pass[p], 16000);
+        double gain = db(amplitude(produced, pass[p]) / 16000);
+        CHECK(gain > -1.0 && gain < 0.1, "%u Hz: %.0f Hz comes out at %.2f dB", in_rate, pass[p], gain);
+    }
+    double top = db(amplitude(convert(in_rate, pass[n_pass - 1], 16000), pass[n_pass - 1]) / 16000);
+    if (stop_hz == 0) { // at the drift path's ratio nothing folds
+        printf("  %u -> %d Hz: %.0f Hz at %.2f dB\n", in_rate, OUT_RATE, pass[n_pass - 1], top);
+        return;
+    }
+    // out of band: where a tone above the output nyquist would alias to, or where an upsampled tone images
+    double image = (in_rate > OUT_RATE) ? OUT_RATE - stop_hz : in_rate - stop_hz;
+    produced = convert(in_rate, stop_hz, 16000);
+    double leak = db(amplitude(produced, image) / 16000 + 1e-9);
+    CHECK(leak < stop_db, "%u Hz: %.0f Hz leaks %.1f dB at %.0f Hz", in_rate, stop_hz, leak, image);
+    printf("  %u -> %d Hz: %.0f Hz at %.2f dB, %.0f Hz images %.1f dB\n", in_rate, OUT_RATE, pass[n_pass - 1], top,
+        stop_hz, leak);
+}
+
+// the kernel in double with the same table and phase arithmetic: the integer path may only differ by rounding
+static void test_reference(uint32_t in_rate) {
+    static resampler_t rs;
+    setup(&rs, in_rate);
+    uint32_t rng = in_rate;
+    for (size_t i = 0; i < in_rate; i++) {
+        in[2 * i] = (int16_t)check_rand(&rng);
+        in[2 * i + 1] = (i & 1) ? INT16_MAX : INT16_MIN; // full scale at nyquist rings past the rails
+    }
+    size_t used, produced = resampler_process(&rs, in, in_rate, out, sizeof(out) / 4, &used);
+
+    uint64_t pos = (uint64_t)(RESAMPLER_TAPS - 1) << 32; // input index of the newest sample in the first window, Q32
+    uint64_t step = ((uint64_t)in_rate << 32) / OUT_RATE;
+    int worst = 0;
+    for (size_t n = 0; n < produced; n++, pos += step) {
+        size_t newest = (size_t)(pos >> 32);
+        uint32_t frac = (uint32_t)pos;
+        int phase = frac >> (32 - RESAMPLER_PHASE_BITS);
+        double t = ((frac >> (32 - RESAMPLER_PHASE_BITS - 15)) & 0x7FFF) / 32768.0;
+        for (int ch = 0; ch < 2; ch++) {
+            double acc = 0;
+            for (int k = 0; k < RESAMPLER_TAPS; k++) {
+                double h = rs.coeffs[phase][k] + t * (rs.coeffs[phase + 1][k] - rs.coeffs[phase][k]);
+                acc += in[2 * (newest - RESAMPLER_TAPS + 1 + k) + ch] * h;
+            }
+            double want = fmax(INT16_MIN, fmin(INT16_MAX, acc / (1 << RESAMPLER_COEFF_BITS)));
+            int diff = abs(out[2 * n + ch] - (int)lrint(want));
+            worst = (diff > worst) ? diff : worst;
+        }
+    }
+    CHECK(worst <= 1, "%u Hz: %d lsb from the double kernel", in_rate, worst);
+
+    // the same input in uneven pieces, as the byte ring hands it over across its wrap
+    setup(&rs, in_rate);
+    size_t at = 0, total = 0;
+    while (at < in_rate) {
+        size_t chunk = 1 + check_rand(&rng) % 700;
+        if (chunk > in_rate - at) chunk = in_rate - at;
+        size_t want = 1 + check_rand(&rng) % 600, got_in;
+        size_t got = resampler_process(&rs, in + 2 * at, chunk, again + 2 * total, want, &got_in);
+        at += got_in;
+        total += got;
+    }
+    CHECK(total == produced && memcmp(out, again, produced * 4) == 0, "%u Hz: split input gave %zu frames, %s", in_rate,
+        total, (memcmp(out, again, produced * 4) == 0) ? "same samples" : "different samples");
+
+    // dc through every phase is unity, to the lsb
+    setup(&rs, in_rate);
+    for (size_t i = 0; i < in_rate; i++) in[2 * i] = in[2 * i + 1] = 20000;
+    produced = resampler_process(&rs, in, in_rate, out, sizeof(out) / 4, &used);
+    int dc_err = 0;
+    for (size_t n = 0; n < produced * 2; n++) dc_err = (abs(out[n] - 20000) > dc_err) ? abs(out[n] - 20000) : dc_err;
+    CHECK(dc_err <= 1, "%u Hz: dc off by %d", in_rate, dc_err);
+
+    // full scale against every coefficient's sign must not wrap the int32 accumulator
+    for (int p = 0; p <= RESAMPLER_PHASES; p++) {
+        int32_t sum = 0;
+        for (int k = 0; k < RESAMPLER_TAPS; k++) sum += abs(rs.coeffs[p][k]);
+        CHECK((int64_t)sum * 32768 < INT32_MAX / 2, "%u Hz: phase %d sums to %d, no headroom", in_rate, p, (int)sum);
+    }
+}
+
+int main(void) {
+    static const double pass[] = { 100, 1000, 5000, 10000, 15000 };
+    test_rate(48000, pass, 5, 23000, -30); // 23 kHz would fold back to 21.1
+    test_rate(32000, pass, 4, 12000, -30); // 32 kHz has no 15 kHz to keep. a 12 kHz tone images at 20 kHz
+    test_rate(44100, pass, 5, 0, 0);
+    test_reference(48000);
+    test_reference(32000);
+    test_reference(44100); // the drift correction path
+    return check_done("resampler");
+}
@@ -0,0 +1,85 @@
+#!/bin/sh
+# the prod write task through mic stalls, on the whole sim: the i2s rx dma stops for 200 ms and then for 50 ms. the
+# tx side must not miss a buffer, so tx_sched late and dropped stay 0 and the sim counts no tx underruns or torn
+# buffers, and every missing mic frame is concealed without the concealment running on past the stall: the mic frames
+# counted late across the stalls are at least the rx buffers the stalls ate and at most SLACK more, and the stale
+# frames dropped to catch up after are at most SLACK. the dma setting is preset in nvs the way the latency tuner
+# leaves it, at the untuned FRAME_SIZE x DMA_BUFFER_COUNT, so the run doesn't hang on what the tuner makes of the
+# host's timing.
+# then the write task woken later than the ring allows while it holds a tx buffer for the stalled mic: the dma is
+# playing that buffer again by then, so it has to be dropped and counted late rather than filled half way through.
+# the wake-ups come 30 to 50 ms late across a long stall, a spread wide enough that some land where filling the held
+# buffer would tear it whatever the host adds. under tsan the mix itself is slow enough to tear a buffer, so this
+# part only runs in a plain build.
+# run from the repo root, at --speed 1 because a single core host falls behind faster than that
+set -e
+SECONDS_=18
+STALLS="--rx-stall 8:200 --rx-stall 12:50"
+FIRST_STALL_MS=8000
+LAST_STALL_END_MS=12050
+SLACK=16 # frames the host's own scheduling can add, a 10 ms wake-up is a couple of frames
+PRESET="--nvs tune.frame=u16:256 --nvs tune.count=u8:8"
+PREEMPTS=$(awk 'BEGIN { for (i = 0; i < 11; i++) printf " --preempt i2s_write_task@%.1f:%d", 4.1 + i * 0.1, 30 + 2 * i }')
+
+sim/build.sh prod >/dev/null
+log=$(mktemp)
+trap 'rm -f "$log"' EXIT
+
+# stats lines look like "I (13605) MAIN: bt ingest: ... | mic: 0 overruns, 2 late, 2 dropped | ... | tx: 0 late, 0 dropped | ..."
+# and the sim's total like "sim: total    i2s rx ... tx 3100 buffers, 0 underruns, 0 torn  adc ..."
+PARSE='
+    /MAIN: bt ingest:/ {
+        ms = substr($2, 2, length($2) - 2) + 0
+        match($0, /mic: [0-9]+ overruns, [0-9]+ late, [0-9]+ dropped/)
+        split(substr($0, RSTART, RLENGTH), m, /[ ,]+/)
+        match($0, /tx: [0-9]+ late, [0-9]+ dropped/)
+        split(substr($0, RSTART, RLENGTH), t, /[ ,]+/)
+        if (ms < first) { base_late = m[4]; base_dropped = m[6] }
+        if (ms > last) { end_late = m[4]; end_dropped = m[6]; reports++ }
+        tx_late = t[2]; tx_dropped = t[4]
+    }
+    /^sim: total/ {
+        for (i = 1; i <= NF; i++) {
+            if ($i == "stalled") stalled = $(i - 1) + 0
+            if ($i == "underruns,") underruns = $(i - 1) + 0
+            if ($i == "torn") torn = $(i - 1) + 0
+        }
+    }'
+
+./sim_prod --seconds $SECONDS_ --speed 1 $PRESET $STALLS >"$log" 2>&1
+awk -v first=$FIRST_STALL_MS -v last=$LAST_STALL_END_MS -v slack=$SLACK "$PARSE"'
+    END {
+        concealed = end_late - base_late
+        dropped = end_dropped - base_dropped
+        printf "  %d rx buffers stalled, %d mic frames concealed, %d dropped after | tx %d late, %d dropped, %d underruns, %d torn\n",
+            stalled, concealed, dropped, tx_late, tx_dropped, underruns, torn
+        ok = 1
+        if (reports == 0) { print "no stats report after the stalls" > "/dev/stderr"; ok = 0 }
+        if (stalled == 0) { print "the sim stalled no rx buffers" > "/dev/stderr"; ok = 0 }
+        if (tx_late != 0 || tx_dropped != 0 || underruns != 0 || torn != 0) { print "tx missed buffers" > "/dev/stderr"; ok = 0 }
+        if (concealed < stalled || concealed > stalled + slack) {
+            printf "%d frames concealed for %d stalled\n", concealed, stalled > "/dev/stderr"; ok = 0
+        }
+        if (dropped > slack) { printf "%d stale mic frames dropped\n", dropped > "/dev/stderr"; ok = 0 }
+        exit !ok
+    }' "$log" # set -e ends the run here on a failure
+
+case "$CFLAGS" in
+*-fsanitize=thread*) # tsan slows the mix to a few ms, which can run a fill past the boundary whatever the check said
+    echo "  late wake-ups skipped under tsan"
+    echo "rx_stall: ok"
+    exit 0 ;;
+esac
+./sim_prod --seconds 11 --speed 1 $PRESET --rx-stall 4:1300 $PREEMPTS >"$log" 2>&1
+awk -v first=4000 -v last=5300 -v slack=$SLACK "$PARSE"'
+    END {
+        printf "  write task woken 30-50 ms late holding a buffer: tx %d late, %d dropped, %d underruns, %d torn\n",
+            tx_late, tx_dropped, underruns, torn
+        ok = 1
+        if (reports == 0) { print "no stats report after the late wake-ups" > "/dev/stderr"; ok = 0 }
+        if (torn != 0) { printf "%d tx buffers filled while the dma played them\n", torn > "/dev/stderr"; ok = 0 }
+        if (tx_late == 0) { print "no held buffer was dropped as late" > "/dev/stderr"; ok = 0 }
+        if (tx_dropped != 0 || underruns != 0) { print "tx missed buffers" > "/dev/stderr"; ok = 0 }
+        exit !ok
+    }' "$log" # set -e ends the run here on a failure
+echo "rx_stall: ok"
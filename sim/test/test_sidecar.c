@@ -0,0 +1,497 @@
+// uses: prod/Sidecar prod/ByteRing
+// the spp sidecar: encoded frames come back out of the parser in any chunking with garbage between them, a bad crc or
+// an oversized length costs exactly the one frame, and random or corrupted streams never break the parser or the
+// event queue. the scheduler fires each event on the sample it is due, in order, and refuses what it can't hold.
+// then the whole path over a local socket in place of the rfcomm link: a phone thread sends a song's lines the way
+// tools/lrc_send.py does, a bluetooth thread fills the rx ring, the write task loop parses on main.c's budget and
+// a sidecar task sends the SHOW frames back for the phone to check
+#include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include "check.h"
+#include "constants.h"
+#include "Sidecar.h"
+#include "ByteRing.h"
+
+#define MAX_FRAMES 400
+#define STREAM_BYTES (MAX_FRAMES * (SIDECAR_FRAME_LEN(SIDECAR_MAX_PAYLOAD) + 48))
+
+typedef struct {
+    uint8_t type;
+    uint8_t len;
+    uint8_t payload[SIDECAR_MAX_PAYLOAD];
+} frame_t;
+
+static uint8_t stream[STREAM_BYTES];
+static frame_t sent[MAX_FRAMES], got[MAX_FRAMES];
+
+static void put_u32(uint8_t* b, uint32_t v) {
+    for (int i = 0; i < 4; i++) b[i] = (uint8_t)(v >> (8 * i));
+}
+
+static size_t encode(uint8_t* out, uint8_t type, const void* payload, size_t len) {
+    return sidecar_encode(out, type, payload, len);
+}
+
+// random bytes that can't be taken for a start of frame
+static size_t garbage(uint8_t* out, size_t max, uint32_t* rng) {
+    size_t n = check_rand(rng) % (max + 1);
+    for (size_t i = 0; i < n; i++) {
+        out[i] = (uint8_t)check_rand(rng);
+        if (out[i] == SIDECAR_SOF) out[i] = 0;
+    }
+    return n;
+}
+
+// the stream in pieces of 1..max_chunk, every complete frame into got[]. returns frames
+static int parse_all(sidecar_parser_t* p, const uint8_t* data, size_t len, size_t max_chunk, uint32_t seed) {
+    int frames = 0;
+    size_t at = 0;
+    while (at < len) {
+        size_t n = 1 + check_rand(&seed) % max_chunk;
+        if (n > len - at) n = len - at;
+        while (n > 0) {
+            bool complete;
+            size_t used = sidecar_parse(p, data + at, n, &complete);
+            if (used == 0 || used > n) {
+                CHECK(0, "parse took %zu of %zu bytes", used, n);
+                return frames;
+            }
+            at += used;
+            n -= used;
+            if (complete && frames < MAX_FRAMES) {
+                got[frames].type = p->type;
+                got[frames].len = p->len;
+                memcpy(got[frames].payload, p->payload, p->len);
+                frames++;
+            }
+        }
+    }
+    return frames;
+}
+
+static bool same_frame(const frame_t* a, const frame_t* b) {
+    return a->type == b->type && a->len == b->len && memcmp(a->payload, b->payload, a->len) == 0;
+}
+
+// frames with garbage between them, every corrupt_every'th one damaged in its type, payload or crc (one byte, which a
+// crc8 always catches), every oversize_every'th preceded by a header with a length past the limit
+static void test_round_trip(size_t max_chunk, int corrupt_every, int oversize_every, uint32_t seed) {
+    static sidecar_parser_t p;
+    uint32_t rng = seed;
+    size_t len = 0;
+    int count = 0, kept = 0, bad = 0;
+    for (int f = 0; f < MAX_FRAMES; f++) {
+        frame_t* fr = &sent[kept];
+        fr->type = (uint8_t)check_rand(&rng);
+        fr->len = (uint8_t)(check_rand(&rng) % (SIDECAR_MAX_PAYLOAD + 1));
+        for (int i = 0; i < fr->len; i++) fr->payload[i] = (uint8_t)check_rand(&rng);
+        if (oversize_every && f % oversize_every == 1) {
+            stream[len++] = SIDECAR_SOF;
+            stream[len++] = fr->type;
+            stream[len++] = (uint8_t)(SIDECAR_MAX_PAYLOAD + 1 + check_rand(&rng) % (255 - SIDECAR_MAX_PAYLOAD));
+            len += garbage(stream + len, 20, &rng);
+            bad++;
+        }
+        size_t at = len;
+        len += encode(stream + len, fr->type, fr->payload, fr->len);
+        if (corrupt_every && f % corrupt_every == 0) {
+            // anything after the sof but the length byte
+            size_t pick = 1 + check_rand(&rng) % (fr->len + 2);
+            if (pick >= 2) pick++;
+            stream[at + pick] ^= (uint8_t)(1 + check_rand(&rng) % 255);
+            bad++;
+        } else {
+            kept++;
+        }
+        len += garbage(stream + len, 12, &rng);
+        count++;
+    }
+    sidecar_parser_init(&p);
+    int frames = parse_all(&p, stream, len, max_chunk, seed);
+    int matched = 0;
+    while (matched < frames && matched < kept && same_frame(&got[matched], &sent[matched])) matched++;
+    CHECK(frames == kept && matched == kept && p.errors == (uint32_t)bad && p.frames == (uint32_t)kept,
+        "chunks of 1..%zu, %d frames, %d damaged: %d parsed, %d matched, %u errors", max_chunk, count, bad, frames, matched,
+        p.errors);
+}
+
+// the queue's bookkeeping: every slot either queued or free exactly once, and the queue in time order
+static bool sched_consistent(const sidecar_sched_t* s) {
+    if (s->count + s->free_count != SIDECAR_QUEUE_LEN) return false;
+    uint8_t seen[SIDECAR_QUEUE_LEN] = { 0 };
+    for (uint32_t i = 0; i < s->count; i++) {
+        if (s->order[i] >= SIDECAR_QUEUE_LEN || seen[s->order[i]]++) return false;
+        if (i > 0 && s->events[s->order[i - 1]].at_ms > s->events[s->order[i]].at_ms) return false;
+    }
+    for (uint32_t i = 0; i < s->free_count; i++) {
+        if (s->free_slots[i] >= SIDECAR_QUEUE_LEN || seen[s->free_slots[i]]++) return false;
+    }
+    return true;
+}
+
+// random bytes, and real frames of every type with random damage, fed straight into the scheduler with a clock that
+// moves forward. nothing may crash, the parser must always make progress and the queue must stay consistent
+static void test_fuzz(void) {
+    static sidecar_parser_t p;
+    static sidecar_sched_t s;
+    uint32_t rng = 77;
+    uint32_t inconsistent = 0, stalls = 0, oversized = 0, early = 0, handled = 0, fired = 0;
+    for (int round = 0; round < 200; round++) {
+        sidecar_parser_init(&p);
+        sidecar_sched_init(&s, SAMPLE_RATE);
+        uint32_t now = check_rand(&rng); // anywhere, including across the wrap
+        size_t len = 0;
+        while (len < STREAM_BYTES - SIDECAR_FRAME_LEN(SIDECAR_MAX_PAYLOAD) - 32) {
+            uint32_t what = check_rand(&rng) % 8;
+            if (what == 0) { // noise, sofs included
+                size_t n = check_rand(&rng) % 32;
+                for (size_t i = 0; i < n; i++) stream[len++] = (uint8_t)check_rand(&rng);
+                continue;
+            }
+            uint8_t payload[SIDECAR_MAX_PAYLOAD];
+            static const uint8_t types[] = { SIDECAR_MSG_CLOCK, SIDECAR_MSG_LYRIC, SIDECAR_MSG_LYRIC, SIDECAR_MSG_PARAM,
+                SIDECAR_MSG_CLEAR, SIDECAR_MSG_SHOW, 0x55 };
+            uint8_t type = types[check_rand(&rng) % sizeof(types)];
+            size_t n = check_rand(&rng) % (SIDECAR_MAX_PAYLOAD + 1);
+            if (type == SIDECAR_MSG_CLOCK || check_rand(&rng) % 4 == 0) n = 4;
+            if (type == SIDECAR_MSG_PARAM && check_rand(&rng) % 4 != 0) n = 7;
+            for (size_t i = 0; i < n; i++) payload[i] = (uint8_t)check_rand(&rng);
+            put_u32(payload, check_rand(&rng) % 600000); // ten minutes of song
+            if (type == SIDECAR_MSG_PARAM && n == 7) payload[4] %= SIDECAR_PARAM_COUNT + 1;
+            size_t at = len;
+            len += encode(stream + len, type, payload, n);
+            if (what == 1) stream[at + check_rand(&rng) % (len - at)] ^= (uint8_t)check_rand(&rng); // damage
+            if (what == 2) len -= check_rand(&rng) % (len - at); // cut short
+        }
+        size_t at = 0;
+        while (at < len) {
+            size_t n = 1 + check_rand(&rng) % 200;
+            if (n > len - at) n = len - at;
+            bool complete;
+            size_t used = sidecar_parse(&p, stream + at, n, &complete);
+            if (used == 0 || used > n) {
+                stalls++;
+                break;
+            }
+            at += used;
+            if (complete) {
+                oversized += (p.len > SIDECAR_MAX_PAYLOAD);
+                sidecar_sched_handle(&s, &p, now);
+                handled++;
+            }
+            now += check_rand(&rng) % 2048;
+            uint32_t last_ms = 0;
+            const sidecar_event_t* ev;
+            for (bool first = true; (ev = sidecar_sched_pop_due(&s, now)) != NULL; first = false) {
+                uint32_t due = s.origin + (uint32_t)((uint64_t)ev->at_ms * SAMPLE_RATE / 1000);
+                early += ((int32_t)(now - due) < 0) || (!first && ev->at_ms < last_ms);
+                early += (ev->type == SIDECAR_MSG_LYRIC && (ev->text_len > SIDECAR_MAX_TEXT || ev->text[ev->text_len] != 0));
+                last_ms = ev->at_ms;
+                fired++;
+            }
+            inconsistent += !sched_consistent(&s);
+        }
+    }
+    printf("  fuzz: %u frames handled, %u events fired\n", handled, fired);
+    CHECK(stalls == 0 && oversized == 0, "%u parser stalls, %u oversized frames", stalls, oversized);
+    CHECK(inconsistent == 0, "queue inconsistent %u times", inconsistent);
+    CHECK(early == 0, "%u events fired early, out of order or unterminated", early);
+    CHECK(handled > 10000 && fired > 1000, "only %u frames handled, %u fired", handled, fired);
+
+    // plain noise, a megabyte of it
+    sidecar_parser_init(&p);
+    uint32_t stalled = 0;
+    for (int block = 0; block < 64; block++) {
+        for (size_t i = 0; i < 16384; i++) stream[i] = (uint8_t)check_rand(&rng);
+        size_t at = 0;
+        while (at < 16384) {
+            bool complete;
+            size_t used = sidecar_parse(&p, stream + at, 16384 - at, &complete);
+            if (used == 0) {
+                stalled++;
+                break;
+            }
+            at += used;
+        }
+    }
+    CHECK(stalled == 0 && p.errors > 1000, "noise: %u stalls, %u errors, %u frames", stalled, p.errors, p.frames);
+}
+
+// one frame of the given type straight into the scheduler
+static bool handle(sidecar_sched_t* s, uint8_t type, const uint8_t* payload, size_t len, uint32_t now) {
+    static sidecar_parser_t p;
+    static uint8_t buf[SIDECAR_FRAME_LEN(SIDECAR_MAX_PAYLOAD)];
+    sidecar_parser_init(&p);
+    size_t n = encode(buf, type, payload, len);
+    bool complete;
+    sidecar_parse(&p, buf, n, &complete);
+    CHECK(complete, "type %u len %zu didn't parse", type, len);
+    return sidecar_sched_handle(s, &p, now);
+}
+
+static bool lyric(sidecar_sched_t* s, uint32_t at_ms, const char* text) {
+    uint8_t payload[SIDECAR_MAX_PAYLOAD];
+    size_t n = strlen(text);
+    put_u32(payload, at_ms);
+    memcpy(payload + 4, text, n);
+    return handle(s, SIDECAR_MSG_LYRIC, payload, 4 + n, 0);
+}
+
+static void test_sched(void) {
+    static sidecar_sched_t s;
+    uint8_t b[8];
+    sidecar_sched_init(&s, SAMPLE_RATE);
+    CHECK(lyric(&s, 1000, "first") && lyric(&s, 500, "zero") && lyric(&s, 1000, "second"), "lines refused");
+    CHECK(sidecar_sched_pop_due(&s, 1u << 30) == NULL, "fired before the first CLOCK");
+
+    // song position 2 s is the audio received at sample 200000
+    put_u32(b, 2000);
+    CHECK(handle(&s, SIDECAR_MSG_CLOCK, b, 4, 200000), "CLOCK refused");
+    uint32_t origin = 200000 - 2 * SAMPLE_RATE;
+    CHECK(s.origin == origin, "origin %u, want %u", s.origin, origin);
+    const sidecar_event_t* ev;
+    CHECK(sidecar_sched_pop_due(&s, origin - 1) == NULL, "fired before the song started");
+    CHECK(sidecar_sched_pop_due(&s, origin + SAMPLE_RATE / 2 - 1) == NULL, "500 ms fired a sample early");
+    ev = sidecar_sched_pop_due(&s, origin + SAMPLE_RATE / 2);
+    CHECK(ev != NULL && strcmp(ev->text, "zero") == 0, "500 ms didn't fire on time");
+    CHECK(sidecar_sched_pop_due(&s, origin + SAMPLE_RATE - 1) == NULL, "1000 ms fired a sample early");
+    ev = sidecar_sched_pop_due(&s, origin + SAMPLE_RATE);
+    CHECK(ev != NULL && strcmp(ev->text, "first") == 0, "same time lines out of order");
+    ev = sidecar_sched_pop_due(&s, origin + SAMPLE_RATE);
+    CHECK(ev != NULL && strcmp(ev->text, "second") == 0, "second of the same time missing");
+    CHECK(sidecar_sched_pop_due(&s, origin + 100 * SAMPLE_RATE) == NULL && sched_consistent(&s), "queue not empty");
+
+    // a param change, and the frames that must be refused
+    put_u32(b, 3000);
+    b[4] = SIDECAR_PARAM_KEY;
+    b[5] = 0xFE, b[6] = 0xFF; // -2
+    CHECK(handle(&s, SIDECAR_MSG_PARAM, b, 7, 0), "PARAM refused");
+    ev = sidecar_sched_pop_due(&s, origin + 3 * SAMPLE_RATE);
+    CHECK(ev != NULL && ev->type == SIDECAR_MSG_PARAM && ev->param == SIDECAR_PARAM_KEY && ev->value == -2, "PARAM wrong");
+    b[4] = SIDECAR_PARAM_COUNT;
+    CHECK(!handle(&s, SIDECAR_MSG_PARAM, b, 7, 0), "unknown param taken");
+    CHECK(!handle(&s, SIDECAR_MSG_PARAM, b, 6, 0), "short PARAM taken");
+    CHECK(!handle(&s, SIDECAR_MSG_LYRIC, b, 3, 0), "LYRIC without a time taken");
+    CHECK(!handle(&s, SIDECAR_MSG_CLOCK, b, 5, 0) && s.origin == origin, "long CLOCK taken");
+    CHECK(handle(&s, 0x55, b, 7, 0) && s.count == 0, "unknown type not skipped");
+    CHECK(s.dropped == 4, "%u dropped, want 4", s.dropped);
+
+    // the longest line there is room for, terminated
+    char longest[SIDECAR_MAX_TEXT + 1];
+    memset(longest, 'a', SIDECAR_MAX_TEXT);
+    longest[SIDECAR_MAX_TEXT] = 0;
+    CHECK(lyric(&s, 0, longest), "longest line refused");
+    ev = sidecar_sched_pop_due(&s, origin);
+    CHECK(ev != NULL && ev->text_len == SIDECAR_MAX_TEXT && strcmp(ev->text, longest) == 0, "longest line cut");
+
+    // full, then CLEAR gives every slot back
+    for (int round = 0; round < 2; round++) {
+        int taken = 0;
+        for (int i = 0; i < SIDECAR_QUEUE_LEN + 3; i++) taken += lyric(&s, 60000 - 1000 * i, "x");
+        CHECK(taken == SIDECAR_QUEUE_LEN && sched_consistent(&s), "round %d: %d lines taken", round, taken);
+        CHECK(handle(&s, SIDECAR_MSG_CLEAR, b, 0, 0) && s.count == 0 && sched_consistent(&s), "CLEAR left %u", s.count);
+    }
+    CHECK(s.dropped == 4 + 6, "%u dropped after the full queue, want 10", s.dropped);
+}
+
+// the transport: the phone's end of the socket, the device's rings and tasks
+#define LINES 24
+#define FIRST_MS 1000
+#define EVERY_MS 150
+
+static int phone_fd, device_fd;
+static uint8_t rx_storage[SPP_RING_CAPACITY], tx_storage[SPP_RING_CAPACITY];
+static byte_ring_t rx_ring, tx_ring;
+static _Atomic bool phone_sent, bt_drained, sidecar_stop;
+static char shown_text[LINES][SIDECAR_MAX_TEXT + 1];
+static uint32_t shown_ms[LINES];
+static int shown_count;
+
+// writes in the small uneven pieces rfcomm delivers
+static void send_all(int fd, const uint8_t* data, size_t len, uint32_t* rng) {
+    while (len > 0) {
+        size_t n = 1 + check_rand(rng) % 40;
+        if (n > len) n = len;
+        ssize_t w = write(fd, data, n);
+        if (w <= 0) return;
+        data += w;
+        len -= (size_t)w;
+    }
+}
+
+// lrc_send.py's order: CLEAR, CLOCK 0, then the lines and tags. one line is damaged in flight and must not show,
+// one frame is a type this build doesn't know
+static void* phone_task(void* arg) {
+    (void)arg;
+    static uint8_t out[LINES * 2 * SIDECAR_FRAME_LEN(SIDECAR_MAX_PAYLOAD)];
+    uint32_t rng = 99;
+    uint8_t payload[SIDECAR_MAX_PAYLOAD] = { 0 };
+    size_t len = encode(out, SIDECAR_MSG_CLEAR, payload, 0);
+    put_u32(payload, 0);
+    len += encode(out + len, SIDECAR_MSG_CLOCK, payload, 4);
+    for (int i = 0; i < LINES; i++) {
+        put_u32(payload, FIRST_MS + EVERY_MS * i);
+        int n = sprintf((char*)payload + 4, "line %d of the song", i);
+        len += encode(out + len, SIDECAR_MSG_LYRIC, payload, 4 + (size_t)n);
+        if (i == 5) {
+            size_t at = len;
+            sprintf((char*)payload + 4, "damaged");
+            len += encode(out + len, SIDECAR_MSG_LYRIC, payload, 11);
+            out[at + 5] ^= 0x20;
+            len += encode(out + len, 0x40, payload, 11);
+            payload[4] = SIDECAR_PARAM_VOCAL_CANCEL, payload[5] = 1, payload[6] = 0;
+            len += encode(out + len, SIDECAR_MSG_PARAM, payload, 7);
+        }
+    }
+    send_all(phone_fd, out, len, &rng);
+    shutdown(phone_fd, SHUT_WR);
+    atomic_store(&phone_sent, true);
+
+    // the lines coming back as they reach the speaker
+    static sidecar_parser_t p;
+    sidecar_parser_init(&p);
+    uint8_t buf[64];
+    ssize_t n;
+    while (shown_count < LINES && (n = read(phone_fd, buf, sizeof(buf))) > 0) {
+        size_t at = 0;
+        while (at < (size_t)n) {
+            bool complete;
+            at += sidecar_parse(&p, buf + at, (size_t)n - at, &complete);
+            if (!complete || p.type != SIDECAR_MSG_SHOW || p.len < 4 || shown_count >= LINES) continue;
+            shown_ms[shown_count] = p.payload[0] | p.payload[1] << 8 | p.payload[2] << 16 | (uint32_t)p.payload[3] << 24;
+            memcpy(shown_text[shown_count], p.payload + 4, p.len - 4u);
+            shown_text[shown_count][p.len - 4] = 0;
+            shown_count++;
+        }
+    }
+    return NULL;
+}
+
+// the spp data callback: whatever the ring has room for. rfcomm's credits hold the rest back on the phone
+static void* bt_task(void* arg) {
+    (void)arg;
+    uint8_t buf[64];
+    while (1) {
+        size_t room = SPP_RING_CAPACITY - byte_ring_fill(&rx_ring);
+        if (room == 0) {
+            usleep(100);
+            continue;
+        }
+        ssize_t n = read(device_fd, buf, (room < sizeof(buf)) ? room : sizeof(buf));
+        if (n <= 0) break;
+        byte_ring_write(&rx_ring, buf, (size_t)n);
+    }
+    atomic_store(&bt_drained, true);
+    return NULL;
+}
+
+// main.c's sidecar_task
+static void* sidecar_task(void* arg) {
+    (void)arg;
+    while (1) {
+        size_t contiguous;
+        const uint8_t* bytes = byte_ring_peek(&tx_ring, &contiguous);
+        if (contiguous == 0) {
+            if (atomic_load(&sidecar_stop)) break;
+            usleep(1000);
+            continue;
+        }
+        ssize_t w = write(device_fd, bytes, contiguous);
+        byte_ring_consume(&tx_ring, (w > 0) ? (size_t)w : contiguous);
+    }
+    shutdown(device_fd, SHUT_WR);
+    return NULL;
+}
+
+static void test_transport(void) {
+    int fds[2];
+    CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0, "no socketpair");
+    phone_fd = fds[0], device_fd = fds[1];
+    byte_ring_init(&rx_ring, rx_storage, SPP_RING_CAPACITY);
+    byte_ring_init(&tx_ring, tx_storage, SPP_RING_CAPACITY);
+    pthread_t phone, bt, sidecar;
+    pthread_create(&phone, NULL, phone_task, NULL);
+    pthread_create(&bt, NULL, bt_task, NULL);
+    pthread_create(&sidecar, NULL, sidecar_task, NULL);
+
+    // the write task, a frame per pass. the clock holds at 0 until everything the phone sent has been parsed, so the
+    // lines' timing doesn't depend on how the threads were scheduled
+    static sidecar_parser_t parser;
+    static sidecar_sched_t sched;
+    sidecar_parser_init(&parser);
+    sidecar_sched_init(&sched, SAMPLE_RATE);
+    uint32_t music_clock = 0, late = 0, params = 0, fired = 0, most_parsed = 0;
+    uint32_t last_clock = (uint32_t)((uint64_t)(FIRST_MS + EVERY_MS * LINES) * SAMPLE_RATE / 1000) + 64 * FRAME_SIZE;
+    while (music_clock < last_clock) {
+        size_t budget = SIDECAR_PARSE_BUDGET;
+        while (budget > 0) {
+            size_t contiguous;
+            const uint8_t* bytes = byte_ring_peek(&rx_ring, &contiguous);
+            if (contiguous == 0) break;
+            if (contiguous > budget) contiguous = budget;
+            bool complete;
+            size_t used = sidecar_parse(&parser, bytes, contiguous, &complete);
+            byte_ring_consume(&rx_ring, used);
+            budget -= used;
+            if (complete) sidecar_sched_handle(&sched, &parser, music_clock);
+        }
+        most_parsed = (SIDECAR_PARSE_BUDGET - budget > most_parsed) ? SIDECAR_PARSE_BUDGET - budget : most_parsed;
+
+        uint32_t queued = DMA_BUFFER_COUNT * FRAME_SIZE;
+        uint32_t audible = (music_clock > queued) ? music_clock - queued : 0;
+        const sidecar_event_t* ev;
+        while ((ev = sidecar_sched_pop_due(&sched, audible)) != NULL) {
+            fired++;
+            uint32_t due = sched.origin + (uint32_t)((uint64_t)ev->at_ms * SAMPLE_RATE / 1000);
+            late += (audible - due >= FRAME_SIZE);
+            if (ev->type == SIDECAR_MSG_PARAM) {
+                params++;
+                continue;
+            }
+            uint8_t payload[SIDECAR_MAX_PAYLOAD], frame[SIDECAR_FRAME_LEN(SIDECAR_MAX_PAYLOAD)];
+            put_u32(payload, ev->at_ms);
+            memcpy(payload + 4, ev->text, ev->text_len);
+            size_t len = encode(frame, SIDECAR_MSG_SHOW, payload, 4 + ev->text_len);
+            while (SPP_RING_CAPACITY - byte_ring_fill(&tx_ring) < len) usleep(100);
+            byte_ring_write(&tx_ring, frame, len);
+        }
+        if (atomic_load(&bt_drained) && byte_ring_fill(&rx_ring) == 0) music_clock += FRAME_SIZE;
+        else usleep(50);
+    }
+    atomic_store(&sidecar_stop, true);
+    pthread_join(sidecar, NULL);
+    pthread_join(phone, NULL);
+    pthread_join(bt, NULL);
+    close(phone_fd);
+    close(device_fd);
+
+    int in_order = 0;
+    for (int i = 0; i < shown_count; i++) {
+        char want[SIDECAR_MAX_TEXT + 1];
+        sprintf(want, "line %d of the song", i);
+        in_order += (shown_ms[i] == (uint32_t)(FIRST_MS + EVERY_MS * i) && strcmp(shown_text[i], want) == 0);
+    }
+    printf("  socket: %d lines back, %u frames, %u bad, most %u bytes parsed in a frame\n", shown_count, parser.frames,
+        parser.errors, most_parsed);
+    CHECK(shown_count == LINES && in_order == LINES, "%d of %d lines shown, %d in order", shown_count, LINES, in_order);
+    CHECK(fired == LINES + 1 && params == 1 && late == 0, "%u fired, %u params, %u late", fired, params, late);
+    CHECK(parser.errors == 1 && parser.frames == LINES + 4, "%u frames, %u bad", parser.frames, parser.errors);
+    CHECK(atomic_load(&rx_ring.overrun_bytes) == 0 && most_parsed <= SIDECAR_PARSE_BUDGET, "rx ring dropped %u bytes",
+        atomic_load(&rx_ring.overrun_bytes));
+}
+
+int main(void) {
+    static const size_t chunks[] = { 1, 3, 17, 104, 4096 };
+    for (size_t c = 0; c < sizeof(chunks) / sizeof(chunks[0]); c++) {
+        test_round_trip(chunks[c], 0, 0, 1 + (uint32_t)c);
+        test_round_trip(chunks[c], 7, 0, 11 + (uint32_t)c);
+        test_round_trip(chunks[c], 5, 9, 21 + (uint32_t)c);
+    }
+    test_fuzz();
+    test_sched();
+    test_transport();
+    return check_done("sidecar");
+}
@@ -0,0 +1,128 @@
+// uses: prod/Telemetry
+// telemetry_encode against tools/telemetry_decode.py: snapshots with random counters and task tables, from none to
+// TELEMETRY_MAX_TASKS and with names that fill all TELEMETRY_NAME_LEN bytes, go into a capture between console log
+// lines the way the uart interleaves them. the decoder has to give back every field of every good packet, by the
+// names telemetry_id_t has, and skip a packet with a bad checksum, a "TLMY" in a log line and one cut off at the end
+#include <string.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include "check.h"
+#include "Telemetry.h"
+
+#define PACKETS 40
+#define JSON_LINE_MAX 16384
+
+static telemetry_snapshot_t snaps[PACKETS];
+static uint8_t packet[TELEMETRY_PACKET_LEN(TELEMETRY_MAX_TASKS)];
+
+// telemetry_id_t's names as the decoder spells them, lowercase without the prefix
+static const char* const ids[] = {
+    "i2s_read_timeout", "i2s_read_error", "mic_overrun", "mic_late", "dsp_overrun", "dsp_worst_us", "tx_late",
+    "tx_dropped", "bt_overrun_bytes", "jitter_underrun", "record_dropped", "bt_callback_worst_us", "mic_dropped",
+    "music_late",
+};
+_Static_assert(sizeof(ids) / sizeof(ids[0]) == TELEM_ID_COUNT, "a telemetry_id_t without a name here or in the decoder");
+
+static void random_snapshot(telemetry_snapshot_t* s, uint32_t* rng, int tasks) {
+    memset(s, 0, sizeof(*s));
+    s->uptime_ms = check_rand(rng);
+    s->heap_free = check_rand(rng) % 300000;
+    s->heap_min_free = s->heap_free / 2;
+    s->heap_largest = s->heap_free / 3;
+    s->psram_free = (check_rand(rng) & 1) ? check_rand(rng) : 0;
+    for (int i = 0; i < TELEM_ID_COUNT; i++) {
+        s->counts[i] = (check_rand(rng) % 4 == 0) ? 0xFFFFFFFFu : check_rand(rng) % 1000;
+        s->args[i] = check_rand(rng);
+    }
+    s->task_count = (uint8_t)tasks;
+    for (int t = 0; t < tasks; t++) {
+        telemetry_task_t* task = &s->tasks[t];
+        int len = 1 + (int)(check_rand(rng) % TELEMETRY_NAME_LEN); // TELEMETRY_NAME_LEN has no terminator
+        for (int c = 0; c < len; c++) task->name[c] = (char)('a' + check_rand(rng) % 26);
+        task->name[0] = (char)('A' + t % 26);
+        task->stack_free = (uint16_t)check_rand(rng);
+        task->cpu_permille = (uint16_t)(check_rand(rng) % 1001);
+        task->priority = (uint8_t)(check_rand(rng) % 25);
+    }
+}
+
+// the decoder's json for one field, so a line can be searched for it
+static bool has(const char* line, const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+static bool has(const char* line, const char* fmt, ...) {
+    char want[256];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(want, sizeof(want), fmt, ap);
+    va_end(ap);
+    return strstr(line, want) != NULL;
+}
+
+static int check_packet(const char* line, const telemetry_snapshot_t* s, int n) {
+    int wrong = 0;
+    wrong += !has(line, "\"uptime_ms\": %u", s->uptime_ms);
+    wrong += !has(line, "\"heap\": {\"free\": %u, \"min_free\": %u, \"largest\": %u, \"psram_free\": %u}", s->heap_free,
+        s->heap_min_free, s->heap_largest, s->psram_free);
+    for (int i = 0; i < TELEM_ID_COUNT; i++) {
+        wrong += !has(line, "\"%s\": {\"count\": %u, \"arg\": %u}", ids[i], s->counts[i], s->args[i]);
+    }
+    wrong += has(line, "\"id%d\"", TELEM_ID_COUNT - 1); // an id the decoder has no name for
+    const char* tasks = strstr(line, "\"tasks\": [");
+    for (int t = 0; t < s->task_count && tasks != NULL; t++) {
+        const telemetry_task_t* task = &s->tasks[t];
+        char want[160];
+        snprintf(want, sizeof(want), "{\"name\": \"%.*s\", \"priority\": %u, \"stack_free\": %u, \"cpu_pct\": %u.%u}",
+            (int)strnlen(task->name, TELEMETRY_NAME_LEN), task->name, task->priority, task->stack_free,
+            task->cpu_permille / 10, task->cpu_permille % 10);
+        const char* at = strstr(tasks, want);
+        if (at == NULL) {
+            wrong++;
+            break;
+        }
+        tasks = at + strlen(want); // in order
+    }
+    if (s->task_count == 0) wrong += !has(line, "\"tasks\": []");
+    if (wrong) fprintf(stderr, "packet %d: %d fields wrong in %.200s...\n", n, wrong, line);
+    return wrong;
+}
+
+int main(void) {
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/test_telemetry_%d.bin", (int)getpid());
+    FILE* capture = fopen(path, "wb");
+    uint32_t rng = 12345;
+    static const int task_counts[] = { 0, 1, 7, TELEMETRY_MAX_TASKS };
+    int expected = 0;
+    CHECK(telemetry_encode(&snaps[0], packet, TELEMETRY_PACKET_LEN(0) - 1) == 0, "encoded into too small a buffer");
+    for (int n = 0; n < PACKETS; n++) {
+        telemetry_snapshot_t* s = &snaps[expected];
+        random_snapshot(s, &rng, task_counts[n % 4]);
+        size_t len = telemetry_encode(s, packet, sizeof(packet));
+        CHECK(len == (size_t)TELEMETRY_PACKET_LEN(s->task_count), "packet %d: %zu bytes for %u tasks", n, len, s->task_count);
+        fprintf(capture, "I (%u) MAIN: sidecar: %d frames, 0 bad\r\n", s->uptime_ms, n);
+        if (n == 13) packet[30] ^= 1; // a bit flipped on the wire
+        else if (n == 21) fputs("W (1) MAIN: TLMY is not a packet\r\n", capture);
+        fwrite(packet, 1, len, capture);
+        expected += (n != 13);
+    }
+    random_snapshot(&snaps[PACKETS - 1], &rng, 3);
+    size_t len = telemetry_encode(&snaps[PACKETS - 1], packet, sizeof(packet));
+    fwrite(packet, 1, len - 5, capture); // the capture stopped mid packet
+    fclose(capture);
+
+    char cmd[256];
+    snprintf(cmd, sizeof(cmd), "python3 prod/tools/telemetry_decode.py %s", path);
+    FILE* decoded = popen(cmd, "r");
+    static char line[JSON_LINE_MAX];
+    int got = 0, wrong = 0;
+    while (decoded != NULL && fgets(line, sizeof(line), decoded) != NULL) {
+        if (got < expected) wrong += check_packet(line, &snaps[got], got);
+        got++;
+    }
+    int status = (decoded != NULL) ? pclose(decoded) : -1;
+    remove(path);
+    printf("  %d packets decoded, %d expected\n", got, expected);
+    CHECK(status == 0, "%s exited with %d", cmd, status);
+    CHECK(got == expected && wrong == 0, "%d packets decoded, %d expected, %d fields wrong", got, expected, wrong);
+    return check_done("telemetry");
+}
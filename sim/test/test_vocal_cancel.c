@@ -0,0 +1,89 @@
+// uses: prod/VocalCancel prod/Biquad
+// vocal removal on tones: a centered tone inside the vocal band has to go, centered bass and cymbals and anything
+// out of phase between the channels have to stay. run in place over whole frames, the way main.c runs it
+#include <string.h>
+#include "check.h"
+#include "VocalCancel.h"
+
+#define RATE 44100
+#define FRAME 256 // stereo samples per call, FRAME_SIZE
+#define LEN (RATE / FRAME * FRAME)
+#define SETTLE (RATE / 5) // filters settled, 200 ms
+
+static int16_t pcm[LEN * 2];
+
+// level of the sinusoid at hz in channel ch, least squares over whole periods after the filters settle
+static double amplitude(int ch, double hz) {
+    size_t n = (size_t)((size_t)((LEN - SETTLE) * hz / RATE) * RATE / hz);
+    double c = 0, s = 0;
+    for (size_t i = 0; i < n; i++) {
+        double w = 2 * M_PI * hz * i / RATE;
+        c += pcm[2 * (SETTLE + i) + ch] * cos(w);
+        s += pcm[2 * (SETTLE + i) + ch] * sin(w);
+    }
+    return 2 * sqrt(c * c + s * s) / n;
+}
+
+// left gets a tone at hz and amplitude l, right the same tone at r. r = l is centered, r = -l is all side
+static void tone(double hz, double l, double r) {
+    for (size_t i = 0; i < LEN; i++) {
+        double s = sin(2 * M_PI * hz * (SETTLE + i) / RATE); // phase 0 where amplitude() starts
+        pcm[2 * i] = (int16_t)lrint(l * s);
+        pcm[2 * i + 1] = (int16_t)lrint(r * s);
+    }
+}
+
+static void run(vocal_cancel_t* vc, size_t offset) {
+    vocal_cancel_init(vc, RATE, VOCAL_CANCEL_LOW_HZ, VOCAL_CANCEL_HIGH_HZ);
+    vocal_cancel_set_enabled(vc, true);
+    static uint8_t bytes[FRAME * 4 + 1];
+    for (size_t i = 0; i < LEN; i += FRAME) {
+        if (offset == 0) { // in place, as main.c does
+            size_t got = vocal_cancel_process(vc, pcm + 2 * i, (const uint8_t*)(pcm + 2 * i), FRAME * 4);
+            CHECK(got == FRAME * 4, "wrote %zu bytes", got);
+        } else { // ringbuffer items aren't aligned
+            memcpy(bytes + offset, pcm + 2 * i, FRAME * 4);
+            vocal_cancel_process(vc, pcm + 2 * i, bytes + offset, FRAME * 4 + 1);
+        }
+    }
+}
+
+static double db(double x) {
+    return 20 * log10(x);
+}
+
+int main(void) {
+    static vocal_cancel_t vc;
+    vocal_cancel_init(&vc, RATE, VOCAL_CANCEL_LOW_HZ, VOCAL_CANCEL_HIGH_HZ);
+    CHECK(!vocal_cancel_enabled(&vc), "starts enabled");
+
+    // centered: cut inside the band, kept outside it. the 4th order edges give 24 dB an octave in from either end
+    struct { double hz, min_db, max_db; } centered[] = {
+        { 40, -1, 0.5 }, { 80, -1, 0.5 }, // bass
+        { 300, -200, -20 }, { 600, -200, -40 }, { 1000, -200, -40 }, { 1500, -200, -40 }, { 2500, -200, -20 }, // the voice
+        { 10000, -1, 0.5 }, { 15000, -1, 0.5 }, // cymbals
+    };
+    for (size_t c = 0; c < sizeof(centered) / sizeof(centered[0]); c++) {
+        tone(centered[c].hz, 16000, 16000);
+        run(&vc, c & 1);
+        for (int ch = 0; ch < 2; ch++) {
+            double gain = db(amplitude(ch, centered[c].hz) / 16000);
+            CHECK(gain >= centered[c].min_db && gain <= centered[c].max_db, "centered %.0f Hz, ch %d: %.1f dB, want %.0f..%.1f",
+                centered[c].hz, ch, gain, centered[c].min_db, centered[c].max_db);
+        }
+    }
+
+    // out of phase has no mid, so it comes through bit for bit
+    tone(1000, 16000, -16000);
+    static int16_t side[LEN * 2];
+    memcpy(side, pcm, sizeof(pcm));
+    run(&vc, 0);
+    CHECK(memcmp(side, pcm, sizeof(pcm)) == 0, "side only content changed");
+
+    // panned hard left inside the band: the centered half goes, the side half stays in both channels
+    tone(1000, 16000, 0);
+    run(&vc, 1);
+    double left = db(amplitude(0, 1000) / 8000), right = db(amplitude(1, 1000) / 8000);
+    CHECK(fabs(left) < 0.5 && fabs(right) < 0.5, "hard left 1 kHz: left %.1f dB, right %.1f dB of half level", left, right);
+    return check_done("vocal_cancel");
+}